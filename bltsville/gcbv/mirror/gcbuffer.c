@@ -65,6 +65,155 @@ GCDBG_FILTERDEF(buffer, GCZONE_NONE,
 )
 
 
+/*******************************************************************************
+ * Per-thread arena.
+ *
+ * Every blitting thread keeps the batches, command buffers and fixups it
+ * frees in its own arena and takes them from there again without locking.
+ * The shared caches in gccontext are only touched when the arena runs empty
+ * or is full, or when the thread exits.
+ */
+
+#define GC_ARENA_MAX_BATCHES	4
+#define GC_ARENA_MAX_BUFFERS	4
+#define GC_ARENA_MAX_FIXUPS	4
+
+struct gcarena {
+	/* Link in gccontext->arenalist. */
+	struct list_head link;
+
+	struct list_head batchvac;		/* gcbatch */
+	struct list_head buffervac;		/* gcbuffer */
+	struct list_head fixupvac;		/* gcfixup */
+
+	unsigned int batchcount;
+	unsigned int buffercount;
+	unsigned int fixupcount;
+};
+
+/* Returns the arena of the calling thread, NULL if it cannot be created. */
+static struct gcarena *get_arena(void)
+{
+	struct gccontext *gccontext = get_context();
+	struct gcarena *gcarena;
+
+	if (!gccontext->arenakeyvalid)
+		return NULL;
+
+	gcarena = pthread_getspecific(gccontext->arenakey);
+	if (gcarena != NULL)
+		return gcarena;
+
+	gcarena = gcalloc(struct gcarena, sizeof(struct gcarena));
+	if (gcarena == NULL)
+		return NULL;
+
+	INIT_LIST_HEAD(&gcarena->batchvac);
+	INIT_LIST_HEAD(&gcarena->buffervac);
+	INIT_LIST_HEAD(&gcarena->fixupvac);
+	gcarena->batchcount = 0;
+	gcarena->buffercount = 0;
+	gcarena->fixupcount = 0;
+
+	if (pthread_setspecific(gccontext->arenakey, gcarena)) {
+		gcfree(gcarena);
+		return NULL;
+	}
+
+	GCLOCK(&gccontext->arenalock);
+	list_add(&gcarena->link, &gccontext->arenalist);
+	GCUNLOCK(&gccontext->arenalock);
+
+	GCDBG(GCZONE_BATCH_ALLOC, "new arena = 0x%08X\n",
+	      (unsigned int) gcarena);
+
+	return gcarena;
+}
+
+/* Hands the contents of an arena back to the shared caches. */
+static void flush_arena(struct gcarena *gcarena)
+{
+	struct gccontext *gccontext = get_context();
+
+	GCLOCK(&gccontext->batchlock);
+	list_splice_init(&gcarena->batchvac, &gccontext->batchvac);
+	gcarena->batchcount = 0;
+	GCUNLOCK(&gccontext->batchlock);
+
+	GCLOCK(&gccontext->bufferlock);
+	list_splice_init(&gcarena->buffervac, &gccontext->buffervac);
+	gcarena->buffercount = 0;
+	GCUNLOCK(&gccontext->bufferlock);
+
+	GCLOCK(&gccontext->fixuplock);
+	list_splice_init(&gcarena->fixupvac, &gccontext->fixupvac);
+	gcarena->fixupcount = 0;
+	GCUNLOCK(&gccontext->fixuplock);
+}
+
+/* Thread exit destructor. */
+static void free_arena(void *arena)
+{
+	struct gccontext *gccontext = get_context();
+	struct gcarena *gcarena = (struct gcarena *) arena;
+
+	/* exit_arenas may have freed the arena already while this thread
+	 * was on its way out; it clears arenakeyvalid under the same lock. */
+	GCLOCK(&gccontext->arenalock);
+	if (!gccontext->arenakeyvalid) {
+		GCUNLOCK(&gccontext->arenalock);
+		return;
+	}
+	list_del(&gcarena->link);
+	GCUNLOCK(&gccontext->arenalock);
+
+	flush_arena(gcarena);
+	gcfree(gcarena);
+}
+
+void init_arenas(void)
+{
+	struct gccontext *gccontext = get_context();
+
+	INIT_LIST_HEAD(&gccontext->arenalist);
+
+	gccontext->arenakeyvalid
+		= (pthread_key_create(&gccontext->arenakey, free_arena) == 0);
+	if (!gccontext->arenakeyvalid)
+		GCERR("failed to create the arena key.\n");
+}
+
+void exit_arenas(void)
+{
+	struct gccontext *gccontext = get_context();
+	struct list_head *head;
+	struct gcarena *gcarena;
+
+	GCLOCK(&gccontext->arenalock);
+
+	if (!gccontext->arenakeyvalid) {
+		GCUNLOCK(&gccontext->arenalock);
+		return;
+	}
+
+	/* Once the key is deleted the destructor no longer runs, so free
+	 * the arenas of all threads, not only the one of the caller. */
+	while (!list_empty(&gccontext->arenalist)) {
+		head = gccontext->arenalist.next;
+		gcarena = list_entry(head, struct gcarena, link);
+		list_del(head);
+		flush_arena(gcarena);
+		gcfree(gcarena);
+	}
+
+	pthread_setspecific(gccontext->arenakey, NULL);
+	pthread_key_delete(gccontext->arenakey);
+	gccontext->arenakeyvalid = false;
+
+	GCUNLOCK(&gccontext->arenalock);
+}
+
+
 /*******************************************************************************
  * Batch/command buffer management.
  */
@@ -78,34 +227,53 @@ enum bverror do_end(__unused struct bvbltparams *bvbltparams,
 enum bverror allocate_batch(struct bvbltparams *bvbltparams,
 			    struct gcbatch **gcbatch)
 {
-	enum bverror bverror;
+	enum bverror bverror = BVERR_NONE;
 	struct gccontext *gccontext = get_context();
+	struct gcarena *gcarena = get_arena();
 	struct gcbatch *temp;
 	struct gcbuffer *gcbuffer;
+	struct list_head *head;
 
 	GCENTER(GCZONE_BATCH_ALLOC);
 
-	/* Lock access to batch management. */
-	GCLOCK(&gccontext->batchlock);
-
-	if (list_empty(&gccontext->batchvac)) {
-		temp = gcalloc(struct gcbatch, sizeof(struct gcbatch));
-		if (temp == NULL) {
-			BVSETBLTERROR(BVERR_OOM,
-				      "batch header allocation failed");
-			goto exit;
-		}
-
-		GCDBG(GCZONE_BATCH_ALLOC, "allocated new batch = 0x%08X\n",
-		      (unsigned int) temp);
-	} else {
-		struct list_head *head;
-		head = gccontext->batchvac.next;
+	if ((gcarena != NULL) && !list_empty(&gcarena->batchvac)) {
+		head = gcarena->batchvac.next;
 		temp = list_entry(head, struct gcbatch, link);
 		list_del(head);
+		gcarena->batchcount -= 1;
 
-		GCDBG(GCZONE_BATCH_ALLOC, "reusing batch = 0x%08X\n",
+		GCDBG(GCZONE_BATCH_ALLOC, "reusing arena batch = 0x%08X\n",
 		      (unsigned int) temp);
+	} else {
+		/* Lock access to batch management. */
+		GCLOCK(&gccontext->batchlock);
+
+		if (list_empty(&gccontext->batchvac)) {
+			temp = NULL;
+		} else {
+			head = gccontext->batchvac.next;
+			temp = list_entry(head, struct gcbatch, link);
+			list_del(head);
+
+			GCDBG(GCZONE_BATCH_ALLOC, "reusing batch = 0x%08X\n",
+			      (unsigned int) temp);
+		}
+
+		/* Unlock access to batch management. */
+		GCUNLOCK(&gccontext->batchlock);
+
+		if (temp == NULL) {
+			temp = gcalloc(struct gcbatch, sizeof(struct gcbatch));
+			if (temp == NULL) {
+				BVSETBLTERROR(BVERR_OOM,
+					      "batch header allocation failed");
+				goto exit;
+			}
+
+			GCDBG(GCZONE_BATCH_ALLOC,
+			      "allocated new batch = 0x%08X\n",
+			      (unsigned int) temp);
+		}
 	}
 
 	memset(temp, 0, sizeof(struct gcbatch));
@@ -127,9 +295,6 @@ enum bverror allocate_batch(struct bvbltparams *bvbltparams,
 	      (unsigned int) temp);
 
 exit:
-	/* Unlock access to batch management. */
-	GCUNLOCK(&gccontext->batchlock);
-
 	GCEXITARG(GCZONE_BATCH_ALLOC, "bv%s = %d\n",
 		  (bverror == BVERR_NONE) ? "result" : "error", bverror);
 	return bverror;
@@ -139,19 +304,25 @@ void free_batch(struct gcbatch *gcbatch)
 {
 	struct list_head *head;
 	struct gccontext *gccontext = get_context();
+	struct gcarena *gcarena = get_arena();
 	struct gcbuffer *gcbuffer;
+	struct list_head batchspill;
+	struct list_head bufferspill;
+	struct list_head fixupspill;
 
 	GCENTERARG(GCZONE_BATCH_ALLOC, "batch = 0x%08X\n",
 		   (unsigned int) gcbatch);
 
-	/* Lock access. */
-	GCLOCK(&gccontext->batchlock);
-	GCLOCK(&gccontext->bufferlock);
-	GCLOCK(&gccontext->fixuplock);
-	GCLOCK(&gccontext->maplock);
+	INIT_LIST_HEAD(&batchspill);
+	INIT_LIST_HEAD(&bufferspill);
+	INIT_LIST_HEAD(&fixupspill);
 
 	/* Free implicit unmappings. */
-	list_splice_init(&gcbatch->unmap, &gccontext->unmapvac);
+	if (!list_empty(&gcbatch->unmap)) {
+		GCLOCK(&gccontext->maplock);
+		list_splice_init(&gcbatch->unmap, &gccontext->unmapvac);
+		GCUNLOCK(&gccontext->maplock);
+	}
 
 	/* Free command buffers. */
 	while (!list_empty(&gcbatch->buffer)) {
@@ -159,20 +330,54 @@ void free_batch(struct gcbatch *gcbatch)
 		gcbuffer = list_entry(head, struct gcbuffer, link);
 
 		/* Free fixups. */
-		list_splice_init(&gcbuffer->fixup, &gccontext->fixupvac);
+		while (!list_empty(&gcbuffer->fixup)) {
+			head = gcbuffer->fixup.next;
+			if ((gcarena != NULL) &&
+			    (gcarena->fixupcount < GC_ARENA_MAX_FIXUPS)) {
+				list_move(head, &gcarena->fixupvac);
+				gcarena->fixupcount += 1;
+			} else {
+				list_move(head, &fixupspill);
+			}
+		}
 
 		/* Free the command buffer. */
-		list_move(&gcbuffer->link, &gccontext->buffervac);
+		if ((gcarena != NULL) &&
+		    (gcarena->buffercount < GC_ARENA_MAX_BUFFERS)) {
+			list_move(&gcbuffer->link, &gcarena->buffervac);
+			gcarena->buffercount += 1;
+		} else {
+			list_move(&gcbuffer->link, &bufferspill);
+		}
 	}
 
 	/* Free the batch. */
-	list_add(&gcbatch->link, &gccontext->batchvac);
+	if ((gcarena != NULL) &&
+	    (gcarena->batchcount < GC_ARENA_MAX_BATCHES)) {
+		list_add(&gcbatch->link, &gcarena->batchvac);
+		gcarena->batchcount += 1;
+	} else {
+		list_add(&gcbatch->link, &batchspill);
+	}
 
-	/* Unlock access. */
-	GCUNLOCK(&gccontext->maplock);
-	GCUNLOCK(&gccontext->fixuplock);
-	GCUNLOCK(&gccontext->bufferlock);
-	GCUNLOCK(&gccontext->batchlock);
+	/* Return what did not fit the arena to the shared caches. */
+	if (!list_empty(&batchspill)) {
+		GCLOCK(&gccontext->batchlock);
+		list_splice_init(&batchspill, &gccontext->batchvac);
+		GCUNLOCK(&gccontext->batchlock);
+	}
+
+	if (!list_empty(&bufferspill)) {
+		GCLOCK(&gccontext->bufferlock);
+		list_splice_init(&bufferspill, &gccontext->buffervac);
+		GCUNLOCK(&gccontext->bufferlock);
+	}
+
+	if (!list_empty(&fixupspill)) {
+		GCLOCK(&gccontext->fixuplock);
+		list_splice_init(&fixupspill, &gccontext->fixupvac);
+		GCUNLOCK(&gccontext->fixuplock);
+	}
 
 	GCEXIT(GCZONE_BATCH_ALLOC);
 }
@@ -181,37 +386,55 @@ enum bverror append_buffer(struct bvbltparams *bvbltparams,
 			   struct gcbatch *gcbatch,
 			   struct gcbuffer **gcbuffer)
 {
-	enum bverror bverror;
+	enum bverror bverror = BVERR_NONE;
 	struct gccontext *gccontext = get_context();
+	struct gcarena *gcarena = get_arena();
 	struct gcbuffer *temp;
+	struct list_head *head;
 
 	GCENTERARG(GCZONE_BUFFER_ALLOC, "batch = 0x%08X\n",
 		   (unsigned int) gcbatch);
 
-	/* Lock access to buffer management. */
-	GCLOCK(&gccontext->bufferlock);
+	if ((gcarena != NULL) && !list_empty(&gcarena->buffervac)) {
+		head = gcarena->buffervac.next;
+		temp = list_entry(head, struct gcbuffer, link);
+		list_move_tail(&temp->link, &gcbatch->buffer);
+		gcarena->buffercount -= 1;
 
-	if (list_empty(&gccontext->buffervac)) {
-		temp = gcalloc(struct gcbuffer, GC_BUFFER_SIZE);
-		if (temp == NULL) {
-			BVSETBLTERROR(BVERR_OOM,
-				      "command buffer allocation failed");
-			goto exit;
+		GCDBG(GCZONE_BUFFER_ALLOC, "reusing arena buffer = 0x%08X\n",
+		      (unsigned int) temp);
+	} else {
+		/* Lock access to buffer management. */
+		GCLOCK(&gccontext->bufferlock);
+
+		if (list_empty(&gccontext->buffervac)) {
+			temp = NULL;
+		} else {
+			head = gccontext->buffervac.next;
+			temp = list_entry(head, struct gcbuffer, link);
+			list_move_tail(&temp->link, &gcbatch->buffer);
+
+			GCDBG(GCZONE_BUFFER_ALLOC, "reusing buffer = 0x%08X\n",
+			      (unsigned int) temp);
 		}
 
-		list_add_tail(&temp->link, &gcbatch->buffer);
+		/* Unlock access to buffer management. */
+		GCUNLOCK(&gccontext->bufferlock);
 
-		GCDBG(GCZONE_BUFFER_ALLOC, "allocated new buffer = 0x%08X\n",
-		      (unsigned int) temp);
-	} else {
-		struct list_head *head;
-		head = gccontext->buffervac.next;
-		temp = list_entry(head, struct gcbuffer, link);
+		if (temp == NULL) {
+			temp = gcalloc(struct gcbuffer, GC_BUFFER_SIZE);
+			if (temp == NULL) {
+				BVSETBLTERROR(BVERR_OOM,
+					      "command buffer allocation failed");
+				goto exit;
+			}
 
-		list_move_tail(&temp->link, &gcbatch->buffer);
+			list_add_tail(&temp->link, &gcbatch->buffer);
 
-		GCDBG(GCZONE_BUFFER_ALLOC, "reusing buffer = 0x%08X\n",
-		      (unsigned int) temp);
+			GCDBG(GCZONE_BUFFER_ALLOC,
+			      "allocated new buffer = 0x%08X\n",
+			      (unsigned int) temp);
+		}
 	}
 
 	INIT_LIST_HEAD(&temp->fixup);
@@ -223,12 +446,8 @@ enum bverror append_buffer(struct bvbltparams *bvbltparams,
 	      (unsigned int) temp);
 
 	*gcbuffer = temp;
-	bverror = BVERR_NONE;
 
 exit:
-	/* Unlock access to buffer management. */
-	GCUNLOCK(&gccontext->bufferlock);
-
 	GCEXITARG(GCZONE_BUFFER_ALLOC, "bv%s = %d\n",
 		  (bverror == BVERR_NONE) ? "result" : "error", bverror);
 	return bverror;
@@ -240,29 +459,52 @@ static enum bverror allocate_fixup(struct bvbltparams *bvbltparams,
 {
 	enum bverror bverror = BVERR_NONE;
 	struct gccontext *gccontext = get_context();
+	struct gcarena *gcarena = get_arena();
 	struct gcfixup *temp;
+	struct list_head *head;
 
-	if (list_empty(&gccontext->fixupvac)) {
-		temp = gcalloc(struct gcfixup, sizeof(struct gcfixup));
-		if (temp == NULL) {
-			BVSETBLTERROR(BVERR_OOM, "fixup allocation failed");
-			goto exit;
-		}
-
-		list_add_tail(&temp->link, &gcbuffer->fixup);
+	if ((gcarena != NULL) && !list_empty(&gcarena->fixupvac)) {
+		head = gcarena->fixupvac.next;
+		temp = list_entry(head, struct gcfixup, link);
+		list_move_tail(&temp->link, &gcbuffer->fixup);
+		gcarena->fixupcount -= 1;
 
 		GCDBG(GCZONE_FIXUP_ALLOC,
-		      "new fixup struct allocated = 0x%08X\n",
+		      "arena fixup struct reused = 0x%08X\n",
 		      (unsigned int) temp);
 	} else {
-		struct list_head *head;
-		head = gccontext->fixupvac.next;
-		temp = list_entry(head, struct gcfixup, link);
+		/* Lock access to fixup management. */
+		GCLOCK(&gccontext->fixuplock);
 
-		list_move_tail(&temp->link, &gcbuffer->fixup);
+		if (list_empty(&gccontext->fixupvac)) {
+			temp = NULL;
+		} else {
+			head = gccontext->fixupvac.next;
+			temp = list_entry(head, struct gcfixup, link);
+			list_move_tail(&temp->link, &gcbuffer->fixup);
+
+			GCDBG(GCZONE_FIXUP_ALLOC,
+			      "fixup struct reused = 0x%08X\n",
+			      (unsigned int) temp);
+		}
+
+		/* Unlock access to fixup management. */
+		GCUNLOCK(&gccontext->fixuplock);
+
+		if (temp == NULL) {
+			temp = gcalloc(struct gcfixup, sizeof(struct gcfixup));
+			if (temp == NULL) {
+				BVSETBLTERROR(BVERR_OOM,
+					      "fixup allocation failed");
+				goto exit;
+			}
 
-		GCDBG(GCZONE_FIXUP_ALLOC, "fixup struct reused = 0x%08X\n",
-			(unsigned int) temp);
+			list_add_tail(&temp->link, &gcbuffer->fixup);
+
+			GCDBG(GCZONE_FIXUP_ALLOC,
+			      "new fixup struct allocated = 0x%08X\n",
+			      (unsigned int) temp);
+		}
 	}
 
 	temp->count = 0;
@@ -278,7 +520,6 @@ enum bverror add_fixup(struct bvbltparams *bvbltparams,
 		       unsigned int surfoffset)
 {
 	enum bverror bverror = BVERR_NONE;
-	struct gccontext *gccontext = get_context();
 	struct list_head *head;
 	struct gcbuffer *buffer;
 	struct gcfixup *gcfixup;
@@ -286,9 +527,6 @@ enum bverror add_fixup(struct bvbltparams *bvbltparams,
 	GCENTERARG(GCZONE_FIXUP, "batch = 0x%08X, fixup ptr = 0x%08X\n",
 		   (unsigned int) gcbatch, (unsigned int) ptr);
 
-	/* Lock access to fixup management. */
-	GCLOCK(&gccontext->fixuplock);
-
 	/* Get the current command buffer. */
 	if (list_empty(&gcbatch->buffer)) {
 		GCERR("no command buffers are allocated");
@@ -329,9 +567,6 @@ enum bverror add_fixup(struct bvbltparams *bvbltparams,
 	GCDBG(GCZONE_FIXUP, "surface offset = 0x%08X\n", surfoffset);
 
 exit:
-	/* Unlock access to fixup management. */
-	GCUNLOCK(&gccontext->fixuplock);
-
 	GCEXITARG(GCZONE_FIXUP, "bv%s = %d\n",
 		  (bverror == BVERR_NONE) ? "result" : "error", bverror);
 	return bverror;
@@ -1120,6 +1120,10 @@ void bv_init(void)
 	GCLOCK_INIT(&gccontext->fixuplock);
 	GCLOCK_INIT(&gccontext->maplock);
 	GCLOCK_INIT(&gccontext->callbacklock);
+	GCLOCK_INIT(&gccontext->arenalock);
+
+	/* Initialize the per-thread arenas. */
+	init_arenas();
 
 	INIT_LIST_HEAD(&gccontext->unmapvac);
 	INIT_LIST_HEAD(&gccontext->buffervac);
@@ -1130,7 +1134,7 @@ void bv_init(void)
 
 	/* Initialize the filter cache. */
 	for (i = 0; i < GC_FILTER_COUNT; i += 1)
-		for (j = 0; j < GC_TAP_COUNT; j += 1)
+		for (j = 0; j <= GC_TAP_COUNT; j += 1)
 			INIT_LIST_HEAD(&gccontext->filtercache[i][j].list);
 
 	/* Query hardware caps. */
@@ -1158,6 +1162,13 @@ void bv_exit(void)
 	struct gcfixup *gcfixup;
 	struct gcbatch *gcbatch;
 	struct gccallbackinfo *gccallbackinfo;
+	struct gcfiltercache *filtercache;
+	struct gcfilterkernel *gcfilterkernel;
+	int i, j, k;
+
+	/* Return the arenas of all threads to the shared caches. */
+	exit_arenas();
+	GCLOCK_DESTROY(&gccontext->arenalock);
 
 	while (gccontext->buffmapvac != NULL) {
 		bvbuffmap = gccontext->buffmapvac;
@@ -1205,6 +1216,28 @@ void bv_exit(void)
 		gcfree(gccallbackinfo);
 	}
 
+	for (i = 0; i < GC_FILTER_COUNT; i += 1) {
+		for (j = 0; j <= GC_TAP_COUNT; j += 1) {
+			filtercache = &gccontext->filtercache[i][j];
+
+			while (!list_empty(&filtercache->list)) {
+				head = filtercache->list.next;
+				gcfilterkernel = list_entry(head,
+							    struct gcfilterkernel,
+							    link);
+				list_del(head);
+				gcfree(gcfilterkernel);
+			}
+			filtercache->count = 0;
+
+			for (k = 0; k < GC_FILTER_PRESET_COUNT; k += 1) {
+				gcfree(filtercache->preset[k]);
+				filtercache->preset[k] = NULL;
+			}
+		}
+	}
+	gccontext->loadedfilter = NULL;
+
 	free_temp(false);
 }
 
@@ -112,6 +112,7 @@ do { \
 #define GC_PHASE_LOAD_COUNT	(GC_PHASE_MAX_COUNT / 2 + 1)
 #define GC_COEFFICIENT_COUNT	(GC_PHASE_LOAD_COUNT * GC_TAP_COUNT)
 #define GC_FILTER_CACHE_MAX	10
+#define GC_FILTER_PRESET_COUNT	12
 
 enum gcfiltertype {
 	GC_FILTER_SYNC,
@@ -121,12 +122,17 @@ enum gcfiltertype {
 	GC_FILTER_COUNT
 };
 
+/* Cache key of upscaling kernels; the coefficients of all upscaling
+ * ratios are the same. */
+#define GC_FILTER_UPSCALE	(~0U)
+
 struct gcfilterkernel {
 	enum gcfiltertype type;
 	unsigned int kernelsize;
 	unsigned int srcsize;
 	unsigned int dstsize;
 	unsigned int scalefactor;
+	unsigned int filterkey;
 	short kernelarray[GC_COEFFICIENT_COUNT];
 	struct list_head link;
 };
@@ -134,6 +140,28 @@ struct gcfilterkernel {
 struct gcfiltercache {
 	unsigned int count;
 	struct list_head list;			/* gcfilterkernel */
+
+	/* Kernels of the common video scale ratios; computed once and
+	 * never evicted. */
+	struct gcfilterkernel *preset[GC_FILTER_PRESET_COUNT];
+};
+
+/* Kernel arrays of the GPU. */
+enum gckernelarray {
+	GC_KERNEL_SHARED,
+	GC_KERNEL_HORIZONTAL,
+	GC_KERNEL_VERTICAL,
+
+	/* Number of kernel arrays. */
+	GC_KERNEL_ARRAY_COUNT
+};
+
+/* Kernel held by a kernel array of the GPU. */
+struct gcloadedkernel {
+	bool valid;
+	enum gcfiltertype type;
+	unsigned int kernelsize;
+	unsigned int filterkey;
 };
 
 
@@ -167,16 +195,25 @@ struct gccontext {
 	struct list_head callbacklist;		/* gccallbackinfo */
 	struct list_head callbackvac;		/* gccallbackinfo */
 
+	/* Per-thread caches of batches, command buffers and fixups
+	 * (gcarena); the shared caches above are only used when a thread
+	 * cache runs empty or full. All arenas are also on arenalist so
+	 * that bv_exit can free those of threads still running. */
+	pthread_key_t arenakey;
+	bool arenakeyvalid;
+	struct list_head arenalist;		/* gcarena */
+
 	/* Access locks. */
 	GCLOCK_TYPE batchlock;
 	GCLOCK_TYPE bufferlock;
 	GCLOCK_TYPE fixuplock;
 	GCLOCK_TYPE maplock;
 	GCLOCK_TYPE callbacklock;
+	GCLOCK_TYPE arenalock;
 
 	/* Kernel table cache. */
 	struct gcfilterkernel *loadedfilter;	/* gcfilterkernel */
-	struct gcfiltercache filtercache[GC_FILTER_COUNT][GC_TAP_COUNT];
+	struct gcfiltercache filtercache[GC_FILTER_COUNT][GC_TAP_COUNT + 1];
 
 	/* Temporary buffer descriptor. */
 	struct bvbuffdesc *tmpbuffdesc;
@@ -466,6 +503,10 @@ struct gcbatch {
 	int dstoffsetX;
 	int dstoffsetY;
 
+	/* Filter kernels loaded by the batch; the GPU state is only
+	 * known to be preserved within the same batch. */
+	struct gcloadedkernel loadedkernel[GC_KERNEL_ARRAY_COUNT];
+
 #if GCDEBUG_ENABLE
 	/* Rectangle validation storage. */
 	struct bvrect prevdstrect;
@@ -527,6 +568,8 @@ enum bverror do_map(struct bvbuffdesc *bvbuffdesc,
 void do_unmap_implicit(struct gcbatch *gcbatch);
 
 /* Batch/command buffer management. */
+void init_arenas(void);
+void exit_arenas(void);
 enum bverror do_end(struct bvbltparams *bvbltparams,
 		    struct gcbatch *gcbatch);
 enum bverror allocate_batch(struct bvbltparams *bvbltparams,
@@ -459,6 +459,63 @@ static void calculate_sync_filter(struct gcfilterkernel *gcfilterkernel)
 }
 
 
+/*******************************************************************************
+ * Compute the scale factor.
+ */
+
+static inline unsigned int get_scale_factor(unsigned int srcsize,
+					    unsigned int dstsize)
+{
+	if ((srcsize <= 1) || (dstsize <= 1))
+		return 0;
+
+	return ((srcsize - 1) << 16) / (dstsize - 1);
+}
+
+
+/*******************************************************************************
+ * Common video scale ratios; 1080p and 720p content to the usual panel sizes.
+ */
+
+static const struct {
+	unsigned int srcsize;
+	unsigned int dstsize;
+} filterpresets[GC_FILTER_PRESET_COUNT] = {
+	{ 1920, 1280 }, { 1920, 1024 }, { 1920, 800 }, { 1920, 720 },
+	{ 1080, 800 }, { 1080, 768 }, { 1080, 720 }, { 1080, 600 },
+	{ 1280, 1024 }, { 1280, 800 }, { 720, 600 }, { 720, 480 }
+};
+
+/* Returns the preset slot for the scale ratio or -1 if it is not common. */
+static int find_preset(unsigned int srcsize, unsigned int dstsize)
+{
+	unsigned int scalefactor;
+	int i;
+
+	if (dstsize >= srcsize)
+		return -1;
+
+	scalefactor = get_scale_factor(srcsize, dstsize);
+	for (i = 0; i < GC_FILTER_PRESET_COUNT; i += 1)
+		if (get_scale_factor(filterpresets[i].srcsize,
+				     filterpresets[i].dstsize) == scalefactor)
+			return i;
+
+	return -1;
+}
+
+static enum gckernelarray get_kernel_array(struct gccmdldstate arraystate)
+{
+	if (arraystate.address == gcmofilterkernel_horizontal_ldst.address)
+		return GC_KERNEL_HORIZONTAL;
+
+	if (arraystate.address == gcmofilterkernel_vertical_ldst.address)
+		return GC_KERNEL_VERTICAL;
+
+	return GC_KERNEL_SHARED;
+}
+
+
 /*******************************************************************************
  * Loads a filter into the GPU.
  */
@@ -479,17 +536,33 @@ static enum bverror load_filter(struct bvbltparams *bvbltparams,
 	struct list_head *filterhead;
 	struct gcfilterkernel *gcfilterkernel;
 	struct gcmofilterkernel *gcmofilterkernel;
+	struct gcloadedkernel *loadedkernel;
+	unsigned int filterkey;
+	int preset, i;
 
 	GCDBG(GCZONE_KERNEL, "kernelsize = %d\n", kernelsize);
 	GCDBG(GCZONE_KERNEL, "srcsize = %d\n", srcsize);
 	GCDBG(GCZONE_KERNEL, "dstsize = %d\n", dstsize);
 	GCDBG(GCZONE_KERNEL, "scalefactor = 0x%08X\n", scalefactor);
 
-	/* Is the filter already loaded? */
+	/* All upscaling ratios share the same kernel. */
+	filterkey = (dstsize >= srcsize) ? GC_FILTER_UPSCALE : scalefactor;
+
+	/* Is the kernel already in the GPU array? */
+	loadedkernel = &batch->loadedkernel[get_kernel_array(arraystate)];
+	if (loadedkernel->valid &&
+	    (loadedkernel->type == type) &&
+	    (loadedkernel->kernelsize == kernelsize) &&
+	    (loadedkernel->filterkey == filterkey)) {
+		GCDBG(GCZONE_KERNEL, "filter already loaded.\n");
+		goto exit;
+	}
+
+	/* Is the filter already computed? */
 	if ((gccontext->loadedfilter != NULL) &&
 	    (gccontext->loadedfilter->type == type) &&
 	    (gccontext->loadedfilter->kernelsize == kernelsize) &&
-	    (gccontext->loadedfilter->scalefactor == scalefactor)) {
+	    (gccontext->loadedfilter->filterkey == filterkey)) {
 		GCDBG(GCZONE_KERNEL, "filter already computed.\n");
 		gcfilterkernel = gccontext->loadedfilter;
 		goto load;
@@ -499,13 +572,24 @@ static enum bverror load_filter(struct bvbltparams *bvbltparams,
 	filtercache = &gccontext->filtercache[type][kernelsize];
 	filterlist = &filtercache->list;
 
+	/* Try the common ratios first. */
+	for (i = 0; i < GC_FILTER_PRESET_COUNT; i += 1) {
+		gcfilterkernel = filtercache->preset[i];
+		if ((gcfilterkernel != NULL) &&
+		    (gcfilterkernel->filterkey == filterkey)) {
+			GCDBG(GCZONE_KERNEL, "preset filter found @ 0x%08X.\n",
+			      (unsigned int) gcfilterkernel);
+			goto load;
+		}
+	}
+
 	/* Try to find existing filter. */
 	GCDBG(GCZONE_KERNEL, "scanning for existing filter.\n");
 	list_for_each(filterhead, filterlist) {
 		gcfilterkernel = list_entry(filterhead,
 					    struct gcfilterkernel,
 					    link);
-		if (gcfilterkernel->scalefactor == scalefactor) {
+		if (gcfilterkernel->filterkey == filterkey) {
 			GCDBG(GCZONE_KERNEL, "filter found @ 0x%08X.\n",
 			      (unsigned int) gcfilterkernel);
 			break;
@@ -521,7 +605,21 @@ static enum bverror load_filter(struct bvbltparams *bvbltparams,
 		}
 	} else {
 		GCDBG(GCZONE_KERNEL, "filter not found.\n");
-		if (filtercache->count == GC_FILTER_CACHE_MAX) {
+		preset = find_preset(srcsize, dstsize);
+		if (preset >= 0) {
+			GCDBG(GCZONE_KERNEL, "allocating preset filter %d.\n",
+			      preset);
+			gcfilterkernel = gcalloc(struct gcfilterkernel,
+						 sizeof(struct gcfilterkernel));
+			if (gcfilterkernel == NULL) {
+				BVSETBLTERROR(BVERR_OOM,
+					      "filter allocation failed");
+				goto exit;
+			}
+
+			INIT_LIST_HEAD(&gcfilterkernel->link);
+			filtercache->preset[preset] = gcfilterkernel;
+		} else if (filtercache->count == GC_FILTER_CACHE_MAX) {
 			GCDBG(GCZONE_KERNEL,
 			      "reached the maximum number of filters.\n");
 			filterhead = filterlist->prev;
@@ -541,10 +639,10 @@ static enum bverror load_filter(struct bvbltparams *bvbltparams,
 			}
 
 			list_add(&gcfilterkernel->link, filterlist);
-		}
 
-		/* Update the number of filters. */
-		filtercache->count += 1;
+			/* Update the number of filters. */
+			filtercache->count += 1;
+		}
 
 		/* Initialize the filter. */
 		gcfilterkernel->type = type;
@@ -552,6 +650,7 @@ static enum bverror load_filter(struct bvbltparams *bvbltparams,
 		gcfilterkernel->srcsize = srcsize;
 		gcfilterkernel->dstsize = dstsize;
 		gcfilterkernel->scalefactor = scalefactor;
+		gcfilterkernel->filterkey = filterkey;
 
 		/* Compute the coefficients. */
 		calculate_sync_filter(gcfilterkernel);
@@ -575,25 +674,17 @@ load:
 	/* Set the filter. */
 	gccontext->loadedfilter = gcfilterkernel;
 
+	/* Remember what the GPU array holds. */
+	loadedkernel->valid = true;
+	loadedkernel->type = type;
+	loadedkernel->kernelsize = kernelsize;
+	loadedkernel->filterkey = filterkey;
+
 exit:
 	return bverror;
 }
 
 
-/*******************************************************************************
- * Compute the scale factor.
- */
-
-static inline unsigned int get_scale_factor(unsigned int srcsize,
-					    unsigned int dstsize)
-{
-	if ((srcsize <= 1) || (dstsize <= 1))
-		return 0;
-
-	return ((srcsize - 1) << 16) / (dstsize - 1);
-}
-
-
 /*******************************************************************************
  * Rotates the specified rectangle to the specified angle.
  */
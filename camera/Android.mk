@@ -124,9 +124,11 @@ TI_CAMERAHAL_COMMON_SRC := \
     BaseCameraAdapter.cpp \
     MemoryManager.cpp \
     Encoder_libjpeg.cpp \
+    StripeEncoder_libjpeg.cpp \
     Decoder_libjpeg.cpp \
     SensorListener.cpp  \
     NV12_resize.cpp \
+    PixelConvert.cpp \
     CameraParameters.cpp \
     TICameraParameters.cpp \
     CameraHalCommon.cpp \
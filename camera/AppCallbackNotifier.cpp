@@ -21,6 +21,7 @@
 #include <ui/GraphicBuffer.h>
 #include <ui/GraphicBufferMapper.h>
 #include "NV12_resize.h"
+#include "PixelConvert.h"
 #include "TICameraParameters.h"
 
 namespace Ti {
@@ -491,7 +492,6 @@ static void copy2Dto1D(void *dst,
     unsigned int alignedRow, row;
     unsigned char *bufferDst, *bufferSrc;
     unsigned char *bufferDstEnd, *bufferSrcEnd;
-    uint16_t *bufferSrc_UV;
 
     unsigned int *y_uv = (unsigned int *)src;
 
@@ -505,42 +505,16 @@ static void copy2Dto1D(void *dst,
             uint32_t xOff = offset % stride;
             uint32_t yOff = offset / stride;
             uint8_t *bufferSrcUV = ((uint8_t*)y_uv[1] + (stride/2)*yOff + xOff);
-            uint8_t *bufferSrcUVEven = bufferSrcUV;
+            uint8_t *bufferDstYUYV = ( uint8_t * ) dst;
+            size_t pairs = width & ~1;
 
-            uint8_t *bufferDstY = ( uint8_t * ) dst;
-            uint8_t *bufferDstU = bufferDstY + 1;
-            uint8_t *bufferDstV = bufferDstY + 3;
-
-            // going to convert from NV12 here and return
+            // going to convert from NV12 here and return, every UV row
+            // serves two Y rows
             for ( int i = 0 ; i < height; i ++ ) {
-                for ( int j = 0 ; j < width / 2 ; j++ ) {
-
-                    // Y
-                    *bufferDstY = *bufferSrc;
-                    bufferSrc++;
-                    bufferDstY += 2;
-
-                    *bufferDstY = *bufferSrc;
-                    bufferSrc++;
-                    bufferDstY += 2;
-
-                    // V
-                    *bufferDstV = *(bufferSrcUV + 1);
-                    bufferDstV += 4;
-
-                    // U
-                    *bufferDstU = *bufferSrcUV;
-                    bufferDstU += 4;
-
-                    bufferSrcUV += 2;
-                }
-                if ( i % 2 ) {
-                    bufferSrcUV += ( stride - width);
-                    bufferSrcUVEven = bufferSrcUV;
-                } else {
-                    bufferSrcUV = bufferSrcUVEven;
-                }
-                bufferSrc += ( stride - width);
+                PixelConvert::mergePairs(bufferSrc, bufferSrcUV + (i / 2) * stride,
+                                         bufferDstYUYV, pairs);
+                bufferSrc += stride;
+                bufferDstYUYV += pairs * 2;
             }
 
             return;
@@ -552,8 +526,6 @@ static void copy2Dto1D(void *dst,
             bufferSrc = ( unsigned char * ) y_uv[0] + offset;
             bufferSrcEnd = ( unsigned char * ) ( ( size_t ) y_uv[0] + length + offset);
             row = width*bytesPerPixel;
-            alignedRow = stride-width;
-            int stride_bytes = stride / 8;
             uint32_t xOff = offset % stride;
             uint32_t yOff = offset / stride;
 
@@ -568,66 +540,17 @@ static void copy2Dto1D(void *dst,
                 }
             }
 
-            bufferSrc_UV = ( uint16_t * ) ((uint8_t*)y_uv[1] + (stride/2)*yOff + xOff);
+            uint8_t *bufferSrcUV = ((uint8_t*)y_uv[1] + (stride/2)*yOff + xOff);
 
             if (strcmp(pixelFormat, android::CameraParameters::PIXEL_FORMAT_YUV420SP) == 0) {
-                 uint16_t *bufferDst_UV;
+                uint8_t *bufferDstUV = ((uint8_t*)dst) + row*height;
 
                 // Step 2: UV plane: convert NV12 to NV21 by swapping U & V
-                bufferDst_UV = (uint16_t *) (((uint8_t*)dst)+row*height);
-
-#ifdef ARCH_ARM_HAVE_NEON
-                for (int i = 0 ; i < height/2 ; i++, bufferSrc_UV += alignedRow/2) {
-                    int n = width;
-                    asm volatile (
-                    "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   blt 1f                                                      \n\t"
-                    "0: @ 32 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #32                                         \n\t"
-                    "   vld2.8  {q0, q1} , [%[src]]!                                \n\t"
-                    "   vswp q0, q1                                                 \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   vst2.8  {q0,q1},[%[dst]]!                                   \n\t"
-                    "   bge 0b                                                      \n\t"
-                    "1: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   blt 3f                                                      \n\t"
-                    "2: @ 16 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #16                                         \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   vswp d0, d1                                                 \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   vst2.8  {d0,d1},[%[dst]]!                                   \n\t"
-                    "   bge 2b                                                      \n\t"
-                    "3: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   blt 5f                                                      \n\t"
-                    "4: @ 8 byte swap                                               \n\t"
-                    "   sub %[n], %[n], #8                                          \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   vswp d0, d1                                                 \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   vst2.8  {d0[0],d1[0]},[%[dst]]!                             \n\t"
-                    "   bge 4b                                                      \n\t"
-                    "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-                    "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-                    : [dst] "+r" (bufferDst_UV), [src] "+r" (bufferSrc_UV), [n] "+r" (n)
-                    : [src_stride] "r" (stride_bytes)
-                    : "cc", "memory", "q0", "q1"
-                    );
-                }
-#else
                 for ( int i = 0; i < height/2; ++i ) {
-                    for ( int j = 0; j < width/2; ++j ) {
-                        bufferDst_UV[j] = (bufferSrc_UV[j] >> 8) | (bufferSrc_UV[j] << 8);
-                    }
-                    bufferSrc_UV += stride/bytesPerPixel/2;
-                    bufferDst_UV += width/2;
+                    PixelConvert::swapPairs(bufferSrcUV, bufferDstUV, width/2);
+                    bufferSrcUV += stride;
+                    bufferDstUV += width;
                 }
-#endif
             } else if (strcmp(pixelFormat, android::CameraParameters::PIXEL_FORMAT_YUV420P) == 0) {
                 // Step 2: UV plane: convert NV12 to YV12 by de-interleaving U & V
                 // TODO(XXX): This version of CameraHal assumes NV12 format it set at
@@ -637,72 +560,15 @@ static void copy2Dto1D(void *dst,
                 size_t yStride, uvStride, ySize, uvSize, size;
                 alignYV12(width, height, yStride, uvStride, ySize, uvSize, size);
 
-                uint16_t *bufferDst_V = (uint16_t *) (((uint8_t*)dst) + ySize);
-                uint16_t *bufferDst_U = (uint16_t *) (((uint8_t*)dst) + ySize + uvSize);
-
-#ifdef ARCH_ARM_HAVE_NEON
-                int inc = (uvStride - width/2)/2;
-
-                for (int i = 0 ; i < height/2 ; i++, bufferSrc_UV += alignedRow/2) {
-                    int n = width;
-                    asm volatile (
-                    "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   blt 1f                                                      \n\t"
-                    "0: @ 32 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #32                                         \n\t"
-                    "   vld2.8  {q0, q1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   vst1.8  {q1},[%[dst_v]]!                                    \n\t"
-                    "   vst1.8  {q0},[%[dst_u]]!                                    \n\t"
-                    "   bge 0b                                                      \n\t"
-                    "1: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   blt 3f                                                      \n\t"
-                    "2: @ 16 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #16                                         \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   vst1.8  {d1},[%[dst_v]]!                                    \n\t"
-                    "   vst1.8  {d0},[%[dst_u]]!                                    \n\t"
-                    "   bge 2b                                                      \n\t"
-                    "3: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   blt 5f                                                      \n\t"
-                    "4: @ 8 byte swap                                               \n\t"
-                    "   sub %[n], %[n], #8                                          \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   vst1.8  {d1[0]},[%[dst_v]]!                                 \n\t"
-                    "   vst1.8  {d0[0]},[%[dst_u]]!                                 \n\t"
-                    "   bge 4b                                                      \n\t"
-                    "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-                    "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-                    : [dst_u] "+r" (bufferDst_U), [dst_v] "+r" (bufferDst_V),
-                      [src] "+r" (bufferSrc_UV), [n] "+r" (n)
-                    : [src_stride] "r" (stride_bytes)
-                    : "cc", "memory", "q0", "q1"
-                    );
-
-                    bufferDst_U += inc;
-                    bufferDst_V += inc;
-                }
-#else
-                uint8_t * udst = reinterpret_cast<uint8_t*>(bufferDst_V);
-                uint8_t * vdst = reinterpret_cast<uint8_t*>(bufferDst_U);
+                uint8_t *bufferDstV = ((uint8_t*)dst) + ySize;
+                uint8_t *bufferDstU = ((uint8_t*)dst) + ySize + uvSize;
 
                 for ( int i = 0; i < height/2; ++i ) {
-                    for ( int j = 0; j < width/2; ++j ) {
-                        udst[j] = bufferSrc_UV[j] >> 8;
-                        vdst[j] = bufferSrc_UV[j] & 0x00ff;
-                    }
-                    bufferSrc_UV += stride/bytesPerPixel/2;
-                    udst += width/2;
-                    vdst += width/2;
+                    PixelConvert::splitPairs(bufferSrcUV, bufferDstU, bufferDstV, width/2);
+                    bufferSrcUV += stride;
+                    bufferDstU += uvStride;
+                    bufferDstV += uvStride;
                 }
-#endif
             }
             return ;
 
@@ -59,9 +59,165 @@ const LUTtypeHAL CamCommandsLUT = {
     cameraCommandsUserToHAL
 };
 
+/*--------------------Frame Buffer Pool Class STARTS here-----------------------------*/
+
+FrameBufferPool::FrameBufferPool(CameraBufferRefSlot slot)
+    : mSlot(slot), mGeneration(1)
+{
+}
+
+void FrameBufferPool::clear()
+{
+    android::AutoMutex lock(mLock);
+    uint32_t generation = (mGeneration + 1) & COUNT_MASK;
+
+    // Generation 0 is what freshly allocated buffers hold
+    if ( 0 == generation ) {
+        generation = 1;
+    }
+
+    mBuffers.clear();
+    __atomic_store_n(&mGeneration, generation, __ATOMIC_RELEASE);
+}
+
+void FrameBufferPool::add(CameraBuffer *buf, int refCount)
+{
+    android::AutoMutex lock(mLock);
+    addLocked(buf, refCount);
+}
+
+void FrameBufferPool::addLocked(CameraBuffer *buf, int refCount)
+{
+    uint32_t *refs = &buf->frameRefs[mSlot];
+
+    if ( (__atomic_load_n(refs, __ATOMIC_RELAXED) >> GENERATION_SHIFT) != mGeneration ) {
+        mBuffers.push(buf);
+    }
+
+    // Counted before it is published, so it can't be returned early
+    addPending(buf, refCount & COUNT_MASK);
+    uint32_t old = __atomic_exchange_n(refs, (mGeneration << GENERATION_SHIFT) | (refCount & COUNT_MASK),
+                                       __ATOMIC_SEQ_CST);
+
+    // The references overwritten, or from an earlier generation, never come back
+    subPending(buf, old & COUNT_MASK);
+}
+
+void FrameBufferPool::addPending(CameraBuffer *buf, uint32_t count)
+{
+    uint32_t old = __atomic_load_n(&buf->frameRefsPending, __ATOMIC_RELAXED);
+    uint32_t refs;
+
+    if ( 0 == count ) {
+        return;
+    }
+
+    do {
+        // A buffer going out again starts a new generation
+        refs = old + count;
+        if ( 0 == (old & COUNT_MASK) ) {
+            refs += 1 << GENERATION_SHIFT;
+        }
+    } while ( !__atomic_compare_exchange_n(&buf->frameRefsPending, &old, refs, false,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) );
+}
+
+bool FrameBufferPool::subPending(CameraBuffer *buf, uint32_t count)
+{
+    uint32_t old = __atomic_load_n(&buf->frameRefsPending, __ATOMIC_RELAXED);
+
+    if ( 0 == count ) {
+        return false;
+    }
+
+    do {
+        if ( (old & COUNT_MASK) < count ) {
+            return false;
+        }
+    } while ( !__atomic_compare_exchange_n(&buf->frameRefsPending, &old, old - count, false,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) );
+
+    return count == (old & COUNT_MASK);
+}
+
+bool FrameBufferPool::decPendingRefCount(CameraBuffer *buf)
+{
+    return subPending(buf, 1);
+}
+
+size_t FrameBufferPool::size() const
+{
+    android::AutoMutex lock(mLock);
+    return mBuffers.size();
+}
+
+CameraBuffer *FrameBufferPool::keyAt(size_t index) const
+{
+    android::AutoMutex lock(mLock);
+    return mBuffers[index];
+}
+
+int FrameBufferPool::getRefCount(CameraBuffer *buf) const
+{
+    uint32_t refs = __atomic_load_n(&buf->frameRefs[mSlot], __ATOMIC_SEQ_CST);
+
+    if ( (refs >> GENERATION_SHIFT) != __atomic_load_n(&mGeneration, __ATOMIC_ACQUIRE) ) {
+        return -1;
+    }
+
+    return refs & COUNT_MASK;
+}
+
+void FrameBufferPool::setRefCount(CameraBuffer *buf, int refCount)
+{
+    uint32_t generation = __atomic_load_n(&mGeneration, __ATOMIC_ACQUIRE);
+    uint32_t *refs = &buf->frameRefs[mSlot];
+    uint32_t old = __atomic_load_n(refs, __ATOMIC_RELAXED);
+
+    if ( (old >> GENERATION_SHIFT) == generation ) {
+        // Counted before it is published, so it can't be returned early
+        addPending(buf, refCount & COUNT_MASK);
+        do {
+            if ( __atomic_compare_exchange_n(refs, &old,
+                                             (generation << GENERATION_SHIFT) | (refCount & COUNT_MASK),
+                                             false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) ) {
+                subPending(buf, old & COUNT_MASK);
+                return;
+            }
+        } while ( (old >> GENERATION_SHIFT) == generation );
+        subPending(buf, refCount & COUNT_MASK);
+    }
+
+    // Only a buffer new to the pool needs the lock
+    android::AutoMutex lock(mLock);
+    addLocked(buf, refCount);
+}
+
+int FrameBufferPool::decRefCount(CameraBuffer *buf)
+{
+    uint32_t generation = __atomic_load_n(&mGeneration, __ATOMIC_ACQUIRE);
+    uint32_t *refs = &buf->frameRefs[mSlot];
+    uint32_t old = __atomic_load_n(refs, __ATOMIC_RELAXED);
+
+    do {
+        if ( ((old >> GENERATION_SHIFT) != generation) || (0 == (old & COUNT_MASK)) ) {
+            return -1;
+        }
+    } while ( !__atomic_compare_exchange_n(refs, &old, old - 1, false,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) );
+
+    return (old - 1) & COUNT_MASK;
+}
+
 /*--------------------Camera Adapter Class STARTS here-----------------------------*/
 
 BaseCameraAdapter::BaseCameraAdapter()
+    : mPreviewBuffersAvailable(CAMERA_BUFFER_REF_PREVIEW),
+      mSnapshotBuffersAvailable(CAMERA_BUFFER_REF_SNAPSHOT),
+      mVideoBuffersAvailable(CAMERA_BUFFER_REF_VIDEO),
+      mCaptureBuffersAvailable(CAMERA_BUFFER_REF_CAPTURE),
+      mPreviewDataBuffersAvailable(CAMERA_BUFFER_REF_PREVIEW_DATA),
+      mVideoInBuffersAvailable(CAMERA_BUFFER_REF_VIDEO_IN)
 {
     mReleaseImageBuffersCallback = NULL;
     mEndImageCaptureCallback = NULL;
@@ -345,35 +501,34 @@ void BaseCameraAdapter::returnFrame(CameraBuffer * frameBuf, CameraFrame::FrameT
 
     if ( NO_ERROR == res)
         {
-        android::AutoMutex lock(mReturnFrameLock);
-
-        refCount = getFrameRefCountByType(frameBuf, frameType);
+        FrameBufferPool *pool = getFrameBufferPool(frameType);
 
         if(frameType == CameraFrame::PREVIEW_FRAME_SYNC)
             {
-            mFramesWithDisplay--;
+            __atomic_sub_fetch(&mFramesWithDisplay, 1, __ATOMIC_RELAXED);
             }
         else if(frameType == CameraFrame::VIDEO_FRAME_SYNC)
             {
-            mFramesWithEncoder--;
+            __atomic_sub_fetch(&mFramesWithEncoder, 1, __ATOMIC_RELAXED);
             }
 
-        if ( 0 < refCount )
+        if ( NULL != pool )
             {
-
-            refCount--;
-            setFrameRefCountByType(frameBuf, frameType, refCount);
-
-            if (mRecording) {
-                refCount += getFrameRefCount(frameBuf);
+            refCount = pool->decRefCount(frameBuf);
             }
 
-            }
-        else
+        if ( 0 > refCount )
             {
             CAMHAL_LOGDA("Frame returned when ref count is already zero!!");
             return;
             }
+
+        // Display and encoder can drop their last references at the same
+        // time, only the one taking the buffer's last reference queues it
+        if ( !FrameBufferPool::decPendingRefCount(frameBuf) && mRecording )
+            {
+            return;
+            }
         }
 
     CAMHAL_LOGVB("REFCOUNT 0x%x %d", frameBuf, refCount);
@@ -1484,127 +1639,45 @@ int BaseCameraAdapter::getFrameRefCount(CameraBuffer * frameBuf)
     return res;
 }
 
-int BaseCameraAdapter::getFrameRefCountByType(CameraBuffer * frameBuf, CameraFrame::FrameType frameType)
+FrameBufferPool *BaseCameraAdapter::getFrameBufferPool(CameraFrame::FrameType frameType)
 {
-    int res = -1;
-    ssize_t index = NAME_NOT_FOUND;
-
-    LOG_FUNCTION_NAME;
-
     switch (frameType) {
         case CameraFrame::IMAGE_FRAME:
         case CameraFrame::RAW_FRAME:
-        {
-            android::AutoMutex lock(mCaptureBufferLock);
-            index = mCaptureBuffersAvailable.indexOfKey(frameBuf);
-            if (index != NAME_NOT_FOUND) {
-                res = mCaptureBuffersAvailable[index];
-            }
-            break;
-        }
+            return &mCaptureBuffersAvailable;
         case CameraFrame::SNAPSHOT_FRAME:
-        {
-            android::AutoMutex lock(mSnapshotBufferLock);
-            index = mSnapshotBuffersAvailable.indexOfKey(frameBuf);
-            if (index != NAME_NOT_FOUND) {
-                res = mSnapshotBuffersAvailable[index];
-            }
-            break;
-        }
+            return &mSnapshotBuffersAvailable;
         case CameraFrame::PREVIEW_FRAME_SYNC:
-        {
-            android::AutoMutex lock(mPreviewBufferLock);
-            index = mPreviewBuffersAvailable.indexOfKey(frameBuf);
-            if (index != NAME_NOT_FOUND) {
-                res = mPreviewBuffersAvailable[index];
-            }
-            break;
-        }
+            return &mPreviewBuffersAvailable;
         case CameraFrame::FRAME_DATA_SYNC:
-        {
-            android::AutoMutex lock(mPreviewDataBufferLock);
-            index = mPreviewDataBuffersAvailable.indexOfKey(frameBuf);
-            if (index != NAME_NOT_FOUND) {
-                res = mPreviewDataBuffersAvailable[index];
-            }
-            break;
-        }
+            return &mPreviewDataBuffersAvailable;
         case CameraFrame::VIDEO_FRAME_SYNC:
-        {
-            android::AutoMutex lock(mVideoBufferLock);
-            index = mVideoBuffersAvailable.indexOfKey(frameBuf);
-            if (index != NAME_NOT_FOUND) {
-                res = mVideoBuffersAvailable[index];
-            }
-            break;
-        }
+            return &mVideoBuffersAvailable;
         case CameraFrame::REPROCESS_INPUT_FRAME:
-        {
-            android::AutoMutex lock(mVideoInBufferLock);
-            index = mVideoInBuffersAvailable.indexOfKey(frameBuf);
-            if (index != NAME_NOT_FOUND) {
-                res = mVideoInBuffersAvailable[index];
-            }
-            break;
-        }
+            return &mVideoInBuffersAvailable;
         default:
-            break;
+            return NULL;
     }
-
-    LOG_FUNCTION_NAME_EXIT;
-
-    return res;
 }
 
-void BaseCameraAdapter::setFrameRefCountByType(CameraBuffer * frameBuf, CameraFrame::FrameType frameType, int refCount)
+int BaseCameraAdapter::getFrameRefCountByType(CameraBuffer * frameBuf, CameraFrame::FrameType frameType)
 {
+    FrameBufferPool *pool = getFrameBufferPool(frameType);
 
-    LOG_FUNCTION_NAME;
+    if ( NULL == pool ) {
+        return -1;
+    }
 
-    switch ( frameType )
-        {
-        case CameraFrame::IMAGE_FRAME:
-        case CameraFrame::RAW_FRAME:
-                {
-                android::AutoMutex lock(mCaptureBufferLock);
-                mCaptureBuffersAvailable.replaceValueFor(frameBuf, refCount);
-                }
-            break;
-        case CameraFrame::SNAPSHOT_FRAME:
-                {
-                android::AutoMutex lock(mSnapshotBufferLock);
-                mSnapshotBuffersAvailable.replaceValueFor(frameBuf, refCount);
-                }
-            break;
-        case CameraFrame::PREVIEW_FRAME_SYNC:
-                {
-                android::AutoMutex lock(mPreviewBufferLock);
-                mPreviewBuffersAvailable.replaceValueFor(frameBuf, refCount);
-                }
-            break;
-        case CameraFrame::FRAME_DATA_SYNC:
-                {
-                android::AutoMutex lock(mPreviewDataBufferLock);
-                mPreviewDataBuffersAvailable.replaceValueFor(frameBuf, refCount);
-                }
-            break;
-        case CameraFrame::VIDEO_FRAME_SYNC:
-                {
-                android::AutoMutex lock(mVideoBufferLock);
-                mVideoBuffersAvailable.replaceValueFor(frameBuf, refCount);
-                }
-            break;
-        case CameraFrame::REPROCESS_INPUT_FRAME: {
-            android::AutoMutex lock(mVideoInBufferLock);
-            mVideoInBuffersAvailable.replaceValueFor(frameBuf, refCount);
-        }
-            break;
-        default:
-            break;
-        };
+    return pool->getRefCount(frameBuf);
+}
 
-    LOG_FUNCTION_NAME_EXIT;
+void BaseCameraAdapter::setFrameRefCountByType(CameraBuffer * frameBuf, CameraFrame::FrameType frameType, int refCount)
+{
+    FrameBufferPool *pool = getFrameBufferPool(frameType);
 
+    if ( NULL != pool ) {
+        pool->setRefCount(frameBuf, refCount);
+    }
 }
 
 status_t BaseCameraAdapter::startVideoCapture()
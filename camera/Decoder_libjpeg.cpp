@@ -14,7 +14,11 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "Decoder_libjpeg.h"
+#include "PixelConvert.h"
 
 extern "C" {
     #include "jpeglib.h"
@@ -23,6 +27,9 @@ extern "C" {
 
 #define NUM_COMPONENTS_IN_YUV 3
 
+/* Segments the DHT source reads the frame from: the tables, then the frame */
+#define DHT_SOURCE_SEGMENTS 2
+
 namespace Ti {
 namespace Camera {
 
@@ -134,39 +141,134 @@ libjpeg_source_mgr::libjpeg_source_mgr(unsigned char *buffer_ptr, int len) : mBu
 
 libjpeg_source_mgr::~libjpeg_source_mgr() {}
 
-Decoder_libjpeg::Decoder_libjpeg()
-{
-    mWidth = 0;
-    mHeight = 0;
-    Y_Plane = NULL;
-    U_Plane = NULL;
-    V_Plane = NULL;
-    UV_Plane = NULL;
+/*
+ * Source manager reading jpeg_odml_dht in front of the MJPEG frame, the SOI
+ * of the frame is skipped as the tables bring their own. libjpeg sees the
+ * same stream appendDHT would build without the frame being copied.
+ */
+struct libjpeg_dht_source_mgr : jpeg_source_mgr {
+    libjpeg_dht_source_mgr(unsigned char *jpeg_src, int filled_len);
+
+    const JOCTET *mSegments[DHT_SOURCE_SEGMENTS];
+    size_t mSegmentLens[DHT_SOURCE_SEGMENTS];
+    int mNextSegment;
+};
+
+static const JOCTET fake_eoi[2] = { 0xFF, JPEG_EOI };
+
+static void libjpeg_dht_init_source(j_decompress_ptr cinfo) {
+    libjpeg_dht_source_mgr* src = (libjpeg_dht_source_mgr*)cinfo->src;
+    src->mNextSegment = 0;
+    src->next_input_byte = NULL;
+    src->bytes_in_buffer = 0;
+#ifndef ANDROID_API_N_OR_LATER
+    src->current_offset = 0;
+#endif
 }
 
-Decoder_libjpeg::~Decoder_libjpeg()
-{
-    release();
+static boolean libjpeg_dht_fill_input_buffer(j_decompress_ptr cinfo) {
+    libjpeg_dht_source_mgr* src = (libjpeg_dht_source_mgr*)cinfo->src;
+
+    if (src->mNextSegment < DHT_SOURCE_SEGMENTS) {
+        src->next_input_byte = src->mSegments[src->mNextSegment];
+        src->bytes_in_buffer = src->mSegmentLens[src->mNextSegment];
+        src->mNextSegment++;
+    } else {
+        // Truncated frame, end it the way the libjpeg stdio source does
+        WARNMS(cinfo, JWRN_JPEG_EOF);
+        src->next_input_byte = fake_eoi;
+        src->bytes_in_buffer = sizeof(fake_eoi);
+    }
+#ifndef ANDROID_API_N_OR_LATER
+    src->current_offset += src->bytes_in_buffer;
+#endif
+    return TRUE;
 }
 
-void Decoder_libjpeg::release()
-{
-    if (Y_Plane) {
-        free(Y_Plane);
-        Y_Plane = NULL;
+#ifndef ANDROID_API_N_OR_LATER
+static boolean libjpeg_dht_seek_input_data(j_decompress_ptr cinfo, long byte_offset) {
+    libjpeg_dht_source_mgr* src = (libjpeg_dht_source_mgr*)cinfo->src;
+    long start = 0;
+
+    for (int i = 0; i < DHT_SOURCE_SEGMENTS; i++) {
+        long len = src->mSegmentLens[i];
+        if (byte_offset < start + len) {
+            src->next_input_byte = src->mSegments[i] + (byte_offset - start);
+            src->bytes_in_buffer = start + len - byte_offset;
+            src->mNextSegment = i + 1;
+            src->current_offset = start + len;
+            return TRUE;
+        }
+        start += len;
     }
-    if (U_Plane) {
-        free(U_Plane);
-        U_Plane = NULL;
+    return FALSE;
+}
+#endif
+
+static void libjpeg_dht_skip_input_data(j_decompress_ptr cinfo, long num_bytes) {
+    libjpeg_dht_source_mgr* src = (libjpeg_dht_source_mgr*)cinfo->src;
+
+    if (num_bytes <= 0) {
+        return;
     }
-    if (V_Plane) {
-        free(V_Plane);
-        V_Plane = NULL;
+
+    // Markers may be skipped across the end of the tables
+    while (num_bytes > (long)src->bytes_in_buffer) {
+        num_bytes -= src->bytes_in_buffer;
+        libjpeg_dht_fill_input_buffer(cinfo);
     }
-    if (UV_Plane) {
-        free(UV_Plane);
-        UV_Plane = NULL;
+    src->next_input_byte += num_bytes;
+    src->bytes_in_buffer -= num_bytes;
+}
+
+libjpeg_dht_source_mgr::libjpeg_dht_source_mgr(unsigned char *jpeg_src, int filled_len) : mNextSegment(0) {
+    mSegments[0] = jpeg_odml_dht;
+    mSegmentLens[0] = sizeof(jpeg_odml_dht);
+    mSegments[1] = jpeg_src + 2;
+    mSegmentLens[1] = filled_len - 2;
+
+    init_source = libjpeg_dht_init_source;
+    fill_input_buffer = libjpeg_dht_fill_input_buffer;
+    skip_input_data = libjpeg_dht_skip_input_data;
+    resync_to_restart = jpeg_resync_to_restart;
+    term_source = libjpeg_term_source;
+#ifndef ANDROID_API_N_OR_LATER
+    seek_input_data = libjpeg_dht_seek_input_data;
+#endif
+}
+
+/*
+ * Only YCbCr with the chroma planes at most halved in each direction maps to
+ * NV12: 4:2:0, 4:2:2 as sent by UVC cameras, 4:4:0 and 4:4:4.
+ */
+static bool is_nv12_compatible(j_decompress_ptr cinfo) {
+    if (cinfo->num_components != NUM_COMPONENTS_IN_YUV ||
+        cinfo->max_h_samp_factor > 2 || cinfo->max_v_samp_factor > 2) {
+        return false;
     }
+
+    if (cinfo->comp_info[0].h_samp_factor != cinfo->max_h_samp_factor ||
+        cinfo->comp_info[0].v_samp_factor != cinfo->max_v_samp_factor) {
+        return false;
+    }
+
+    for (int i = 1; i < NUM_COMPONENTS_IN_YUV; i++) {
+        if (cinfo->comp_info[i].h_samp_factor != 1 || cinfo->comp_info[i].v_samp_factor != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Decoder_libjpeg::Decoder_libjpeg()
+{
+    UV_Plane = NULL;
+    mUVPlaneSize = 0;
+}
+
+Decoder_libjpeg::~Decoder_libjpeg()
+{
+    free(UV_Plane);
 }
 
 int Decoder_libjpeg::readDHTSize()
@@ -210,20 +312,42 @@ int Decoder_libjpeg::appendDHT(unsigned char *jpeg_src, int filled_len, unsigned
 
 bool Decoder_libjpeg::decode(unsigned char *jpeg_src, int filled_len, unsigned char *nv12_buffer, int stride)
 {
-    struct jpeg_decompress_struct cinfo;
-    struct jpeg_error_mgr jerr;
+    if (filled_len == 0)
+        return false;
+
     struct libjpeg_source_mgr s_mgr(jpeg_src, filled_len);
+    return decodeRaw(&s_mgr, nv12_buffer, stride);
+}
 
-    if (filled_len == 0)
+bool Decoder_libjpeg::decodeWithDHT(unsigned char *jpeg_src, int filled_len, unsigned char *nv12_buffer, int stride)
+{
+    if (filled_len <= 2)
         return false;
 
+    struct libjpeg_dht_source_mgr s_mgr(jpeg_src, filled_len);
+    return decodeRaw(&s_mgr, nv12_buffer, stride);
+}
+
+bool Decoder_libjpeg::decodeRaw(jpeg_source_mgr *src, unsigned char *nv12_buffer, int stride)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
     cinfo.err = jpeg_std_error(&jerr);
     jpeg_create_decompress(&cinfo);
 
-    cinfo.src = &s_mgr;
+    cinfo.src = src;
     int status = jpeg_read_header(&cinfo, true);
     if (status != JPEG_HEADER_OK) {
         CAMHAL_LOGEA("jpeg header corrupted");
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    if (!is_nv12_compatible(&cinfo)) {
+        CAMHAL_LOGEB("Unsupported sampling, %d components, max factors %dx%d",
+                cinfo.num_components, cinfo.max_h_samp_factor, cinfo.max_v_samp_factor);
+        jpeg_destroy_decompress(&cinfo);
         return false;
     }
 
@@ -232,78 +356,88 @@ bool Decoder_libjpeg::decode(unsigned char *jpeg_src, int filled_len, unsigned c
     status = jpeg_start_decompress(&cinfo);
     if (!status){
         CAMHAL_LOGEA("jpeg_start_decompress failed");
+        jpeg_destroy_decompress(&cinfo);
         return false;
     }
 
-    if (mWidth == 0){
-        mWidth = cinfo.output_width;
-        mHeight = cinfo.output_height;
-        CAMHAL_LOGEA("w x h = %d x %d. stride=%d", cinfo.output_width, cinfo.output_height, stride);
-    }
-    else if ((cinfo.output_width > mWidth) || (cinfo.output_height > mHeight)) {
-        CAMHAL_LOGEA(" Free the existing buffers so that they are reallocated for new w x h. Old WxH = %dx%d. New WxH = %dx%d",
-        mWidth, mHeight, cinfo.output_width, cinfo.output_height);
-        release();
-        mWidth = cinfo.output_width;
-        mHeight = cinfo.output_height;
+    // Luma lines of an iMCU row, the chroma ones are decoded at one line per
+    // block line and land on every NV12 chroma line (4:2:0) or every other
+    // one (4:2:2, the last of each pair is kept)
+    unsigned int lines = cinfo.max_v_samp_factor * DCTSIZE;
+    unsigned int uv_lines = lines / 2;
+    unsigned int uv_width = cinfo.comp_info[1].width_in_blocks * DCTSIZE;
+    unsigned int y_width = cinfo.comp_info[0].width_in_blocks * DCTSIZE;
+    unsigned int x_step = 2 / cinfo.max_h_samp_factor;
+    size_t uv_plane_size = 2 * uv_lines * uv_width + y_width;
+
+    if (uv_plane_size > mUVPlaneSize) {
+        free(UV_Plane);
+        UV_Plane = (unsigned char *)malloc(uv_plane_size);
+        mUVPlaneSize = UV_Plane ? uv_plane_size : 0;
+        if (!UV_Plane) {
+            CAMHAL_LOGEB("Failed to allocate %d bytes of chroma lines", (int)uv_plane_size);
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
     }
 
-    unsigned int decoded_uv_buffer_size = cinfo.output_width * cinfo.output_height / 2;
-    if (Y_Plane == NULL)Y_Plane = (unsigned char **)malloc(cinfo.output_height * sizeof(unsigned char *));
-    if (U_Plane == NULL)U_Plane = (unsigned char **)malloc(cinfo.output_height * sizeof(unsigned char *));
-    if (V_Plane == NULL)V_Plane = (unsigned char **)malloc(cinfo.output_height * sizeof(unsigned char *));
-    if (UV_Plane == NULL) UV_Plane = (unsigned char *)malloc(decoded_uv_buffer_size);
-
-    unsigned char **YUV_Planes[NUM_COMPONENTS_IN_YUV];
-    YUV_Planes[0] = Y_Plane;
-    YUV_Planes[1] = U_Plane;
-    YUV_Planes[2] = V_Plane;
+    unsigned char *u_lines = UV_Plane;
+    unsigned char *v_lines = u_lines + uv_lines * uv_width;
+    unsigned char *spare_line = v_lines + uv_lines * uv_width;
 
-    unsigned char *row = &nv12_buffer[0];
+    JSAMPROW y_rows[2 * DCTSIZE];
+    JSAMPROW u_rows[DCTSIZE];
+    JSAMPROW v_rows[DCTSIZE];
+    JSAMPARRAY YUV_Planes[NUM_COMPONENTS_IN_YUV] = { y_rows, u_rows, v_rows };
 
-    // Y Component
-    for (unsigned int j = 0; j < cinfo.output_height; j++, row += stride)
-        YUV_Planes[0][j] = row;
+    for (unsigned int j = 0; j < DCTSIZE; j++) {
+        u_rows[j] = u_lines + (j * cinfo.max_v_samp_factor / 2) * uv_width;
+        v_rows[j] = v_lines + (j * cinfo.max_v_samp_factor / 2) * uv_width;
+    }
 
-    row = &UV_Plane[0];
+    unsigned char *uv_plane = nv12_buffer + (stride * cinfo.output_height);
+    unsigned int uv_height = cinfo.output_height / 2;
+    unsigned int uv_pairs = cinfo.output_width / 2;
+    bool ret = true;
 
-    // U Component
-    for (unsigned int j = 0; j < cinfo.output_height; j+=2, row += cinfo.output_width / 2){
-        YUV_Planes[1][j+0] = row;
-        YUV_Planes[1][j+1] = row;
-    }
+    while (cinfo.output_scanline < cinfo.output_height) {
+        unsigned int y = cinfo.output_scanline;
 
-    // V Component
-    for (unsigned int j = 0; j < cinfo.output_height; j+=2, row += cinfo.output_width / 2){
-        YUV_Planes[2][j+0] = row;
-        YUV_Planes[2][j+1] = row;
-    }
+        // Y Component, straight into the output
+        for (unsigned int j = 0; j < lines; j++) {
+            y_rows[j] = y + j < cinfo.output_height ? nv12_buffer + (y + j) * stride : spare_line;
+        }
 
-    // Interleaving U and V
-    for (unsigned int i = 0; i < cinfo.output_height; i += 8) {
-        jpeg_read_raw_data(&cinfo, YUV_Planes, 8);
-        YUV_Planes[0] += 8;
-        YUV_Planes[1] += 8;
-        YUV_Planes[2] += 8;
-    }
+        if (jpeg_read_raw_data(&cinfo, YUV_Planes, lines) != lines) {
+            CAMHAL_LOGEA("jpeg_read_raw_data failed");
+            ret = false;
+            break;
+        }
 
-    unsigned char *uv_ptr = nv12_buffer + (stride * cinfo.output_height);
-    unsigned char *u_ptr = UV_Plane;
-    unsigned char *v_ptr = UV_Plane + (decoded_uv_buffer_size / 2);
-    for(unsigned int i = 0; i < cinfo.output_height / 2; i++){
-        for(unsigned int j = 0; j < cinfo.output_width; j+=2){
-            *(uv_ptr + j) = *u_ptr; u_ptr++;
-            *(uv_ptr + j + 1) = *v_ptr; v_ptr++;
+        // Interleaving U and V while the lines are still in cache
+        unsigned char *uv_ptr = uv_plane + (y / 2) * stride;
+        for (unsigned int i = 0; i < uv_lines && y / 2 + i < uv_height; i++, uv_ptr += stride) {
+            const unsigned char *u_ptr = u_lines + i * uv_width;
+            const unsigned char *v_ptr = v_lines + i * uv_width;
+            if (x_step == 1) {
+                PixelConvert::mergePairs(u_ptr, v_ptr, uv_ptr, uv_pairs);
+                continue;
+            }
+            // 4:4:4, every other chroma sample
+            for (unsigned int j = 0; j < uv_pairs; j++) {
+                uv_ptr[2 * j] = u_ptr[j * x_step];
+                uv_ptr[2 * j + 1] = v_ptr[j * x_step];
+            }
         }
-        uv_ptr = uv_ptr + stride;
     }
 
-    jpeg_finish_decompress(&cinfo);
+    if (ret) {
+        jpeg_finish_decompress(&cinfo);
+    }
     jpeg_destroy_decompress(&cinfo);
 
-    return true;
+    return ret;
 }
 
 } // namespace Camera
 } // namespace Ti
-
@@ -23,6 +23,129 @@
 
 #define STRIDE 4096
 
+/*==========================================================================
+* Function Name  : VT_resizeRowY_lp
+*
+* Description    : Computes one luma row of a frame resized to codx x cody.
+*
+* Input(s)       : input_img_ptr        -> Input Image Structure
+*                : row                  -> output row
+*                : codx, cody           -> output size
+*                : ptr8                 -> codx bytes of output
+============================================================================*/
+void
+VT_resizeRowY_lp(
+        structConvImage* i_img_ptr,
+        mmUint16 row,
+        mmUint32 codx,
+        mmUint32 cody,
+        mmUchar* ptr8
+        ) {
+    mmUint32 resizeFactorX = ((i_img_ptr->uWidth-1)<<9) / codx;
+    mmUint32 resizeFactorY = ((i_img_ptr->uHeight-1)<<9) / cody;
+    mmUchar* inImgPtrY = (mmUchar *) i_img_ptr->imgPtr + i_img_ptr->uOffset;
+    mmUchar *pu8Yrow1 = NULL;
+    mmUchar *pu8Yrow2 = NULL;
+    mmUint16 col, x, y;
+    mmUint16 xf, yf;
+
+    y  = (mmUint16) ((mmUint32) (row*resizeFactorY) >> 9);
+    yf = (mmUchar)  ((mmUint32)((row*resizeFactorY) >> 6) & 0x7);
+    pu8Yrow1 = inImgPtrY + (y) * i_img_ptr->uStride;
+    pu8Yrow2 = pu8Yrow1 + i_img_ptr->uStride;
+
+    for ( col = 0; col < codx; col++ ) {
+        mmUchar *pu8ptr1 = NULL;
+        mmUchar *pu8ptr2 = NULL;
+        mmUint16 accum_1;
+
+        x  = (mmUint16) ((mmUint32)  (col*resizeFactorX) >> 9);
+        xf = (mmUchar)  ((mmUint32) ((col*resizeFactorX) >> 6) & 0x7);
+
+        pu8ptr1 = pu8Yrow1 + (x);
+        pu8ptr2 = pu8Yrow2 + (x);
+
+        /* A, B, C and D pixels, the weights add up to 64 */
+        accum_1 =  bWeights[xf][yf][0] * pu8ptr1[0];
+        accum_1 += bWeights[xf][yf][1] * pu8ptr1[1];
+        accum_1 += bWeights[xf][yf][3] * pu8ptr2[0];
+        accum_1 += bWeights[xf][yf][2] * pu8ptr2[1];
+
+        ptr8[col] = (mmUchar)(accum_1>>6);
+    }
+}
+
+/*==========================================================================
+* Function Name  : VT_resizeRowCbCr_lp
+*
+* Description    : Computes one chroma row of a frame resized to codx x cody.
+*
+* Input(s)       : input_img_ptr        -> Input Image Structure
+*                : row                  -> output chroma row
+*                : codx, cody           -> output size
+*                : ptr8Cb, ptr8Cr       -> codx/2 samples of output each
+*                : step                 -> distance between output samples,
+*                                          2 for an interleaved chroma plane
+============================================================================*/
+void
+VT_resizeRowCbCr_lp(
+        structConvImage* i_img_ptr,
+        mmUint16 row,
+        mmUint32 codx,
+        mmUint32 cody,
+        mmUchar* ptr8Cb,
+        mmUchar* ptr8Cr,
+        mmUint32 step
+        ) {
+    mmUint32 resizeFactorX = ((i_img_ptr->uWidth-1)<<9) / codx;
+    mmUint32 resizeFactorY = ((i_img_ptr->uHeight-1)<<9) / cody;
+    mmUchar* inImgPtrU = (mmUchar *) i_img_ptr->clrPtr + i_img_ptr->uOffset/2;
+    mmUchar* inImgPtrV = (mmUchar*)inImgPtrU + 1;
+    mmUchar *pu8Cbr1 = NULL;
+    mmUchar *pu8Cbr2 = NULL;
+    mmUchar *pu8Crr1 = NULL;
+    mmUchar *pu8Crr2 = NULL;
+    mmUint16 col, x, y;
+    mmUint16 xf, yf;
+
+    y  = (mmUint16) ((mmUint32) (row*resizeFactorY) >> 9);
+    yf = (mmUchar)  ((mmUint32)((row*resizeFactorY) >> 6) & 0x7);
+
+    pu8Cbr1 = inImgPtrU + (y) * i_img_ptr->uStride;
+    pu8Cbr2 = pu8Cbr1 + i_img_ptr->uStride;
+    pu8Crr1 = inImgPtrV + (y) * i_img_ptr->uStride;
+    pu8Crr2 = pu8Crr1 + i_img_ptr->uStride;
+
+    for ( col = 0; col < (((codx)>>1)); col++ ) {
+        mmUchar *pu8Cbc1 = NULL;
+        mmUchar *pu8Cbc2 = NULL;
+        mmUchar *pu8Crc1 = NULL;
+        mmUchar *pu8Crc2 = NULL;
+        mmUint16 accum_1Cb, accum_1Cr;
+
+        x  = (mmUint16) ((mmUint32)  (col*resizeFactorX) >> 9);
+        xf = (mmUchar)  ((mmUint32) ((col*resizeFactorX) >> 6) & 0x7);
+
+        pu8Cbc1 = pu8Cbr1 + (x*2);
+        pu8Cbc2 = pu8Cbr2 + (x*2);
+        pu8Crc1 = pu8Crr1 + (x*2);
+        pu8Crc2 = pu8Crr2 + (x*2);
+
+        /* A, B, C and D pixels, the weights add up to 64 */
+        accum_1Cb =  bWeights[xf][yf][0] * pu8Cbc1[0];
+        accum_1Cr =  bWeights[xf][yf][0] * pu8Crc1[0];
+        accum_1Cb += bWeights[xf][yf][1] * pu8Cbc1[2];
+        accum_1Cr += bWeights[xf][yf][1] * pu8Crc1[2];
+        accum_1Cb += bWeights[xf][yf][3] * pu8Cbc2[0];
+        accum_1Cr += bWeights[xf][yf][3] * pu8Crc2[0];
+        accum_1Cb += bWeights[xf][yf][2] * pu8Cbc2[2];
+        accum_1Cr += bWeights[xf][yf][2] * pu8Crc2[2];
+
+        ptr8Cb[col*step] = (mmUchar)(accum_1Cb>>6);
+        ptr8Cr[col*step] = (mmUchar)(accum_1Cr>>6);
+    }
+}
+
 /*==========================================================================
 * Function Name  : VT_resizeFrame_Video_opt2_lp
 *
@@ -46,21 +169,12 @@ VT_resizeFrame_Video_opt2_lp(
         ) {
     LOG_FUNCTION_NAME;
 
-    mmUint16 row,col;
-    mmUint32 resizeFactorX;
-    mmUint32 resizeFactorY;
-
-    mmUint16 x, y;
-
+    mmUint16 row;
     mmUchar* ptr8;
     mmUchar *ptr8Cb, *ptr8Cr;
 
-    mmUint16 xf, yf;
-    mmUchar* inImgPtrY;
-    mmUchar* inImgPtrU;
-    mmUchar* inImgPtrV;
     mmUint32 cox, coy, codx, cody;
-    mmUint16 idx,idy, idxC;
+    mmUint16 idx,idy;
 
     if ( i_img_ptr->uWidth == o_img_ptr->uWidth ) {
         if ( i_img_ptr->uHeight == o_img_ptr->uHeight ) {
@@ -77,10 +191,6 @@ VT_resizeFrame_Video_opt2_lp(
         return false;
     }
 
-    inImgPtrY = (mmUchar *) i_img_ptr->imgPtr + i_img_ptr->uOffset;
-    inImgPtrU = (mmUchar *) i_img_ptr->clrPtr + i_img_ptr->uOffset/2;
-    inImgPtrV = (mmUchar*)inImgPtrU + 1;
-
     if ( !cropout ) {
         cox = 0;
         coy = 0;
@@ -101,9 +211,6 @@ VT_resizeFrame_Video_opt2_lp(
         return false;
     }
 
-    resizeFactorX = ((idx-1)<<9) / codx;
-    resizeFactorY = ((idy-1)<<9) / cody;
-
     if( i_img_ptr->eFormat != IC_FORMAT_YCbCr420_lp ||
             o_img_ptr->eFormat != IC_FORMAT_YCbCr420_lp ) {
         CAMHAL_LOGE("eFormat not supported");
@@ -114,68 +221,8 @@ VT_resizeFrame_Video_opt2_lp(
 
     ////////////////////////////for Y//////////////////////////
     for ( row = 0; row < cody; row++ ) {
-        mmUchar *pu8Yrow1 = NULL;
-        mmUchar *pu8Yrow2 = NULL;
-        y  = (mmUint16) ((mmUint32) (row*resizeFactorY) >> 9);
-        yf = (mmUchar)  ((mmUint32)((row*resizeFactorY) >> 6) & 0x7);
-        pu8Yrow1 = inImgPtrY + (y) * i_img_ptr->uStride;
-        pu8Yrow2 = pu8Yrow1 + i_img_ptr->uStride;
-
-        for ( col = 0; col < codx; col++ ) {
-            mmUchar in11, in12, in21, in22;
-            mmUchar *pu8ptr1 = NULL;
-            mmUchar *pu8ptr2 = NULL;
-            mmUchar w;
-            mmUint16 accum_1;
-            //mmUint32 accum_W;
-
-            x  = (mmUint16) ((mmUint32)  (col*resizeFactorX) >> 9);
-            xf = (mmUchar)  ((mmUint32) ((col*resizeFactorX) >> 6) & 0x7);
-
-            //accum_W = 0;
-            accum_1 =  0;
-
-            pu8ptr1 = pu8Yrow1 + (x);
-            pu8ptr2 = pu8Yrow2 + (x);
-
-            /* A pixel */
-            //in = *(inImgPtrY + (y)*idx + (x));
-            in11 = *(pu8ptr1);
-
-            w = bWeights[xf][yf][0];
-            accum_1 = (w * in11);
-            //accum_W += (w);
-
-            /* B pixel */
-            //in = *(inImgPtrY + (y)*idx + (x+1));
-            in12 = *(pu8ptr1+1);
-            w = bWeights[xf][yf][1];
-            accum_1 += (w * in12);
-            //accum_W += (w);
-
-            /* C pixel */
-            //in = *(inImgPtrY + (y+1)*idx + (x));
-            in21 = *(pu8ptr2);
-            w = bWeights[xf][yf][3];
-            accum_1 += (w * in21);
-            //accum_W += (w);
-
-            /* D pixel */
-            //in = *(inImgPtrY + (y+1)*idx + (x+1));
-            in22 = *(pu8ptr2+1);
-            w = bWeights[xf][yf][2];
-            accum_1 += (w * in22);
-            //accum_W += (w);
-
-            /* divide by sum of the weights */
-            //accum_1 /= (accum_W);
-            //accum_1 = (accum_1/64);
-            accum_1 = (accum_1>>6);
-            *ptr8 = (mmUchar)accum_1 ;
-
-            ptr8++;
-        }
-        ptr8 = ptr8 + (o_img_ptr->uStride - codx);
+        VT_resizeRowY_lp(i_img_ptr, row, codx, cody, ptr8);
+        ptr8 = ptr8 + o_img_ptr->uStride;
     }
     ////////////////////////////for Y//////////////////////////
 
@@ -185,103 +232,10 @@ VT_resizeFrame_Video_opt2_lp(
 
     ptr8Cr = (mmUchar*)(ptr8Cb+1);
 
-    idxC = (idx>>1);
     for ( row = 0; row < (((cody)>>1)); row++ ) {
-        mmUchar *pu8Cbr1 = NULL;
-        mmUchar *pu8Cbr2 = NULL;
-        mmUchar *pu8Crr1 = NULL;
-        mmUchar *pu8Crr2 = NULL;
-
-        y  = (mmUint16) ((mmUint32) (row*resizeFactorY) >> 9);
-        yf = (mmUchar)  ((mmUint32)((row*resizeFactorY) >> 6) & 0x7);
-
-        pu8Cbr1 = inImgPtrU + (y) * i_img_ptr->uStride;
-        pu8Cbr2 = pu8Cbr1 + i_img_ptr->uStride;
-        pu8Crr1 = inImgPtrV + (y) * i_img_ptr->uStride;
-        pu8Crr2 = pu8Crr1 + i_img_ptr->uStride;
-
-        for ( col = 0; col < (((codx)>>1)); col++ ) {
-            mmUchar in11, in12, in21, in22;
-            mmUchar *pu8Cbc1 = NULL;
-            mmUchar *pu8Cbc2 = NULL;
-            mmUchar *pu8Crc1 = NULL;
-            mmUchar *pu8Crc2 = NULL;
-
-            mmUchar w;
-            mmUint16 accum_1Cb, accum_1Cr;
-            //mmUint32 accum_WCb, accum_WCr;
-
-            x  = (mmUint16) ((mmUint32)  (col*resizeFactorX) >> 9);
-            xf = (mmUchar)  ((mmUint32) ((col*resizeFactorX) >> 6) & 0x7);
-
-            //accum_WCb = accum_WCr =  0;
-            accum_1Cb = accum_1Cr =  0;
-
-            pu8Cbc1 = pu8Cbr1 + (x*2);
-            pu8Cbc2 = pu8Cbr2 + (x*2);
-            pu8Crc1 = pu8Crr1 + (x*2);
-            pu8Crc2 = pu8Crr2 + (x*2);
-
-            /* A pixel */
-            w = bWeights[xf][yf][0];
-
-            in11 = *(pu8Cbc1);
-            accum_1Cb = (w * in11);
-            //    accum_WCb += (w);
-
-            in11 = *(pu8Crc1);
-            accum_1Cr = (w * in11);
-            //accum_WCr += (w);
-
-            /* B pixel */
-            w = bWeights[xf][yf][1];
-
-            in12 = *(pu8Cbc1+2);
-            accum_1Cb += (w * in12);
-            //accum_WCb += (w);
-
-            in12 = *(pu8Crc1+2);
-            accum_1Cr += (w * in12);
-            //accum_WCr += (w);
-
-            /* C pixel */
-            w = bWeights[xf][yf][3];
-
-            in21 = *(pu8Cbc2);
-            accum_1Cb += (w * in21);
-            //accum_WCb += (w);
-
-            in21 = *(pu8Crc2);
-            accum_1Cr += (w * in21);
-            //accum_WCr += (w);
-
-            /* D pixel */
-            w = bWeights[xf][yf][2];
-
-            in22 = *(pu8Cbc2+2);
-            accum_1Cb += (w * in22);
-            //accum_WCb += (w);
-
-            in22 = *(pu8Crc2+2);
-            accum_1Cr += (w * in22);
-            //accum_WCr += (w);
-
-            /* divide by sum of the weights */
-            //accum_1Cb /= (accum_WCb);
-            accum_1Cb = (accum_1Cb>>6);
-            *ptr8Cb = (mmUchar)accum_1Cb ;
-
-            accum_1Cr = (accum_1Cr >> 6);
-            *ptr8Cr = (mmUchar)accum_1Cr ;
-
-            ptr8Cb++;
-            ptr8Cr++;
-
-            ptr8Cb++;
-            ptr8Cr++;
-        }
-        ptr8Cb = ptr8Cb + (o_img_ptr->uStride-codx);
-        ptr8Cr = ptr8Cr + (o_img_ptr->uStride-codx);
+        VT_resizeRowCbCr_lp(i_img_ptr, row, codx, cody, ptr8Cb, ptr8Cr, 2);
+        ptr8Cb = ptr8Cb + o_img_ptr->uStride;
+        ptr8Cr = ptr8Cr + o_img_ptr->uStride;
     }
     ///////////////////For Cb- Cr////////////////////////////////////////
 
@@ -3530,7 +3530,7 @@ OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(__unused OMX_IN O
         if (mRecording)
             {
             mask |= (unsigned int)CameraFrame::VIDEO_FRAME_SYNC;
-            mFramesWithEncoder++;
+            __atomic_add_fetch(&mFramesWithEncoder, 1, __ATOMIC_RELAXED);
             }
 
         //CAMHAL_LOGV("FBD pBuffer = 0x%x", pBuffHeader->pBuffer);
@@ -3547,7 +3547,7 @@ OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(__unused OMX_IN O
             }
 
         stat = sendCallBacks(cameraFrame, pBuffHeader, mask, pPortParam);
-        mFramesWithDisplay++;
+        __atomic_add_fetch(&mFramesWithDisplay, 1, __ATOMIC_RELAXED);
 
         mFramesWithDucati--;
 
@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file PixelConvert.cpp
+*
+* This file implements the YUV layout conversions with NEON, SSE2 and AVX2
+* intrinsics and a C fallback
+*
+*/
+
+#include "PixelConvert.h"
+
+#include <pthread.h>
+
+#if defined(ARCH_ARM_HAVE_NEON) || defined(__aarch64__)
+#define PIXEL_CONVERT_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSE2__)
+#define PIXEL_CONVERT_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernels are built with a target attribute and only run when the CPU
+// has it, gcc before 4.9 cannot use the intrinsics that way
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define PIXEL_CONVERT_HAVE_AVX2
+#include <immintrin.h>
+#define PIXEL_CONVERT_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace Ti {
+namespace Camera {
+
+struct pixel_convert_kernels {
+    void (*split_pairs)(const uint8_t* src, uint8_t* even, uint8_t* odd, size_t pairs);
+    void (*merge_pairs)(const uint8_t* even, const uint8_t* odd, uint8_t* dst, size_t pairs);
+    void (*swap_pairs)(const uint8_t* src, uint8_t* dst, size_t pairs);
+    void (*yuv422i_to_planes)(const uint8_t* src0, const uint8_t* src1,
+                              uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr,
+                              size_t pairs, bool uyvy);
+};
+
+/* C kernels, also converting whatever the vector ones leave at the end */
+
+static void split_pairs_c(const uint8_t* src, uint8_t* even, uint8_t* odd, size_t pairs) {
+    if (odd) {
+        for (size_t i = 0; i < pairs; i++) {
+            even[i] = src[i * 2];
+            odd[i] = src[i * 2 + 1];
+        }
+    } else {
+        for (size_t i = 0; i < pairs; i++) {
+            even[i] = src[i * 2];
+        }
+    }
+}
+
+static void merge_pairs_c(const uint8_t* even, const uint8_t* odd, uint8_t* dst, size_t pairs) {
+    for (size_t i = 0; i < pairs; i++) {
+        dst[i * 2] = even[i];
+        dst[i * 2 + 1] = odd[i];
+    }
+}
+
+static void swap_pairs_c(const uint8_t* src, uint8_t* dst, size_t pairs) {
+    for (size_t i = 0; i < pairs; i++) {
+        uint8_t first = src[i * 2];
+        dst[i * 2] = src[i * 2 + 1];
+        dst[i * 2 + 1] = first;
+    }
+}
+
+static void yuv422i_to_planes_c(const uint8_t* src0, const uint8_t* src1,
+                                uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr,
+                                size_t pairs, bool uyvy) {
+    // byte offsets in a 2 pixel group
+    const int y = uyvy ? 1 : 0;
+    const int u = uyvy ? 0 : 1;
+    const int v = uyvy ? 2 : 3;
+
+    for (size_t i = 0; i < pairs; i++) {
+        const uint8_t* p0 = src0 + i * 4;
+        const uint8_t* p1 = src1 + i * 4;
+
+        y0[i * 2] = p0[y];
+        y0[i * 2 + 1] = p0[y + 2];
+        y1[i * 2] = p1[y];
+        y1[i * 2 + 1] = p1[y + 2];
+        cb[i] = (p0[u] + p1[u] + 1) >> 1;
+        cr[i] = (p0[v] + p1[v] + 1) >> 1;
+    }
+}
+
+static const pixel_convert_kernels c_kernels = {
+    split_pairs_c,
+    merge_pairs_c,
+    swap_pairs_c,
+    yuv422i_to_planes_c,
+};
+
+#ifdef PIXEL_CONVERT_HAVE_NEON
+
+static void split_pairs_neon(const uint8_t* src, uint8_t* even, uint8_t* odd, size_t pairs) {
+    size_t n = pairs & ~(size_t)15;
+
+    for (size_t i = 0; i < n; i += 16) {
+        uint8x16x2_t v = vld2q_u8(src + i * 2);
+        vst1q_u8(even + i, v.val[0]);
+        if (odd) {
+            vst1q_u8(odd + i, v.val[1]);
+        }
+    }
+    split_pairs_c(src + n * 2, even + n, odd ? odd + n : NULL, pairs - n);
+}
+
+static void merge_pairs_neon(const uint8_t* even, const uint8_t* odd, uint8_t* dst, size_t pairs) {
+    size_t n = pairs & ~(size_t)15;
+
+    for (size_t i = 0; i < n; i += 16) {
+        uint8x16x2_t v;
+        v.val[0] = vld1q_u8(even + i);
+        v.val[1] = vld1q_u8(odd + i);
+        vst2q_u8(dst + i * 2, v);
+    }
+    merge_pairs_c(even + n, odd + n, dst + n * 2, pairs - n);
+}
+
+static void swap_pairs_neon(const uint8_t* src, uint8_t* dst, size_t pairs) {
+    size_t n = pairs & ~(size_t)7;
+
+    for (size_t i = 0; i < n; i += 8) {
+        vst1q_u8(dst + i * 2, vrev16q_u8(vld1q_u8(src + i * 2)));
+    }
+    swap_pairs_c(src + n * 2, dst + n * 2, pairs - n);
+}
+
+static void yuv422i_to_planes_neon(const uint8_t* src0, const uint8_t* src1,
+                                   uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr,
+                                   size_t pairs, bool uyvy) {
+    // lanes of a vld4 of 2 pixel groups
+    const int y = uyvy ? 1 : 0;
+    const int u = uyvy ? 0 : 1;
+    const int v = uyvy ? 2 : 3;
+    size_t n = pairs & ~(size_t)15;
+
+    for (size_t i = 0; i < n; i += 16) {
+        uint8x16x4_t p0 = vld4q_u8(src0 + i * 4);
+        uint8x16x4_t p1 = vld4q_u8(src1 + i * 4);
+        uint8x16x2_t luma;
+
+        luma.val[0] = p0.val[y];
+        luma.val[1] = p0.val[y + 2];
+        vst2q_u8(y0 + i * 2, luma);
+        luma.val[0] = p1.val[y];
+        luma.val[1] = p1.val[y + 2];
+        vst2q_u8(y1 + i * 2, luma);
+        vst1q_u8(cb + i, vrhaddq_u8(p0.val[u], p1.val[u]));
+        vst1q_u8(cr + i, vrhaddq_u8(p0.val[v], p1.val[v]));
+    }
+    yuv422i_to_planes_c(src0 + n * 4, src1 + n * 4, y0 + n * 2, y1 + n * 2, cb + n, cr + n,
+                        pairs - n, uyvy);
+}
+
+static const pixel_convert_kernels neon_kernels = {
+    split_pairs_neon,
+    merge_pairs_neon,
+    swap_pairs_neon,
+    yuv422i_to_planes_neon,
+};
+
+#endif
+
+#ifdef PIXEL_CONVERT_HAVE_SSE2
+
+static void split_pairs_sse2(const uint8_t* src, uint8_t* even, uint8_t* odd, size_t pairs) {
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    size_t n = pairs & ~(size_t)15;
+
+    for (size_t i = 0; i < n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i * 2));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i * 2 + 16));
+
+        _mm_storeu_si128((__m128i*)(even + i),
+                         _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        if (odd) {
+            _mm_storeu_si128((__m128i*)(odd + i),
+                             _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+        }
+    }
+    split_pairs_c(src + n * 2, even + n, odd ? odd + n : NULL, pairs - n);
+}
+
+static void merge_pairs_sse2(const uint8_t* even, const uint8_t* odd, uint8_t* dst, size_t pairs) {
+    size_t n = pairs & ~(size_t)15;
+
+    for (size_t i = 0; i < n; i += 16) {
+        __m128i e = _mm_loadu_si128((const __m128i*)(even + i));
+        __m128i o = _mm_loadu_si128((const __m128i*)(odd + i));
+
+        _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi8(e, o));
+        _mm_storeu_si128((__m128i*)(dst + i * 2 + 16), _mm_unpackhi_epi8(e, o));
+    }
+    merge_pairs_c(even + n, odd + n, dst + n * 2, pairs - n);
+}
+
+static void swap_pairs_sse2(const uint8_t* src, uint8_t* dst, size_t pairs) {
+    size_t n = pairs & ~(size_t)7;
+
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i * 2));
+        _mm_storeu_si128((__m128i*)(dst + i * 2),
+                         _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+    }
+    swap_pairs_c(src + n * 2, dst + n * 2, pairs - n);
+}
+
+// Luma or chroma bytes of yuv422i, in the low byte of each 16 bit lane
+static inline __m128i select_even_sse2(__m128i x) {
+    return _mm_and_si128(x, _mm_set1_epi16(0x00FF));
+}
+
+static inline __m128i select_odd_sse2(__m128i x) {
+    return _mm_srli_epi16(x, 8);
+}
+
+static void yuv422i_to_planes_sse2(const uint8_t* src0, const uint8_t* src1,
+                                   uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr,
+                                   size_t pairs, bool uyvy) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t n = pairs & ~(size_t)7;
+
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(src0 + i * 4));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(src0 + i * 4 + 16));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(src1 + i * 4));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(src1 + i * 4 + 16));
+        __m128i luma0, luma1, chroma0, chroma1, chroma;
+
+        if (uyvy) {
+            luma0 = _mm_packus_epi16(select_odd_sse2(a0), select_odd_sse2(b0));
+            luma1 = _mm_packus_epi16(select_odd_sse2(a1), select_odd_sse2(b1));
+            chroma0 = _mm_packus_epi16(select_even_sse2(a0), select_even_sse2(b0));
+            chroma1 = _mm_packus_epi16(select_even_sse2(a1), select_even_sse2(b1));
+        } else {
+            luma0 = _mm_packus_epi16(select_even_sse2(a0), select_even_sse2(b0));
+            luma1 = _mm_packus_epi16(select_even_sse2(a1), select_even_sse2(b1));
+            chroma0 = _mm_packus_epi16(select_odd_sse2(a0), select_odd_sse2(b0));
+            chroma1 = _mm_packus_epi16(select_odd_sse2(a1), select_odd_sse2(b1));
+        }
+
+        // Cb and Cr alternate in both layouts, Cb first
+        chroma = _mm_avg_epu8(chroma0, chroma1);
+        _mm_storeu_si128((__m128i*)(y0 + i * 2), luma0);
+        _mm_storeu_si128((__m128i*)(y1 + i * 2), luma1);
+        _mm_storel_epi64((__m128i*)(cb + i), _mm_packus_epi16(select_even_sse2(chroma), zero));
+        _mm_storel_epi64((__m128i*)(cr + i), _mm_packus_epi16(select_odd_sse2(chroma), zero));
+    }
+    yuv422i_to_planes_c(src0 + n * 4, src1 + n * 4, y0 + n * 2, y1 + n * 2, cb + n, cr + n,
+                        pairs - n, uyvy);
+}
+
+static const pixel_convert_kernels sse2_kernels = {
+    split_pairs_sse2,
+    merge_pairs_sse2,
+    swap_pairs_sse2,
+    yuv422i_to_planes_sse2,
+};
+
+#endif
+
+#ifdef PIXEL_CONVERT_HAVE_AVX2
+
+// packus works within 128 bit lanes, this puts the 64 bit quarters back in order
+#define AVX2_PACK_ORDER 0xD8
+
+static PIXEL_CONVERT_AVX2_TARGET
+void split_pairs_avx2(const uint8_t* src, uint8_t* even, uint8_t* odd, size_t pairs) {
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    size_t n = pairs & ~(size_t)31;
+
+    for (size_t i = 0; i < n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i * 2));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i * 2 + 32));
+        __m256i e = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+
+        _mm256_storeu_si256((__m256i*)(even + i), _mm256_permute4x64_epi64(e, AVX2_PACK_ORDER));
+        if (odd) {
+            __m256i o = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+            _mm256_storeu_si256((__m256i*)(odd + i), _mm256_permute4x64_epi64(o, AVX2_PACK_ORDER));
+        }
+    }
+    split_pairs_c(src + n * 2, even + n, odd ? odd + n : NULL, pairs - n);
+}
+
+static PIXEL_CONVERT_AVX2_TARGET
+void merge_pairs_avx2(const uint8_t* even, const uint8_t* odd, uint8_t* dst, size_t pairs) {
+    size_t n = pairs & ~(size_t)31;
+
+    for (size_t i = 0; i < n; i += 32) {
+        __m256i e = _mm256_loadu_si256((const __m256i*)(even + i));
+        __m256i o = _mm256_loadu_si256((const __m256i*)(odd + i));
+        __m256i lo = _mm256_unpacklo_epi8(e, o);
+        __m256i hi = _mm256_unpackhi_epi8(e, o);
+
+        _mm256_storeu_si256((__m256i*)(dst + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(dst + i * 2 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    merge_pairs_c(even + n, odd + n, dst + n * 2, pairs - n);
+}
+
+static PIXEL_CONVERT_AVX2_TARGET
+void swap_pairs_avx2(const uint8_t* src, uint8_t* dst, size_t pairs) {
+    size_t n = pairs & ~(size_t)15;
+
+    for (size_t i = 0; i < n; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(src + i * 2));
+        _mm256_storeu_si256((__m256i*)(dst + i * 2),
+                            _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8)));
+    }
+    swap_pairs_c(src + n * 2, dst + n * 2, pairs - n);
+}
+
+static PIXEL_CONVERT_AVX2_TARGET
+void yuv422i_to_planes_avx2(const uint8_t* src0, const uint8_t* src1,
+                            uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr,
+                            size_t pairs, bool uyvy) {
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m128i luma_shift = _mm_cvtsi32_si128(uyvy ? 8 : 0);
+    const __m128i chroma_shift = _mm_cvtsi32_si128(uyvy ? 0 : 8);
+    size_t n = pairs & ~(size_t)15;
+
+    for (size_t i = 0; i < n; i += 16) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)(src0 + i * 4));
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(src0 + i * 4 + 32));
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(src1 + i * 4));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(src1 + i * 4 + 32));
+        __m256i luma0, luma1, chroma0, chroma1, chroma, c;
+
+        // the sample wanted is shifted to the low byte, then masked
+        luma0 = _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(a0, luma_shift), mask),
+                                    _mm256_and_si256(_mm256_srl_epi16(b0, luma_shift), mask));
+        luma1 = _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(a1, luma_shift), mask),
+                                    _mm256_and_si256(_mm256_srl_epi16(b1, luma_shift), mask));
+        chroma0 = _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(a0, chroma_shift), mask),
+                                      _mm256_and_si256(_mm256_srl_epi16(b0, chroma_shift), mask));
+        chroma1 = _mm256_packus_epi16(_mm256_and_si256(_mm256_srl_epi16(a1, chroma_shift), mask),
+                                      _mm256_and_si256(_mm256_srl_epi16(b1, chroma_shift), mask));
+
+        _mm256_storeu_si256((__m256i*)(y0 + i * 2), _mm256_permute4x64_epi64(luma0, AVX2_PACK_ORDER));
+        _mm256_storeu_si256((__m256i*)(y1 + i * 2), _mm256_permute4x64_epi64(luma1, AVX2_PACK_ORDER));
+
+        // chroma is put in pair order too, so the packs below only leave
+        // their halves apart within each lane
+        chroma = _mm256_avg_epu8(_mm256_permute4x64_epi64(chroma0, AVX2_PACK_ORDER),
+                                 _mm256_permute4x64_epi64(chroma1, AVX2_PACK_ORDER));
+        c = _mm256_packus_epi16(_mm256_and_si256(chroma, mask), zero);
+        _mm_storeu_si128((__m128i*)(cb + i),
+                         _mm256_castsi256_si128(_mm256_permute4x64_epi64(c, AVX2_PACK_ORDER)));
+        c = _mm256_packus_epi16(_mm256_srli_epi16(chroma, 8), zero);
+        _mm_storeu_si128((__m128i*)(cr + i),
+                         _mm256_castsi256_si128(_mm256_permute4x64_epi64(c, AVX2_PACK_ORDER)));
+    }
+    yuv422i_to_planes_c(src0 + n * 4, src1 + n * 4, y0 + n * 2, y1 + n * 2, cb + n, cr + n,
+                        pairs - n, uyvy);
+}
+
+static const pixel_convert_kernels avx2_kernels = {
+    split_pairs_avx2,
+    merge_pairs_avx2,
+    swap_pairs_avx2,
+    yuv422i_to_planes_avx2,
+};
+
+#endif
+
+/* Instruction set selection */
+
+static const pixel_convert_kernels* const isa_kernels[PIXEL_CONVERT_ISAS] = {
+    &c_kernels,
+#ifdef PIXEL_CONVERT_HAVE_NEON
+    &neon_kernels,
+#else
+    NULL,
+#endif
+#ifdef PIXEL_CONVERT_HAVE_SSE2
+    &sse2_kernels,
+#else
+    NULL,
+#endif
+#ifdef PIXEL_CONVERT_HAVE_AVX2
+    &avx2_kernels,
+#else
+    NULL,
+#endif
+};
+
+static const char* const isa_names[PIXEL_CONVERT_ISAS] = { "c", "neon", "sse2", "avx2" };
+
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+static PixelConvertIsa current_isa = PIXEL_CONVERT_C;
+
+static bool isa_supported(PixelConvertIsa isa) {
+    if ((int)isa < 0 || isa >= PIXEL_CONVERT_ISAS || !isa_kernels[isa]) {
+        return false;
+    }
+
+#ifdef PIXEL_CONVERT_HAVE_AVX2
+    if (isa == PIXEL_CONVERT_AVX2) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+
+    return true;
+}
+
+static void init_kernels() {
+    int isa = PIXEL_CONVERT_ISAS - 1;
+
+    while (isa > PIXEL_CONVERT_C && !isa_supported((PixelConvertIsa)isa)) {
+        isa--;
+    }
+    __atomic_store_n(&current_isa, (PixelConvertIsa)isa, __ATOMIC_RELEASE);
+}
+
+static const pixel_convert_kernels* get_kernels() {
+    pthread_once(&kernels_once, init_kernels);
+    return isa_kernels[__atomic_load_n(&current_isa, __ATOMIC_ACQUIRE)];
+}
+
+/* public static functions */
+
+void PixelConvert::splitPairs(const uint8_t* src, uint8_t* even, uint8_t* odd, size_t pairs) {
+    get_kernels()->split_pairs(src, even, odd, pairs);
+}
+
+void PixelConvert::mergePairs(const uint8_t* even, const uint8_t* odd, uint8_t* dst, size_t pairs) {
+    get_kernels()->merge_pairs(even, odd, dst, pairs);
+}
+
+void PixelConvert::swapPairs(const uint8_t* src, uint8_t* dst, size_t pairs) {
+    get_kernels()->swap_pairs(src, dst, pairs);
+}
+
+void PixelConvert::yuv422iToPlanes(const uint8_t* src0, const uint8_t* src1,
+                                   uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr,
+                                   size_t width, bool uyvy) {
+    get_kernels()->yuv422i_to_planes(src0, src1, y0, y1, cb, cr, (width + 1) / 2, uyvy);
+}
+
+void PixelConvert::yuyvToNV12(const uint8_t* src, size_t srcStride,
+                              uint8_t* dstY, uint8_t* dstUV, size_t dstStride,
+                              int width, int height) {
+    const pixel_convert_kernels* kernels = get_kernels();
+
+    // every YUYV byte pair is a Y and a NV12 chroma sample, odd rows only
+    // give their Y
+    for (int i = 0; i < height; i++) {
+        uint8_t* uv = (i & 1) || i / 2 >= height / 2 ? NULL : dstUV + (i / 2) * dstStride;
+
+        kernels->split_pairs(src + i * srcStride, dstY + i * dstStride, uv, width);
+    }
+}
+
+PixelConvertIsa PixelConvert::getIsa() {
+    pthread_once(&kernels_once, init_kernels);
+    return __atomic_load_n(&current_isa, __ATOMIC_ACQUIRE);
+}
+
+bool PixelConvert::setIsa(PixelConvertIsa isa) {
+    pthread_once(&kernels_once, init_kernels);
+    if (!isa_supported(isa)) {
+        return false;
+    }
+
+    __atomic_store_n(&current_isa, isa, __ATOMIC_RELEASE);
+    return true;
+}
+
+const char* PixelConvert::getIsaName(PixelConvertIsa isa) {
+    return (int)isa >= 0 && isa < PIXEL_CONVERT_ISAS ? isa_names[isa] : "unknown";
+}
+
+} // namespace Camera
+} // namespace Ti
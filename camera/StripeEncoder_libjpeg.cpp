@@ -0,0 +1,743 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file StripeEncoder_libjpeg.cpp
+*
+* This file encodes yuv420sp and yuv422i buffers to a jpeg, in stripes
+* encoded in parallel
+*
+*/
+
+#include "StripeEncoder_libjpeg.h"
+#include "NV12_resize.h"
+#include "PixelConvert.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+extern "C" {
+    #include "jpeglib.h"
+    #include "jerror.h"
+}
+
+#define MIN(x,y) ((x < y) ? x : y)
+
+// Lines of an MCU row, libjpeg gets 4:2:0 planes
+#define MCU_LINES (2 * DCTSIZE)
+
+// Stripes shorter than this are not worth handing to another thread
+#define MIN_STRIPE_MCU_ROWS 8
+
+// Largest restart interval a DRI segment holds
+#define MAX_RESTART_INTERVAL 65535
+
+#define JPEG_MARKER_SOF0 0xC0
+#define JPEG_MARKER_RST0 0xD0
+#define JPEG_MARKER_EOI  0xD9
+#define JPEG_MARKER_SOS  0xDA
+
+namespace Ti {
+namespace Camera {
+
+struct libjpeg_destination_mgr : jpeg_destination_mgr {
+    libjpeg_destination_mgr(uint8_t* input, int size);
+
+    uint8_t* buf;
+    int bufsize;
+    size_t jpegsize;
+};
+
+static void libjpeg_init_destination (j_compress_ptr cinfo) {
+    libjpeg_destination_mgr* dest = (libjpeg_destination_mgr*)cinfo->dest;
+
+    dest->next_output_byte = dest->buf;
+    dest->free_in_buffer = dest->bufsize;
+    dest->jpegsize = 0;
+}
+
+static boolean libjpeg_empty_output_buffer(j_compress_ptr cinfo) {
+    libjpeg_destination_mgr* dest = (libjpeg_destination_mgr*)cinfo->dest;
+
+    dest->next_output_byte = dest->buf;
+    dest->free_in_buffer = dest->bufsize;
+    return TRUE; // ?
+}
+
+static void libjpeg_term_destination (j_compress_ptr cinfo) {
+    libjpeg_destination_mgr* dest = (libjpeg_destination_mgr*)cinfo->dest;
+    dest->jpegsize = dest->bufsize - dest->free_in_buffer;
+}
+
+libjpeg_destination_mgr::libjpeg_destination_mgr(uint8_t* input, int size) {
+    this->init_destination = libjpeg_init_destination;
+    this->empty_output_buffer = libjpeg_empty_output_buffer;
+    this->term_destination = libjpeg_term_destination;
+
+    this->buf = input;
+    this->bufsize = size;
+
+    jpegsize = 0;
+}
+
+// Destination of a stripe, grows as libjpeg fills it
+struct libjpeg_memory_destination_mgr : jpeg_destination_mgr {
+    libjpeg_memory_destination_mgr();
+    ~libjpeg_memory_destination_mgr();
+
+    uint8_t* buf;
+    size_t bufsize; // set to the initial size before encoding
+    size_t jpegsize;
+    bool failed;
+};
+
+static void libjpeg_memory_init_destination (j_compress_ptr cinfo) {
+    libjpeg_memory_destination_mgr* dest = (libjpeg_memory_destination_mgr*)cinfo->dest;
+
+    if (!dest->buf) {
+        dest->buf = (uint8_t*)malloc(dest->bufsize);
+        dest->failed = !dest->buf;
+    }
+    dest->next_output_byte = dest->buf;
+    dest->free_in_buffer = dest->buf ? dest->bufsize : 0;
+    dest->jpegsize = 0;
+}
+
+static boolean libjpeg_memory_empty_output_buffer(j_compress_ptr cinfo) {
+    libjpeg_memory_destination_mgr* dest = (libjpeg_memory_destination_mgr*)cinfo->dest;
+    uint8_t* buf = dest->failed ? NULL : (uint8_t*)realloc(dest->buf, dest->bufsize * 2);
+
+    if (!buf) {
+        // keep going over what we have, the stripe is dropped afterwards
+        CAMHAL_LOGEA("Encoder: no memory for a stripe");
+        dest->failed = true;
+        dest->next_output_byte = dest->buf;
+        dest->free_in_buffer = dest->bufsize;
+        return TRUE;
+    }
+
+    dest->buf = buf;
+    dest->next_output_byte = buf + dest->bufsize;
+    dest->free_in_buffer = dest->bufsize;
+    dest->bufsize *= 2;
+    return TRUE;
+}
+
+static void libjpeg_memory_term_destination (j_compress_ptr cinfo) {
+    libjpeg_memory_destination_mgr* dest = (libjpeg_memory_destination_mgr*)cinfo->dest;
+    dest->jpegsize = dest->bufsize - dest->free_in_buffer;
+}
+
+libjpeg_memory_destination_mgr::libjpeg_memory_destination_mgr() {
+    this->init_destination = libjpeg_memory_init_destination;
+    this->empty_output_buffer = libjpeg_memory_empty_output_buffer;
+    this->term_destination = libjpeg_memory_term_destination;
+
+    buf = NULL;
+    bufsize = 0;
+    jpegsize = 0;
+    failed = false;
+}
+
+libjpeg_memory_destination_mgr::~libjpeg_memory_destination_mgr() {
+    free(buf);
+}
+
+/* private static functions */
+
+// Byte offsets of the first Y, Cb and Cr sample in a 2 pixel group of
+// yuv422i or in a chroma pair of yuv420sp
+struct libjpeg_input_layout {
+    int bpp;
+    int y, cb, cr;
+};
+
+static const libjpeg_input_layout input_layouts[LIBJPEG_INPUT_FORMATS] = {
+    // yuv420sp chroma pairs have always been taken with Cr first
+    { 1, 0, 1, 0 },
+    { 2, 0, 1, 3 },
+    { 2, 1, 0, 2 },
+};
+
+// Source of an encode, resolved once and shared by its stripes
+struct libjpeg_source {
+    const libjpeg_input_layout* layout;
+    structConvImage resize_src;
+    uint8_t* row_src;
+    uint8_t* row_uv; // used only for yuv420sp
+    int out_width;
+    int width, height;
+    int c_width, c_height, resize_c_height;
+    int y_pad, c_pad, stride;
+    bool resize, direct_y;
+};
+
+// Repeats the last sample into the padding libjpeg reads up to the next block
+static void pad_row(uint8_t* row, int width, int padded_width) {
+    if (padded_width > width) {
+        memset(row + width, row[width - 1], padded_width - width);
+    }
+}
+
+// Splits a row of yuv420sp chroma pairs into the Cb and Cr planes
+static void yuv420sp_to_planes(uint8_t* cb, uint8_t* cr, const uint8_t* uv,
+                               int width, const libjpeg_input_layout* layout) {
+    if (layout->cb == 0) {
+        PixelConvert::splitPairs(uv, cb, cr, width);
+    } else {
+        PixelConvert::splitPairs(uv, cr, cb, width);
+    }
+}
+
+static bool init_source(libjpeg_source* source, libjpeg_encode_params* input,
+                        libjpeg_input_format format) {
+    int out_width = input->out_width;
+    int in_width = input->in_width;
+    int out_height = input->out_height;
+    int in_height = input->in_height;
+    int right_crop = input->right_crop;
+
+    // param check...
+    if ((in_width < 2) || (out_width < 2) || (in_height < 2) || (out_height < 2) ||
+         (input->src == NULL) || (input->dst == NULL) || (input->quality < 1) ||
+         (input->src_size < 1) || (input->dst_size < 1) || ((int)format < 0) ||
+         (format >= LIBJPEG_INPUT_FORMATS) || (right_crop < 0) ||
+         (out_width - right_crop < 2)) {
+        return false;
+    }
+
+    source->layout = &input_layouts[format];
+    source->resize = (in_width != out_width) || (in_height != out_height);
+    if (source->resize && (source->layout->bpp != 1)) {
+        CAMHAL_LOGEB("Encoder: resizing is not supported for this format: %d", format);
+        return false;
+    }
+
+    // yuv422i comes in pixel pairs, only a crop can make the width odd
+    if ((source->layout->bpp != 1) && (out_width & 1)) {
+        CAMHAL_LOGEB("Encoder: odd widths are not supported for this format: %d", format);
+        return false;
+    }
+
+    // libjpeg takes 4:2:0 planes an MCU row at a time, each row padded to
+    // whole blocks
+    source->out_width = out_width;
+    source->width = out_width - right_crop;
+    source->height = out_height;
+    source->c_width = (source->width + 1) / 2;
+    source->c_height = (out_height + 1) / 2;
+    source->y_pad = (out_width + MCU_LINES - 1) & ~(MCU_LINES - 1);
+    source->c_pad = source->y_pad / 2;
+    source->stride = out_width * source->layout->bpp;
+
+    // Unscaled yuv420sp luma is handed to libjpeg in place, it reads up to
+    // the end of the last block of a line
+    source->direct_y = !source->resize && (source->layout->bpp == 1) &&
+                       (((source->width + DCTSIZE - 1) & ~(DCTSIZE - 1)) <= source->stride);
+
+    if (source->resize) {
+        source->resize_src.uWidth = in_width;
+        source->resize_src.uStride = in_width;
+        source->resize_src.uHeight = in_height;
+        source->resize_src.eFormat = IC_FORMAT_YCbCr420_lp;
+        source->resize_src.imgPtr = input->src;
+        source->resize_src.clrPtr = input->src + in_width * in_height;
+        source->resize_src.uOffset = 0;
+        // VT_resizeFrame_Video_opt2_lp only produces this many chroma rows
+        source->resize_c_height = out_height / 2;
+    }
+
+    source->row_src = input->src + input->start_offset;
+    source->row_uv = input->src + out_width * out_height;
+
+    return true;
+}
+
+// Size of the buffers holding one MCU row of planes
+static size_t planes_size(const libjpeg_source* source) {
+    return (source->direct_y ? 0 : MCU_LINES * source->y_pad) + MCU_LINES * source->c_pad;
+}
+
+// Feeds libjpeg the MCU rows starting at first_line until the image it was
+// set up for is complete. Returns false if canceled.
+static bool write_mcu_rows(j_compress_ptr cinfo, const libjpeg_source* source,
+                           uint8_t* planes_buf, int first_line,
+                           const volatile bool* canceled) {
+    const libjpeg_input_layout* layout = source->layout;
+    uint8_t* cb_buf = planes_buf;
+    uint8_t* cr_buf = cb_buf + DCTSIZE * source->c_pad;
+    uint8_t* y_buf = cr_buf + DCTSIZE * source->c_pad;
+    JSAMPROW y_rows[MCU_LINES], cb_rows[DCTSIZE], cr_rows[DCTSIZE];
+    JSAMPARRAY planes[3] = { y_rows, cb_rows, cr_rows };
+    const int stride = source->stride;
+    const int width = source->width;
+
+    while (cinfo->next_scanline < cinfo->image_height) {
+        int c_row = (first_line + cinfo->next_scanline) / 2;
+
+        if (*canceled) {
+            return false;
+        }
+
+        for (int i = 0; i < DCTSIZE; i++, c_row++) {
+            int l0 = c_row * 2;
+            int l1 = MIN(l0 + 1, source->height - 1);
+
+            // lines below the image repeat the last one, the first row of an
+            // MCU row is always in it
+            if (c_row >= source->c_height) {
+                y_rows[i * 2] = y_rows[i * 2 + 1] = y_rows[i * 2 - 1];
+                cb_rows[i] = cb_rows[i - 1];
+                cr_rows[i] = cr_rows[i - 1];
+                continue;
+            }
+
+            cb_rows[i] = cb_buf + i * source->c_pad;
+            cr_rows[i] = cr_buf + i * source->c_pad;
+
+            if (source->direct_y) {
+                y_rows[i * 2] = source->row_src + l0 * stride;
+                y_rows[i * 2 + 1] = source->row_src + l1 * stride;
+            } else {
+                y_rows[i * 2] = y_buf + i * 2 * source->y_pad;
+                y_rows[i * 2 + 1] = y_rows[i * 2] + source->y_pad;
+            }
+
+            if (source->resize) {
+                structConvImage* resize_src = const_cast<structConvImage*>(&source->resize_src);
+
+                VT_resizeRowY_lp(resize_src, l0, source->out_width, source->height, y_rows[i * 2]);
+                VT_resizeRowY_lp(resize_src, l1, source->out_width, source->height, y_rows[i * 2 + 1]);
+                // the first sample of a pair is Cr, see input_layouts. The
+                // last chroma row of an odd height repeats the one above, it
+                // may start an MCU row.
+                VT_resizeRowCbCr_lp(resize_src, MIN(c_row, source->resize_c_height - 1),
+                                    source->out_width, source->height,
+                                    cr_rows[i], cb_rows[i], 1);
+            } else if (layout->bpp == 1) {
+                if (!source->direct_y) {
+                    memcpy(y_rows[i * 2], source->row_src + l0 * stride, width);
+                    memcpy(y_rows[i * 2 + 1], source->row_src + l1 * stride, width);
+                }
+                yuv420sp_to_planes(cb_rows[i], cr_rows[i], source->row_uv + c_row * stride,
+                                   source->c_width, layout);
+            } else {
+                // chroma of the two rows is averaged the way libjpeg
+                // downsamples it vertically
+                PixelConvert::yuv422iToPlanes(source->row_src + l0 * stride,
+                                              source->row_src + l1 * stride,
+                                              y_rows[i * 2], y_rows[i * 2 + 1],
+                                              cb_rows[i], cr_rows[i], width, layout->y == 1);
+            }
+
+            if (!source->direct_y) {
+                pad_row(y_rows[i * 2], width, source->y_pad);
+                pad_row(y_rows[i * 2 + 1], width, source->y_pad);
+            }
+            pad_row(cb_rows[i], source->c_width, source->c_pad);
+            pad_row(cr_rows[i], source->c_width, source->c_pad);
+        }
+
+        jpeg_write_raw_data(cinfo, planes, MCU_LINES);
+    }
+
+    return true;
+}
+
+// Encodes lines of the source as a complete JPEG. A restart interval other
+// than 0 goes into its DRI segment. Returns false if canceled.
+static bool encode_lines(const libjpeg_source* source, int quality, int first_line, int lines,
+                         unsigned int restart_interval, jpeg_destination_mgr* dest,
+                         uint8_t* planes_buf, const volatile bool* canceled) {
+    jpeg_compress_struct    cinfo;
+    jpeg_error_mgr jerr;
+    bool done;
+
+    cinfo.err = jpeg_std_error(&jerr);
+
+    jpeg_create_compress(&cinfo);
+
+    cinfo.dest = dest;
+    cinfo.image_width = source->width;
+    cinfo.image_height = lines;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    cinfo.input_gamma = 1;
+
+    // defaults to 2x2 luma and 1x1 chroma sampling
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.raw_data_in = TRUE;
+    cinfo.restart_interval = restart_interval;
+
+    jpeg_start_compress(&cinfo, TRUE);
+
+    done = write_mcu_rows(&cinfo, source, planes_buf, first_line, canceled);
+
+    // no need to finish encoding routine if we are prematurely stopping
+    // we will end up crashing in dest_mgr since data is incomplete
+    if (done)
+        jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    return done;
+}
+
+struct libjpeg_stripe {
+    libjpeg_memory_destination_mgr dest;
+    bool done;
+};
+
+// A split encode, the stripe counters are protected by the pool lock
+struct libjpeg_stripe_job {
+    const libjpeg_source* source;
+    int quality;
+    const volatile bool* canceled;
+    int stripe_lines;
+    unsigned int restart_interval;
+    libjpeg_stripe* stripes;
+    int count;
+    int next;
+    int finished;
+};
+
+static void encode_stripe(libjpeg_stripe_job* job, int index) {
+    const libjpeg_source* source = job->source;
+    libjpeg_stripe* stripe = &job->stripes[index];
+    int first_line = index * job->stripe_lines;
+    int lines = MIN(job->stripe_lines, source->height - first_line);
+    uint8_t* planes_buf = (uint8_t*)malloc(planes_size(source));
+
+    stripe->done = false;
+    if (!planes_buf) {
+        CAMHAL_LOGEA("Encoder: no memory for the MCU row buffers");
+        return;
+    }
+
+    // a quarter of the 4:2:0 size is plenty for most quality settings
+    stripe->dest.bufsize = MIN(source->width * lines * 3 / 8 + 4096, 4 << 20);
+    stripe->done = encode_lines(source, job->quality, first_line, lines,
+                                job->restart_interval, &stripe->dest, planes_buf,
+                                job->canceled) && !stripe->dest.failed;
+
+    free(planes_buf);
+}
+
+// Offset of the first header segment with the given marker, 0 if not found
+static size_t find_segment(const uint8_t* jpeg, size_t size, uint8_t marker) {
+    size_t pos = 2; // SOI
+
+    while (pos + 4 <= size) {
+        if (jpeg[pos] != 0xFF) {
+            break;
+        }
+        if (jpeg[pos + 1] == marker) {
+            return pos;
+        }
+        if (jpeg[pos + 1] == JPEG_MARKER_SOS) {
+            break;
+        }
+        pos += 2 + ((jpeg[pos + 2] << 8) | jpeg[pos + 3]);
+    }
+
+    return 0;
+}
+
+// Joins the encoded stripes into one JPEG in the destination of the encode:
+// the headers and data of the first stripe with the image height patched
+// in, then RSTn and the data of each other stripe.
+static size_t join_stripes(libjpeg_encode_params* input, const libjpeg_stripe_job* job) {
+    uint8_t* dst = input->dst;
+    size_t size = 0;
+    size_t sof;
+
+    for (int i = 0; i < job->count; i++) {
+        const libjpeg_stripe* stripe = &job->stripes[i];
+        const uint8_t* data = stripe->dest.buf;
+        size_t len = stripe->dest.jpegsize;
+
+        if (!stripe->done || (len < 4) || (data[len - 1] != JPEG_MARKER_EOI)) {
+            return 0;
+        }
+        len -= 2;
+
+        if (i) {
+            size_t sos = find_segment(data, len, JPEG_MARKER_SOS);
+            size_t start;
+
+            if (!sos) {
+                return 0;
+            }
+            start = sos + 2 + ((data[sos + 2] << 8) | data[sos + 3]);
+            data += start;
+            len -= start;
+        }
+
+        if (size + len + 4 > (size_t)input->dst_size) {
+            CAMHAL_LOGEB("Encoder: jpeg larger than the destination (%d)", input->dst_size);
+            return 0;
+        }
+
+        if (i) {
+            dst[size++] = 0xFF;
+            dst[size++] = JPEG_MARKER_RST0 + ((i - 1) & 7);
+        }
+        memcpy(dst + size, data, len);
+        size += len;
+    }
+
+    dst[size++] = 0xFF;
+    dst[size++] = JPEG_MARKER_EOI;
+
+    // SOF0 holds the height of the first stripe
+    sof = find_segment(dst, size, JPEG_MARKER_SOF0);
+    if (!sof) {
+        return 0;
+    }
+    dst[sof + 5] = (job->source->height >> 8) & 0xFF;
+    dst[sof + 6] = job->source->height & 0xFF;
+
+    return size;
+}
+
+/**
+ * Worker threads shared by all encodes. The thread starting an encode works
+ * on its stripes too, idle workers take stripes of the oldest encode.
+ */
+class StripeEncoderPool {
+public:
+    static StripeEncoderPool* get();
+
+    int getWorkerCount() const { return mWorkers.size(); }
+
+    ///Returns once every stripe of the job is encoded
+    void run(libjpeg_stripe_job* job);
+
+private:
+    class Worker : public android::Thread {
+    public:
+        Worker(StripeEncoderPool* pool) : android::Thread(false), mPool(pool) {}
+
+        virtual bool threadLoop() {
+            mPool->workerLoop();
+            return false;
+        }
+
+    private:
+        StripeEncoderPool* mPool;
+    };
+
+    StripeEncoderPool();
+
+    void workerLoop();
+    bool claimLocked(libjpeg_stripe_job* job, int* index);
+
+    static android::Mutex sLock;
+    static StripeEncoderPool* sPool;
+
+    android::Mutex mLock;
+    android::Condition mJobCond;
+    android::Condition mDoneCond;
+    android::Vector<libjpeg_stripe_job*> mJobs;
+    android::Vector<android::sp<Worker> > mWorkers;
+};
+
+android::Mutex StripeEncoderPool::sLock;
+StripeEncoderPool* StripeEncoderPool::sPool = NULL;
+
+StripeEncoderPool* StripeEncoderPool::get() {
+    android::AutoMutex lock(sLock);
+
+    // lives as long as the process, idle workers just wait for jobs
+    if (!sPool) {
+        sPool = new StripeEncoderPool();
+    }
+
+    return sPool;
+}
+
+StripeEncoderPool::StripeEncoderPool() {
+    long cores = sysconf(_SC_NPROCESSORS_CONF);
+
+    if (cores < 1) {
+        cores = 1;
+    }
+
+    for (long i = 0; i < cores; i++) {
+        android::sp<Worker> worker = new Worker(this);
+
+        if (worker->run("StripeEncoder") != android::NO_ERROR) {
+            CAMHAL_LOGEA("Encoder: failed to start a stripe encoder");
+            break;
+        }
+        mWorkers.push(worker);
+    }
+}
+
+bool StripeEncoderPool::claimLocked(libjpeg_stripe_job* job, int* index) {
+    if (job->next >= job->count) {
+        return false;
+    }
+
+    *index = job->next++;
+
+    if (job->next == job->count) {
+        for (size_t i = 0; i < mJobs.size(); i++) {
+            if (mJobs[i] == job) {
+                mJobs.removeAt(i);
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+void StripeEncoderPool::run(libjpeg_stripe_job* job) {
+    android::AutoMutex lock(mLock);
+    int index;
+
+    mJobs.push(job);
+    mJobCond.broadcast();
+
+    while (claimLocked(job, &index)) {
+        mLock.unlock();
+        encode_stripe(job, index);
+        mLock.lock();
+        job->finished++;
+    }
+
+    while (job->finished < job->count) {
+        mDoneCond.wait(mLock);
+    }
+}
+
+void StripeEncoderPool::workerLoop() {
+    android::AutoMutex lock(mLock);
+
+    for (;;) {
+        libjpeg_stripe_job* job;
+        int index;
+
+        if (mJobs.isEmpty()) {
+            mJobCond.wait(mLock);
+            continue;
+        }
+
+        job = mJobs[0];
+        claimLocked(job, &index);
+
+        mLock.unlock();
+        encode_stripe(job, index);
+        mLock.lock();
+
+        if (++job->finished == job->count) {
+            mDoneCond.broadcast();
+        }
+    }
+}
+
+/* public static functions */
+size_t StripeEncoder_libjpeg::encode(libjpeg_encode_params* input, libjpeg_input_format format,
+                                     const volatile bool* canceled, int maxStripes) {
+    libjpeg_source source;
+    libjpeg_stripe_job job;
+    int mcu_rows, mcus_per_row, stripe_mcu_rows = 0;
+    int stripes;
+
+    if (!input) {
+        return 0;
+    }
+
+    input->jpeg_size = 0;
+
+    if (!init_source(&source, input, format)) {
+        return 0;
+    }
+
+    mcu_rows = (source.height + MCU_LINES - 1) / MCU_LINES;
+    mcus_per_row = (source.width + MCU_LINES - 1) / MCU_LINES;
+
+    stripes = maxStripes > 0 ? maxStripes : getWorkerCount();
+    stripes = MIN(stripes, mcu_rows / MIN_STRIPE_MCU_ROWS);
+    if (stripes > 1) {
+        // a stripe must fit a restart interval
+        stripe_mcu_rows = (mcu_rows + stripes - 1) / stripes;
+        stripe_mcu_rows = MIN(stripe_mcu_rows, MAX_RESTART_INTERVAL / mcus_per_row);
+        stripes = stripe_mcu_rows ? (mcu_rows + stripe_mcu_rows - 1) / stripe_mcu_rows : 1;
+    }
+
+    CAMHAL_LOGDB("encoding...  \n\t"
+                 "width: %d    \n\t"
+                 "height:%d    \n\t"
+                 "dest %p      \n\t"
+                 "dest size:%d \n\t"
+                 "mSrc %p \n\t"
+                 "format: %d \n\t"
+                 "stripes: %d",
+                 input->out_width, input->out_height, input->dst,
+                 input->dst_size, input->src, format, stripes);
+
+    if (stripes <= 1) {
+        libjpeg_destination_mgr dest_mgr(input->dst, input->dst_size);
+        uint8_t* planes_buf = (uint8_t*)malloc(planes_size(&source));
+
+        if (!planes_buf) {
+            CAMHAL_LOGEA("Encoder: no memory for the MCU row buffers");
+            return 0;
+        }
+
+        encode_lines(&source, input->quality, 0, source.height, 0, &dest_mgr,
+                     planes_buf, canceled);
+        free(planes_buf);
+
+        input->jpeg_size = dest_mgr.jpegsize;
+        return dest_mgr.jpegsize;
+    }
+
+    job.source = &source;
+    job.quality = input->quality;
+    job.canceled = canceled;
+    job.stripe_lines = stripe_mcu_rows * MCU_LINES;
+    job.restart_interval = stripe_mcu_rows * mcus_per_row;
+    job.stripes = new libjpeg_stripe[stripes];
+    job.count = stripes;
+    job.next = 0;
+    job.finished = 0;
+
+    StripeEncoderPool::get()->run(&job);
+
+    if (!*canceled) {
+        input->jpeg_size = join_stripes(input, &job);
+    }
+
+    delete [] job.stripes;
+
+    return input->jpeg_size;
+}
+
+int StripeEncoder_libjpeg::getWorkerCount() {
+    return StripeEncoderPool::get()->getWorkerCount();
+}
+
+} // namespace Camera
+} // namespace Ti
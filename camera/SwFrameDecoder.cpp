@@ -14,72 +14,253 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
+
 #include "Common.h"
 #include "SwFrameDecoder.h"
 
 namespace Ti {
 namespace Camera {
 
+/* Tiler NV12 preview buffers */
+static const int NV12_TILER_STRIDE = 4096;
+
+/* More threads than this do not pay off against the preview rate */
+static const long MAX_DECODE_THREADS = 4;
+
 SwFrameDecoder::SwFrameDecoder()
-: mjpegWithHdrSize(0), mJpegWithHeaderBuffer(NULL) {
+: mMaxInFlight(0), mSequence(0), mStopping(false) {
 }
 
 SwFrameDecoder::~SwFrameDecoder() {
-    delete [] mJpegWithHeaderBuffer;
-    mJpegWithHeaderBuffer = NULL;
+    stopThreads();
 }
 
 
 void SwFrameDecoder::doConfigure(__unused const DecoderParameters& params) {
     LOG_FUNCTION_NAME;
 
-    mjpegWithHdrSize = (mParams.width * mParams.height / 2) +
-            mJpgdecoder.readDHTSize();
-    if (mJpegWithHeaderBuffer != NULL) {
-        delete [] mJpegWithHeaderBuffer;
-        mJpegWithHeaderBuffer = NULL;
-    }
-    mJpegWithHeaderBuffer = new unsigned char[mjpegWithHdrSize];
+    android::AutoMutex lock(mJobLock);
+    mJobs.clear();
+    mFailedOutputs.clear();
+    mSequence = 0;
 
     LOG_FUNCTION_NAME_EXIT;
 }
 
+status_t SwFrameDecoder::doStart() {
+    LOG_FUNCTION_NAME;
 
-void SwFrameDecoder::doProcessInputBuffer() {
+    long cores = sysconf(_SC_NPROCESSORS_CONF);
+    if (cores < 1) {
+        cores = 1;
+    } else if (cores > MAX_DECODE_THREADS) {
+        cores = MAX_DECODE_THREADS;
+    }
+
+    android::AutoMutex lock(mJobLock);
+    mStopping = false;
+    for (long i = 0; i < cores; i++) {
+        android::sp<DecodeThread> thread = new DecodeThread(this);
+        if (thread->run("SwFrameDecoder", android::PRIORITY_URGENT_DISPLAY) != NO_ERROR) {
+            CAMHAL_LOGEB("Couldn't start decode thread %d", (int)i);
+            break;
+        }
+        mThreads.push_back(thread);
+    }
+
+    if (mThreads.isEmpty()) {
+        return UNKNOWN_ERROR;
+    }
+
+    // Each worker has the next frame queued behind the one it decodes
+    mMaxInFlight = mThreads.size() * 2;
+    CAMHAL_LOGDB("%d decode threads", (int)mThreads.size());
+
+    LOG_FUNCTION_NAME_EXIT;
+    return NO_ERROR;
+}
+
+void SwFrameDecoder::doStop() {
     LOG_FUNCTION_NAME;
-    nsecs_t timestamp = 0;
 
-    CAMHAL_LOGV("Will add header to MJPEG");
-    int final_jpg_sz = 0;
+    stopThreads();
+
+    android::AutoMutex lock(mJobLock);
+    requeueFailedOutputsLocked();
+
+    LOG_FUNCTION_NAME_EXIT;
+}
+
+void SwFrameDecoder::stopThreads() {
+    android::Vector< android::sp<DecodeThread> > threads;
+
     {
-        int inIndex = mInQueue.itemAt(0);
-        android::sp<MediaBuffer>& inBuffer = mInBuffers->editItemAt(inIndex);
-        android::AutoMutex lock(inBuffer->getLock());
-        timestamp = inBuffer->getTimestamp();
-        final_jpg_sz = mJpgdecoder.appendDHT(
-                reinterpret_cast<unsigned char*>(inBuffer->buffer),
-                inBuffer->filledLen, mJpegWithHeaderBuffer, mjpegWithHdrSize);
-        inBuffer->setStatus(BufferStatus_InDecoded);
+        android::AutoMutex lock(mJobLock);
+        mStopping = true;
+        for (size_t i = 0; i < mJobs.size(); i++) {
+            if (mJobs[i].state == DecodeJobState_Pending) {
+                mJobs.editItemAt(i).state = DecodeJobState_Canceled;
+            }
+        }
+        completeLocked();
+        mJobCondition.broadcast();
+        threads = mThreads;
+        mThreads.clear();
     }
-    CAMHAL_LOGV("Added header to MJPEG");
-    {
-        int outIndex = mOutQueue.itemAt(0);
-        android::sp<MediaBuffer>& outBuffer = mOutBuffers->editItemAt(outIndex);
+
+    // Frames being decoded complete on their own before the threads exit
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i]->requestExitAndWait();
+    }
+}
+
+bool SwFrameDecoder::claimOutputLocked(DecodeJob& job) {
+    for (size_t i = 0; i < mOutQueue.size(); i++) {
+        android::sp<MediaBuffer>& outBuffer = mOutBuffers->editItemAt(mOutQueue[i]);
         android::AutoMutex lock(outBuffer->getLock());
-        CameraBuffer* buffer = reinterpret_cast<CameraBuffer*>(outBuffer->buffer);
-        if (!mJpgdecoder.decode(mJpegWithHeaderBuffer, final_jpg_sz,
-                reinterpret_cast<unsigned char*>(buffer->mapped), 4096)) {
-            CAMHAL_LOGEA("Error while decoding JPEG");
-            return;
+        if (outBuffer->getStatus() == BufferStatus_OutQueued) {
+            CameraBuffer* buffer = reinterpret_cast<CameraBuffer*>(outBuffer->buffer);
+            outBuffer->setStatus(BufferStatus_OutWaitForFill);
+            job.out = outBuffer;
+            job.dst = reinterpret_cast<unsigned char*>(buffer->mapped);
+            return true;
+        }
+    }
+    return false;
+}
+
+void SwFrameDecoder::requeueFailedOutputsLocked() {
+    for (size_t i = 0; i < mFailedOutputs.size(); i++) {
+        for (size_t j = 0; j < mOutQueue.size(); j++) {
+            int index = mOutQueue[j];
+            android::sp<MediaBuffer>& outBuffer = mOutBuffers->editItemAt(index);
+
+            if (outBuffer == mFailedOutputs[i]) {
+                android::AutoMutex lock(outBuffer->getLock());
+                outBuffer->setStatus(BufferStatus_OutQueued);
+                mOutQueue.removeAt(j);
+                mOutQueue.push_back(index);
+                break;
+            }
+        }
+    }
+    mFailedOutputs.clear();
+}
+
+void SwFrameDecoder::doProcessInputBuffer() {
+    LOG_FUNCTION_NAME;
+
+    android::AutoMutex lock(mJobLock);
+
+    requeueFailedOutputsLocked();
+
+    for (size_t i = 0; i < mInQueue.size(); i++) {
+        android::sp<MediaBuffer>& inBuffer = mInBuffers->editItemAt(mInQueue[i]);
+        DecodeJob job;
+
+        {
+            android::AutoMutex bufferLock(inBuffer->getLock());
+            if (inBuffer->getStatus() != BufferStatus_InQueued) {
+                continue;
+            }
+
+            // The frame is decoded in place, its buffer is held until then
+            if (mStopping || mJobs.size() >= mMaxInFlight || !claimOutputLocked(job)) {
+                CAMHAL_LOGDB("Dropping MJPEG frame %d, %d in flight", mInQueue[i], (int)mJobs.size());
+                inBuffer->setStatus(BufferStatus_InDecoded);
+                continue;
+            }
+
+            job.sequence = mSequence++;
+            job.in = inBuffer;
+            job.src = reinterpret_cast<unsigned char*>(inBuffer->buffer);
+            job.filledLen = inBuffer->filledLen;
+            job.timestamp = inBuffer->getTimestamp();
+            job.state = DecodeJobState_Pending;
+            inBuffer->setStatus(BufferStatus_InWaitForEmpty);
         }
-        outBuffer->setTimestamp(timestamp);
-        outBuffer->setStatus(BufferStatus_OutFilled);
+
+        mJobs.push_back(job);
+        mJobCondition.signal();
     }
-    CAMHAL_LOGV("JPEG decoded!");
 
     LOG_FUNCTION_NAME_EXIT;
 }
 
+bool SwFrameDecoder::decodeNext(Decoder_libjpeg& decoder) {
+    android::AutoMutex lock(mJobLock);
+    size_t index = 0;
+
+    for (;;) {
+        if (mStopping) {
+            return false;
+        }
+
+        // Frames are claimed in queue order, pending ones trail the rest
+        while (index < mJobs.size() && mJobs[index].state != DecodeJobState_Pending) {
+            index++;
+        }
+        if (index < mJobs.size()) {
+            break;
+        }
+
+        mJobCondition.wait(mJobLock);
+        index = 0;
+    }
+
+    DecodeJob& job = mJobs.editItemAt(index);
+    int sequence = job.sequence;
+    unsigned char* src = job.src;
+    unsigned char* dst = job.dst;
+    int filledLen = job.filledLen;
+    job.state = DecodeJobState_Running;
+
+    mJobLock.unlock();
+    bool decoded = decoder.decodeWithDHT(src, filledLen, dst, NV12_TILER_STRIDE);
+    mJobLock.lock();
+
+    if (!decoded) {
+        CAMHAL_LOGEA("Error while decoding JPEG");
+    }
+
+    // Jobs ahead may have completed meanwhile, the index moved
+    for (size_t i = 0; i < mJobs.size(); i++) {
+        if (mJobs[i].sequence == sequence) {
+            mJobs.editItemAt(i).state = decoded ? DecodeJobState_Done : DecodeJobState_Failed;
+            break;
+        }
+    }
+    completeLocked();
+
+    return true;
+}
+
+void SwFrameDecoder::completeLocked() {
+    while (!mJobs.isEmpty() && mJobs[0].state >= DecodeJobState_Done) {
+        const DecodeJob& job = mJobs[0];
+
+        {
+            android::AutoMutex lock(job.out->getLock());
+            if (job.state == DecodeJobState_Done) {
+                job.out->setTimestamp(job.timestamp);
+                job.out->setStatus(BufferStatus_OutFilled);
+            } else {
+                // Nothing to show, the buffer takes a later frame. Left in
+                // its slot it would be filled ahead of the frames before it.
+                mFailedOutputs.push_back(job.out);
+            }
+        }
+
+        {
+            android::AutoMutex lock(job.in->getLock());
+            job.in->setStatus(BufferStatus_InDecoded);
+        }
+
+        mJobs.removeAt(0);
+    }
+}
+
 
 }  // namespace Camera
 }  // namespace Ti
@@ -39,6 +39,7 @@
 #include <linux/videodev.h>
 #include <cutils/properties.h>
 #include "DecoderFactory.h"
+#include "PixelConvert.h"
 
 #define UNLIKELY( exp ) (__builtin_expect( (exp) != 0, false ))
 static int mDebugFps = 0;
@@ -54,7 +55,6 @@ namespace Camera {
 #define FPS_PERIOD 30
 
 //Proto Types
-static void convertYUV422i_yuyvTouyvy(uint8_t *src, uint8_t *dest, size_t size );
 static void convertYUV422ToNV12Tiler(unsigned char *src, unsigned char *dest, int width, int height );
 static void convertYUV422ToNV12(unsigned char *src, unsigned char *dest, int width, int height );
 
@@ -1204,33 +1204,9 @@ V4LCameraAdapter::~V4LCameraAdapter()
     LOG_FUNCTION_NAME_EXIT;
 }
 
-static void convertYUV422i_yuyvTouyvy(uint8_t *src, uint8_t *dest, size_t size ) {
-    //convert YUV422I yuyv to uyvy format.
-    uint32_t *bf = (uint32_t*)src;
-    uint32_t *dst = (uint32_t*)dest;
-
-    LOG_FUNCTION_NAME;
-
-    if (!src || !dest) {
-        return;
-    }
-
-    for(size_t i = 0; i < size; i = i+4)
-    {
-        dst[0] = ((bf[0] & 0x00FF00FF) << 8) | ((bf[0] & 0xFF00FF00) >> 8);
-        bf++;
-        dst++;
-    }
-
-    LOG_FUNCTION_NAME_EXIT;
-}
-
 static void convertYUV422ToNV12Tiler(unsigned char *src, unsigned char *dest, int width, int height ) {
     //convert YUV422I to YUV420 NV12 format and copies directly to preview buffers (Tiler memory).
     int stride = 4096;
-    unsigned char *bf = src;
-    unsigned char *dst_y = dest;
-    unsigned char *dst_uv = dest + ( height * stride);
 #ifdef PPM_PER_FRAME_CONVERSION
     static int frameCount = 0;
     static nsecs_t ppm_diff = 0;
@@ -1239,61 +1215,7 @@ static void convertYUV422ToNV12Tiler(unsigned char *src, unsigned char *dest, in
 
     LOG_FUNCTION_NAME;
 
-    if (width % 16 ) {
-        for(int i = 0; i < height; i++) {
-            for(int j = 0; j < width; j++) {
-                *dst_y = *bf;
-                dst_y++;
-                bf = bf + 2;
-            }
-            dst_y += (stride - width);
-        }
-
-        bf = src;
-        bf++;  //UV sample
-        for(int i = 0; i < height/2; i++) {
-            for(int j=0; j<width; j++) {
-                *dst_uv = *bf;
-                dst_uv++;
-                bf = bf + 2;
-            }
-            bf = bf + width*2;
-            dst_uv = dst_uv + (stride - width);
-        }
-    } else {
-        //neon conversion
-        for(int i = 0; i < height; i++) {
-            int n = width;
-            int skip = i & 0x1;       // skip uv elements for the odd rows
-            asm volatile (
-                "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-                "   cmp %[n], #16                                               \n\t"
-                "   blt 5f                                                      \n\t"
-                "0: @ 16 pixel copy                                             \n\t"
-                "   vld2.8  {q0, q1} , [%[src]]! @ q0 = yyyy.. q1 = uvuv..      \n\t"
-                "                                @ now q0 = y q1 = uv           \n\t"
-                "   vst1.32   {d0,d1}, [%[dst_y]]!                              \n\t"
-                "   cmp    %[skip], #0                                          \n\t"
-                "   bne 1f                                                      \n\t"
-                "   vst1.32  {d2,d3},[%[dst_uv]]!                               \n\t"
-                "1: @ skip odd rows for UV                                      \n\t"
-                "   sub %[n], %[n], #16                                         \n\t"
-                "   cmp %[n], #16                                               \n\t"
-                "   bge 0b                                                      \n\t"
-                "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-                "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-                : [dst_y] "+r" (dst_y), [dst_uv] "+r" (dst_uv), [src] "+r" (src), [n] "+r" (n)
-                : [src_stride] "r" (width), [skip] "r" (skip)
-                : "cc", "memory", "q0", "q1", "q2", "d0", "d1", "d2", "d3"
-            );
-            dst_y = dst_y + (stride - width);
-            if (skip == 0) {
-                dst_uv = dst_uv + (stride - width);
-            }
-        } //end of for()
-    }
+    PixelConvert::yuyvToNV12(src, width * 2, dest, dest + (height * stride), stride, width, height);
 
 #ifdef PPM_PER_FRAME_CONVERSION
     ppm_diff += (systemTime() - ppm_start);
@@ -1313,61 +1235,9 @@ static void convertYUV422ToNV12Tiler(unsigned char *src, unsigned char *dest, in
 
 static void convertYUV422ToNV12(unsigned char *src, unsigned char *dest, int width, int height ) {
     //convert YUV422I to YUV420 NV12 format.
-    unsigned char *bf = src;
-    unsigned char *dst_y = dest;
-    unsigned char *dst_uv = dest + (width * height);
-
     LOG_FUNCTION_NAME;
 
-    if (width % 16 ) {
-        for(int i = 0; i < height; i++) {
-            for(int j = 0; j < width; j++) {
-                *dst_y = *bf;
-                dst_y++;
-                bf = bf + 2;
-            }
-        }
-
-        bf = src;
-        bf++;  //UV sample
-        for(int i = 0; i < height/2; i++) {
-            for(int j=0; j<width; j++) {
-                *dst_uv = *bf;
-                dst_uv++;
-                bf = bf + 2;
-            }
-            bf = bf + width*2;
-        }
-    } else {
-        //neon conversion
-        for(int i = 0; i < height; i++) {
-            int n = width;
-            int skip = i & 0x1;       // skip uv elements for the odd rows
-            asm volatile (
-                "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-                "   cmp %[n], #16                                               \n\t"
-                "   blt 5f                                                      \n\t"
-                "0: @ 16 pixel copy                                             \n\t"
-                "   vld2.8  {q0, q1} , [%[src]]! @ q0 = yyyy.. q1 = uvuv..      \n\t"
-                "                                @ now q0 = y q1 = uv           \n\t"
-                "   vst1.32   {d0,d1}, [%[dst_y]]!                              \n\t"
-                "   cmp    %[skip], #0                                          \n\t"
-                "   bne 1f                                                      \n\t"
-                "   vst1.32  {d2,d3},[%[dst_uv]]!                               \n\t"
-                "1: @ skip odd rows for UV                                      \n\t"
-                "   sub %[n], %[n], #16                                         \n\t"
-                "   cmp %[n], #16                                               \n\t"
-                "   bge 0b                                                      \n\t"
-                "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-                "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-                : [dst_y] "+r" (dst_y), [dst_uv] "+r" (dst_uv), [src] "+r" (src), [n] "+r" (n)
-                : [src_stride] "r" (width), [skip] "r" (skip)
-                : "cc", "memory", "q0", "q1", "q2", "d0", "d1", "d2", "d3"
-            );
-        }
-    }
+    PixelConvert::yuyvToNV12(src, width * 2, dest, dest + (width * height), width, width, height);
 
     LOG_FUNCTION_NAME_EXIT;
 }
@@ -1411,7 +1281,7 @@ void V4LCameraAdapter::returnOutputBuffer(int index)
     if (mRecording)
     {
         frame.mFrameMask |= (unsigned int)CameraFrame::VIDEO_FRAME_SYNC;
-        mFramesWithEncoder++;
+        __atomic_add_fetch(&mFramesWithEncoder, 1, __ATOMIC_RELAXED);
     }
 
     int ret = setInitFrameRefCount(frame.mBuffer, frame.mFrameMask);
@@ -1528,7 +1398,7 @@ int V4LCameraAdapter::previewThread()
         if (mRecording)
         {
             frame.mFrameMask |= (unsigned int)CameraFrame::VIDEO_FRAME_SYNC;
-            mFramesWithEncoder++;
+            __atomic_add_fetch(&mFramesWithEncoder, 1, __ATOMIC_RELAXED);
         }
 
         ret = setInitFrameRefCount(frame.mBuffer, frame.mFrameMask);
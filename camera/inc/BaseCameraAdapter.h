@@ -34,6 +34,57 @@ struct LUTtypeHAL{
     const LUT *Table;
 };
 
+/**
+  * The buffers of one BaseCameraAdapter buffer pool, with the reference
+  * counts of the frames sent out from them.
+  *
+  * Counts live in the buffers themselves (CameraBuffer::frameRefs), so sending
+  * frames out and returning them only needs atomic operations. Each count is
+  * tagged with the pool generation, clear() starts a new one which drops the
+  * counts of every buffer without touching them, as they may be freed by then.
+  * The buffer list is only used when the pool is reconfigured.
+  *
+  * CameraBuffer::frameRefsPending sums the counts of a buffer over all pools,
+  * so a buffer shared by preview and video is queued again exactly once: by
+  * whoever drops its last reference. It is tagged with a generation bumped
+  * each time the buffer goes out again, so that decrement can't be confused
+  * with one from an earlier round.
+  */
+class FrameBufferPool
+{
+public:
+    FrameBufferPool(CameraBufferRefSlot slot);
+
+    //KeyedVector like interface for configuring the pool
+    void clear();
+    void add(CameraBuffer *buf, int refCount);
+    size_t size() const;
+    CameraBuffer *keyAt(size_t index) const;
+
+    ///Returns -1 if the buffer is not in the pool
+    int getRefCount(CameraBuffer *buf) const;
+    ///Adds the buffer to the pool if needed
+    void setRefCount(CameraBuffer *buf, int refCount);
+    ///Returns the count left or -1 if it was zero already
+    int decRefCount(CameraBuffer *buf);
+    ///Drops one of the references a buffer has over all pools, returns true
+    ///if it was the last one
+    static bool decPendingRefCount(CameraBuffer *buf);
+
+private:
+    static const uint32_t COUNT_MASK = 0xFFFF;
+    static const int GENERATION_SHIFT = 16;
+
+    void addLocked(CameraBuffer *buf, int refCount);
+    static void addPending(CameraBuffer *buf, uint32_t count);
+    static bool subPending(CameraBuffer *buf, uint32_t count);
+
+    const CameraBufferRefSlot mSlot;
+    uint32_t mGeneration;
+    mutable android::Mutex mLock;
+    android::Vector<CameraBuffer *> mBuffers;
+};
+
 class BaseCameraAdapter : public CameraAdapter
 {
 
@@ -180,6 +231,7 @@ protected:
     int getFrameRefCount(CameraBuffer* frameBuf);
     int getFrameRefCountByType(CameraBuffer* frameBuf, CameraFrame::FrameType frameType);
     int setInitFrameRefCount(CameraBuffer* buf, unsigned int mask);
+    FrameBufferPool *getFrameBufferPool(CameraFrame::FrameType frameType);
     static const char* getLUTvalue_translateHAL(int Value, LUTtypeHAL LUT);
 
 // private member functions
@@ -219,8 +271,6 @@ protected:
 
 #endif
 
-    mutable android::Mutex mReturnFrameLock;
-
     //Lock protecting the Adapter state
     mutable android::Mutex mLock;
     AdapterState mAdapterState;
@@ -243,37 +293,37 @@ protected:
     CameraBuffer *mPreviewBuffers;
     int mPreviewBufferCount;
     size_t mPreviewBuffersLength;
-    android::KeyedVector<CameraBuffer *, int> mPreviewBuffersAvailable;
+    FrameBufferPool mPreviewBuffersAvailable;
     mutable android::Mutex mPreviewBufferLock;
 
     //Snapshot buffer management data
-    android::KeyedVector<CameraBuffer *, int> mSnapshotBuffersAvailable;
+    FrameBufferPool mSnapshotBuffersAvailable;
     mutable android::Mutex mSnapshotBufferLock;
 
     //Video buffer management data
     CameraBuffer *mVideoBuffers;
-    android::KeyedVector<CameraBuffer *, int> mVideoBuffersAvailable;
+    FrameBufferPool mVideoBuffersAvailable;
     int mVideoBuffersCount;
     size_t mVideoBuffersLength;
     mutable android::Mutex mVideoBufferLock;
 
     //Image buffer management data
     CameraBuffer *mCaptureBuffers;
-    android::KeyedVector<CameraBuffer *, int> mCaptureBuffersAvailable;
+    FrameBufferPool mCaptureBuffersAvailable;
     int mCaptureBuffersCount;
     size_t mCaptureBuffersLength;
     mutable android::Mutex mCaptureBufferLock;
 
     //Metadata buffermanagement
     CameraBuffer *mPreviewDataBuffers;
-    android::KeyedVector<CameraBuffer *, int> mPreviewDataBuffersAvailable;
+    FrameBufferPool mPreviewDataBuffersAvailable;
     int mPreviewDataBuffersCount;
     size_t mPreviewDataBuffersLength;
     mutable android::Mutex mPreviewDataBufferLock;
 
     //Video input buffer management data (used for reproc pipe)
     CameraBuffer *mVideoInBuffers;
-    android::KeyedVector<CameraBuffer *, int> mVideoInBuffersAvailable;
+    FrameBufferPool mVideoInBuffersAvailable;
     mutable android::Mutex mVideoInBufferLock;
 
     Utils::MessageQueue mFrameQ;
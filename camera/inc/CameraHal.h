@@ -331,6 +331,17 @@ typedef enum {
     CAMERA_BUFFER_ION
 } CameraBufferType;
 
+// Buffer pools of BaseCameraAdapter a buffer keeps frame references for
+enum CameraBufferRefSlot {
+    CAMERA_BUFFER_REF_PREVIEW = 0,
+    CAMERA_BUFFER_REF_SNAPSHOT,
+    CAMERA_BUFFER_REF_VIDEO,
+    CAMERA_BUFFER_REF_CAPTURE,
+    CAMERA_BUFFER_REF_PREVIEW_DATA,
+    CAMERA_BUFFER_REF_VIDEO_IN,
+    CAMERA_BUFFER_REF_SLOTS
+};
+
 typedef struct _CameraBuffer {
     CameraBufferType type;
     /* opaque is the generic drop-in replacement for the pointers
@@ -376,6 +387,11 @@ typedef struct _CameraBuffer {
     int offset; // where valid data starts
     int actual_size; // size of the entire buffer with borders
     int privateData;
+
+    /* Frame reference counts, owned by BaseCameraAdapter and only accessed
+     * atomically. See FrameBufferPool. */
+    uint32_t frameRefs[CAMERA_BUFFER_REF_SLOTS];
+    uint32_t frameRefsPending;
 } CameraBuffer;
 
 void * camera_buffer_get_omx_ptr (CameraBuffer *buffer);
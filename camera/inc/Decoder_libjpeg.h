@@ -17,16 +17,11 @@
 #ifndef ANDROID_CAMERA_HARDWARE_DECODER_LIBJPEG_H
 #define ANDROID_CAMERA_HARDWARE_DECODER_LIBJPEG_H
 
-#include "CameraHal.h"
+#include <stddef.h>
 
-extern "C" {
-#include "jhead.h"
-
-#undef TRUE
-#undef FALSE
-
-}
+#include "Common.h"
 
+struct jpeg_source_mgr;
 
 namespace Ti {
 namespace Camera {
@@ -42,13 +37,17 @@ public:
     static int appendDHT(unsigned char *jpeg_src, int filled_len, unsigned char *jpeg_with_dht_buffer, int buff_size);
     bool decode(unsigned char *jpeg_src, int filled_len, unsigned char *nv12_buffer, int stride);
 
+    ///Decodes an MJPEG frame that left out its Huffman tables, the default
+    ///ones are read ahead of the frame instead of copying it behind them
+    bool decodeWithDHT(unsigned char *jpeg_src, int filled_len, unsigned char *nv12_buffer, int stride);
+
 private:
-    void release();
-    unsigned char **Y_Plane;
-    unsigned char **U_Plane;
-    unsigned char **V_Plane;
+    bool decodeRaw(jpeg_source_mgr *src, unsigned char *nv12_buffer, int stride);
+
+    // chroma rows of one iMCU row waiting to be interleaved, plus a row
+    // taking the luma lines decoded past the bottom of the image
     unsigned char *UV_Plane;
-    unsigned int mWidth, mHeight;
+    size_t mUVPlaneSize;
 };
 
 } // namespace Camera
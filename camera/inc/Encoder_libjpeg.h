@@ -36,6 +36,7 @@ extern "C" {
 }
 
 #include "CameraHal.h"
+#include "StripeEncoder_libjpeg.h"
 
 #define CANCEL_TIMEOUT 5000000 // 5 seconds
 
@@ -126,21 +127,7 @@ class ExifElementsTable {
 class Encoder_libjpeg : public android::Thread {
     /* public member types and variables */
     public:
-        struct params {
-            uint8_t* src;
-            int src_size;
-            uint8_t* dst;
-            int dst_size;
-            int quality;
-            int in_width;
-            int in_height;
-            int out_width;
-            int out_height;
-            int right_crop;
-            int start_offset;
-            const char* format;
-            size_t jpeg_size;
-         };
+        typedef libjpeg_encode_params params;
     /* public member functions */
     public:
         Encoder_libjpeg(params* main_jpeg,
@@ -132,4 +132,31 @@ VT_resizeFrame_Video_opt2_lp(
         mmUint16 dummy                         /* Transparent pixel value              */
         );
 
+/*==========================================================================
+* Function Name  : VT_resizeRowY_lp, VT_resizeRowCbCr_lp
+*
+* Description    : Compute one output row of VT_resizeFrame_Video_opt2_lp,
+*                  for resizing straight into a consumer's row buffers.
+*                  Chroma samples are written step bytes apart.
+============================================================================*/
+void
+VT_resizeRowY_lp(
+        structConvImage* i_img_ptr,        /* Points to the input image           */
+        mmUint16 row,                      /* Output row                          */
+        mmUint32 codx,                     /* Output width                        */
+        mmUint32 cody,                     /* Output height                       */
+        mmUchar* ptr8                      /* codx output samples                 */
+        );
+
+void
+VT_resizeRowCbCr_lp(
+        structConvImage* i_img_ptr,        /* Points to the input image           */
+        mmUint16 row,                      /* Output chroma row                   */
+        mmUint32 codx,                     /* Output width                        */
+        mmUint32 cody,                     /* Output height                       */
+        mmUchar* ptr8Cb,                   /* codx/2 samples of the first plane   */
+        mmUchar* ptr8Cr,                   /* codx/2 samples of the second plane  */
+        mmUint32 step                      /* Distance between output samples     */
+        );
+
 #endif //#define NV12_RESIZE_H_
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file PixelConvert.h
+*
+* This defines the pixel layout conversions shared by camerahal
+*
+*/
+
+#ifndef ANDROID_CAMERA_HARDWARE_PIXELCONVERT_H
+#define ANDROID_CAMERA_HARDWARE_PIXELCONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Ti {
+namespace Camera {
+
+/**
+ * Instruction sets the kernels are built for
+ */
+enum PixelConvertIsa {
+    PIXEL_CONVERT_C = 0,
+    PIXEL_CONVERT_NEON,
+    PIXEL_CONVERT_SSE2,
+    PIXEL_CONVERT_AVX2,
+    PIXEL_CONVERT_ISAS
+};
+
+/**
+ * Byte shuffles between the YUV layouts the camera paths pass around:
+ * yuv422i (YUYV and UYVY), NV12, NV21 and planar chroma.
+ *
+ * Every kernel takes any length, the part that does not fill a vector is
+ * converted one sample at a time. Rows need no alignment, and frame level
+ * conversions take the stride of each side so tiler buffers (4096 bytes)
+ * are read and written in place. The kernels use NEON on ARM, AVX2 or
+ * SSE2 on x86, picked on first use from what the CPU supports, and plain
+ * C elsewhere.
+ */
+class PixelConvert {
+public:
+    ///Splits pairs of bytes into two rows: even gets the first byte of each
+    ///pair and odd the second. odd may be NULL to drop the second bytes.
+    ///NV12 chroma to Cb and Cr, or YUYV to Y and NV12 chroma.
+    static void splitPairs(const uint8_t* src, uint8_t* even, uint8_t* odd, size_t pairs);
+
+    ///Inverse of splitPairs. Cb and Cr to NV12 chroma, or Y and NV12 chroma
+    ///to YUYV.
+    static void mergePairs(const uint8_t* even, const uint8_t* odd, uint8_t* dst, size_t pairs);
+
+    ///Swaps the bytes of each pair, src and dst may be the same.
+    ///NV12 to NV21 chroma, or YUYV to UYVY.
+    static void swapPairs(const uint8_t* src, uint8_t* dst, size_t pairs);
+
+    ///Splits two rows of yuv422i into planes, chroma of the two rows is
+    ///averaged rounding up. An odd width reads the whole last pair and
+    ///writes one Y sample past it.
+    static void yuv422iToPlanes(const uint8_t* src0, const uint8_t* src1,
+                                uint8_t* y0, uint8_t* y1, uint8_t* cb, uint8_t* cr,
+                                size_t width, bool uyvy);
+
+    ///YUYV to NV12, chroma is taken from the even rows
+    static void yuyvToNV12(const uint8_t* src, size_t srcStride,
+                           uint8_t* dstY, uint8_t* dstUV, size_t dstStride,
+                           int width, int height);
+
+    ///Instruction set the kernels currently run with
+    static PixelConvertIsa getIsa();
+
+    ///Switches the kernels to another instruction set, false if this build
+    ///or CPU lacks it. Meant for tests, not while conversions are running.
+    static bool setIsa(PixelConvertIsa isa);
+
+    static const char* getIsaName(PixelConvertIsa isa);
+};
+
+} // namespace Camera
+} // namespace Ti
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file StripeEncoder_libjpeg.h
+*
+* This defines API for camerahal to encode YUV to JPEG in parallel stripes
+*
+*/
+
+#ifndef ANDROID_CAMERA_HARDWARE_STRIPEENCODER_LIBJPEG_H
+#define ANDROID_CAMERA_HARDWARE_STRIPEENCODER_LIBJPEG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Ti {
+namespace Camera {
+
+/**
+ * Input formats, the format string of a capture is resolved by Encoder_libjpeg
+ */
+enum libjpeg_input_format {
+    LIBJPEG_INPUT_YUV420SP = 0,
+    LIBJPEG_INPUT_YUV422I_YUYV,
+    LIBJPEG_INPUT_YUV422I_UYVY,
+    LIBJPEG_INPUT_FORMATS
+};
+
+/**
+ * Source and destination of one JPEG encode
+ */
+struct libjpeg_encode_params {
+    uint8_t* src;
+    int src_size;
+    uint8_t* dst;
+    int dst_size;
+    int quality;
+    int in_width;
+    int in_height;
+    int out_width;
+    int out_height;
+    int right_crop;
+    int start_offset;
+    const char* format;
+    size_t jpeg_size;
+};
+
+/**
+ * Encodes yuv420sp and yuv422i to JPEG with libjpeg, in horizontal stripes
+ * on a pool of worker threads sized to the number of cores.
+ *
+ * Every stripe is a whole number of MCU rows, encoded on its own as a
+ * single restart interval. The stripes are joined with RSTn markers under
+ * the headers of the first one. This gives the baseline JPEG that one
+ * libjpeg pass would produce with the restart interval set to a stripe.
+ * The pool is shared by all encodes, so a burst of captures keeps every
+ * core busy. Images too small to split are encoded in one pass on the
+ * calling thread.
+ */
+class StripeEncoder_libjpeg {
+public:
+    ///Returns the JPEG size, 0 on error or if canceled is set while encoding.
+    ///maxStripes limits the split, 0 leaves it to the pool size.
+    static size_t encode(libjpeg_encode_params* input, libjpeg_input_format format,
+                         const volatile bool* canceled, int maxStripes = 0);
+
+    ///Number of worker threads encoding stripes
+    static int getWorkerCount();
+};
+
+} // namespace Camera
+} // namespace Ti
+
+#endif
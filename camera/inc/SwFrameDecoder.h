@@ -17,12 +17,32 @@
 #ifndef SWFRAMEDECODER_H_
 #define SWFRAMEDECODER_H_
 
+#include <utils/threads.h>
 #include "FrameDecoder.h"
 #include "Decoder_libjpeg.h"
 
 namespace Ti {
 namespace Camera {
 
+enum DecodeJobState {
+    DecodeJobState_Pending,
+    DecodeJobState_Running,
+    DecodeJobState_Done,
+    DecodeJobState_Failed,
+    DecodeJobState_Canceled
+};
+
+/**
+ * Decodes MJPEG frames to NV12 with libjpeg on a few worker threads.
+ *
+ * Every queued input is paired with a free output and decoded on the next
+ * idle worker, so a frame per worker is in flight. Frames complete in the
+ * order they were queued whichever worker finishes first, and each output
+ * carries the timestamp of its input. Outputs are handed back in output queue
+ * order, so the output of a frame that failed to decode goes to the back of
+ * it. A frame arriving with no free output, or with every worker already a
+ * frame behind, is dropped rather than holding up the capture buffers.
+ */
 class SwFrameDecoder: public FrameDecoder {
 public:
     SwFrameDecoder();
@@ -31,15 +51,54 @@ public:
 protected:
     virtual void doConfigure(const DecoderParameters& config);
     virtual void doProcessInputBuffer();
-    virtual status_t doStart() { return NO_ERROR; }
-    virtual void doStop() { }
+    virtual status_t doStart();
+    virtual void doStop();
     virtual void doFlush() { }
     virtual void doRelease() { }
 
 private:
-    int mjpegWithHdrSize;
-    Decoder_libjpeg mJpgdecoder;
-    unsigned char* mJpegWithHeaderBuffer;
+    struct DecodeJob {
+        int sequence;
+        android::sp<MediaBuffer> in;
+        android::sp<MediaBuffer> out;
+        unsigned char* src;
+        int filledLen;
+        unsigned char* dst;
+        nsecs_t timestamp;
+        DecodeJobState state;
+    };
+
+    class DecodeThread : public android::Thread {
+    public:
+        DecodeThread(SwFrameDecoder* decoder) : android::Thread(false), mDecoder(decoder) {}
+
+        virtual bool threadLoop() {
+            return mDecoder->decodeNext(mJpgdecoder);
+        }
+
+    private:
+        SwFrameDecoder* mDecoder;
+        Decoder_libjpeg mJpgdecoder;
+    };
+
+    ///Decodes the oldest pending frame, false once the decoder stops
+    bool decodeNext(Decoder_libjpeg& decoder);
+    bool claimOutputLocked(DecodeJob& job);
+    ///Moves the outputs of failed frames to the back of the output queue,
+    ///only with the FrameDecoder lock held
+    void requeueFailedOutputsLocked();
+    ///Hands the finished frames at the head of the queue back, in order
+    void completeLocked();
+    void stopThreads();
+
+    android::Mutex mJobLock;
+    android::Condition mJobCondition;
+    android::Vector<DecodeJob> mJobs;
+    android::Vector< android::sp<MediaBuffer> > mFailedOutputs;
+    android::Vector< android::sp<DecodeThread> > mThreads;
+    size_t mMaxInFlight;
+    int mSequence;
+    bool mStopping;
 };
 
 }  // namespace Camera
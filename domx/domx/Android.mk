@@ -9,6 +9,7 @@ LOCAL_SRC_FILES:= \
     omx_rpc/src/omx_rpc_config.c \
     omx_rpc/src/omx_rpc_platform.c \
     omx_proxy_common/src/omx_proxy_common.c \
+    omx_proxy_common/src/omx_proxy_bufmap.c \
     profiling/src/profile.c \
     plugins/memplugin.c \
     plugins/memplugin_table.c \
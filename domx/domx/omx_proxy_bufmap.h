@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ *  @file  omx_proxy_bufmap.h
+ *         Lookup of the proxy buffer list entries by local or remote buffer
+ *         header in constant time.
+ *
+ *  @path \WTSD_DucatiMMSW\framework\domx\omx_proxy_common\
+ *
+ *  @rev 1.0
+ */
+
+#ifndef OMX_PROXY_BUFMAP_H
+#define OMX_PROXY_BUFMAP_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif				/* __cplusplus */
+
+/******************************************************************
+ *   INCLUDE FILES
+ ******************************************************************/
+#include <OMX_Core.h>
+
+/******************************************************************
+ *   DEFINES - CONSTANTS
+ ******************************************************************/
+/*Slots in a map, a power of two at least twice the number of proxy buffers
+  so that probe sequences stay short*/
+#define PROXY_BUFMAP_SIZE                 256
+#define PROXY_BUFMAP_SHIFT                (32 - 8)
+/*Returned by PROXY_BufMapFind() for unknown headers*/
+#define PROXY_BUFMAP_NOT_FOUND            0xFFFFFFFF
+/*Key of a freed slot, headers are word aligned so it never is a real one*/
+#define PROXY_BUFMAP_TOMBSTONE            ((OMX_PTR) 1)
+
+/*===============================================================*/
+/** PROXY_BUFFER_MAP         : Open addressing hash table from a buffer header
+ *                             to its index in the proxy buffer list. Entries
+ *                             never move once added: a removed entry leaves a
+ *                             tombstone, so that the RPC callback thread can
+ *                             look headers up while the client adds or frees
+ *                             other buffers.
+ *
+ * @param pKey               : Buffer header, NULL for a never used slot or
+ *                             PROXY_BUFMAP_TOMBSTONE for a freed one.
+ *
+ * @param nIndex             : Buffer list index of the header in the slot.
+ *
+ * @param nEntries           : Number of headers mapped.
+ */
+/*===============================================================*/
+	typedef struct PROXY_BUFFER_MAP
+	{
+		OMX_PTR pKey[PROXY_BUFMAP_SIZE];
+		OMX_U8 nIndex[PROXY_BUFMAP_SIZE];
+		OMX_U32 nEntries;
+	} PROXY_BUFFER_MAP;
+
+/*******************************************************************************
+* Functions
+*******************************************************************************/
+	void PROXY_BufMapInit(PROXY_BUFFER_MAP * pMap);
+	OMX_ERRORTYPE PROXY_BufMapAdd(PROXY_BUFFER_MAP * pMap, OMX_PTR pKey,
+	    OMX_U32 nIndex);
+	void PROXY_BufMapRemove(PROXY_BUFFER_MAP * pMap, OMX_PTR pKey);
+	OMX_U32 PROXY_BufMapFind(PROXY_BUFFER_MAP * pMap, OMX_PTR pKey);
+
+#ifdef __cplusplus
+}
+#endif				/* __cplusplus */
+
+#endif
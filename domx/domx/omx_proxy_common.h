@@ -72,6 +72,7 @@ extern "C"
 #include "omx_rpc_internal.h"
 #include "omx_rpc_utils.h"
 #include "memplugin.h"
+#include "omx_proxy_bufmap.h"
 
 /****************************************************************
  * PUBLIC DECLARATIONS Defined here, used elsewhere
@@ -255,6 +256,9 @@ extern "C"
 		OMX_HANDLETYPE hRemoteComp;
 
 		PROXY_BUFFER_INFO tBufList[MAX_NUM_PROXY_BUFFERS];
+		/* tBufList index by local and by remote buffer header */
+		PROXY_BUFFER_MAP tLocalBufMap;
+		PROXY_BUFFER_MAP tRemoteBufMap;
 		PROXY_PORT_TYPE proxyPortBuffers[PROXY_MAXNUMOFPORTS];
 		OMX_BOOL IsLoadedState;
 		OMX_U32 nTotalBuffers;
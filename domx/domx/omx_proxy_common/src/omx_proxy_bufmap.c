@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ *  @file  omx_proxy_bufmap.c
+ *         Buffer header to proxy buffer list index maps. Buffer callbacks
+ *         from the remote core and buffer calls from the client resolve
+ *         their header through these instead of walking the buffer list.
+ *
+ *  @path \WTSD_DucatiMMSW\framework\domx\omx_proxy_common\src
+ *
+ *  @rev 1.0
+ */
+
+/******************************************************************
+ *   INCLUDE FILES
+ ******************************************************************/
+#include <stdint.h>
+#include <string.h>
+
+#include "omx_proxy_bufmap.h"
+
+/* Headers are word aligned allocations, Fibonacci hashing spreads them */
+#define PROXY_BUFMAP_HASH(pKey) \
+    ((OMX_U32) ((OMX_U32) (uintptr_t) (pKey) * 2654435761U) >> PROXY_BUFMAP_SHIFT)
+#define PROXY_BUFMAP_NEXT(nSlot) (((nSlot) + 1) & (PROXY_BUFMAP_SIZE - 1))
+
+/* Keys are published after their index, a reader that sees a key also sees
+   the index stored for it */
+#define PROXY_BUFMAP_LOAD_KEY(pMap, nSlot) \
+    __atomic_load_n(&(pMap)->pKey[nSlot], __ATOMIC_ACQUIRE)
+#define PROXY_BUFMAP_STORE_KEY(pMap, nSlot, pNewKey) \
+    __atomic_store_n(&(pMap)->pKey[nSlot], (pNewKey), __ATOMIC_RELEASE)
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_BufMapInit()
+ * @brief Empties a map.
+ * @param pMap : Map to be emptied.
+ */
+/* ===========================================================================*/
+void PROXY_BufMapInit(PROXY_BUFFER_MAP * pMap)
+{
+	memset(pMap, 0, sizeof(PROXY_BUFFER_MAP));
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_BufMapAdd()
+ * @brief Maps pKey to nIndex, replacing any previous mapping of pKey. Adds
+ *        and removes must not run concurrently with each other, finds may.
+ * @param pMap : Map to be updated.
+ * @param pKey : Buffer header, not NULL.
+ * @param nIndex : Index of the header in the buffer list.
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+OMX_ERRORTYPE PROXY_BufMapAdd(PROXY_BUFFER_MAP * pMap, OMX_PTR pKey,
+    OMX_U32 nIndex)
+{
+	OMX_U32 nSlot = PROXY_BUFMAP_HASH(pKey), nProbes = 0;
+	OMX_U32 nFree = PROXY_BUFMAP_SIZE;
+
+	if (pKey == NULL || pKey == PROXY_BUFMAP_TOMBSTONE || nIndex > 0xFF)
+		return OMX_ErrorBadParameter;
+
+	/*The whole probe sequence is searched for pKey, the first tombstone
+	  on the way is reused if pKey is new*/
+	for (nProbes = 0; nProbes < PROXY_BUFMAP_SIZE; nProbes++)
+	{
+		if (pMap->pKey[nSlot] == pKey)
+		{
+			__atomic_store_n(&pMap->nIndex[nSlot], (OMX_U8) nIndex,
+			    __ATOMIC_RELAXED);
+			return OMX_ErrorNone;
+		}
+		if (pMap->pKey[nSlot] == NULL)
+		{
+			if (nFree == PROXY_BUFMAP_SIZE)
+				nFree = nSlot;
+			break;
+		}
+		if (pMap->pKey[nSlot] == PROXY_BUFMAP_TOMBSTONE &&
+		    nFree == PROXY_BUFMAP_SIZE)
+			nFree = nSlot;
+		nSlot = PROXY_BUFMAP_NEXT(nSlot);
+	}
+	if (nFree == PROXY_BUFMAP_SIZE)
+		return OMX_ErrorInsufficientResources;
+
+	pMap->nIndex[nFree] = (OMX_U8) nIndex;
+	PROXY_BUFMAP_STORE_KEY(pMap, nFree, pKey);
+	pMap->nEntries++;
+
+	return OMX_ErrorNone;
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_BufMapRemove()
+ * @brief Drops the mapping of pKey. Its slot becomes a tombstone, the other
+ *        entries stay where they are so that a concurrent find of any of
+ *        them still succeeds.
+ * @param pMap : Map to be updated.
+ * @param pKey : Buffer header.
+ */
+/* ===========================================================================*/
+void PROXY_BufMapRemove(PROXY_BUFFER_MAP * pMap, OMX_PTR pKey)
+{
+	OMX_U32 nSlot = PROXY_BUFMAP_HASH(pKey), nProbes = 0;
+
+	if (pKey == NULL || pKey == PROXY_BUFMAP_TOMBSTONE)
+		return;
+
+	while (pMap->pKey[nSlot] != pKey)
+	{
+		if (pMap->pKey[nSlot] == NULL ||
+		    ++nProbes == PROXY_BUFMAP_SIZE)
+			return;
+		nSlot = PROXY_BUFMAP_NEXT(nSlot);
+	}
+	PROXY_BUFMAP_STORE_KEY(pMap, nSlot, PROXY_BUFMAP_TOMBSTONE);
+
+	/*With no header left every find fails anyway, so the tombstones can
+	  go without moving anything a reader could be looking for*/
+	if (--pMap->nEntries == 0)
+	{
+		for (nSlot = 0; nSlot < PROXY_BUFMAP_SIZE; nSlot++)
+			PROXY_BUFMAP_STORE_KEY(pMap, nSlot, NULL);
+	}
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_BufMapFind()
+ * @brief Looks up the buffer list index of pKey. Safe to call while another
+ *        thread adds or removes other headers.
+ * @param pMap : Map to be searched.
+ * @param pKey : Buffer header.
+ * @return Index, PROXY_BUFMAP_NOT_FOUND if pKey is not mapped.
+ */
+/* ===========================================================================*/
+OMX_U32 PROXY_BufMapFind(PROXY_BUFFER_MAP * pMap, OMX_PTR pKey)
+{
+	OMX_U32 nSlot = PROXY_BUFMAP_HASH(pKey), nProbes = 0;
+	OMX_PTR pSlotKey = NULL;
+
+	if (pKey == NULL || pKey == PROXY_BUFMAP_TOMBSTONE)
+		return PROXY_BUFMAP_NOT_FOUND;
+
+	while ((pSlotKey = PROXY_BUFMAP_LOAD_KEY(pMap, nSlot)) != pKey)
+	{
+		if (pSlotKey == NULL || ++nProbes == PROXY_BUFMAP_SIZE)
+			return PROXY_BUFMAP_NOT_FOUND;
+		nSlot = PROXY_BUFMAP_NEXT(nSlot);
+	}
+
+	return __atomic_load_n(&pMap->nIndex[nSlot], __ATOMIC_RELAXED);
+}
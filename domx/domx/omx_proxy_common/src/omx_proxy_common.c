@@ -453,7 +453,7 @@ static OMX_ERRORTYPE PROXY_EmptyBufferDone(OMX_HANDLETYPE hComponent,
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
-	OMX_U16 count;
+	OMX_U32 count;
 	OMX_BUFFERHEADERTYPE *pBufHdr = NULL;
 
 	PROXY_require((hComp->pComponentPrivate != NULL),
@@ -466,27 +466,22 @@ static OMX_ERRORTYPE PROXY_EmptyBufferDone(OMX_HANDLETYPE hComponent,
 	    ("hComponent=%p, pCompPrv=%p, remoteBufHdr=%p, nFilledLen=%d, nOffset=%d, nFlags=%08x",
 	    hComponent, pCompPrv, remoteBufHdr, nfilledLen, nOffset, nFlags);
 
-	for (count = 0; count < pCompPrv->nTotalBuffers; ++count)
-	{
-		if (pCompPrv->tBufList[count].pBufHeaderRemote ==
-		    remoteBufHdr)
-		{
-			pBufHdr = pCompPrv->tBufList[count].pBufHeader;
-			pBufHdr->nFilledLen = nfilledLen;
-			pBufHdr->nOffset = nOffset;
-			pBufHdr->nFlags = nFlags;
-			/* Setting mark info to NULL. This would always be
-			   NULL in EBD, whether component has propagated the
-			   mark or has generated mark event */
-			pBufHdr->hMarkTargetComponent = NULL;
-			pBufHdr->pMarkData = NULL;
-			break;
-		}
-	}
-	PROXY_assert((count != pCompPrv->nTotalBuffers),
+	count = PROXY_BufMapFind(&pCompPrv->tRemoteBufMap,
+	    (OMX_PTR) remoteBufHdr);
+	PROXY_assert((count != PROXY_BUFMAP_NOT_FOUND),
 	    OMX_ErrorBadParameter,
 	    "Received invalid-buffer header from OMX component");
 
+	pBufHdr = pCompPrv->tBufList[count].pBufHeader;
+	pBufHdr->nFilledLen = nfilledLen;
+	pBufHdr->nOffset = nOffset;
+	pBufHdr->nFlags = nFlags;
+	/* Setting mark info to NULL. This would always be
+	   NULL in EBD, whether component has propagated the
+	   mark or has generated mark event */
+	pBufHdr->hMarkTargetComponent = NULL;
+	pBufHdr->pMarkData = NULL;
+
 	KPI_OmxCompBufferEvent(KPI_BUFFER_EBD, hComponent, &(pCompPrv->tBufList[count]));
 
       EXIT:
@@ -523,7 +518,7 @@ OMX_ERRORTYPE PROXY_FillBufferDone(OMX_HANDLETYPE hComponent,
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
-	OMX_U16 count;
+	OMX_U32 count;
 	OMX_BUFFERHEADERTYPE *pBufHdr = NULL;
 
 	PROXY_require((hComp->pComponentPrivate != NULL),
@@ -536,34 +531,27 @@ OMX_ERRORTYPE PROXY_FillBufferDone(OMX_HANDLETYPE hComponent,
 	    ("hComponent=%p, pCompPrv=%p, remoteBufHdr=%p, nFilledLen=%d, nOffset=%d, nFlags=%08x",
 	    hComponent, pCompPrv, remoteBufHdr, nfilledLen, nOffset, nFlags);
 
-	for (count = 0; count < pCompPrv->nTotalBuffers; ++count)
-	{
-		if (pCompPrv->tBufList[count].pBufHeaderRemote ==
-		    remoteBufHdr)
-		{
-			pBufHdr = pCompPrv->tBufList[count].pBufHeader;
-			pBufHdr->nFilledLen = nfilledLen;
-			pBufHdr->nOffset = nOffset;
-			pBufHdr->nFlags = nFlags;
-			pBufHdr->nTimeStamp = nTimeStamp;
-			if (pMarkData != NULL)
-			{
-				/*Update mark info in the buffer header */
-				pBufHdr->pMarkData =
-				    ((PROXY_MARK_DATA *)
-				    pMarkData)->pMarkDataActual;
-				pBufHdr->hMarkTargetComponent =
-				    ((PROXY_MARK_DATA *)
-				    pMarkData)->hComponentActual;
-				TIMM_OSAL_Free(pMarkData);
-			}
-			break;
-		}
-	}
-	PROXY_assert((count != pCompPrv->nTotalBuffers),
+	count = PROXY_BufMapFind(&pCompPrv->tRemoteBufMap,
+	    (OMX_PTR) remoteBufHdr);
+	PROXY_assert((count != PROXY_BUFMAP_NOT_FOUND),
 	    OMX_ErrorBadParameter,
 	    "Received invalid-buffer header from OMX component");
 
+	pBufHdr = pCompPrv->tBufList[count].pBufHeader;
+	pBufHdr->nFilledLen = nfilledLen;
+	pBufHdr->nOffset = nOffset;
+	pBufHdr->nFlags = nFlags;
+	pBufHdr->nTimeStamp = nTimeStamp;
+	if (pMarkData != NULL)
+	{
+		/*Update mark info in the buffer header */
+		pBufHdr->pMarkData =
+		    ((PROXY_MARK_DATA *) pMarkData)->pMarkDataActual;
+		pBufHdr->hMarkTargetComponent =
+		    ((PROXY_MARK_DATA *) pMarkData)->hComponentActual;
+		TIMM_OSAL_Free(pMarkData);
+	}
+
 	KPI_OmxCompBufferEvent(KPI_BUFFER_FBD, hComponent, &(pCompPrv->tBufList[count]));
 
       EXIT:
@@ -618,17 +606,11 @@ OMX_ERRORTYPE PROXY_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	    pBufferHdr->nOffset, pBufferHdr->nFlags);
 
 	/*First find the index of this buffer header to retrieve remote buffer header */
-	for (count = 0; count < pCompPrv->nTotalBuffers; count++)
-	{
-		if (pCompPrv->tBufList[count].pBufHeader == pBufferHdr)
-		{
-			DOMX_DEBUG("Buffer Index of Match %d ", count);
-			break;
-		}
-	}
-	PROXY_assert((count != pCompPrv->nTotalBuffers),
+	count = PROXY_BufMapFind(&pCompPrv->tLocalBufMap, pBufferHdr);
+	PROXY_assert((count != PROXY_BUFMAP_NOT_FOUND),
 	    OMX_ErrorBadParameter,
 	    "Could not find the remote header in buffer list");
+	DOMX_DEBUG("Buffer Index of Match %d ", count);
 
 	if (pBufferHdr->hMarkTargetComponent != NULL)
 	{
@@ -731,17 +713,11 @@ OMX_ERRORTYPE PROXY_FillThisBuffer(OMX_HANDLETYPE hComponent,
 	    pBufferHdr->nOffset, pBufferHdr->nFlags);
 
 	/*First find the index of this buffer header to retrieve remote buffer header */
-	for (count = 0; count < pCompPrv->nTotalBuffers; count++)
-	{
-		if (pCompPrv->tBufList[count].pBufHeader == pBufferHdr)
-		{
-			DOMX_DEBUG("Buffer Index of Match %d ", count);
-			break;
-		}
-	}
-	PROXY_assert((count != pCompPrv->nTotalBuffers),
+	count = PROXY_BufMapFind(&pCompPrv->tLocalBufMap, pBufferHdr);
+	PROXY_assert((count != PROXY_BUFMAP_NOT_FOUND),
 	    OMX_ErrorBadParameter,
 	    "Could not find the remote header in buffer list");
+	DOMX_DEBUG("Buffer Index of Match %d ", count);
 
 	KPI_OmxCompBufferEvent(KPI_BUFFER_FTB, hComponent, &(pCompPrv->tBufList[count]));
 
@@ -927,6 +903,9 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv->tBufList[currentBuffer].pBufHeader = pBufferHeader;
 	pCompPrv->tBufList[currentBuffer].pBufHeaderRemote = pBufHeaderRemote;
+	PROXY_BufMapAdd(&pCompPrv->tLocalBufMap, pBufferHeader, currentBuffer);
+	PROXY_BufMapAdd(&pCompPrv->tRemoteBufMap, (OMX_PTR) pBufHeaderRemote,
+	    currentBuffer);
 
 
 	//keeping track of number of Buffers
@@ -1154,6 +1133,9 @@ static OMX_ERRORTYPE PROXY_UseBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	//Storing details of pBufferHeader/Mapped/Actual buffer address locally.
 	pCompPrv->tBufList[currentBuffer].pBufHeader = pBufferHeader;
 	pCompPrv->tBufList[currentBuffer].pBufHeaderRemote = pBufHeaderRemote;
+	PROXY_BufMapAdd(&pCompPrv->tLocalBufMap, pBufferHeader, currentBuffer);
+	PROXY_BufMapAdd(&pCompPrv->tRemoteBufMap, (OMX_PTR) pBufHeaderRemote,
+	    currentBuffer);
 
 	//keeping track of number of Buffers
 	pCompPrv->nAllocatedBuffers++;
@@ -1214,17 +1196,11 @@ OMX_ERRORTYPE PROXY_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	    hComponent, pCompPrv, nPortIndex, pBufferHdr,
 	    pBufferHdr->pBuffer);
 
-	for (count = 0; count < pCompPrv->nTotalBuffers; count++)
-	{
-		if (pCompPrv->tBufList[count].pBufHeader == pBufferHdr)
-		{
-			DOMX_DEBUG("Buffer Index of Match %d", count);
-			break;
-		}
-	}
-	PROXY_assert((count != pCompPrv->nTotalBuffers),
+	count = PROXY_BufMapFind(&pCompPrv->tLocalBufMap, pBufferHdr);
+	PROXY_assert((count != PROXY_BUFMAP_NOT_FOUND),
 	    OMX_ErrorBadParameter,
 	    "Could not find the mapped address in component private buffer list");
+	DOMX_DEBUG("Buffer Index of Match %d", count);
 
 	pBuffer = (OMX_U32)pBufferHdr->pBuffer;
     pAuxBuf0 = (OMX_PTR) pBuffer;
@@ -1323,6 +1299,10 @@ OMX_ERRORTYPE PROXY_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 			TIMM_OSAL_Free(pCompPrv->tBufList[count].pBufHeader->
 			    pPlatformPrivate);
 		}
+		PROXY_BufMapRemove(&pCompPrv->tLocalBufMap,
+		    pCompPrv->tBufList[count].pBufHeader);
+		PROXY_BufMapRemove(&pCompPrv->tRemoteBufMap,
+		    (OMX_PTR) pCompPrv->tBufList[count].pBufHeaderRemote);
 		TIMM_OSAL_Free(pCompPrv->tBufList[count].pBufHeader);
 		TIMM_OSAL_Memset(&(pCompPrv->tBufList[count]), 0,
 		    sizeof(PROXY_BUFFER_INFO));
@@ -2231,6 +2211,8 @@ OMX_ERRORTYPE PROXY_ComponentDeInit(OMX_HANDLETYPE hComponent)
 			    sizeof(PROXY_BUFFER_INFO));
 		}
 	}
+	PROXY_BufMapInit(&pCompPrv->tLocalBufMap);
+	PROXY_BufMapInit(&pCompPrv->tRemoteBufMap);
 
 	KPI_OmxCompDeinit(hComponent);
 
@@ -2290,6 +2272,8 @@ OMX_ERRORTYPE OMX_ProxyCommonInit(OMX_HANDLETYPE hComponent)
 
 	pCompPrv->nTotalBuffers = 0;
 	pCompPrv->nAllocatedBuffers = 0;
+	PROXY_BufMapInit(&pCompPrv->tLocalBufMap);
+	PROXY_BufMapInit(&pCompPrv->tRemoteBufMap);
 	pCompPrv->proxyEmptyBufferDone = PROXY_EmptyBufferDone;
 	pCompPrv->proxyFillBufferDone = PROXY_FillBufferDone;
 	pCompPrv->proxyEventHandler = PROXY_EventHandler;
@@ -62,6 +62,7 @@ extern "C"
  ******************************************************************/
 /* ----- system and platform files ----------------------------*/
 #include <pthread.h>
+#include <stdint.h>
 
 #include <OMX_Component.h>
 #include <OMX_Core.h>
@@ -85,6 +86,10 @@ extern "C"
 #define RPC_OMX_MAX_FUNCTION_LIST 21
 /*Packet size for each message*/
 #define RPC_PACKET_SIZE 0x12C
+/*Number of preallocated packets per instance. Covers the in flight stub
+  calls, the replies queued in the message pipes and the packet being read by
+  the callback thread. Packets beyond this are taken from the heap.*/
+#define RPC_PACKET_POOL_SIZE 32
 
 
 
@@ -154,6 +159,32 @@ extern "C"
 * STRUCTURES
 *******************************************************************************/
 
+/*===============================================================*/
+/** RPC_PACKET_POOL                 : Lock free pool of RPC packets
+ *
+ *  @ param pSlots                  : RPC_PACKET_POOL_SIZE packets of
+ *                                    RPC_PACKET_SIZE each.
+ *  @ param nHead                   : Index of the first free slot in the low
+ *                                    16 bits, ABA tag in the high 16 bits.
+ *  @ param nNext                   : Free list link of each slot.
+ *  @ param nInUse                  : Slots currently handed out.
+ *  @ param nPeak                   : Highest nInUse seen.
+ *  @ param nHits                   : Allocations served by the pool.
+ *  @ param nMisses                 : Allocations that fell back to the heap.
+ *
+ */
+/*===============================================================*/
+	typedef struct RPC_PACKET_POOL
+	{
+		OMX_U8 *pSlots;
+		volatile int32_t nHead;
+		volatile int32_t nNext[RPC_PACKET_POOL_SIZE];
+		volatile int32_t nInUse;
+		volatile int32_t nPeak;
+		volatile int32_t nHits;
+		volatile int32_t nMisses;
+	} RPC_PACKET_POOL;
+
 /*===============================================================*/
 /** RPC_OMX_CONTEXT                 : RPC context structure
  *
@@ -169,6 +200,8 @@ extern "C"
  *                                    remote core.
  *  @ param hActualRemoteCompHandle : Actual component handle on remote core.
  *  @ param pAppData                : App data of RPC caller
+ *  @ param sPacketPool             : Packets shared by the stubs and the
+ *                                    callback thread.
  *
  */
 /*===============================================================*/
@@ -181,8 +214,13 @@ extern "C"
 		OMX_HANDLETYPE hRemoteHandle;
 		OMX_HANDLETYPE hActualRemoteCompHandle;
 		OMX_PTR pAppData;
+		RPC_PACKET_POOL sPacketPool;
 	} RPC_OMX_CONTEXT;
 
+	OMX_PTR RPC_AllocPacket(RPC_OMX_CONTEXT * pRPCCtx, OMX_U32 nPacketSize);
+
+	void RPC_ReleasePacket(RPC_OMX_CONTEXT * pRPCCtx, OMX_PTR pPacket);
+
 #ifdef __cplusplus
 }
 #endif
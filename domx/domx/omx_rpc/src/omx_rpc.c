@@ -55,6 +55,8 @@
 #include <string.h>
 #include <stdio.h>
 
+#include <cutils/atomic.h>
+
 #include <OMX_Types.h>
 #include <timm_osal_interfaces.h>
 #include <timm_osal_trace.h>
@@ -74,21 +76,177 @@
 #define RPC_MSG_SIZE_FOR_PIPE (sizeof(OMX_PTR))
 #define MAX_ATTEMPTS 60
 
-#define RPC_getPacket(nPacketSize, pPacket) do { \
-    pPacket = TIMM_OSAL_Malloc(nPacketSize, TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT); \
+#define RPC_getPacket(hCtx, nPacketSize, pPacket) do { \
+    pPacket = RPC_AllocPacket(hCtx, nPacketSize); \
     RPC_assert(pPacket != NULL, RPC_OMX_ErrorInsufficientResources, \
            "Error Allocating RCM Message Frame"); \
     } while(0)
 
-#define RPC_freePacket(pPacket) do { \
-    if(pPacket != NULL) TIMM_OSAL_Free(pPacket); \
+#define RPC_freePacket(hCtx, pPacket) do { \
+    if(pPacket != NULL) RPC_ReleasePacket(hCtx, pPacket); \
     } while(0)
 
+/*Free list links are slot indices, this one terminates the list*/
+#define RPC_PACKET_POOL_END RPC_PACKET_POOL_SIZE
+#define RPC_PACKET_POOL_IDX_MASK 0xFFFF
+#define RPC_PACKET_POOL_TAG_INC 0x10000
+
 OMX_U8 pBufferError[RPC_PACKET_SIZE];
 
 void *RPC_CallbackThread(void *data);
 
 
+
+/* ===========================================================================*/
+/**
+* @name RPC_PacketPoolInit()
+* @brief Preallocates the packets of an instance and chains them all up in the
+*        free list.
+* @param pPool [IN] : Pool to be set up.
+* @return RPC_OMX_ErrorNone = Successful
+*/
+/* ===========================================================================*/
+static RPC_OMX_ERRORTYPE RPC_PacketPoolInit(RPC_PACKET_POOL * pPool)
+{
+	OMX_U32 i = 0;
+
+	pPool->pSlots =
+	    TIMM_OSAL_Malloc(RPC_PACKET_POOL_SIZE * RPC_PACKET_SIZE,
+	    TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT);
+	if (pPool->pSlots == NULL)
+		return RPC_OMX_ErrorInsufficientResources;
+
+	for (i = 0; i < RPC_PACKET_POOL_SIZE; i++)
+		pPool->nNext[i] = i + 1;
+	pPool->nHead = 0;
+	pPool->nInUse = pPool->nPeak = pPool->nHits = pPool->nMisses = 0;
+
+	return RPC_OMX_ErrorNone;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_PacketPoolDeInit()
+* @brief Releases the packets of an instance. Any packet still handed out at
+*        this point is lost and taken out of the memory counter.
+* @param pPool [IN] : Pool to be torn down.
+*/
+/* ===========================================================================*/
+static void RPC_PacketPoolDeInit(RPC_PACKET_POOL * pPool)
+{
+	if (pPool->pSlots == NULL)
+		return;
+
+	DOMX_DEBUG("Packet pool: %d hits, %d heap fallbacks, peak %d of %d",
+	    pPool->nHits, pPool->nMisses, pPool->nPeak, RPC_PACKET_POOL_SIZE);
+	if (pPool->nInUse)
+	{
+		DOMX_ERROR("%d packets not returned to the pool",
+		    pPool->nInUse);
+		TIMM_OSAL_UpdateMemCounter(-pPool->nInUse);
+	}
+
+	TIMM_OSAL_Free(pPool->pSlots);
+	pPool->pSlots = NULL;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_AllocPacket()
+* @brief Takes a packet out of the pool of an instance. Stubs on any thread and
+*        the callback thread allocate concurrently so the free list is a lock
+*        free stack, the tag in nHead keeps a slot popped and pushed back in
+*        between from being mistaken for an unchanged head. Falls back to the
+*        heap when all slots are in use. Pool packets count in
+*        TIMM_OSAL_GetMemCounter like heap packets.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param nPacketSize [IN] : Size needed, at most RPC_PACKET_SIZE for a slot.
+* @return Packet, NULL if out of memory.
+*/
+/* ===========================================================================*/
+OMX_PTR RPC_AllocPacket(RPC_OMX_CONTEXT * pRPCCtx, OMX_U32 nPacketSize)
+{
+	RPC_PACKET_POOL *pPool = &pRPCCtx->sPacketPool;
+	int32_t nOld = 0, nNew = 0, nIdx = 0, nInUse = 0, nPeak = 0;
+
+	if (pPool->pSlots != NULL && nPacketSize <= RPC_PACKET_SIZE)
+	{
+		do
+		{
+			nOld = android_atomic_acquire_load(&pPool->nHead);
+			nIdx = nOld & RPC_PACKET_POOL_IDX_MASK;
+			if (nIdx == RPC_PACKET_POOL_END)
+				break;
+			nNew = ((nOld + RPC_PACKET_POOL_TAG_INC) &
+			    ~RPC_PACKET_POOL_IDX_MASK) | pPool->nNext[nIdx];
+		}
+		while (android_atomic_acquire_cas(nOld, nNew, &pPool->nHead));
+
+		if (nIdx != RPC_PACKET_POOL_END)
+		{
+			android_atomic_inc(&pPool->nHits);
+			nInUse = android_atomic_inc(&pPool->nInUse) + 1;
+			nPeak = pPool->nPeak;
+			while (nInUse > nPeak &&
+			    android_atomic_cmpxchg(nPeak, nInUse, &pPool->nPeak))
+				nPeak = pPool->nPeak;
+			TIMM_OSAL_UpdateMemCounter(1);
+			return pPool->pSlots + nIdx * RPC_PACKET_SIZE;
+		}
+	}
+
+	android_atomic_inc(&pPool->nMisses);
+	return TIMM_OSAL_Malloc(nPacketSize, TIMM_OSAL_TRUE, 0,
+	    TIMMOSAL_MEM_SEGMENT_INT);
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_ReleasePacket()
+* @brief Gives a packet from RPC_AllocPacket() back to where it came from. The
+*        global error packet handed out on fatal errors is left alone.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param pPacket [IN] : Packet to be released.
+*/
+/* ===========================================================================*/
+void RPC_ReleasePacket(RPC_OMX_CONTEXT * pRPCCtx, OMX_PTR pPacket)
+{
+	RPC_PACKET_POOL *pPool = &pRPCCtx->sPacketPool;
+	OMX_U8 *pSlot = pPacket;
+	int32_t nOld = 0, nNew = 0, nIdx = 0;
+
+	if (pPacket == NULL || pPacket == pBufferError)
+		return;
+
+	if (pPool->pSlots == NULL || pSlot < pPool->pSlots ||
+	    pSlot >= pPool->pSlots + RPC_PACKET_POOL_SIZE * RPC_PACKET_SIZE)
+	{
+		TIMM_OSAL_Free(pPacket);
+		return;
+	}
+
+	/*Accounted before the push so that nInUse never exceeds the pool*/
+	android_atomic_dec(&pPool->nInUse);
+	TIMM_OSAL_UpdateMemCounter(-1);
+
+	nIdx = (pSlot - pPool->pSlots) / RPC_PACKET_SIZE;
+	do
+	{
+		nOld = android_atomic_acquire_load(&pPool->nHead);
+		pPool->nNext[nIdx] = nOld & RPC_PACKET_POOL_IDX_MASK;
+		nNew = ((nOld + RPC_PACKET_POOL_TAG_INC) &
+		    ~RPC_PACKET_POOL_IDX_MASK) | nIdx;
+	}
+	while (android_atomic_release_cas(nOld, nNew, &pPool->nHead));
+}
+
+
 /* ===========================================================================*/
 /**
 * @name RPC_InstanceInit()
@@ -124,6 +282,10 @@ RPC_OMX_ERRORTYPE RPC_InstanceInit(__unused OMX_STRING cComponentName,
 	    "Malloc failed");
 	TIMM_OSAL_Memset(pRPCCtx, 0, sizeof(RPC_OMX_CONTEXT));
 
+	eRPCError = RPC_PacketPoolInit(&pRPCCtx->sPacketPool);
+	RPC_assert(eRPCError == RPC_OMX_ErrorNone,
+	    RPC_OMX_ErrorInsufficientResources, "Packet pool alloc failed");
+
 	DOMX_DEBUG("Calling open and OMX_IOCCONNECT ioctl on the device");
 	while (1)
 	{
@@ -276,6 +438,9 @@ RPC_OMX_ERRORTYPE RPC_InstanceDeInit(OMX_HANDLETYPE hRPCCtx)
 		}
 	}
 
+	/*Callback thread is gone, nothing can take or return packets anymore*/
+	RPC_PacketPoolDeInit(&pRPCCtx->sPacketPool);
+
 	TIMM_OSAL_Free(pRPCCtx);
 
 	EXIT:
@@ -329,7 +494,7 @@ void *RPC_CallbackThread(void *data)
 		if (FD_ISSET(pRPCCtx->fd_omx, &readfds))
 		{
 			DOMX_DEBUG("Recd. omx message");
-			RPC_getPacket(nPacketSize, pBuffer);
+			RPC_getPacket(pRPCCtx, nPacketSize, pBuffer);
 			status = read(pRPCCtx->fd_omx, pBuffer, nPacketSize);
             if(status < 0)
             {
@@ -366,19 +531,19 @@ void *RPC_CallbackThread(void *data)
 			case RPC_OMX_FXN_IDX_EVENTHANDLER:
 				RPC_SKEL_EventHandler(((struct omx_packet *)
 					pBuffer)->data);
-				RPC_freePacket(pBuffer);
+				RPC_freePacket(pRPCCtx, pBuffer);
 				pBuffer = NULL;
 				break;
 			case RPC_OMX_FXN_IDX_EMPTYBUFFERDONE:
 				RPC_SKEL_EmptyBufferDone(((struct omx_packet *)
 					pBuffer)->data);
-				RPC_freePacket(pBuffer);
+				RPC_freePacket(pRPCCtx, pBuffer);
 				pBuffer = NULL;
 				break;
 			case RPC_OMX_FXN_IDX_FILLBUFFERDONE:
 				RPC_SKEL_FillBufferDone(((struct omx_packet *)
 					pBuffer)->data);
-				RPC_freePacket(pBuffer);
+				RPC_freePacket(pRPCCtx, pBuffer);
 				pBuffer = NULL;
 				break;
 			default:
@@ -387,7 +552,7 @@ void *RPC_CallbackThread(void *data)
 					//On a true OMX_ErrorHardware error, send the global error packet
 					//and release the local allocated packet to avoid memory leaks since
 					//the listener will not free the packet on OMX_ErrorHardware errors.
-					RPC_freePacket(pBuffer);
+					RPC_freePacket(pRPCCtx, pBuffer);
 					pBuffer = NULL;
 					((struct omx_packet *) pBufferError)->result = OMX_ErrorHardware;
 					eError = TIMM_OSAL_WriteToPipe(pRPCCtx->pMsgPipe[nFxnIdx],
@@ -414,7 +579,7 @@ EXIT:
 			//AD TODO: Send error CB to client and then go back in loop to wait for killfd
 			if (pBuffer != NULL)
 			{
-				RPC_freePacket(pBuffer);
+				RPC_freePacket(pRPCCtx, pBuffer);
 				pBuffer = NULL;
 			}
 			/*Report all hardware errors as fatal and exit from listener thread*/
@@ -85,20 +85,21 @@
 #define RPC_SYNC_MODE
 
 
-#define RPC_getPacket(nPacketSize, pPacket) do { \
-    pPacket = TIMM_OSAL_Malloc(nPacketSize, TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT); \
+/* Packets come from the per instance pool, see RPC_AllocPacket() */
+#define RPC_getPacket(hCtx, nPacketSize, pPacket) do { \
+    pPacket = RPC_AllocPacket(hCtx, nPacketSize); \
     RPC_assert(pPacket != NULL, RPC_OMX_ErrorInsufficientResources, \
            "Error Allocating RCM Message Frame"); \
     TIMM_OSAL_Memset(pPacket, 0, nPacketSize); \
     } while(0)
 
-#define RPC_freePacket(pPacket) do { \
-    if(pPacket != NULL) TIMM_OSAL_Free(pPacket); \
+#define RPC_freePacket(hCtx, pPacket) do { \
+    if(pPacket != NULL) RPC_ReleasePacket(hCtx, pPacket); \
     } while(0)
 
 #define RPC_sendPacket_sync(hCtx, pPacket, nPacketSize, nFxnIdx, pRetPacket, nSize) do { \
     status = write(hCtx->fd_omx, pPacket, nPacketSize); \
-    RPC_freePacket(pPacket); \
+    RPC_freePacket(hCtx, pPacket); \
     pPacket = NULL; \
     if(status < 0 && errno == ENXIO) {  \
          RPC_assert(0, RPC_OMX_ErrorHardware, "Write failed - Ducati in faulty state"); \
@@ -186,7 +187,7 @@ RPC_OMX_ERRORTYPE RPC_GetHandle(OMX_HANDLETYPE hRPCCtx,
 	    cComponentName);
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_HANDLE;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	DOMX_DEBUG("Packing data");
@@ -229,9 +230,9 @@ RPC_OMX_ERRORTYPE RPC_GetHandle(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -265,7 +266,7 @@ RPC_OMX_ERRORTYPE RPC_FreeHandle(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_FREE_HANDLE;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
@@ -282,9 +283,9 @@ RPC_OMX_ERRORTYPE RPC_FreeHandle(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -322,7 +323,7 @@ RPC_OMX_ERRORTYPE RPC_SetParameter(OMX_HANDLETYPE hRPCCtx,
 	struct omx_packet *pOmxPacket = NULL;
 
 	nFxnIdx = RPC_OMX_FXN_IDX_SET_PARAMETER;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if (pLocBufNeedMap != NULL && ((long int)pLocBufNeedMap - (long int)pCompParam) >= 0 ) {
@@ -357,9 +358,9 @@ RPC_OMX_ERRORTYPE RPC_SetParameter(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -398,7 +399,7 @@ RPC_OMX_ERRORTYPE RPC_GetParameter(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_PARAMETER;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if (pLocBufNeedMap != NULL && ((long int)pLocBufNeedMap - (long int)pCompParam) >= 0 ) {
@@ -436,10 +437,10 @@ RPC_OMX_ERRORTYPE RPC_GetParameter(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	//In case of Error Hardware this packet gets freed in omx_rpc.c
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -477,7 +478,7 @@ RPC_OMX_ERRORTYPE RPC_SetConfig(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_SET_CONFIG;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if (pLocBufNeedMap != NULL && ((long int)pLocBufNeedMap - (long int)pCompConfig) >= 0 ) {
@@ -505,9 +506,9 @@ RPC_OMX_ERRORTYPE RPC_SetConfig(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -544,7 +545,7 @@ RPC_OMX_ERRORTYPE RPC_GetConfig(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_CONFIG;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if (pLocBufNeedMap != NULL && ((long int)pLocBufNeedMap - (long int)pCompConfig) >= 0 ) {
@@ -582,9 +583,9 @@ RPC_OMX_ERRORTYPE RPC_GetConfig(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -623,7 +624,7 @@ RPC_OMX_ERRORTYPE RPC_SendCommand(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_SEND_CMD;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
@@ -654,9 +655,9 @@ RPC_OMX_ERRORTYPE RPC_SendCommand(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -693,7 +694,7 @@ RPC_OMX_ERRORTYPE RPC_GetState(OMX_HANDLETYPE hRPCCtx, OMX_STATETYPE * pState,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_STATE;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
@@ -716,9 +717,9 @@ RPC_OMX_ERRORTYPE RPC_GetState(OMX_HANDLETYPE hRPCCtx, OMX_STATETYPE * pState,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -764,7 +765,7 @@ RPC_OMX_ERRORTYPE RPC_GetComponentVersion(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_VERSION;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
@@ -793,9 +794,9 @@ RPC_OMX_ERRORTYPE RPC_GetComponentVersion(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	return eRPCError;
 }
@@ -832,7 +833,7 @@ RPC_OMX_ERRORTYPE RPC_GetExtensionIndex(OMX_HANDLETYPE hRPCCtx,
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_EXT_INDEX;
 
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
@@ -858,9 +859,9 @@ RPC_OMX_ERRORTYPE RPC_GetExtensionIndex(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	return eRPCError;
 
@@ -901,7 +902,7 @@ RPC_OMX_ERRORTYPE RPC_AllocateBuffer(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_ALLOCATE_BUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
@@ -987,9 +988,9 @@ RPC_OMX_ERRORTYPE RPC_AllocateBuffer(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -1037,7 +1038,7 @@ RPC_OMX_ERRORTYPE RPC_UseBuffer(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_USE_BUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	DOMX_DEBUG("Marshaling data");
@@ -1150,9 +1151,9 @@ RPC_OMX_ERRORTYPE RPC_UseBuffer(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -1187,7 +1188,7 @@ RPC_OMX_ERRORTYPE RPC_FreeBuffer(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_FREE_BUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*Offset is the location of the buffer pointer from the start of the data packet */
@@ -1212,9 +1213,9 @@ RPC_OMX_ERRORTYPE RPC_FreeBuffer(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -1255,7 +1256,7 @@ RPC_OMX_ERRORTYPE RPC_EmptyThisBuffer(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_EMPTYTHISBUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if(bMapBuffer == OMX_TRUE)
@@ -1320,9 +1321,9 @@ RPC_OMX_ERRORTYPE RPC_EmptyThisBuffer(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -1361,7 +1362,7 @@ RPC_OMX_ERRORTYPE RPC_FillThisBuffer(OMX_HANDLETYPE hRPCCtx,
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_FILLTHISBUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
@@ -1399,9 +1400,9 @@ RPC_OMX_ERRORTYPE RPC_FillThisBuffer(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -1460,7 +1461,7 @@ RPC_OMX_ERRORTYPE RPC_ComponentTunnelRequest(OMX_HANDLETYPE hRPCCtx,
         printf(" Entering rpc:domx_stub.c:ComponentTunnelRequest\n");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_COMP_TUNNEL_REQUEST;
-	RPC_getPacket(nPacketSize, pPacket);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
 	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
         /*Pack the values into a packet*/
@@ -1479,9 +1480,9 @@ RPC_OMX_ERRORTYPE RPC_ComponentTunnelRequest(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
 	return eRPCError;
@@ -95,6 +95,8 @@ extern "C"
 
 	TIMM_OSAL_U32 TIMM_OSAL_GetMemCounter(void);
 
+	void TIMM_OSAL_UpdateMemCounter(TIMM_OSAL_S32 nDelta);
+
 #define TIMM_OSAL_MallocExtn(size, bBlockContiguous, unBlockAlignment, tMemSegId, hHeap) \
     TIMM_OSAL_Malloc(size, bBlockContiguous, unBlockAlignment, tMemSegId )
 
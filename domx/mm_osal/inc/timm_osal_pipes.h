@@ -81,6 +81,9 @@ extern "C"
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_GetPipeReadyMessageCount(TIMM_OSAL_PTR
 	    pPipe, TIMM_OSAL_U32 * count);
 
+	TIMM_OSAL_ERRORTYPE TIMM_OSAL_GetPipeEventFd(TIMM_OSAL_PTR pPipe,
+	    TIMM_OSAL_S32 * pFd);
+
 
 #ifdef __cplusplus
 }
@@ -248,3 +248,20 @@ TIMM_OSAL_U32 TIMM_OSAL_GetMemCounter(void)
 
 	return gMallocCounter;
 }
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_UpdateMemCounter function ....
+*
+* Used by clients that recycle blocks out of their own preallocated pools so
+* that blocks handed out from a pool are accounted in TIMM_OSAL_GetMemCounter
+* the same way as blocks from TIMM_OSAL_Malloc.
+*
+* @see
+*/
+/* ========================================================================== */
+
+void TIMM_OSAL_UpdateMemCounter(TIMM_OSAL_S32 nDelta)
+{
+	__sync_fetch_and_add(&gMallocCounter, nDelta);
+}
@@ -33,7 +33,8 @@
 /*
 *   @file  timm_osal_pipes.c
 *   This file contains methods that provides the functionality
-*   for creating/using Nucleus pipes.
+*   for creating/using pipes. Pipes are in-process ring buffers, messages
+*   never go through the kernel unless a pollable fd is requested.
 *
 *  @path \
 *
@@ -55,24 +56,46 @@
 #include "timm_osal_error.h"
 #include "timm_osal_memory.h"
 #include "timm_osal_trace.h"
+#include "timm_osal_pipes.h"
 
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
-#include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/eventfd.h>
+
+/*
+* Ring sizes are powers of two. The ring starts out sized for the requested
+* pipe and grows on demand up to what a kernel pipe used to buffer, writers
+* only wait once that much is queued.
+*/
+#define TIMM_OSAL_PIPE_MIN_SIZE   64
+#define TIMM_OSAL_PIPE_MAX_SIZE   65536
+
+/* Variable size messages are stored behind their length */
+#define TIMM_OSAL_PIPE_HDR_SIZE   sizeof(TIMM_OSAL_U32)
 
 /**
 * TIMM_OSAL_PIPE structure define the OSAL pipe
 */
 typedef struct TIMM_OSAL_PIPE
 {
-	int pfd[2];
+	TIMM_OSAL_U8 *pBuffer;
+	TIMM_OSAL_U32 bufferSize;
+	TIMM_OSAL_U32 head;
+	TIMM_OSAL_U32 usedBytes;
 	TIMM_OSAL_U32 pipeSize;
 	TIMM_OSAL_U32 messageSize;
 	TIMM_OSAL_U8 isFixedMessage;
-	int messageCount;
-	int totalBytesInPipe;
+	volatile int messageCount;
+	int readWaiters;
+	int writeWaiters;
+	int eventFd;
+	pthread_mutex_t mutex;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
 } TIMM_OSAL_PIPE;
 
 
@@ -80,6 +103,219 @@ typedef struct TIMM_OSAL_PIPE
 * Function Prototypes
 ******************************************************************************/
 
+static TIMM_OSAL_U32 PipeRecordSize(TIMM_OSAL_PIPE * pHandle,
+    TIMM_OSAL_U32 size)
+{
+	return pHandle->isFixedMessage ? pHandle->messageSize :
+	    TIMM_OSAL_PIPE_HDR_SIZE + size;
+}
+
+static void PipeCopyIn(TIMM_OSAL_PIPE * pHandle, TIMM_OSAL_U32 offset,
+    const void *pData, TIMM_OSAL_U32 size)
+{
+	TIMM_OSAL_U32 mask = pHandle->bufferSize - 1;
+	TIMM_OSAL_U32 first;
+
+	offset &= mask;
+	first = pHandle->bufferSize - offset;
+	if (first >= size)
+	{
+		memcpy(pHandle->pBuffer + offset, pData, size);
+	} else
+	{
+		memcpy(pHandle->pBuffer + offset, pData, first);
+		memcpy(pHandle->pBuffer, (const TIMM_OSAL_U8 *)pData + first,
+		    size - first);
+	}
+}
+
+static void PipeCopyOut(TIMM_OSAL_PIPE * pHandle, TIMM_OSAL_U32 offset,
+    void *pData, TIMM_OSAL_U32 size)
+{
+	TIMM_OSAL_U32 mask = pHandle->bufferSize - 1;
+	TIMM_OSAL_U32 first;
+
+	offset &= mask;
+	first = pHandle->bufferSize - offset;
+	if (first >= size)
+	{
+		memcpy(pData, pHandle->pBuffer + offset, size);
+	} else
+	{
+		memcpy(pData, pHandle->pBuffer + offset, first);
+		memcpy((TIMM_OSAL_U8 *)pData + first, pHandle->pBuffer,
+		    size - first);
+	}
+}
+
+/*
+* Converts a millisecond timeout into the absolute time the condition waits
+* take, same as the semaphore and event timeouts
+*/
+static void PipeAbsTimeout(TIMM_OSAL_S32 timeout, struct timespec *pAbs)
+{
+	struct timeval now;
+	TIMM_OSAL_U32 timeout_us;
+
+	gettimeofday(&now, NULL);
+	timeout_us = now.tv_usec + 1000 * (timeout % 1000);
+	pAbs->tv_sec = now.tv_sec + timeout / 1000 + timeout_us / 1000000;
+	pAbs->tv_nsec = (timeout_us % 1000000) * 1000;
+}
+
+/*
+* Waits on cond with the pipe mutex held. Returns TIMM_OSAL_ERR_TIMEOUT once
+* pAbs has passed, pAbs NULL waits forever.
+*/
+static TIMM_OSAL_ERRORTYPE PipeWait(TIMM_OSAL_PIPE * pHandle,
+    pthread_cond_t * cond, int *pWaiters, struct timespec *pAbs)
+{
+	int status;
+
+	(*pWaiters)++;
+	if (pAbs)
+		status = pthread_cond_timedwait(cond, &pHandle->mutex, pAbs);
+	else
+		status = pthread_cond_wait(cond, &pHandle->mutex);
+	(*pWaiters)--;
+
+	if (ETIMEDOUT == status)
+		return TIMM_OSAL_ERR_TIMEOUT;
+	return SUCCESS == status ? TIMM_OSAL_ERR_NONE : TIMM_OSAL_ERR_UNKNOWN;
+}
+
+/*
+* Makes room for nRecord more bytes, growing the ring if it is not at its
+* maximum size yet and waiting for readers otherwise
+*/
+static TIMM_OSAL_ERRORTYPE PipeReserve(TIMM_OSAL_PIPE * pHandle,
+    TIMM_OSAL_U32 nRecord, TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	struct timespec abs_timeout, *pAbs = NULL;
+	TIMM_OSAL_U32 newSize;
+	TIMM_OSAL_U8 *pNew;
+
+	if (nRecord > TIMM_OSAL_PIPE_MAX_SIZE)
+		return TIMM_OSAL_ERR_PARAMETER;
+
+	while (pHandle->bufferSize - pHandle->usedBytes < nRecord)
+	{
+		if (pHandle->bufferSize < TIMM_OSAL_PIPE_MAX_SIZE)
+		{
+			newSize = pHandle->bufferSize * 2;
+			while (newSize - pHandle->usedBytes < nRecord)
+				newSize *= 2;
+			pNew = (TIMM_OSAL_U8 *) TIMM_OSAL_Malloc(newSize, 0, 0,
+			    0);
+			if (TIMM_OSAL_NULL == pNew)
+				return TIMM_OSAL_ERR_ALLOC;
+
+			/* Queued messages end up at the start of the new ring */
+			PipeCopyOut(pHandle, pHandle->head, pNew,
+			    pHandle->usedBytes);
+			TIMM_OSAL_Free(pHandle->pBuffer);
+			pHandle->pBuffer = pNew;
+			pHandle->bufferSize = newSize;
+			pHandle->head = 0;
+			break;
+		}
+
+		if (TIMM_OSAL_NO_SUSPEND == timeout)
+			return TIMM_OSAL_ERR_PIPE_FULL;
+		if (!pAbs && (TIMM_OSAL_S32) TIMM_OSAL_SUSPEND != timeout)
+		{
+			PipeAbsTimeout(timeout, &abs_timeout);
+			pAbs = &abs_timeout;
+		}
+		bReturnStatus = PipeWait(pHandle, &pHandle->notFull,
+		    &pHandle->writeWaiters, pAbs);
+		if (TIMM_OSAL_ERR_NONE != bReturnStatus)
+			break;
+	}
+
+	return bReturnStatus;
+}
+
+/*
+* Stores a message at the tail or, for bFront, in front of the oldest one.
+* Both are O(1) in the number of queued messages.
+*/
+static TIMM_OSAL_ERRORTYPE PipeWrite(TIMM_OSAL_PIPE * pHandle,
+    void *pMessage, TIMM_OSAL_U32 size, TIMM_OSAL_S32 timeout,
+    TIMM_OSAL_BOOL bFront)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+	TIMM_OSAL_U32 nRecord, offset;
+	TIMM_OSAL_U32 hdr = size;
+	eventfd_t one = 1;
+
+	if (TIMM_OSAL_NULL == pHandle || TIMM_OSAL_NULL == pMessage)
+	{
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
+	if (size == 0)
+	{
+		TIMM_OSAL_Error("0 size!!!");
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
+	if (pHandle->isFixedMessage && size > pHandle->messageSize)
+	{
+		TIMM_OSAL_Error("Message larger than the pipe message size!!!");
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
+
+	nRecord = PipeRecordSize(pHandle, size);
+
+	pthread_mutex_lock(&pHandle->mutex);
+
+	bReturnStatus = PipeReserve(pHandle, nRecord, timeout);
+	if (TIMM_OSAL_ERR_NONE != bReturnStatus)
+	{
+		pthread_mutex_unlock(&pHandle->mutex);
+		TIMM_OSAL_Error("Write of pipe failed!!!");
+		goto EXIT;
+	}
+
+	if (bFront)
+	{
+		pHandle->head = (pHandle->head - nRecord) &
+		    (pHandle->bufferSize - 1);
+		offset = pHandle->head;
+	} else
+	{
+		offset = pHandle->head + pHandle->usedBytes;
+	}
+
+	if (pHandle->isFixedMessage)
+	{
+		PipeCopyIn(pHandle, offset, pMessage, size);
+	} else
+	{
+		PipeCopyIn(pHandle, offset, &hdr, TIMM_OSAL_PIPE_HDR_SIZE);
+		PipeCopyIn(pHandle, offset + TIMM_OSAL_PIPE_HDR_SIZE,
+		    pMessage, size);
+	}
+	pHandle->usedBytes += nRecord;
+	pHandle->messageCount++;
+
+	if (pHandle->eventFd >= 0)
+		eventfd_write(pHandle->eventFd, one);
+	if (pHandle->readWaiters)
+		pthread_cond_signal(&pHandle->notEmpty);
+
+	pthread_mutex_unlock(&pHandle->mutex);
+
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
+
+      EXIT:
+	return bReturnStatus;
+}
+
+
 /* ========================================================================== */
 /**
 * @fn TIMM_OSAL_CreatePipe function
@@ -94,6 +330,14 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreatePipe(TIMM_OSAL_PTR * pPipe,
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	TIMM_OSAL_PIPE *pHandle = TIMM_OSAL_NULL;
+	TIMM_OSAL_U32 initialSize;
+
+	if (isFixedMessage && (messageSize == 0 ||
+		messageSize > TIMM_OSAL_PIPE_MAX_SIZE))
+	{
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
 
 	pHandle =
 	    (TIMM_OSAL_PIPE *) TIMM_OSAL_Malloc(sizeof(TIMM_OSAL_PIPE), 0, 0,
@@ -106,19 +350,45 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreatePipe(TIMM_OSAL_PTR * pPipe,
 	}
 	TIMM_OSAL_Memset(pHandle, 0x0, sizeof(TIMM_OSAL_PIPE));
 
-	pHandle->pfd[0] = -1;
-	pHandle->pfd[1] = -1;
-	if (SUCCESS != pipe(pHandle->pfd))
+	/* pipeSize is a message count for fixed pipes, bytes otherwise */
+	initialSize = TIMM_OSAL_PIPE_MIN_SIZE;
+	while (initialSize < TIMM_OSAL_PIPE_MAX_SIZE &&
+	    initialSize < (isFixedMessage ? pipeSize * messageSize : pipeSize))
+		initialSize *= 2;
+
+	pHandle->pBuffer =
+	    (TIMM_OSAL_U8 *) TIMM_OSAL_Malloc(initialSize, 0, 0, 0);
+	if (TIMM_OSAL_NULL == pHandle->pBuffer)
+	{
+		bReturnStatus = TIMM_OSAL_ERR_ALLOC;
+		goto EXIT;
+	}
+
+	if (SUCCESS != pthread_mutex_init(&pHandle->mutex, NULL))
+	{
+		TIMM_OSAL_Error("Pipe Create: Mutex Init failed!!!");
+		goto EXIT;
+	}
+	if (SUCCESS != pthread_cond_init(&pHandle->notEmpty, NULL))
+	{
+		TIMM_OSAL_Error("Pipe Create: Condition Init failed!!!");
+		pthread_mutex_destroy(&pHandle->mutex);
+		goto EXIT;
+	}
+	if (SUCCESS != pthread_cond_init(&pHandle->notFull, NULL))
 	{
-		TIMM_OSAL_Error("Pipe failed: %s!!!", strerror(errno));
+		TIMM_OSAL_Error("Pipe Create: Condition Init failed!!!");
+		pthread_cond_destroy(&pHandle->notEmpty);
+		pthread_mutex_destroy(&pHandle->mutex);
 		goto EXIT;
 	}
 
+	pHandle->bufferSize = initialSize;
 	pHandle->pipeSize = pipeSize;
 	pHandle->messageSize = messageSize;
 	pHandle->isFixedMessage = isFixedMessage;
 	pHandle->messageCount = 0;
-	pHandle->totalBytesInPipe = 0;
+	pHandle->eventFd = -1;
 
 	*pPipe = (TIMM_OSAL_PTR) pHandle;
 
@@ -127,6 +397,8 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreatePipe(TIMM_OSAL_PTR * pPipe,
 
 	return bReturnStatus;
 EXIT:
+	if (TIMM_OSAL_NULL != pHandle)
+		TIMM_OSAL_Free(pHandle->pBuffer);
 	TIMM_OSAL_Free(pHandle);
 	return bReturnStatus;
 }
@@ -153,17 +425,24 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeletePipe(TIMM_OSAL_PTR pPipe)
 		goto EXIT;
 	}
 
-	if (SUCCESS != close(pHandle->pfd[0]))
+	if (pHandle->eventFd >= 0 && SUCCESS != close(pHandle->eventFd))
 	{
-		TIMM_OSAL_Error("Delete_Pipe Read fd failed!!!");
+		TIMM_OSAL_Error("Delete_Pipe event fd failed!!!");
 		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	}
-	if (SUCCESS != close(pHandle->pfd[1]))
+	if (SUCCESS != pthread_cond_destroy(&pHandle->notEmpty) ||
+	    SUCCESS != pthread_cond_destroy(&pHandle->notFull))
 	{
-		TIMM_OSAL_Error("Delete_Pipe Write fd failed!!!");
+		TIMM_OSAL_Error("Delete_Pipe condition destroy failed!!!");
+		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+	}
+	if (SUCCESS != pthread_mutex_destroy(&pHandle->mutex))
+	{
+		TIMM_OSAL_Error("Delete_Pipe mutex destroy failed!!!");
 		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	}
 
+	TIMM_OSAL_Free(pHandle->pBuffer);
 	TIMM_OSAL_Free(pHandle);
 EXIT:
 	return bReturnStatus;
@@ -180,36 +459,10 @@ EXIT:
 /* ========================================================================== */
 
 TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToPipe(TIMM_OSAL_PTR pPipe,
-    void *pMessage, TIMM_OSAL_U32 size, __unused TIMM_OSAL_S32 timeout)
+    void *pMessage, TIMM_OSAL_U32 size, TIMM_OSAL_S32 timeout)
 {
-	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	TIMM_OSAL_U32 lSizeWritten = -1;
-
-	TIMM_OSAL_PIPE *pHandle = (TIMM_OSAL_PIPE *) pPipe;
-
-	if (size == 0)
-	{
-		TIMM_OSAL_Error("0 size!!!");
-		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
-		goto EXIT;
-	}
-	lSizeWritten = write(pHandle->pfd[1], pMessage, size);
-
-	if (lSizeWritten != size)
-	{
-		TIMM_OSAL_Error("Write of pipe failed!!!");
-		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
-		goto EXIT;
-	}
-
-	/*Update message count and size */
-	pHandle->messageCount++;
-	pHandle->totalBytesInPipe += size;
-
-	bReturnStatus = TIMM_OSAL_ERR_NONE;
-
-      EXIT:
-	return bReturnStatus;
+	return PipeWrite((TIMM_OSAL_PIPE *) pPipe, pMessage, size, timeout,
+	    TIMM_OSAL_FALSE);
 }
 
 
@@ -223,73 +476,10 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToPipe(TIMM_OSAL_PTR pPipe,
 /* ========================================================================== */
 
 TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToFrontOfPipe(TIMM_OSAL_PTR pPipe,
-    void *pMessage, TIMM_OSAL_U32 size, __unused TIMM_OSAL_S32 timeout)
+    void *pMessage, TIMM_OSAL_U32 size, TIMM_OSAL_S32 timeout)
 {
-
-	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	TIMM_OSAL_U32 lSizeWritten = -1;
-	TIMM_OSAL_U32 lSizeRead = -1;
-	TIMM_OSAL_PIPE *pHandle = (TIMM_OSAL_PIPE *) pPipe;
-	TIMM_OSAL_U8 *tempPtr = NULL;
-
-
-	/*First write to this pipe */
-	if (size == 0)
-	{
-		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
-		goto EXIT;
-	}
-
-	lSizeWritten = write(pHandle->pfd[1], pMessage, size);
-
-	if (lSizeWritten != size)
-	{
-		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
-		goto EXIT;
-	}
-
-	/*Update number of messages */
-	pHandle->messageCount++;
-
-
-	if (pHandle->messageCount > 1)
-	{
-		/*First allocate memory */
-		tempPtr =
-		    (TIMM_OSAL_U8 *) TIMM_OSAL_Malloc(pHandle->
-		    totalBytesInPipe, 0, 0, 0);
-
-		if (tempPtr == NULL)
-		{
-			bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
-			goto EXIT;
-		}
-
-		/*Read out of pipe */
-		lSizeRead =
-		    read(pHandle->pfd[0], tempPtr, pHandle->totalBytesInPipe);
-
-		/*Write back to pipe */
-		lSizeWritten =
-		    write(pHandle->pfd[1], tempPtr,
-		    pHandle->totalBytesInPipe);
-
-		if (lSizeWritten != size)
-		{
-			bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
-			goto EXIT;
-		}
-
-		/*Update Total bytes in pipe */
-		pHandle->totalBytesInPipe += size;
-	}
-
-
-      EXIT:
-	TIMM_OSAL_Free(tempPtr);
-
-	return bReturnStatus;
-
+	return PipeWrite((TIMM_OSAL_PIPE *) pPipe, pMessage, size, timeout,
+	    TIMM_OSAL_TRUE);
 }
 
 
@@ -298,6 +488,7 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToFrontOfPipe(TIMM_OSAL_PTR pPipe,
 /**
 * @fn TIMM_OSAL_ReadFromPipe function
 *
+* Reads the oldest message. A message larger than size is truncated.
 *
 */
 /* ========================================================================== */
@@ -307,41 +498,79 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_ReadFromPipe(TIMM_OSAL_PTR pPipe,
     TIMM_OSAL_U32 size, TIMM_OSAL_U32 * actualSize, TIMM_OSAL_S32 timeout)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	TIMM_OSAL_U32 lSizeRead = -1;
 	TIMM_OSAL_PIPE *pHandle = (TIMM_OSAL_PIPE *) pPipe;
+	struct timespec abs_timeout, *pAbs = NULL;
+	TIMM_OSAL_U32 msgSize, offset, nRecord;
+	eventfd_t value;
 
-	if (size == 0)
+	if (TIMM_OSAL_NULL == pHandle || TIMM_OSAL_NULL == pMessage)
 	{
-		TIMM_OSAL_Error("nRead size has error!!!");
 		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
 		goto EXIT;
 	}
-	if ((pHandle->messageCount == 0) && (timeout == TIMM_OSAL_NO_SUSPEND))
+	if (size == 0)
 	{
-		/*If timeout is 0 and pipe is empty, return error */
-		TIMM_OSAL_Error("Pipe is empty!!!");
-		bReturnStatus = TIMM_OSAL_ERR_PIPE_EMPTY;
+		TIMM_OSAL_Error("nRead size has error!!!");
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
 		goto EXIT;
 	}
-	if ((timeout !=TIMM_OSAL_NO_SUSPEND) &&
-	    (timeout != (TIMM_OSAL_S32)TIMM_OSAL_SUSPEND))
+
+	pthread_mutex_lock(&pHandle->mutex);
+
+	while (pHandle->messageCount == 0)
 	{
-		TIMM_OSAL_Warning("Only infinite or no timeouts \
-			supported. Going to read with infinite timeout now");
+		if (timeout == TIMM_OSAL_NO_SUSPEND)
+		{
+			/*If timeout is 0 and pipe is empty, return error */
+			pthread_mutex_unlock(&pHandle->mutex);
+			TIMM_OSAL_Error("Pipe is empty!!!");
+			bReturnStatus = TIMM_OSAL_ERR_PIPE_EMPTY;
+			goto EXIT;
+		}
+		if (!pAbs && timeout != (TIMM_OSAL_S32) TIMM_OSAL_SUSPEND)
+		{
+			PipeAbsTimeout(timeout, &abs_timeout);
+			pAbs = &abs_timeout;
+		}
+		bReturnStatus = PipeWait(pHandle, &pHandle->notEmpty,
+		    &pHandle->readWaiters, pAbs);
+		if (TIMM_OSAL_ERR_NONE != bReturnStatus)
+		{
+			pthread_mutex_unlock(&pHandle->mutex);
+			goto EXIT;
+		}
 	}
-	/*read blocks infinitely until message is available */
-	*actualSize = lSizeRead = read(pHandle->pfd[0], pMessage, size);
-	if (0 == lSizeRead)
+
+	offset = pHandle->head;
+	if (pHandle->isFixedMessage)
 	{
-		TIMM_OSAL_Error("EOF reached or no data in pipe!!!");
-		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
-		goto EXIT;
+		msgSize = pHandle->messageSize;
+		nRecord = msgSize;
+	} else
+	{
+		PipeCopyOut(pHandle, offset, &msgSize,
+		    TIMM_OSAL_PIPE_HDR_SIZE);
+		offset += TIMM_OSAL_PIPE_HDR_SIZE;
+		nRecord = TIMM_OSAL_PIPE_HDR_SIZE + msgSize;
 	}
+	if (msgSize > size)
+		msgSize = size;
+	PipeCopyOut(pHandle, offset, pMessage, msgSize);
 
-	bReturnStatus = TIMM_OSAL_ERR_NONE;
-
+	pHandle->head = (pHandle->head + nRecord) & (pHandle->bufferSize - 1);
+	pHandle->usedBytes -= nRecord;
 	pHandle->messageCount--;
-	pHandle->totalBytesInPipe -= size;
+
+	if (pHandle->eventFd >= 0)
+		eventfd_read(pHandle->eventFd, &value);
+	if (pHandle->writeWaiters)
+		pthread_cond_signal(&pHandle->notFull);
+
+	pthread_mutex_unlock(&pHandle->mutex);
+
+	if (actualSize)
+		*actualSize = msgSize;
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
 
       EXIT:
 	return bReturnStatus;
@@ -358,12 +587,29 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_ReadFromPipe(TIMM_OSAL_PTR pPipe,
 */
 /* ========================================================================== */
 
-TIMM_OSAL_ERRORTYPE TIMM_OSAL_ClearPipe(__unused TIMM_OSAL_PTR pPipe)
+TIMM_OSAL_ERRORTYPE TIMM_OSAL_ClearPipe(TIMM_OSAL_PTR pPipe)
 {
-	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR;
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_PIPE *pHandle = (TIMM_OSAL_PIPE *) pPipe;
+	eventfd_t value;
 
-	TIMM_OSAL_Warning("This function is currently not implemented");
+	if (TIMM_OSAL_NULL == pHandle)
+	{
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
 
+	pthread_mutex_lock(&pHandle->mutex);
+	while (pHandle->eventFd >= 0 && pHandle->messageCount-- > 0)
+		eventfd_read(pHandle->eventFd, &value);
+	pHandle->messageCount = 0;
+	pHandle->head = 0;
+	pHandle->usedBytes = 0;
+	if (pHandle->writeWaiters)
+		pthread_cond_broadcast(&pHandle->notFull);
+	pthread_mutex_unlock(&pHandle->mutex);
+
+      EXIT:
 	return bReturnStatus;
 }
 
@@ -414,3 +660,48 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_GetPipeReadyMessageCount(TIMM_OSAL_PTR pPipe,
 	return bReturnStatus;
 
 }
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_GetPipeEventFd function
+*
+* Returns an fd that polls readable while messages are queued, for callers
+* that have to wait on the pipe together with other fds. The eventfd is
+* only created on the first call, pipes nobody polls never touch the kernel.
+* The fd is owned by the pipe and closed by TIMM_OSAL_DeletePipe.
+*
+*/
+/* ========================================================================== */
+
+TIMM_OSAL_ERRORTYPE TIMM_OSAL_GetPipeEventFd(TIMM_OSAL_PTR pPipe,
+    TIMM_OSAL_S32 * pFd)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_PIPE *pHandle = (TIMM_OSAL_PIPE *) pPipe;
+
+	if (TIMM_OSAL_NULL == pHandle || TIMM_OSAL_NULL == pFd)
+	{
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
+
+	pthread_mutex_lock(&pHandle->mutex);
+	if (pHandle->eventFd < 0)
+	{
+		pHandle->eventFd = eventfd(pHandle->messageCount,
+		    EFD_NONBLOCK | EFD_SEMAPHORE);
+		if (pHandle->eventFd < 0)
+		{
+			TIMM_OSAL_Error("Pipe eventfd failed: %s!!!",
+			    strerror(errno));
+			bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+		}
+	}
+	*pFd = pHandle->eventFd;
+	pthread_mutex_unlock(&pHandle->mutex);
+
+      EXIT:
+	return bReturnStatus;
+}
@@ -738,18 +738,11 @@ OMX_ERRORTYPE PROXY_VIDDEC_FillBufferDone(OMX_HANDLETYPE hComponent,
 
 	if(pCompPrv->proxyPortBuffers[OMX_VIDEODECODER_OUTPUT_PORT].proxyBufferType
 			== GrallocPointers) {
-		for (count = 0; count < pCompPrv->nTotalBuffers; ++count)
-		{
-			if (pCompPrv->tBufList[count].pBufHeaderRemote == remoteBufHdr)
-			{
-				grallocHandle = (IMG_native_handle_t*)(pCompPrv->tBufList[count].pBufHeader)->pBuffer;
-				break;
-			}
-		}
-
-		PROXY_assert((count != pCompPrv->nTotalBuffers),
+		count = PROXY_BufMapFind(&pCompPrv->tRemoteBufMap, (OMX_PTR) remoteBufHdr);
+		PROXY_assert((count != PROXY_BUFMAP_NOT_FOUND),
 				OMX_ErrorBadParameter,
 				"Received invalid-buffer header from OMX component");
+		grallocHandle = (IMG_native_handle_t*)(pCompPrv->tBufList[count].pBufHeader)->pBuffer;
 		pCompPrv->grallocModule->unlock((gralloc_module_t const *) pCompPrv->grallocModule, (buffer_handle_t)grallocHandle);
 
 #ifdef ENABLE_RAW_BUFFERS_DUMP_UTILITY
@@ -17,8 +17,14 @@
 
 #include <android/log.h>
 #include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
 #include <time.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "mapinfo.h"
 
@@ -29,10 +35,12 @@ extern void *__real_calloc(int nmemb, int size);
 extern void __real_free(void *ptr);
 
 static mapinfo *milist;
+static mapindex *miindex;
 
 #define MAX_BACKTRACE_DEPTH 15
 #define ALLOCATION_TAG      0x1ee7d00d
 #define BACKLOG_TAG         0xbabecafe
+#define UNTRACKED_TAG       0x5ca1ab1e
 #define FREE_POISON         0xa5
 #define BACKLOG_MAX         50
 #define FRONT_GUARD         0xaa
@@ -40,16 +48,59 @@ static mapinfo *milist;
 #define REAR_GUARD          0xbb
 #define REAR_GUARD_LEN      (1<<4)
 #define SCANNER_SLEEP_S     3
+#define SCANNER_TICK_MS     100
+#define SCANNER_BUDGET      512
+#define TRACE_TABLE_SIZE    (1<<13)
 
+/*
+ * Sampling: with HEAPTRACKER_SAMPLE_BYTES=N in the environment, only about
+ * one allocation per N allocated bytes is unwound and tracked, the rest just
+ * gets its guards checked when freed. 0 tracks every allocation.
+ */
+#ifndef HEAPTRACKER_SAMPLE_BYTES
+#define HEAPTRACKER_SAMPLE_BYTES 0
+#endif
+
+/*
+ * Sending HEAPTRACKER_PROFILE_SIGNAL makes the scanner write a heap profile
+ * to HEAPTRACKER_PROFILE_DIR/heap.<pid>.<seq>.prof, see
+ * heaptracker_dump_profile(). The handler is not installed if the process
+ * already handles the signal.
+ */
+#ifndef HEAPTRACKER_PROFILE_SIGNAL
+#define HEAPTRACKER_PROFILE_SIGNAL SIGUSR2
+#endif
+#ifndef HEAPTRACKER_PROFILE_DIR
+#define HEAPTRACKER_PROFILE_DIR "/data/local/tmp"
+#endif
+
+/* Call stacks are interned, allocations only point at their trace */
+struct trace {
+    uint32_t hash;
+    int depth;
+    /* allocations made from here since start, scaled when sampling */
+    uint32_t alloc_count;
+    uint64_t alloc_bytes;
+    /* only used while writing a profile, under profile_lock */
+    uint32_t live_count;
+    uint64_t live_bytes;
+    uint32_t prev_count;
+    uint64_t prev_bytes;
+    intptr_t bt[];
+};
+
+struct alloc_list;
+
+/* 48 bytes on 32 bit, keeps the user data 8 byte aligned */
 struct hdr {
     uint32_t tag;
+    uint32_t weight;    /* bytes this allocation stands for when sampling */
+    size_t size;
     struct hdr *prev;
     struct hdr *next;
-    intptr_t bt[MAX_BACKTRACE_DEPTH];
-    int bt_depth;
-    intptr_t freed_bt[MAX_BACKTRACE_DEPTH];
-    int freed_bt_depth;
-    size_t size;
+    struct alloc_list *list;
+    struct trace *bt;
+    struct trace *freed_bt;
     char front_guard[FRONT_GUARD_LEN];
 } __attribute__((packed));
 
@@ -57,6 +108,29 @@ struct ftr {
     char rear_guard[REAR_GUARD_LEN];
 } __attribute__((packed));
 
+/*
+ * Tracked allocations live on the list of the thread that made them, so
+ * threads do not contend on a global lock. The lists outlive their threads
+ * and are handed to new threads, the scanner walks them a bounded number of
+ * allocations at a time starting at cursor.
+ */
+struct alloc_list {
+    pthread_mutex_t lock;
+    unsigned num;
+    struct hdr *first;
+    struct hdr *last;
+    struct hdr *cursor;
+    int scanning;
+    int in_use;
+    struct alloc_list *next_list;
+};
+
+struct thread_state {
+    struct alloc_list *list;
+    ssize_t countdown;
+    uint32_t seed;
+};
+
 static inline struct ftr * to_ftr(struct hdr *hdr)
 {
     return (struct ftr *)(((char *)(hdr + 1)) + hdr->size);
@@ -86,16 +160,27 @@ void (*malloc_log)(const char *fmt, ...) = default_log;
 /* Call this ad dlclose() to get leaked memory */
 void free_leaked_memory(void);
 
-static unsigned num;
-static struct hdr *first;
-static struct hdr *last;
-static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+static size_t sample_bytes = HEAPTRACKER_SAMPLE_BYTES;
+
+static struct alloc_list *lists;
+static pthread_mutex_t lists_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+
+static struct trace *traces[TRACE_TABLE_SIZE];
+static pthread_mutex_t traces_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static unsigned backlog_num;
 static struct hdr *backlog_first;
 static struct hdr *backlog_last;
 static pthread_rwlock_t backlog_lock = PTHREAD_RWLOCK_INITIALIZER;
 
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t profile_requested;
+static unsigned profile_seq;
+static struct timespec start_time;
+static struct timespec profile_time;
+
 void print_backtrace(const intptr_t *bt, int depth)
 {
     mapinfo *mi;
@@ -109,13 +194,187 @@ void print_backtrace(const intptr_t *bt, int depth)
 
     malloc_log("*** *** *** *** *** *** *** *** *** *** *** *** *** *** *** ***\n");
     for (cnt = 0; cnt < depth && cnt < MAX_BACKTRACE_DEPTH; cnt++) {
-        mi = pc_to_mapinfo(milist, bt[cnt], &rel_pc);
+        mi = miindex ? pc_to_mapindex(miindex, bt[cnt], &rel_pc) :
+                       pc_to_mapinfo(milist, bt[cnt], &rel_pc);
         malloc_log("\t#%02d  pc %08x  %s\n", cnt,
                    mi ? rel_pc : bt[cnt],
                    mi ? mi->name : "(unknown)");
     }
 }
 
+static void print_trace(const struct trace *trace)
+{
+    if (trace)
+        print_backtrace(trace->bt, trace->depth);
+    else
+        malloc_log("\t(stack trace table full, not recorded)\n");
+}
+
+static inline uint32_t hash_trace(const intptr_t *bt, int depth)
+{
+    uint32_t hash = 2166136261U;
+    int i;
+    for (i = 0; i < depth; i++)
+        hash = (hash ^ (uint32_t)bt[i]) * 16777619U;
+    return hash;
+}
+
+static inline int same_trace(const struct trace *trace, uint32_t hash,
+                             const intptr_t *bt, int depth)
+{
+    return trace->hash == hash && trace->depth == depth &&
+           !memcmp(trace->bt, bt, depth * sizeof(intptr_t));
+}
+
+/*
+ * Returns the interned copy of a call stack, NULL if the table is full.
+ * Lookups do not lock, new traces are published with a release store.
+ */
+static struct trace *intern_trace(const intptr_t *bt, int depth)
+{
+    uint32_t hash = hash_trace(bt, depth);
+    unsigned i, idx;
+    struct trace *trace;
+
+    for (i = 0, idx = hash; i < TRACE_TABLE_SIZE; i++, idx++) {
+        trace = __atomic_load_n(&traces[idx & (TRACE_TABLE_SIZE - 1)],
+                                __ATOMIC_ACQUIRE);
+        if (!trace)
+            break;
+        if (same_trace(trace, hash, bt, depth))
+            return trace;
+    }
+    if (i == TRACE_TABLE_SIZE)
+        return NULL;
+
+    pthread_mutex_lock(&traces_lock);
+    /* Someone may have added it or taken the free slot meanwhile */
+    for (; i < TRACE_TABLE_SIZE; i++, idx++) {
+        trace = traces[idx & (TRACE_TABLE_SIZE - 1)];
+        if (!trace)
+            break;
+        if (same_trace(trace, hash, bt, depth))
+            goto out;
+    }
+    trace = NULL;
+    if (i == TRACE_TABLE_SIZE)
+        goto out;
+
+    trace = __real_malloc(sizeof(struct trace) + depth * sizeof(intptr_t));
+    if (trace) {
+        memset(trace, 0, sizeof(struct trace));
+        trace->hash = hash;
+        trace->depth = depth;
+        memcpy(trace->bt, bt, depth * sizeof(intptr_t));
+        __atomic_store_n(&traces[idx & (TRACE_TABLE_SIZE - 1)], trace,
+                         __ATOMIC_RELEASE);
+    }
+out:
+    pthread_mutex_unlock(&traces_lock);
+    return trace;
+}
+
+static inline struct trace *record_trace(void)
+{
+    intptr_t bt[MAX_BACKTRACE_DEPTH];
+    int depth = heaptracker_stacktrace(bt, MAX_BACKTRACE_DEPTH);
+    return intern_trace(bt, depth);
+}
+
+static void release_thread_state(void *data)
+{
+    struct thread_state *ts = data;
+
+    pthread_mutex_lock(&lists_lock);
+    ts->list->in_use = 0;
+    pthread_mutex_unlock(&lists_lock);
+    __real_free(ts);
+}
+
+static void create_thread_key(void)
+{
+    pthread_key_create(&thread_key, release_thread_state);
+}
+
+/* Hands the calling thread a list left behind by an exited thread or a new one */
+static struct alloc_list *get_list(void)
+{
+    struct alloc_list *list;
+
+    pthread_mutex_lock(&lists_lock);
+    for (list = lists; list; list = list->next_list)
+        if (!list->in_use)
+            break;
+    if (!list) {
+        list = __real_calloc(1, sizeof(*list));
+        if (list) {
+            pthread_mutex_init(&list->lock, NULL);
+            list->next_list = lists;
+            __atomic_store_n(&lists, list, __ATOMIC_RELEASE);
+        }
+    }
+    if (list)
+        list->in_use = 1;
+    pthread_mutex_unlock(&lists_lock);
+
+    return list;
+}
+
+static struct thread_state *thread_state(void)
+{
+    struct thread_state *ts;
+
+    pthread_once(&thread_key_once, create_thread_key);
+    ts = pthread_getspecific(thread_key);
+    if (!ts) {
+        ts = __real_malloc(sizeof(*ts));
+        if (!ts)
+            return NULL;
+        ts->list = get_list();
+        if (!ts->list) {
+            __real_free(ts);
+            return NULL;
+        }
+        ts->seed = (uint32_t)(intptr_t)ts;
+        ts->countdown = sample_bytes;
+        pthread_setspecific(thread_key, ts);
+    }
+    return ts;
+}
+
+/*
+ * Decides whether an allocation of size bytes is tracked. The thread counts
+ * down the bytes it allocates, the allocation crossing zero is sampled and
+ * the next distance is drawn around sample_bytes so that periodic
+ * allocation patterns do not alias with it.
+ */
+static inline int sample(struct thread_state *ts, size_t size, uint32_t *weight)
+{
+    size_t period = sample_bytes;
+
+    if (!period) {
+        *weight = size;
+        return 1;
+    }
+
+    ts->countdown -= size;
+    if (ts->countdown > 0)
+        return 0;
+
+    ts->seed = ts->seed * 1103515245 + 12345;
+    ts->countdown = 1 + (ts->seed >> 8) % (2 * period);
+    *weight = size > period ? size : period;
+    return 1;
+}
+
+/* Number of allocations a tracked allocation stands for */
+static inline uint32_t weight_count(const struct hdr *hdr)
+{
+    if (!hdr->size || hdr->weight <= hdr->size)
+        return 1;
+    return (hdr->weight + hdr->size / 2) / hdr->size;
+}
+
 static inline void init_front_guard(struct hdr *hdr)
 {
     memset(hdr->front_guard, FRONT_GUARD, FRONT_GUARD_LEN);
@@ -183,27 +442,53 @@ static inline int __del(struct hdr *hdr, struct hdr **first, struct hdr **last)
     return 0;
 }
 
-static inline void add(struct hdr *hdr, size_t size)
+static inline void init_guards(struct hdr *hdr, size_t size)
 {
-    pthread_rwlock_wrlock(&lock);
-    hdr->tag = ALLOCATION_TAG;
     hdr->size = size;
     init_front_guard(hdr);
     init_rear_guard(hdr);
-    num++;
-    __add(hdr, &first, &last);
-    pthread_rwlock_unlock(&lock);
+}
+
+static inline void add(struct hdr *hdr, size_t size, uint32_t weight,
+                       struct alloc_list *list)
+{
+    hdr->tag = ALLOCATION_TAG;
+    hdr->weight = weight;
+    hdr->list = list;
+    hdr->bt = record_trace();
+    hdr->freed_bt = NULL;
+    init_guards(hdr, size);
+    if (hdr->bt) {
+        __atomic_add_fetch(&hdr->bt->alloc_count, weight_count(hdr),
+                           __ATOMIC_RELAXED);
+        __atomic_add_fetch(&hdr->bt->alloc_bytes, weight, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_lock(&list->lock);
+    list->num++;
+    __add(hdr, &list->first, &list->last);
+    pthread_mutex_unlock(&list->lock);
+}
+
+static inline void __unlink(struct hdr *hdr, struct alloc_list *list)
+{
+    /* Keep the scanner position valid */
+    if (list->cursor == hdr)
+        list->cursor = hdr->next;
+    list->num--;
+    __del(hdr, &list->first, &list->last);
 }
 
 static inline int del(struct hdr *hdr)
 {
+    struct alloc_list *list;
+
     if (hdr->tag != ALLOCATION_TAG)
         return -1;
 
-    pthread_rwlock_wrlock(&lock);
-    __del(hdr, &first, &last);
-    num--;
-    pthread_rwlock_unlock(&lock);
+    list = hdr->list;
+    pthread_mutex_lock(&list->lock);
+    __unlink(hdr, list);
+    pthread_mutex_unlock(&list->lock);
     return 0;
 }
 
@@ -277,11 +562,11 @@ static inline int __check_allocation(struct hdr *hdr, int *safe)
     if (!valid && *safe) {
         malloc_log("+++ ALLOCATION %p SIZE %d ALLOCATED HERE:\n",
                         user(hdr), hdr->size);
-        print_backtrace(hdr->bt, hdr->bt_depth);
+        print_trace(hdr->bt);
         if (hdr->tag == BACKLOG_TAG) {
             malloc_log("+++ ALLOCATION %p SIZE %d FREED HERE:\n",
                        user(hdr), hdr->size);
-            print_backtrace(hdr->freed_bt, hdr->freed_bt_depth);
+            print_trace(hdr->freed_bt);
         }
     }
 
@@ -317,14 +602,13 @@ static inline void del_from_backlog(struct hdr *hdr)
     pthread_rwlock_unlock(&backlog_lock);
 }
 
-static inline int del_leak(struct hdr *hdr, int *safe)
+static inline int del_leak(struct hdr *hdr, struct alloc_list *list, int *safe)
 {
     int valid;
-    pthread_rwlock_wrlock(&lock);
-    valid = __del_and_check(hdr,
-                            &first, &last, &num,
-                            safe);
-    pthread_rwlock_unlock(&lock);
+    pthread_mutex_lock(&list->lock);
+    valid = __check_allocation(hdr, safe);
+    __unlink(hdr, list);
+    pthread_mutex_unlock(&list->lock);
     return valid;
 }
 
@@ -344,17 +628,45 @@ static inline void add_to_backlog(struct hdr *hdr)
     pthread_rwlock_unlock(&backlog_lock);
 }
 
+/* Allocations that were not sampled only get their guards checked */
+static inline int del_untracked(struct hdr *hdr)
+{
+    int safe;
+
+    if (hdr->tag != UNTRACKED_TAG)
+        return -1;
+
+    if (!check_guards(hdr, &safe)) {
+        malloc_log("+++ ALLOCATION %p SIZE %d (NOT SAMPLED) FREED HERE:\n",
+                   user(hdr), hdr->size);
+        print_backtrace(NULL, 0);
+    }
+    hdr->tag = 0;
+    return 0;
+}
+
+/* Sets up a new allocation, tracked or not depending on sampling */
+static inline void *track(struct hdr *hdr, size_t size)
+{
+    struct thread_state *ts = thread_state();
+    uint32_t weight;
+
+    if (ts && sample(ts, size, &weight)) {
+        add(hdr, size, weight, ts->list);
+    } else {
+        hdr->tag = UNTRACKED_TAG;
+        init_guards(hdr, size);
+    }
+    return user(hdr);
+}
+
 void* __wrap_malloc(size_t size)
 {
 //  malloc_tracker_log("%s: %s\n", __FILE__, __FUNCTION__);
     struct hdr *hdr = __real_malloc(sizeof(struct hdr) + size +
                                     sizeof(struct ftr));
-    if (hdr) {
-        hdr->bt_depth = heaptracker_stacktrace(
-                            hdr->bt, MAX_BACKTRACE_DEPTH);
-        add(hdr, size);
-        return user(hdr);
-    }
+    if (hdr)
+        return track(hdr, size);
     return NULL;
 }
 
@@ -366,35 +678,34 @@ void __wrap_free(void *ptr)
 
     hdr = meta(ptr);
 
-    if (del(hdr) < 0) {
-        intptr_t bt[MAX_BACKTRACE_DEPTH];
-        int depth;
-        depth = heaptracker_stacktrace(bt, MAX_BACKTRACE_DEPTH);
+    if (!del_untracked(hdr)) {
+        __real_free(hdr);
+    }
+    else if (del(hdr) < 0) {
         if (hdr->tag == BACKLOG_TAG) {
             malloc_log("+++ ALLOCATION %p SIZE %d BYTES MULTIPLY FREED!\n",
                        user(hdr), hdr->size);
             malloc_log("+++ ALLOCATION %p SIZE %d ALLOCATED HERE:\n",
                        user(hdr), hdr->size);
-            print_backtrace(hdr->bt, hdr->bt_depth);
-            /* hdr->freed_bt_depth should be nonzero here */
+            print_trace(hdr->bt);
+            /* hdr->freed_bt should be set here */
             malloc_log("+++ ALLOCATION %p SIZE %d FIRST FREED HERE:\n",
                        user(hdr), hdr->size);
-            print_backtrace(hdr->freed_bt, hdr->freed_bt_depth);
+            print_trace(hdr->freed_bt);
             malloc_log("+++ ALLOCATION %p SIZE %d NOW BEING FREED HERE:\n",
                        user(hdr), hdr->size);
-            print_backtrace(bt, depth);
+            print_backtrace(NULL, 0);
         }
         else {
             malloc_log("+++ ALLOCATION %p IS CORRUPTED OR NOT ALLOCATED VIA TRACKER!\n",
                        user(hdr));
-            print_backtrace(bt, depth);
+            print_backtrace(NULL, 0);
             /* Leak here so that we do not crash */
             //__real_free(user(hdr));
         }
     }
     else {
-        hdr->freed_bt_depth = heaptracker_stacktrace(hdr->freed_bt,
-                                      MAX_BACKTRACE_DEPTH);
+        hdr->freed_bt = record_trace();
         add_to_backlog(hdr);
     }
 }
@@ -414,23 +725,20 @@ void *__wrap_realloc(void *ptr, size_t size)
     hdr = meta(ptr);
 
 //  malloc_log("%s: %s\n", __FILE__, __FUNCTION__);
-    if (del(hdr) < 0) {
-        intptr_t bt[MAX_BACKTRACE_DEPTH];
-        int depth;
-        depth = heaptracker_stacktrace(bt, MAX_BACKTRACE_DEPTH);
+    if (del_untracked(hdr) < 0 && del(hdr) < 0) {
         if (hdr->tag == BACKLOG_TAG) {
             malloc_log("+++ REALLOCATION %p SIZE %d OF FREED MEMORY!\n",
                        user(hdr), size, hdr->size);
             malloc_log("+++ ALLOCATION %p SIZE %d ALLOCATED HERE:\n",
                        user(hdr), hdr->size);
-            print_backtrace(hdr->bt, hdr->bt_depth);
-            /* hdr->freed_bt_depth should be nonzero here */
+            print_trace(hdr->bt);
+            /* hdr->freed_bt should be set here */
             malloc_log("+++ ALLOCATION %p SIZE %d FIRST FREED HERE:\n",
                        user(hdr), hdr->size);
-            print_backtrace(hdr->freed_bt, hdr->freed_bt_depth);
+            print_trace(hdr->freed_bt);
             malloc_log("+++ ALLOCATION %p SIZE %d NOW BEING REALLOCATED HERE:\n",
                        user(hdr), hdr->size);
-            print_backtrace(bt, depth);
+            print_backtrace(NULL, 0);
 
 	    /* We take the memory out of the backlog and fall through so the
 	     * reallocation below succeeds.  Since we didn't really free it, we
@@ -441,7 +749,7 @@ void *__wrap_realloc(void *ptr, size_t size)
         else {
             malloc_log("+++ REALLOCATION %p SIZE %d IS CORRUPTED OR NOT ALLOCATED VIA TRACKER!\n",
                        user(hdr), size);
-            print_backtrace(bt, depth);
+            print_backtrace(NULL, 0);
             // just get a whole new allocation and leak the old one
             return __real_realloc(0, size);
             // return __real_realloc(user(hdr), size); // assuming it was allocated externally
@@ -449,11 +757,8 @@ void *__wrap_realloc(void *ptr, size_t size)
     }
  
     hdr = __real_realloc(hdr, sizeof(struct hdr) + size + sizeof(struct ftr));
-    if (hdr) {
-        hdr->bt_depth = heaptracker_stacktrace(hdr->bt, MAX_BACKTRACE_DEPTH);
-        add(hdr, size);
-        return user(hdr);
-    }
+    if (hdr)
+        return track(hdr, size);
 
     return NULL;
 }
@@ -464,34 +769,37 @@ void *__wrap_calloc(int nmemb, size_t size)
     struct hdr *hdr;
     size_t __size = nmemb * size;
     hdr = __real_calloc(1, sizeof(struct hdr) + __size + sizeof(struct ftr));
-    if (hdr) {
-        hdr->bt_depth = heaptracker_stacktrace(
-                            hdr->bt, MAX_BACKTRACE_DEPTH);
-        add(hdr, __size);
-        return user(hdr);
-    }
+    if (hdr)
+        return track(hdr, __size);
     return NULL;
 }
 
 void heaptracker_free_leaked_memory(void)
 {
-    struct hdr *del; int cnt;
+    struct alloc_list *list;
+    struct hdr *del;
+    unsigned num = 0;
+
+    for (list = lists; list; list = list->next_list)
+        num += list->num;
 
     if (num)
         malloc_log("+++ THERE ARE %d LEAKED ALLOCATIONS\n", num);
 
-    while (last) {
-        int safe;
-        del = last;
-        malloc_log("+++ DELETING %d BYTES OF LEAKED MEMORY AT %p (%d REMAINING)\n",
-                del->size, user(del), num);
-        if (del_leak(del, &safe)) {
-            /* safe == 1, because the allocation is valid */
-            malloc_log("+++ ALLOCATION %p SIZE %d ALLOCATED HERE:\n",
-                        user(del), del->size);
-            print_backtrace(del->bt, del->bt_depth);
+    for (list = lists; list; list = list->next_list) {
+        while (list->last) {
+            int safe;
+            del = list->last;
+            malloc_log("+++ DELETING %d BYTES OF LEAKED MEMORY AT %p (%d REMAINING)\n",
+                    del->size, user(del), num--);
+            if (del_leak(del, list, &safe)) {
+                /* safe == 1, because the allocation is valid */
+                malloc_log("+++ ALLOCATION %p SIZE %d ALLOCATED HERE:\n",
+                            user(del), del->size);
+                print_trace(del->bt);
+            }
+            __real_free(del);
         }
-        __real_free(del);
     }
 
 //  malloc_log("+++ DELETING %d BACKLOGGED ALLOCATIONS\n", backlog_num);
@@ -520,28 +828,236 @@ static int check_list(struct hdr *list, pthread_rwlock_t *rwlock)
     return num_checked;
 }
 
+/*
+ * Checks allocations of list from where the previous call stopped until
+ * *budget is used up. Returns 1 once the end of the list is reached.
+ */
+static int check_list_part(struct alloc_list *list, int *budget)
+{
+    struct hdr *hdr;
+    int safe, done;
+
+    pthread_mutex_lock(&list->lock);
+    if (!list->scanning) {
+        list->cursor = list->last;
+        list->scanning = 1;
+    }
+    for (hdr = list->cursor; hdr && *budget > 0; hdr = hdr->next, (*budget)--)
+        (void)__check_allocation(hdr, &safe);
+    list->cursor = hdr;
+    done = !hdr;
+    if (done)
+        list->scanning = 0;
+    pthread_mutex_unlock(&list->lock);
+
+    return done;
+}
+
+static unsigned elapsed_ms(const struct timespec *from,
+                           const struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000 +
+           (to->tv_nsec - from->tv_nsec) / 1000000;
+}
+
+/* Sums up the live allocations per trace, returns the totals */
+static void aggregate_live(uint32_t *count, uint64_t *bytes)
+{
+    struct alloc_list *list;
+    struct trace *trace;
+    struct hdr *hdr;
+    unsigned i;
+
+    for (i = 0; i < TRACE_TABLE_SIZE; i++) {
+        trace = __atomic_load_n(&traces[i], __ATOMIC_ACQUIRE);
+        if (trace) {
+            trace->live_count = 0;
+            trace->live_bytes = 0;
+        }
+    }
+
+    *count = 0;
+    *bytes = 0;
+    for (list = __atomic_load_n(&lists, __ATOMIC_ACQUIRE); list;
+         list = list->next_list) {
+        pthread_mutex_lock(&list->lock);
+        for (hdr = list->last; hdr; hdr = hdr->next) {
+            uint32_t n = weight_count(hdr);
+            *count += n;
+            *bytes += hdr->weight;
+            if (hdr->bt) {
+                hdr->bt->live_count += n;
+                hdr->bt->live_bytes += hdr->weight;
+            }
+        }
+        pthread_mutex_unlock(&list->lock);
+    }
+}
+
+static void write_maps(FILE *fp)
+{
+    char data[1024];
+    size_t len;
+    FILE *maps = fopen("/proc/self/maps", "r");
+
+    if (!maps)
+        return;
+    while ((len = fread(data, 1, sizeof(data), maps)) > 0)
+        fwrite(data, 1, len, fp);
+    fclose(maps);
+}
+
+/*
+ * Writes the tracked allocations aggregated by call stack in the legacy
+ * heap profile format read by pprof:
+ *
+ *   live count: live bytes [allocated count: allocated bytes] @ pc ...
+ *
+ * followed by the process maps for symbolization. Allocated counts are
+ * cumulative since start, a comment after each record gives the rate since
+ * the previous profile. When sampling, counts and bytes are estimates scaled
+ * by the sampling weight. Returns 0 on success, -1 if the file could not be
+ * written.
+ */
+int heaptracker_dump_profile(const char *path)
+{
+    FILE *fp;
+    struct trace *trace;
+    struct timespec now;
+    uint32_t live_count, alloc_count = 0;
+    uint64_t live_bytes, alloc_bytes = 0;
+    unsigned i, since_start, since_prev;
+    int cnt, ret;
+
+    fp = fopen(path, "w");
+    if (!fp)
+        return -1;
+
+    pthread_mutex_lock(&profile_lock);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    since_start = elapsed_ms(&start_time, &now);
+    since_prev = elapsed_ms(profile_time.tv_sec ? &profile_time : &start_time,
+                            &now);
+    aggregate_live(&live_count, &live_bytes);
+    for (i = 0; i < TRACE_TABLE_SIZE; i++) {
+        trace = __atomic_load_n(&traces[i], __ATOMIC_ACQUIRE);
+        if (trace) {
+            alloc_count += __atomic_load_n(&trace->alloc_count, __ATOMIC_RELAXED);
+            alloc_bytes += __atomic_load_n(&trace->alloc_bytes, __ATOMIC_RELAXED);
+        }
+    }
+
+    fprintf(fp, "heap profile: %6u: %8llu [%6u: %8llu] @ heapprofile\n",
+            live_count, (unsigned long long)live_bytes,
+            alloc_count, (unsigned long long)alloc_bytes);
+    fprintf(fp, "# pid %d, %u ms since start, %u ms since the previous profile\n",
+            getpid(), since_start, since_prev);
+    if (sample_bytes)
+        fprintf(fp, "# sampled one allocation per %u bytes\n",
+                (unsigned)sample_bytes);
+
+    for (i = 0; i < TRACE_TABLE_SIZE; i++) {
+        uint32_t count;
+        uint64_t bytes;
+
+        trace = __atomic_load_n(&traces[i], __ATOMIC_ACQUIRE);
+        if (!trace)
+            continue;
+        count = __atomic_load_n(&trace->alloc_count, __ATOMIC_RELAXED);
+        bytes = __atomic_load_n(&trace->alloc_bytes, __ATOMIC_RELAXED);
+        /* traces only recorded for frees have nothing to report */
+        if (!count)
+            continue;
+
+        fprintf(fp, "%6u: %8llu [%6u: %8llu] @",
+                trace->live_count, (unsigned long long)trace->live_bytes,
+                count, (unsigned long long)bytes);
+        for (cnt = 0; cnt < trace->depth; cnt++)
+            fprintf(fp, " 0x%08lx", (unsigned long)trace->bt[cnt]);
+        fprintf(fp, "\n");
+        if (since_prev && count != trace->prev_count)
+            fprintf(fp, "# %llu allocs/s %llu bytes/s\n",
+                    (count - trace->prev_count) * 1000ULL / since_prev,
+                    (bytes - trace->prev_bytes) * 1000ULL / since_prev);
+        trace->prev_count = count;
+        trace->prev_bytes = bytes;
+    }
+
+    fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+    write_maps(fp);
+    profile_time = now;
+    pthread_mutex_unlock(&profile_lock);
+
+    ret = ferror(fp) ? -1 : 0;
+    if (fclose(fp))
+        ret = -1;
+    return ret;
+}
+
+/* Not safe to write the profile from the handler, the scanner picks it up */
+static void request_profile(int sig __attribute__((unused)))
+{
+    profile_requested = 1;
+}
+
+static void dump_requested_profile(void)
+{
+    char path[128];
+
+    profile_requested = 0;
+    snprintf(path, sizeof(path), "%s/heap.%d.%04u.prof",
+             HEAPTRACKER_PROFILE_DIR, getpid(), profile_seq++);
+    if (heaptracker_dump_profile(path))
+        malloc_log("+++ COULD NOT WRITE HEAP PROFILE %s\n", path);
+    else
+        malloc_log("+++ HEAP PROFILE WRITTEN TO %s\n", path);
+}
+
 static pthread_t scanner_thread;
 static pthread_cond_t scanner_cond = PTHREAD_COND_INITIALIZER;
 static int scanner_stop;
 static pthread_mutex_t scanner_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * The scanner checks at most SCANNER_BUDGET allocations per tick and starts
+ * a new pass over all allocations at most every SCANNER_SLEEP_S seconds, so
+ * its cost does not grow with the heap.
+ */
 static void* scanner(void *data __attribute__((unused)))
 {
-    struct timespec ts;
-    int num_checked, num_checked_backlog;
+    struct alloc_list *list = NULL;
+    struct timespec ts, pass_start = { 0, 0 };
+    int budget;
 
     while (1) {
-        num_checked = check_list(last, &lock);
-        num_checked_backlog = check_list(backlog_last, &backlog_lock);
-
-//      malloc_log("@@@ scanned %d/%d allocs and %d/%d freed\n",
-//                 num_checked, num,
-//                 num_checked_backlog, backlog_num);
+        if (profile_requested)
+            dump_requested_profile();
+
+        budget = SCANNER_BUDGET;
+        while (budget > 0) {
+            if (!list) {
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                if (pass_start.tv_sec &&
+                    ts.tv_sec - pass_start.tv_sec < SCANNER_SLEEP_S)
+                    break;
+                pass_start = ts;
+                budget -= check_list(backlog_last, &backlog_lock);
+                list = __atomic_load_n(&lists, __ATOMIC_ACQUIRE);
+                if (!list)
+                    break;
+            }
+            if (check_list_part(list, &budget))
+                list = list->next_list;
+        }
 
         pthread_mutex_lock(&scanner_lock);
         if (!scanner_stop) {
             clock_gettime(CLOCK_REALTIME, &ts);
-            ts.tv_sec += SCANNER_SLEEP_S;
+            ts.tv_nsec += SCANNER_TICK_MS * 1000000L;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
             pthread_cond_timedwait(&scanner_cond, &scanner_lock, &ts);
         }
         if (scanner_stop) {
@@ -558,8 +1074,28 @@ static void* scanner(void *data __attribute__((unused)))
 static void init(void) __attribute__((constructor));
 static void init(void)
 {
+    const char *env = getenv("HEAPTRACKER_SAMPLE_BYTES");
+    struct sigaction sa;
+
+    if (env)
+        sample_bytes = strtoul(env, NULL, 0);
+    if (sample_bytes)
+        malloc_log("+++ HEAPTRACKER SAMPLING ONE ALLOCATION PER %u BYTES\n",
+                   sample_bytes);
+
 //  malloc_log("@@@ start scanner thread");
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    if (!sigaction(HEAPTRACKER_PROFILE_SIGNAL, NULL, &sa) &&
+        sa.sa_handler == SIG_DFL) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = request_profile;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(HEAPTRACKER_PROFILE_SIGNAL, &sa, NULL);
+    }
+
     milist = init_mapinfo(getpid());
+    miindex = index_mapinfo(milist);
     pthread_create(&scanner_thread,
                    NULL,
                    scanner,
@@ -579,5 +1115,7 @@ static void deinit(void)
 //  malloc_log("@@@ scanner thread stopped");
 
     heaptracker_free_leaked_memory();
+    deinit_mapindex(miindex);
+    miindex = NULL;
     deinit_mapinfo(milist);
 }
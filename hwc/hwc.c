@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <poll.h>
 #include <sys/ioctl.h>
@@ -51,6 +52,7 @@
 #include "hwc_dev.h"
 #include "display.h"
 #include "dock_image.h"
+#include "hwc_trace.h"
 #include "sw_vsync.h"
 
 #define min(a, b) ( { typeof(a) __a = (a), __b = (b); __a < __b ? __a : __b; } )
@@ -67,6 +69,7 @@
 #define NUM_NONSCALING_OVERLAYS 1
 #define NUM_EXT_DISPLAY_BACK_BUFFERS 2
 #define ASPECT_RATIO_TOLERANCE 0.02f
+#define HWC_TRACE_DUMP_FRAMES 32  /* frames of the composition trace shown by dumpsys */
 
 /* copied from: KK bionic/libc/kernel/common/linux/fb.h */
 #ifndef FB_FLAG_RATIO_4_3
@@ -1471,8 +1474,8 @@ static bool blit_layers(omap_hwc_device_t *hwc_dev, hwc_display_contents_1_t *li
         hwc_dev->procs->extension_cb(hwc_dev->procs, HWC_EXTENDED_OP_LAYERDATA, NULL, -1) != 0)
         goto err_out;
 
-    /* Check if we have enough space in the extended layer list */
-    if ((sizeof(hwc_layer_extended_t) * list->numHwLayers) > sizeof(grgz_ext_layer_list))
+    /* Make sure the extended layer list can hold all the layers */
+    if (rgz_ext_layer_list_reserve(&grgz_ext_layer_list, list->numHwLayers))
         goto err_out;
 #endif
     uint32_t i;
@@ -1520,6 +1523,8 @@ static bool blit_layers(omap_hwc_device_t *hwc_dev, hwc_display_contents_1_t *li
             .bvc = {
                 .dstgeom = &gscrngeom,
                 .noblend = 0,
+                /* Idle screens keep producing the same blits when blitting everything */
+                .plancache = hwc_dev->blt_policy == BLTPOLICY_ALL,
             }
         }
     };
@@ -1529,6 +1534,13 @@ static bool blit_layers(omap_hwc_device_t *hwc_dev, hwc_display_contents_1_t *li
         goto err_out;
     }
 
+    if (out.data.bvc.plancache) {
+        if (out.data.bvc.out_cached)
+            hwc_dev->blit_plan_hits++;
+        else
+            hwc_dev->blit_plan_misses++;
+    }
+
     /* This is a special situation where the regionizer decided no blits are
      * needed for this frame but there are blit buffers to synchronize with. Can
      * happen only if the regionizer is enabled otherwise it's likely a bug
@@ -1538,6 +1550,12 @@ static bool blit_layers(omap_hwc_device_t *hwc_dev, hwc_display_contents_1_t *li
         goto err_out;
     }
 
+    /* The blit buffers are posted after the overlay ones */
+    if (bufoff + out.data.bvc.out_nhndls > MAX_HWC_LAYERS) {
+        ALOGE("Too many blit buffers to post (%d + %d)", bufoff, out.data.bvc.out_nhndls);
+        goto err_out;
+    }
+
     hwc_dev->blit_flags |= HWC_BLT_FLAG_USE_FB;
     hwc_dev->blit_num = out.data.bvc.out_blits;
     hwc_dev->post2_blit_buffers = out.data.bvc.out_nhndls;
@@ -1627,6 +1645,272 @@ handle_error:
     return -1;
 }
 
+/*
+ * Overlay allocation
+ *
+ * An allocator picks the layers of the primary display shown on DSS pipes, the
+ * others are composed into the framebuffer by SGX or the blitter. Any plan it
+ * returns must follow the rules the pipe setup relies on: at most max_ovls
+ * pipes, the overlays fit the TILER 1D slot and there is no blended overlay
+ * above a composed layer.
+ */
+#define OVL_PLAN_MAX_LAYERS 32      /* bits in ovl_plan.ovl_mask */
+#define OVL_SEARCH_MAX_LAYERS 8     /* larger lists are allocated greedily */
+
+struct ovl_allocator {
+    const char *name;
+    void (*allocate)(omap_hwc_device_t *hwc_dev, hwc_display_contents_1_t *list,
+                     uint32_t max_ovls, ovl_plan_t *plan);
+};
+
+static inline bool ovl_plan_has(ovl_plan_t *plan, uint32_t ix)
+{
+    return ix < OVL_PLAN_MAX_LAYERS && (plan->ovl_mask & (1U << ix));
+}
+
+/* Whether the layer can be shown on a DSS pipe at all */
+static bool ovl_candidate(omap_hwc_device_t *hwc_dev, hwc_layer_1_t *layer)
+{
+    return can_dss_render_layer(hwc_dev, layer) &&
+           (!hwc_dev->force_sgx ||
+            /* render protected and dockable layers via DSS */
+            is_protected(layer) ||
+            is_upscaled_NV12(hwc_dev, layer) ||
+            (hwc_dev->ext.current.docking && hwc_dev->ext.current.enabled && dockable(layer)));
+}
+
+/*
+ * Whether the layer must not be composed: SGX can't read protected buffers, and
+ * forced SGX composition only leaves the layers above on pipes.
+ */
+static bool ovl_mandatory(omap_hwc_device_t *hwc_dev, hwc_layer_1_t *layer)
+{
+    return ovl_candidate(hwc_dev, layer) && (is_protected(layer) || hwc_dev->force_sgx);
+}
+
+static uint32_t primary_fps(omap_hwc_device_t *hwc_dev)
+{
+    display_t *display = hwc_dev->displays[HWC_DISPLAY_PRIMARY];
+
+    return display ? display->configs[display->active_config_ix].fps : 60;
+}
+
+/* Memory traffic of fetching the source of a layer in bytes/s */
+static uint64_t layer_fetch_bw(omap_hwc_device_t *hwc_dev, hwc_layer_1_t *layer, uint32_t fps)
+{
+    IMG_native_handle_t *handle = (IMG_native_handle_t *)layer->handle;
+    uint32_t bpp = get_format_bpp(handle ? handle->iFormat : hwc_dev->fb_dev->base.format);
+
+    /* NV12 carries a half resolution chroma plane on top of the luma */
+    if (handle && is_NV12(handle))
+        bpp = bpp * 3 / 2;
+    return (uint64_t)WIDTH(layer->sourceCrop) * HEIGHT(layer->sourceCrop) * bpp / 8 * fps;
+}
+
+/* Memory traffic of composing a layer into the framebuffer in bytes/s */
+static uint64_t layer_compose_bw(omap_hwc_device_t *hwc_dev, hwc_layer_1_t *layer, uint32_t fps)
+{
+    uint64_t dst = (uint64_t)WIDTH(layer->displayFrame) * HEIGHT(layer->displayFrame) *
+                   get_format_bpp(hwc_dev->fb_dev->base.format) / 8 * fps;
+
+    /* blending reads the framebuffer back before writing it */
+    return layer_fetch_bw(hwc_dev, layer, fps) + (is_BLENDED(layer) ? 2 : 1) * dst;
+}
+
+/*
+ * Fixed cost of a composition pass. Waking up SGX is charged as much as
+ * writing the whole framebuffer, the blitter doesn't need the GPU.
+ */
+static uint64_t composition_bw(omap_hwc_device_t *hwc_dev, uint32_t fps)
+{
+    if (hwc_dev->blt_policy != BLTPOLICY_DISABLED)
+        return 0;
+    return (uint64_t)hwc_dev->fb_dev->base.width * hwc_dev->fb_dev->base.height *
+           get_format_bpp(hwc_dev->fb_dev->base.format) / 8 * fps;
+}
+
+static void ovl_plan_cost(omap_hwc_device_t *hwc_dev, hwc_display_contents_1_t *list,
+                          ovl_plan_t *plan)
+{
+    uint32_t fps = primary_fps(hwc_dev);
+    uint32_t i;
+
+    plan->cost = 0;
+    plan->composition = false;
+    for (i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_1_t *layer = &list->hwLayers[i];
+
+        if (layer->compositionType == HWC_FRAMEBUFFER_TARGET)
+            continue;
+        if (ovl_plan_has(plan, i)) {
+            plan->cost += layer_fetch_bw(hwc_dev, layer, fps);
+        } else {
+            plan->cost += layer_compose_bw(hwc_dev, layer, fps);
+            plan->composition = true;
+        }
+    }
+    if (plan->composition)
+        plan->cost += composition_bw(hwc_dev, fps);
+}
+
+/* Take DSS pipes bottom to top as long as the layers fit */
+static void ovl_alloc_greedy(omap_hwc_device_t *hwc_dev, hwc_display_contents_1_t *list,
+                             uint32_t max_ovls, ovl_plan_t *plan)
+{
+    bool composed = false;
+    uint32_t i;
+
+    plan->allocator = "greedy";
+    for (i = 0; i < list->numHwLayers && i < OVL_PLAN_MAX_LAYERS; i++) {
+        hwc_layer_1_t *layer = &list->hwLayers[i];
+        IMG_native_handle_t *handle = (IMG_native_handle_t *)layer->handle;
+
+        if (plan->num_ovls < max_ovls &&
+            ovl_candidate(hwc_dev, layer) &&
+            plan->mem + mem1d(handle) <= limits.tiler1d_slot_size &&
+            /* can't have a transparent overlay in the middle of the framebuffer stack */
+            !(is_BLENDED(layer) && composed)) {
+            plan->ovl_mask |= 1U << i;
+            plan->num_ovls++;
+            plan->mem += mem1d(handle);
+        } else if (hwc_dev->use_sgx) {
+            composed = true;
+        }
+    }
+    ovl_plan_cost(hwc_dev, list, plan);
+}
+
+struct ovl_search {
+    omap_hwc_device_t *hwc_dev;
+    hwc_display_contents_1_t *list;
+    uint32_t max_ovls;
+    uint64_t composition_bw;
+    bool candidate[OVL_SEARCH_MAX_LAYERS];
+    bool mandatory[OVL_SEARCH_MAX_LAYERS];
+    uint64_t fetch_bw[OVL_SEARCH_MAX_LAYERS];
+    uint64_t compose_bw[OVL_SEARCH_MAX_LAYERS];
+    ovl_plan_t best;
+};
+
+/*
+ * Depth first over the layers, each one either goes to a pipe or is composed.
+ * A mandatory layer that can't get a pipe ends the branch.
+ */
+static void ovl_search(struct ovl_search *s, uint32_t ix, ovl_plan_t *plan, bool composed)
+{
+    hwc_layer_1_t *layer = &s->list->hwLayers[ix];
+    ovl_plan_t p;
+
+    /* no way to get cheaper than the best plan so far */
+    if (plan->cost >= s->best.cost)
+        return;
+
+    if (ix == s->list->numHwLayers) {
+        s->best = *plan;
+        return;
+    }
+
+    if (layer->compositionType == HWC_FRAMEBUFFER_TARGET) {
+        ovl_search(s, ix + 1, plan, composed);
+        return;
+    }
+
+    if (s->candidate[ix] && plan->num_ovls < s->max_ovls &&
+        plan->mem + mem1d((IMG_native_handle_t *)layer->handle) <= limits.tiler1d_slot_size &&
+        !(is_BLENDED(layer) && composed)) {
+        p = *plan;
+        p.ovl_mask |= 1U << ix;
+        p.num_ovls++;
+        p.mem += mem1d((IMG_native_handle_t *)layer->handle);
+        p.cost += s->fetch_bw[ix];
+        ovl_search(s, ix + 1, &p, composed);
+    }
+
+    if (s->mandatory[ix])
+        return;
+
+    p = *plan;
+    p.cost += s->compose_bw[ix];
+    if (!p.composition) {
+        p.composition = true;
+        p.cost += s->composition_bw;
+    }
+    ovl_search(s, ix + 1, &p, true);
+}
+
+/*
+ * Pick the plan with the least memory traffic: layers on pipes are fetched
+ * once per refresh, composed layers are fetched and written into the
+ * framebuffer, blended ones read it back as well. Starts from the greedy plan
+ * so the result is never worse than it.
+ */
+static void ovl_alloc_cost(omap_hwc_device_t *hwc_dev, hwc_display_contents_1_t *list,
+                           uint32_t max_ovls, ovl_plan_t *plan)
+{
+    struct ovl_search s;
+    ovl_plan_t start;
+    uint32_t fps = primary_fps(hwc_dev);
+    bool feasible = true;
+    uint32_t i;
+
+    ovl_alloc_greedy(hwc_dev, list, max_ovls, plan);
+    /*
+     * Without SGX every layer has to be on a pipe, there is nothing to choose.
+     * The search visits up to 2^(OVL_SEARCH_MAX_LAYERS + 1) nodes per prepare.
+     */
+    if (!hwc_dev->use_sgx || list->numHwLayers > OVL_SEARCH_MAX_LAYERS)
+        return;
+
+    memset(&s, 0, sizeof(s));
+    s.hwc_dev = hwc_dev;
+    s.list = list;
+    s.max_ovls = max_ovls;
+    s.composition_bw = composition_bw(hwc_dev, fps);
+    for (i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_1_t *layer = &list->hwLayers[i];
+
+        if (layer->compositionType == HWC_FRAMEBUFFER_TARGET)
+            continue;
+        s.candidate[i] = ovl_candidate(hwc_dev, layer);
+        s.mandatory[i] = ovl_mandatory(hwc_dev, layer);
+        s.fetch_bw[i] = s.candidate[i] ? layer_fetch_bw(hwc_dev, layer, fps) : 0;
+        s.compose_bw[i] = layer_compose_bw(hwc_dev, layer, fps);
+        /* a greedy plan composing a mandatory layer is no bound */
+        if (s.mandatory[i] && !ovl_plan_has(plan, i))
+            feasible = false;
+    }
+    s.best = *plan;
+    if (!feasible)
+        s.best.cost = UINT64_MAX;
+
+    memset(&start, 0, sizeof(start));
+    ovl_search(&s, 0, &start, false);
+
+    /* no plan keeps every mandatory layer on a pipe, stay with the greedy one */
+    if (s.best.cost == UINT64_MAX)
+        return;
+
+    *plan = s.best;
+    plan->allocator = "cost";
+}
+
+static const struct ovl_allocator ovl_allocators[] = {
+    { "cost", ovl_alloc_cost },
+    { "greedy", ovl_alloc_greedy },
+};
+
+static const struct ovl_allocator *find_ovl_allocator(const char *name)
+{
+    uint32_t i;
+
+    for (i = 0; i < sizeof(ovl_allocators) / sizeof(ovl_allocators[0]); i++) {
+        if (!strcmp(ovl_allocators[i].name, name))
+            return &ovl_allocators[i];
+    }
+    ALOGW("unknown overlay allocator %s, using %s", name, ovl_allocators[0].name);
+    return &ovl_allocators[0];
+}
+
 static int hwc_prepare(struct hwc_composer_device_1 *dev, size_t numDisplays,
         hwc_display_contents_1_t** displays)
 {
@@ -1643,6 +1927,9 @@ static int hwc_prepare(struct hwc_composer_device_1 *dev, size_t numDisplays,
     pthread_mutex_lock(&hwc_dev->lock);
     memset(dsscomp, 0x0, sizeof(*dsscomp));
     dsscomp->sync_id = sync_id++;
+    hwc_trace_prepare_start(dsscomp->sync_id);
+    if (hwc_dev->use_sw_vsync)
+        sw_vsync_kick();
 
     gather_layer_statistics(hwc_dev, list);
 
@@ -1677,7 +1964,9 @@ static int hwc_prepare(struct hwc_composer_device_1 *dev, size_t numDisplays,
 
     if (hwc_dev->blt_policy == BLTPOLICY_ALL) {
         /* Check if we can blit everything */
+        int64_t blit_start = hwc_trace_now();
         blit_all = blit_layers(hwc_dev, list, 0);
+        hwc_trace_blit(blit_start);
         if (blit_all) {
             needs_fb = 1;
             hwc_dev->use_sgx = 0;
@@ -1691,25 +1980,21 @@ static int hwc_prepare(struct hwc_composer_device_1 *dev, size_t numDisplays,
      */
     dsscomp->num_ovls = needs_fb ? 1 /*VID1*/ : 0 /*GFX*/;
 
+    /* choose the layers shown on DSS pipes */
+    ovl_plan_t *plan = &hwc_dev->ovl_plan;
+    memset(plan, 0, sizeof(*plan));
+    if (list && !blit_all && num->max_hw_overlays > dsscomp->num_ovls)
+        hwc_dev->ovl_allocator->allocate(hwc_dev, list,
+                                         num->max_hw_overlays - dsscomp->num_ovls, plan);
+
     /* set up if DSS layers */
-    uint32_t mem_used = 0;
     for (i = 0; list && i < list->numHwLayers && !blit_all; i++) {
         hwc_layer_1_t *layer = &list->hwLayers[i];
         IMG_native_handle_t *handle = (IMG_native_handle_t *)layer->handle;
 
-        if (dsscomp->num_ovls < num->max_hw_overlays &&
-            can_dss_render_layer(hwc_dev, layer) &&
-            (!hwc_dev->force_sgx ||
-             /* render protected and dockable layers via DSS */
-             is_protected(layer) ||
-             is_upscaled_NV12(hwc_dev, layer) ||
-             (hwc_dev->ext.current.docking && hwc_dev->ext.current.enabled && dockable(layer))) &&
-            mem_used + mem1d(handle) <= limits.tiler1d_slot_size &&
-            /* can't have a transparent overlay in the middle of the framebuffer stack */
-            !(is_BLENDED(layer) && fb_z >= 0)) {
+        if (dsscomp->num_ovls < num->max_hw_overlays && ovl_plan_has(plan, i)) {
 
             /* render via DSS overlay */
-            mem_used += mem1d(handle);
             layer->compositionType = HWC_OVERLAY;
             /*
              * This hint will not be used in vanilla ICS, but maybe in
@@ -1784,9 +2069,11 @@ static int hwc_prepare(struct hwc_composer_device_1 *dev, size_t numDisplays,
          * we need to reset its state.
          */
         if (hwc_dev->use_sgx) {
+            int64_t blit_start = hwc_trace_now();
             if (blit_layers(hwc_dev, list, dsscomp->num_ovls == 1 ? 0 : dsscomp->num_ovls)) {
                 hwc_dev->use_sgx = 0;
             }
+            hwc_trace_blit(blit_start);
         } else
             rgz_release(&grgz);
     }
@@ -1939,6 +2226,9 @@ static int hwc_prepare(struct hwc_composer_device_1 *dev, size_t numDisplays,
              hwc_dev->ext_ovls, num->max_hw_overlays, hwc_dev->last_ext_ovls, hwc_dev->last_int_ovls);
     }
 
+    hwc_trace_prepare_end(list ? list->numHwLayers : 0, dsscomp->num_ovls, hwc_dev->blit_num,
+                          hwc_dev->use_sgx, blit_all);
+
     pthread_mutex_unlock(&hwc_dev->lock);
     return 0;
 }
@@ -1991,6 +2281,7 @@ static int hwc_set(struct hwc_composer_device_1 *dev,
     bool invalidate;
 
     pthread_mutex_lock(&hwc_dev->lock);
+    hwc_trace_set_start();
 
     reset_screen(hwc_dev);
 
@@ -2063,16 +2354,21 @@ static int hwc_set(struct hwc_composer_device_1 *dev,
                 }
             }
         }
+
         ALOGI_IF(debugblt && hwc_dev->blt_policy != BLTPOLICY_DISABLED,
             "Post2, blits %d, ovl_buffers %d, blit_buffers %d sgx %d",
             hwc_dev->blit_num, hwc_dev->post2_layers, hwc_dev->post2_blit_buffers,
             hwc_dev->use_sgx);
 
         debug_post2(hwc_dev, nbufs);
+        hwc_trace_post_start();
         err = hwc_dev->fb_dev->Post2((framebuffer_device_t *)hwc_dev->fb_dev,
                                  hwc_dev->buffers,
                                  nbufs,
                                  dsscomp, omaplfb_comp_data_sz);
+        hwc_trace_post_end(err);
+        if (hwc_dev->use_sw_vsync && !err)
+            sw_vsync_post(systemTime(SYSTEM_TIME_MONOTONIC));
         showfps();
     }
     hwc_dev->last_ext_ovls = hwc_dev->ext_ovls;
@@ -2117,11 +2413,34 @@ static void hwc_dump(struct hwc_composer_device_1 *dev, char *buff, int buff_len
                           cfg->ix, cfg->zorder);
     }
 
+    ovl_plan_t *plan = &hwc_dev->ovl_plan;
+    if (plan->allocator)
+        dump_printf(&log, "  overlay plan (%s): layers 0x%x on %d pipes, %dKB TILER, %s, ~%lluMB/s\n",
+                          plan->allocator, plan->ovl_mask, plan->num_ovls, plan->mem >> 10,
+                          plan->composition ? "composition" : "no composition",
+                          (unsigned long long)(plan->cost >> 20));
+
     if (hwc_dev->blt_policy != BLTPOLICY_DISABLED) {
         dump_printf(&log, "  bltpolicy: %s, bltmode: %s\n",
             hwc_dev->blt_policy == BLTPOLICY_DEFAULT ? "default" :
                 hwc_dev->blt_policy == BLTPOLICY_ALL ? "all" : "unknown",
                     hwc_dev->blt_mode == BLTMODE_PAINT ? "paint" : "regionize");
+        if (hwc_dev->blt_policy == BLTPOLICY_ALL)
+            dump_printf(&log, "  blit plans: %u replayed, %u generated\n",
+                hwc_dev->blit_plan_hits, hwc_dev->blit_plan_misses);
+    }
+
+    if (hwc_trace_enabled() && log.len < log.buf_len) {
+        char path[PROPERTY_VALUE_MAX];
+        display_t *display = hwc_dev->displays[HWC_DISPLAY_PRIMARY];
+        uint32_t fps = display ? display->configs[display->active_config_ix].fps : 0;
+        int64_t period = fps ? 1000000000LL / fps : 0;
+
+        log.len += hwc_trace_dump(log.buf + log.len, log.buf_len - log.len, HWC_TRACE_DUMP_FRAMES, period);
+
+        /* full ring for offline analysis */
+        if (property_get("debug.hwc.trace_file", path, "") > 0)
+            hwc_trace_export(path);
     }
     dump_printf(&log, "\n");
 }
@@ -2142,6 +2461,10 @@ static int hwc_device_close(hw_device_t* device)
 
         /* pthread will get killed when parent process exits */
         pthread_mutex_destroy(&hwc_dev->lock);
+        rgz_free(&grgz);
+#ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
+        rgz_ext_layer_list_free(&grgz_ext_layer_list);
+#endif
         free_displays(hwc_dev);
         free(hwc_dev);
     }
@@ -2376,6 +2699,7 @@ static void handle_uevents(omap_hwc_device_t *hwc_dev, const char *buff, int len
     }
 
     if (vsync) {
+        hwc_trace_vsync(timestamp);
         if (hwc_dev->procs)
             hwc_dev->procs->vsync(hwc_dev->procs, 0, timestamp);
     } else {
@@ -2678,6 +3002,8 @@ static int hwc_device_open(const hw_module_t* module, const char* name, hw_devic
     hwc_dev->flags_nv12_only = atoi(value);
     property_get("debug.hwc.idle", value, "250");
     hwc_dev->idle = atoi(value);
+    property_get("debug.hwc.trace", value, "0");
+    hwc_trace_init(atoi(value) > 0);
 
     /* get the board specific clone properties */
     /* 0:0:1280:720 */
@@ -2733,6 +3059,9 @@ static int hwc_device_open(const hw_module_t* module, const char* name, hw_devic
         }
     }
 
+    property_get("persist.hwc.ovl_allocator", value, "cost");
+    hwc_dev->ovl_allocator = find_ovl_allocator(value);
+
     property_get("persist.hwc.upscaled_nv12_limit", value, "2.");
     sscanf(value, "%f", &hwc_dev->upscaled_nv12_limit);
     if (hwc_dev->upscaled_nv12_limit < 0. || hwc_dev->upscaled_nv12_limit > 2048.) {
@@ -115,6 +115,17 @@ struct counts {
 };
 typedef struct counts counts_t;
 
+/* Layers of the primary display shown on DSS pipes, chosen by an overlay allocator */
+struct ovl_plan {
+    const char *allocator;
+    uint32_t ovl_mask;                  /* layers on DSS pipes, the rest is composed */
+    uint32_t num_ovls;
+    uint32_t mem;                       /* TILER 1D memory used by the overlays */
+    uint64_t cost;                      /* estimated memory traffic in bytes/s */
+    bool composition;                   /* some layers are composed into the framebuffer */
+};
+typedef struct ovl_plan ovl_plan_t;
+
 struct omap_hwc_device {
     /* static data */
     hwc_composer_device_1_t base;
@@ -161,8 +172,13 @@ struct omap_hwc_device {
     enum bltmode blt_mode;
     enum bltpolicy blt_policy;
 
+    const struct ovl_allocator *ovl_allocator;
+    ovl_plan_t ovl_plan;         /* overlay plan of the last composition */
+
     uint32_t blit_flags;
     int blit_num;
+    uint32_t blit_plan_hits;     /* frames whose blits were replayed from the plan cache */
+    uint32_t blit_plan_misses;
     struct omap_hwc_data comp_data; /* This is a kernel data structure */
     struct rgz_blt_entry blit_ops[RGZ_MAX_BLITS];
 
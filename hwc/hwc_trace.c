@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <cutils/atomic.h>
+#include <cutils/log.h>
+#include <utils/Timers.h>
+
+#include "hwc_trace.h"
+
+#define TRACE_MASK (HWC_TRACE_FRAMES - 1)
+#define NS_TO_US(t) ((int)((t) / 1000))
+
+static bool trace_enabled;
+static hwc_trace_frame_t ring[HWC_TRACE_FRAMES];
+static volatile int32_t last_seq;   /* frame started by the latest prepare */
+static volatile int32_t posted_seq; /* latest frame handed to Post2 */
+
+void hwc_trace_init(bool enabled)
+{
+    trace_enabled = enabled;
+    ALOGI_IF(enabled, "composition trace of %d frames enabled", HWC_TRACE_FRAMES);
+}
+
+bool hwc_trace_enabled(void)
+{
+    return trace_enabled;
+}
+
+int64_t hwc_trace_now(void)
+{
+    return trace_enabled ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+}
+
+/* Record of the frame being composed, prepare and set are serialized by the caller */
+static hwc_trace_frame_t *current_frame(void)
+{
+    int32_t seq = last_seq;
+    hwc_trace_frame_t *f = &ring[seq & TRACE_MASK];
+
+    return trace_enabled && seq && f->seq == seq ? f : NULL;
+}
+
+void hwc_trace_prepare_start(int sync_id)
+{
+    hwc_trace_frame_t *f;
+    int32_t seq;
+
+    if (!trace_enabled)
+        return;
+
+    /* 0 marks a record in use, skip it when wrapping around */
+    seq = last_seq + 1;
+    if (!seq)
+        seq = 1;
+    f = &ring[seq & TRACE_MASK];
+
+    android_atomic_release_store(0, &f->seq);
+    memset((void *)f, 0, sizeof(*f));
+    f->sync_id = sync_id;
+    f->prepare_start = systemTime(SYSTEM_TIME_MONOTONIC);
+    android_atomic_release_store(seq, &f->seq);
+    android_atomic_release_store(seq, &last_seq);
+}
+
+void hwc_trace_prepare_end(uint32_t layers, uint32_t ovls, uint32_t blits, bool sgx, bool blit_all)
+{
+    hwc_trace_frame_t *f = current_frame();
+
+    if (!f)
+        return;
+    f->layers = layers;
+    f->ovls = ovls;
+    f->blits = blits;
+    f->sgx = sgx;
+    f->blit_all = blit_all;
+    f->prepare_end = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void hwc_trace_blit(int64_t start)
+{
+    hwc_trace_frame_t *f = current_frame();
+
+    /* blit_layers() may run twice per frame */
+    if (f && start)
+        f->blit_time += systemTime(SYSTEM_TIME_MONOTONIC) - start;
+}
+
+void hwc_trace_set_start(void)
+{
+    hwc_trace_frame_t *f = current_frame();
+
+    if (f)
+        f->set_start = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void hwc_trace_post_start(void)
+{
+    hwc_trace_frame_t *f = current_frame();
+
+    if (f)
+        f->post_start = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void hwc_trace_post_end(int err)
+{
+    hwc_trace_frame_t *f = current_frame();
+
+    if (!f)
+        return;
+    f->err = err;
+    f->post_end = systemTime(SYSTEM_TIME_MONOTONIC);
+    android_atomic_release_store(f->seq, &posted_seq);
+}
+
+/*
+ * Called from the uevent or the s/w vsync thread. The vsync is charged to the
+ * latest posted frame unless that one already has its vsync, or the vsync
+ * happened before the frame was posted.
+ */
+void hwc_trace_vsync(int64_t timestamp)
+{
+    int32_t seq;
+    hwc_trace_frame_t *f;
+
+    if (!trace_enabled)
+        return;
+
+    seq = android_atomic_acquire_load(&posted_seq);
+    if (!seq)
+        return;
+    f = &ring[seq & TRACE_MASK];
+    if (android_atomic_acquire_load(&f->seq) != seq || timestamp < f->post_start)
+        return;
+    if (android_atomic_cmpxchg(0, 1, &f->vsync_claimed))
+        return;
+    f->vsync = timestamp;
+}
+
+int hwc_trace_snapshot(hwc_trace_frame_t *frames, int max)
+{
+    int32_t seq = android_atomic_acquire_load(&last_seq);
+    int i, n = 0;
+
+    if (!trace_enabled || !seq)
+        return 0;
+    if (max > HWC_TRACE_FRAMES)
+        max = HWC_TRACE_FRAMES;
+
+    for (i = max - 1; i >= 0; i--) {
+        int32_t s = seq - i;
+        hwc_trace_frame_t *f = &ring[s & TRACE_MASK];
+
+        if (s <= 0 || android_atomic_acquire_load(&f->seq) != s)
+            continue;
+        memcpy(&frames[n], (const void *)f, sizeof(*f));
+        /* the record was reused while copying it */
+        if (android_atomic_acquire_load(&f->seq) != s)
+            continue;
+        n++;
+    }
+    return n;
+}
+
+/* The stage that took the longest in a frame */
+static const char *slowest_stage(hwc_trace_frame_t *f)
+{
+    int64_t prepare = f->prepare_end - f->prepare_start - f->blit_time;
+    int64_t blit = f->blit_time;
+    int64_t client = f->set_start - f->prepare_end;    /* SurfaceFlinger/GL between prepare and set */
+    int64_t post = f->post_end - f->set_start;
+
+    if (!f->post_end)
+        return "set";
+    if (blit >= prepare && blit >= client && blit >= post)
+        return "blit";
+    if (prepare >= client && prepare >= post)
+        return "prepare";
+    return client >= post ? "client" : "post";
+}
+
+int hwc_trace_dump(char *buf, int buf_len, int frames, int64_t period)
+{
+    hwc_trace_frame_t snap[HWC_TRACE_FRAMES];
+    int i, n, len = 0, late = 0;
+
+    n = hwc_trace_snapshot(snap, frames);
+    if (!n || buf_len <= 0)
+        return 0;
+
+#define TRACE_PRINTF(...) \
+    do { \
+        if (len < buf_len) \
+            len += snprintf(buf + len, buf_len - len, __VA_ARGS__); \
+    } while (0)
+
+    TRACE_PRINTF("  composition trace (us):\n");
+    TRACE_PRINTF("     sync_id  prepare     blit   client     post  ->vsync  ovls blits sgx\n");
+    for (i = 0; i < n; i++) {
+        hwc_trace_frame_t *f = &snap[i];
+        hwc_trace_frame_t *prev = i ? &snap[i - 1] : NULL;
+        bool missed = false;
+
+        /*
+         * A frame missed its vsync if it was started in time for the one
+         * after the previous frame's vsync but was shown one or more
+         * periods later.
+         */
+        if (prev && prev->vsync && f->vsync && period &&
+            f->vsync - prev->vsync > period * 3 / 2 &&
+            f->prepare_start < prev->vsync + period) {
+            missed = true;
+            late++;
+        }
+
+        TRACE_PRINTF("    %8d %8d %8d %8d %8d %8d %5d %5d %3s%s%s%s%s\n",
+            f->sync_id,
+            NS_TO_US(f->prepare_end - f->prepare_start),
+            NS_TO_US(f->blit_time),
+            f->set_start ? NS_TO_US(f->set_start - f->prepare_end) : -1,
+            f->post_end ? NS_TO_US(f->post_end - f->set_start) : -1,
+            f->vsync ? NS_TO_US(f->vsync - f->post_end) : -1,
+            f->ovls, f->blits, f->sgx ? "yes" : "no",
+            f->blit_all ? " blit_all" : "",
+            f->err ? " err" : "",
+            missed ? " late:" : "",
+            missed ? slowest_stage(f) : "");
+    }
+    TRACE_PRINTF("     %d of %d frames missed their vsync\n", late, n);
+#undef TRACE_PRINTF
+
+    return len < buf_len ? len : buf_len - 1;
+}
+
+int hwc_trace_export(const char *path)
+{
+    hwc_trace_frame_t snap[HWC_TRACE_FRAMES];
+    int i, n;
+    FILE *fp;
+
+    n = hwc_trace_snapshot(snap, HWC_TRACE_FRAMES);
+    fp = fopen(path, "w");
+    if (!fp) {
+        ALOGE("failed to open %s for the trace export: %m", path);
+        return -errno;
+    }
+
+    fprintf(fp, "seq,sync_id,prepare_start,prepare_end,blit_time,set_start,post_start,post_end,vsync,"
+                "layers,ovls,blits,sgx,blit_all,err\n");
+    for (i = 0; i < n; i++) {
+        hwc_trace_frame_t *f = &snap[i];
+
+        fprintf(fp, "%d,%d,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%u,%u,%u,%u,%u,%d\n",
+                f->seq, f->sync_id,
+                (long long)f->prepare_start, (long long)f->prepare_end, (long long)f->blit_time,
+                (long long)f->set_start, (long long)f->post_start, (long long)f->post_end,
+                (long long)f->vsync,
+                f->layers, f->ovls, f->blits, f->sgx, f->blit_all, f->err);
+    }
+    fclose(fp);
+    return n;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HWC_TRACE_H__
+#define __HWC_TRACE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Per-frame composition timeline
+ *
+ * Every prepare starts a frame record in a ring, the following stages of the
+ * frame (blits, set, the Post2 ioctl and the first vsync after it) stamp
+ * their times into it. Writers never block: prepare and set already run under
+ * the device lock, the vsync paths only claim the vsync slot of the last posted
+ * frame with a compare-and-swap. Readers copy records and drop those that were
+ * reused meanwhile.
+ */
+#define HWC_TRACE_FRAMES 256        /* power of 2 */
+
+struct hwc_trace_frame {
+    volatile int32_t seq;           /* 0 while the record is being reused */
+    int32_t sync_id;                /* dsscomp sync id of the frame */
+
+    int64_t prepare_start;
+    int64_t prepare_end;
+    int64_t blit_time;              /* time spent in blit_layers() */
+    int64_t set_start;
+    int64_t post_start;
+    int64_t post_end;
+    volatile int32_t vsync_claimed;
+    int64_t vsync;                  /* first vsync after the post */
+
+    /* composition decision */
+    uint16_t layers;
+    uint16_t ovls;                  /* DSS pipes incl. the framebuffer */
+    uint16_t blits;
+    uint8_t sgx;
+    uint8_t blit_all;
+    int32_t err;                    /* Post2 result */
+};
+typedef struct hwc_trace_frame hwc_trace_frame_t;
+
+void hwc_trace_init(bool enabled);
+bool hwc_trace_enabled(void);
+
+void hwc_trace_prepare_start(int sync_id);
+void hwc_trace_prepare_end(uint32_t layers, uint32_t ovls, uint32_t blits, bool sgx, bool blit_all);
+int64_t hwc_trace_now(void);         /* 0 while tracing is disabled */
+void hwc_trace_blit(int64_t start);
+void hwc_trace_set_start(void);
+void hwc_trace_post_start(void);
+void hwc_trace_post_end(int err);
+void hwc_trace_vsync(int64_t timestamp);
+
+/* Copies out up to max of the latest frames, oldest first */
+int hwc_trace_snapshot(hwc_trace_frame_t *frames, int max);
+/* Human readable timeline of the latest frames, returns the length written */
+int hwc_trace_dump(char *buf, int buf_len, int frames, int64_t period);
+/* One CSV line per frame in the ring */
+int hwc_trace_export(const char *path);
+
+#endif
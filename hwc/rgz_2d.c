@@ -93,6 +93,33 @@ struct rgz_blts blts;
 /* Represents a screen sized background layer */
 static hwc_layer_1_t bg_layer;
 
+/*
+ * Grow a pooled array to hold at least n entries, the contents are preserved.
+ * Pools never shrink, steady state compositions don't allocate memory.
+ */
+static int rgz_pool_reserve(void **array, int *size, int n, size_t entsz)
+{
+    void *p;
+    int newsz;
+
+    if (n <= *size)
+        return 0;
+    newsz = max(n, *size * 2);
+    p = realloc(*array, newsz * entsz);
+    if (!p) {
+        OUTE("Unable to grow regionizer pool to %d entries", newsz);
+        return -1;
+    }
+    /* Entries past the old size start zeroed like the fixed tables did */
+    bzero((char *)p + *size * entsz, (newsz - *size) * entsz);
+    *array = p;
+    *size = newsz;
+    return 0;
+}
+
+#define RGZ_POOL_RESERVE(array, size, n) \
+    rgz_pool_reserve((void **)&(array), &(size), (n), sizeof(*(array)))
+
 static void svgout_header(int htmlw, int htmlh, int coordw, int coordh)
 {
     OUTP("<svg xmlns=\"http://www.w3.org/2000/svg\""
@@ -129,7 +156,7 @@ static int get_top_rect(blit_hregion_t *hregion, int subregion, blit_rect_t **ro
 {
     int l = hregion->nlayers - 1;
     do {
-        *routp = &hregion->blitrects[l][subregion];
+        *routp = RGZ_BLITRECT(hregion, l, subregion);
         if (!empty_rect(*routp))
             break;
     }
@@ -148,7 +175,7 @@ static int get_layer_ops(blit_hregion_t *hregion, int subregion, int *bottom)
     int ops = 0;
     *bottom = -1;
     do {
-        if (!empty_rect(&hregion->blitrects[l][subregion])) {
+        if (!empty_rect(RGZ_BLITRECT(hregion, l, subregion))) {
             ops++;
             *bottom = l;
             hwc_layer_1_t *layer = &hregion->rgz_layers[l]->hwc_layer;
@@ -164,7 +191,7 @@ static int get_layer_ops(blit_hregion_t *hregion, int subregion, int *bottom)
 static int get_layer_ops_next(blit_hregion_t *hregion, int subregion, int l)
 {
     while (++l < hregion->nlayers) {
-        if (!empty_rect(&hregion->blitrects[l][subregion]))
+        if (!empty_rect(RGZ_BLITRECT(hregion, l, subregion)))
             return l;
     }
     return -1;
@@ -738,11 +765,16 @@ static int rgz_out_bvcmd_paint(rgz_t *rgz, rgz_out_params_t *params)
     int i, j;
     params->data.bvc.out_blits = 0;
     params->data.bvc.out_nhndls = 0;
+
+    rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
+    if (RGZ_POOL_RESERVE(rgz->pool.hndls, rgz->pool.hndlsz, cur_fb_state->rgz_layerno))
+        return -1;
+    params->data.bvc.out_hndls = rgz->pool.hndls;
+
     rgz_blts_init(&blts);
     rgz_out_clrdst(params, NULL);
 
     /* Begin from index 1 to remove the background layer from the output */
-    rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
     for (i = 1, j = 0; i < cur_fb_state->rgz_layerno; i++) {
         rgz_layer_t *rgz_layer = &cur_fb_state->rgz_layers[i];
         hwc_layer_1_t *l = &rgz_layer->hwc_layer;
@@ -813,48 +845,71 @@ static float getscaleh(hwc_layer_1_t *layer)
     return ((float)HEIGHT(layer->displayFrame)) / (float)h;
 }
 
+static int rgz_cmp_edge(const void *a, const void *b)
+{
+    int ea = *(const int *)a;
+    int eb = *(const int *)b;
+    return (ea > eb) - (ea < eb);
+}
+
 /*
- * Simple bubble sort on an array, ascending order
+ * Sort an array of edges in ascending order and leave only unique values,
+ * returns the number of unique edges
  */
-static void rgz_bsort(int *a, int len)
+static int rgz_sort_edges(int *a, int len)
 {
-    int i, j;
-    for (i = 0; i < len; i++) {
-        for (j = 0; j < i; j++) {
-            if (a[i] < a[j]) {
-                int temp = a[i];
-                a[i] = a[j];
-                a[j] = temp;
-            }
-        }
+    int i, unique = 0;
+    if (len <= 0)
+        return 0;
+    qsort(a, len, sizeof(*a), rgz_cmp_edge);
+    for (i = 1; i < len; i++) {
+        if (a[i] != a[unique])
+            a[++unique] = a[i];
     }
+    return unique + 1;
+}
+
+/* Index of the first edge in a sorted array which is greater than value */
+static int rgz_edge_upper(int *a, int len, int value)
+{
+    int lo = 0, hi = len;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (a[mid] > value)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+/* Index of the first edge in a sorted array which is not less than value */
+static int rgz_edge_lower(int *a, int len, int value)
+{
+    int lo = 0, hi = len;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (a[mid] >= value)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
 }
 
 /*
- * Leave only unique numbers in a sorted array
+ * Find the range of intervals [a[i], a[i+1]) overlapping the span
+ * [start, end). Returns 0 if the span doesn't overlap any interval.
  */
-static int rgz_bunique(int *a, int len)
-{
-    int unique = 1;
-    int base = 0;
-    while (base + 1 < len) {
-        if (a[base] == a[base + 1]) {
-            int skip = 1;
-            while (base + skip < len && a[base] == a[base + skip])
-                skip++;
-            if (base + skip == len)
-                break;
-            int i;
-            for (i = 0; i < skip - 1; i++)
-                a[base + 1 + i] = a[base + skip];
-        }
-        unique++;
-        base++;
-    }
-    return unique;
+static int rgz_edge_span(int *a, int len, int start, int end, int *first, int *last)
+{
+    *first = max(0, rgz_edge_upper(a, len, start) - 1);
+    *last = min(len - 2, rgz_edge_lower(a, len, end) - 1);
+    return *first <= *last;
 }
 
-static void rgz_gen_blitregions(rgz_t *rgz, blit_hregion_t *hregion, int screen_width)
+static void rgz_gen_blitregions(rgz_t *rgz, blit_hregion_t *hregion, int *offsets,
+    int screen_width)
 {
 /*
  * 1. Get the offsets (left/right positions) of each layer within the
@@ -864,13 +919,12 @@ static void rgz_gen_blitregions(rgz_t *rgz, blit_hregion_t *hregion, int screen_
  *    find the intersection. Some intersections will be empty.
  */
 
-    int offsets[RGZ_SUBREGIONMAX];
     int noffsets=0;
     int l, r;
 
     /*
-     * Add damaged region, then all layers. We are guaranteed to not go outside
-     * of offsets array boundaries at this point.
+     * Add damaged region, then all layers. The offsets array is sized for all
+     * the input layers plus the damaged region.
      */
     offsets[noffsets++] = rgz->damaged_area.left;
     offsets[noffsets++] = rgz->damaged_area.right;
@@ -881,31 +935,31 @@ static void rgz_gen_blitregions(rgz_t *rgz, blit_hregion_t *hregion, int screen_
         offsets[noffsets++] = max(0, layer->displayFrame.left);
         offsets[noffsets++] = min(layer->displayFrame.right, screen_width);
     }
-    rgz_bsort(offsets, noffsets);
-    noffsets = rgz_bunique(offsets, noffsets);
+    noffsets = rgz_sort_edges(offsets, noffsets);
     hregion->nsubregions = noffsets - 1;
-    bzero(hregion->blitrects, sizeof(hregion->blitrects));
-    for (r = 0; r + 1 < noffsets; r++) {
-        blit_rect_t subregion;
-        subregion.top = hregion->rect.top;
-        subregion.bottom = hregion->rect.bottom;
-        subregion.left = offsets[r];
-        subregion.right = offsets[r+1];
-
-        ALOGD_IF(debug, "                sub l %d r %d",
-            subregion.left, subregion.right);
-        for (l = 0; l < hregion->nlayers; l++) {
-            hwc_layer_1_t *layer = &hregion->rgz_layers[l]->hwc_layer;
-            if (RECT_INTERSECTS(subregion, layer->displayFrame)) {
+    bzero(hregion->blitrects,
+        sizeof(blit_rect_t) * hregion->nlayers * hregion->nsubregions);
 
-                hregion->blitrects[l][r] = subregion;
-
-                ALOGD_IF(debug, "hregion->blitrects[%d][%d] (%d %d %d %d)", l, r,
-                        hregion->blitrects[l][r].left,
-                        hregion->blitrects[l][r].top,
-                        hregion->blitrects[l][r].right,
-                        hregion->blitrects[l][r].bottom);
-            }
+    /*
+     * Every layer in the hregion spans it vertically, so a layer intersects
+     * exactly the run of subregions between its left and right edges
+     */
+    for (l = 0; l < hregion->nlayers; l++) {
+        hwc_layer_1_t *layer = &hregion->rgz_layers[l]->hwc_layer;
+        int first, last;
+        if (!rgz_edge_span(offsets, noffsets, layer->displayFrame.left,
+                layer->displayFrame.right, &first, &last))
+            continue;
+        for (r = first; r <= last; r++) {
+            blit_rect_t *subregion = RGZ_BLITRECT(hregion, l, r);
+            subregion->top = hregion->rect.top;
+            subregion->bottom = hregion->rect.bottom;
+            subregion->left = offsets[r];
+            subregion->right = offsets[r+1];
+
+            ALOGD_IF(debug, "hregion->blitrects[%d][%d] (%d %d %d %d)", l, r,
+                    subregion->left, subregion->top,
+                    subregion->right, subregion->bottom);
         }
     }
 }
@@ -955,17 +1009,51 @@ static int rgz_in_valid_hwc_layer(hwc_layer_1_t *layer)
     return 1;
 }
 
-/* Reset dirty region data and state */
+/* Reset dirty region data and state, the pooled storage is kept */
 static void rgz_delete_region_data(rgz_t *rgz){
     if (!rgz)
         return;
-    if (rgz->hregions)
-        free(rgz->hregions);
-    rgz->hregions = NULL;
     rgz->nhregions = 0;
     rgz->state &= ~RGZ_REGION_DATA;
 }
 
+/* Make sure a framebuffer state can store at least n layers */
+static int rgz_fb_state_reserve(rgz_t *rgz, rgz_fb_state_t *fb_state, int n)
+{
+    rgz_layer_t *prev_layers = fb_state->rgz_layers;
+
+    if (RGZ_POOL_RESERVE(fb_state->rgz_layers, fb_state->rgz_layersz, n))
+        return -1;
+
+    /* The region data points into the current state, drop it if it moved */
+    if (fb_state == &rgz->cur_fb_state && prev_layers != fb_state->rgz_layers)
+        rgz_delete_region_data(rgz);
+    return 0;
+}
+
+static void rgz_fb_state_free(rgz_fb_state_t *fb_state)
+{
+    free(fb_state->rgz_layers);
+    bzero(fb_state, sizeof(*fb_state));
+}
+
+/* Reset the regionizer to its initial state keeping the storage it owns */
+static void rgz_reset(rgz_t *rgz)
+{
+    rgz_t prev = *rgz;
+    int i;
+
+    bzero(rgz, sizeof(*rgz));
+    rgz->pool = prev.pool;
+    rgz->plan_cache = prev.plan_cache;
+    rgz->cur_fb_state.rgz_layers = prev.cur_fb_state.rgz_layers;
+    rgz->cur_fb_state.rgz_layersz = prev.cur_fb_state.rgz_layersz;
+    for (i = 0; i < RGZ_NUM_FB; i++) {
+        rgz->fb_states[i].rgz_layers = prev.fb_states[i].rgz_layers;
+        rgz->fb_states[i].rgz_layersz = prev.fb_states[i].rgz_layersz;
+    }
+}
+
 static rgz_fb_state_t* get_prev_fb_state(rgz_t *rgz)
 {
     return &rgz->fb_states[rgz->fb_state_idx];
@@ -1215,13 +1303,14 @@ static int rgz_in_hwccheck(rgz_in_params_t *p, rgz_t *rgz)
      * state for dirty region handling
      */
     rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
+    if (rgz_fb_state_reserve(rgz, cur_fb_state, layerno + 1))
+        return -1;
     rgz_add_background_layer(cur_fb_state);
 
     for (l = 0; l < layerno; l++) {
         if (layers[l].compositionType == HWC_FRAMEBUFFER) {
             candidates++;
-            if (rgz_in_valid_hwc_layer(&layers[l]) &&
-                    possible_blit < RGZ_INPUT_MAXLAYERS) {
+            if (rgz_in_valid_hwc_layer(&layers[l])) {
                 rgz_layer_t *rgz_layer = &cur_fb_state->rgz_layers[possible_blit+1];
                 rgz_layer->hwc_layer = layers[l];
 #ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
@@ -1235,21 +1324,19 @@ static int rgz_in_hwccheck(rgz_in_params_t *p, rgz_t *rgz)
 
         if (layers[l].hints & HWC_HINT_CLEAR_FB) {
             candidates++;
-            if (possible_blit < RGZ_INPUT_MAXLAYERS) {
-                /*
-                 * Use only the layer rectangle as an input to regionize when the clear
-                 * fb hint is present, mark this layer to identify it.
-                 */
-                rgz_layer_t *rgz_layer = &cur_fb_state->rgz_layers[possible_blit+1];
-                rgz_layer->hwc_layer = layers[l];
+            /*
+             * Use only the layer rectangle as an input to regionize when the clear
+             * fb hint is present, mark this layer to identify it.
+             */
+            rgz_layer_t *rgz_layer = &cur_fb_state->rgz_layers[possible_blit+1];
+            rgz_layer->hwc_layer = layers[l];
 #ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
-                rgz_layer->identity = extlayers[l].identity;
+            rgz_layer->identity = extlayers[l].identity;
 #endif
-                rgz_layer->buffidx = RGZ_CLEARHINT_BUFFIDX;
-                /* Set dummy handle to maintain dirty region state */
-                rgz_layer->hwc_layer.handle = (void*) 0x1;
-                possible_blit++;
-            }
+            rgz_layer->buffidx = RGZ_CLEARHINT_BUFFIDX;
+            /* Set dummy handle to maintain dirty region state */
+            rgz_layer->hwc_layer.handle = (void*) 0x1;
+            possible_blit++;
         }
     }
 
@@ -1268,20 +1355,79 @@ static int rgz_in_hwccheck(rgz_in_params_t *p, rgz_t *rgz)
     rgz_handle_dirty_region(rgz, p, prev_fb_state, target_fb_state);
 
     /* Copy the current geometry to use it in the next frame */
+    if (rgz_fb_state_reserve(rgz, target_fb_state, cur_fb_state->rgz_layerno)) {
+        target_fb_state->rgz_layerno = 0;
+        return -1;
+    }
     memcpy(target_fb_state->rgz_layers, cur_fb_state->rgz_layers, sizeof(rgz_layer_t) * cur_fb_state->rgz_layerno);
     target_fb_state->rgz_layerno = cur_fb_state->rgz_layerno;
 
     return RGZ_ALL;
 }
 
+/* Check if the hregions were generated from the geometry of the current frame */
+static int rgz_geom_key_matches(rgz_in_params_t *p, rgz_t *rgz)
+{
+    rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
+    rgz_geom_key_t *key = &rgz->geom_key;
+    int i;
+
+    if (key->screen_width != (int)p->data.hwc.dstgeom->width ||
+        key->screen_height != (int)p->data.hwc.dstgeom->height ||
+        key->rgz_layerno != cur_fb_state->rgz_layerno ||
+        memcmp(&key->damaged_area, &rgz->damaged_area, sizeof(key->damaged_area)))
+        return 0;
+
+    for (i = 0; i < cur_fb_state->rgz_layerno; i++) {
+        if (memcmp(&key->frames[i], &cur_fb_state->rgz_layers[i].hwc_layer.displayFrame,
+                sizeof(hwc_rect_t)))
+            return 0;
+    }
+    return 1;
+}
+
+/* Remember the geometry the hregions of the current frame depend on */
+static int rgz_set_geom_key(rgz_in_params_t *p, rgz_t *rgz)
+{
+    rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
+    rgz_geom_key_t *key = &rgz->geom_key;
+    int i;
+
+    if (RGZ_POOL_RESERVE(rgz->pool.frames, rgz->pool.framesz, cur_fb_state->rgz_layerno))
+        return -1;
+
+    key->screen_width = p->data.hwc.dstgeom->width;
+    key->screen_height = p->data.hwc.dstgeom->height;
+    key->rgz_layerno = cur_fb_state->rgz_layerno;
+    key->damaged_area = rgz->damaged_area;
+    key->frames = rgz->pool.frames;
+    for (i = 0; i < cur_fb_state->rgz_layerno; i++)
+        key->frames[i] = cur_fb_state->rgz_layers[i].hwc_layer.displayFrame;
+    return 0;
+}
+
+/*
+ * Find the run of hregions a layer spans. The layer must overlap the hregions
+ * horizontally as well, these all share the same left and right bounds.
+ */
+static int rgz_layer_hregion_span(hwc_layer_1_t *layer, int *yentries, int ylen,
+    int hregion_right, int *first, int *last)
+{
+    if (layer->displayFrame.right <= 0 || layer->displayFrame.left >= hregion_right)
+        return 0;
+    return rgz_edge_span(yentries, ylen, layer->displayFrame.top,
+        layer->displayFrame.bottom, first, last);
+}
+
 static int rgz_in_hwc(rgz_in_params_t *p, rgz_t *rgz)
 {
     int i, j;
-    int yentries[RGZ_SUBREGIONMAX];
+    int *yentries;
     int dispw;  /* widest layer */
     int screen_width = p->data.hwc.dstgeom->width;
     int screen_height = p->data.hwc.dstgeom->height;
     rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
+    rgz_pool_t *pool = &rgz->pool;
 
     if (!(rgz->state & RGZ_STATE_INIT)) {
         OUTE("rgz_process started with bad state");
@@ -1289,18 +1435,24 @@ static int rgz_in_hwc(rgz_in_params_t *p, rgz_t *rgz)
     }
 
     /*
-     * Figure out if there is enough space to store the top-bottom coordinates
-     * of each layer including the damaged area
+     * The hregions only reference layers by their position in the current
+     * framebuffer state, if no layer moved and the damaged area is the same
+     * the previous region data is still valid.
      */
-    if (((cur_fb_state->rgz_layerno + 1) * 2) > RGZ_SUBREGIONMAX) {
-        OUTE("%s: Not enough space to store top-bottom coordinates of each layer (max %d, needed %d*2)",
-            __func__, RGZ_SUBREGIONMAX, cur_fb_state->rgz_layerno + 1);
-        return -1;
+    if ((rgz->state & RGZ_REGION_DATA) && rgz_geom_key_matches(p, rgz)) {
+        ALOGD_IF(debug, "Reusing %d hregions, layerno = %d", rgz->nhregions,
+            cur_fb_state->rgz_layerno);
+        return 0;
     }
 
     /* Delete the previous region data */
     rgz_delete_region_data(rgz);
 
+    /* Make room for the top-bottom coordinates of each layer and the damaged area */
+    if (RGZ_POOL_RESERVE(pool->edges, pool->edgesz, (cur_fb_state->rgz_layerno + 1) * 2))
+        return -1;
+    yentries = pool->edges;
+
     /*
      * Find the horizontal regions, add damaged area first which is already
      * inside display boundaries
@@ -1318,47 +1470,85 @@ static int rgz_in_hwc(rgz_in_params_t *p, rgz_t *rgz)
         yentries[ylen++] = min(layer->displayFrame.bottom, screen_height);
         dispw = dispw > layer->displayFrame.right ? dispw : layer->displayFrame.right;
     }
-    rgz_bsort(yentries, ylen);
-    ylen = rgz_bunique(yentries, ylen);
+    ylen = rgz_sort_edges(yentries, ylen);
 
     /* at this point we have an array of horizontal regions */
-    rgz->nhregions = ylen - 1;
-
-    blit_hregion_t *hregions = calloc(rgz->nhregions, sizeof(blit_hregion_t));
-    if (!hregions) {
-        OUTE("Unable to allocate memory for hregions");
+    int nhregions = ylen - 1;
+    if (RGZ_POOL_RESERVE(pool->hregions, pool->hregionsz, nhregions))
         return -1;
-    }
+    blit_hregion_t *hregions = pool->hregions;
     rgz->hregions = hregions;
 
-    ALOGD_IF(debug, "Allocated %d regions (sz = %d), layerno = %d", rgz->nhregions,
-        rgz->nhregions * sizeof(blit_hregion_t), cur_fb_state->rgz_layerno);
-
-    for (i = 0; i < rgz->nhregions; i++) {
+    /* Avoid hregions outside the display boundaries */
+    int hregion_right = dispw > screen_width ? screen_width : dispw;
+    for (i = 0; i < nhregions; i++) {
         hregions[i].rect.top = yentries[i];
         hregions[i].rect.bottom = yentries[i+1];
-        /* Avoid hregions outside the display boundaries */
         hregions[i].rect.left = 0;
-        hregions[i].rect.right = dispw > screen_width ? screen_width : dispw;
+        hregions[i].rect.right = hregion_right;
         hregions[i].nlayers = 0;
-        for (j = 0; j < cur_fb_state->rgz_layerno; j++) {
-            hwc_layer_1_t *layer = &cur_fb_state->rgz_layers[j].hwc_layer;
-            if (RECT_INTERSECTS(hregions[i].rect, layer->displayFrame)) {
-                int l = hregions[i].nlayers++;
-                hregions[i].rgz_layers[l] = &cur_fb_state->rgz_layers[j];
-            }
+    }
+
+    /*
+     * Sweep the layers in z-order and append each one to the run of hregions
+     * it spans vertically, this keeps the layers of every hregion sorted by
+     * z-order without testing each layer against each hregion. The first pass
+     * only counts the layers to size the hregion tables.
+     */
+    for (j = 0; j < cur_fb_state->rgz_layerno; j++) {
+        hwc_layer_1_t *layer = &cur_fb_state->rgz_layers[j].hwc_layer;
+        int first, last;
+        if (!rgz_layer_hregion_span(layer, yentries, ylen, hregion_right, &first, &last))
+            continue;
+        for (i = first; i <= last; i++)
+            hregions[i].nlayers++;
+    }
+
+    /* A hregion with n layers has at most 2n+1 subregions, see rgz_gen_blitregions */
+    int nlayers = 0, nrects = 0;
+    for (i = 0; i < nhregions; i++) {
+        nlayers += hregions[i].nlayers;
+        nrects += hregions[i].nlayers * (hregions[i].nlayers * 2 + 1);
+    }
+    if (RGZ_POOL_RESERVE(pool->layers, pool->layersz, nlayers) ||
+        RGZ_POOL_RESERVE(pool->rects, pool->rectsz, nrects))
+        return -1;
+
+    nlayers = nrects = 0;
+    for (i = 0; i < nhregions; i++) {
+        hregions[i].rgz_layers = &pool->layers[nlayers];
+        hregions[i].blitrects = &pool->rects[nrects];
+        nlayers += hregions[i].nlayers;
+        nrects += hregions[i].nlayers * (hregions[i].nlayers * 2 + 1);
+        hregions[i].nlayers = 0;
+    }
+
+    for (j = 0; j < cur_fb_state->rgz_layerno; j++) {
+        hwc_layer_1_t *layer = &cur_fb_state->rgz_layers[j].hwc_layer;
+        int first, last;
+        if (!rgz_layer_hregion_span(layer, yentries, ylen, hregion_right, &first, &last))
+            continue;
+        for (i = first; i <= last; i++) {
+            int l = hregions[i].nlayers++;
+            hregions[i].rgz_layers[l] = &cur_fb_state->rgz_layers[j];
         }
     }
+    rgz->nhregions = nhregions;
+
+    ALOGD_IF(debug, "Generated %d regions, layerno = %d", rgz->nhregions,
+        cur_fb_state->rgz_layerno);
 
     /* Calculate blit regions */
     for (i = 0; i < rgz->nhregions; i++) {
-        rgz_gen_blitregions(rgz, &hregions[i], screen_width);
+        rgz_gen_blitregions(rgz, &hregions[i], pool->edges, screen_width);
         ALOGD_IF(debug, "hregion %3d: nsubregions %d", i, hregions[i].nsubregions);
         ALOGD_IF(debug, "           : %d to %d: ",
             hregions[i].rect.top, hregions[i].rect.bottom);
         for (j = 0; j < hregions[i].nlayers; j++)
             ALOGD_IF(debug, "              %p ", &hregions[i].rgz_layers[j]->hwc_layer);
     }
+    if (rgz_set_geom_key(p, rgz))
+        return -1;
     rgz->state |= RGZ_REGION_DATA;
     return 0;
 }
@@ -1585,7 +1775,7 @@ static int rgz_hwc_subregion_blit(blit_hregion_t *hregion, int sidx, rgz_out_par
 
     /* Determine if this region is dirty */
     int dirty = 0;
-    blit_rect_t *subregion_rect = &hregion->blitrects[lix][sidx];
+    blit_rect_t *subregion_rect = RGZ_BLITRECT(hregion, lix, sidx);
     if (RECT_INTERSECTS(*damaged_area, *subregion_rect)) {
         /* The subregion intersects the damaged area, draw unconditionally */
         dirty = 1;
@@ -1608,7 +1798,7 @@ static int rgz_hwc_subregion_blit(blit_hregion_t *hregion, int sidx, rgz_out_par
     if (hregion->rgz_layers[lix]->buffidx == RGZ_BACKGROUND_BUFFIDX) {
         if (ldepth == 1) {
             /* Background layer is the only operation, clear subregion */
-            rgz_out_clrdst(params, &hregion->blitrects[lix][sidx]);
+            rgz_out_clrdst(params, RGZ_BLITRECT(hregion, lix, sidx));
             return 0;
         } else {
             /* No need to generate blits with background layer if there is
@@ -1626,7 +1816,7 @@ static int rgz_hwc_subregion_blit(blit_hregion_t *hregion, int sidx, rgz_out_par
     if (hregion->rgz_layers[lix]->buffidx == RGZ_CLEARHINT_BUFFIDX) {
         ldepth--;
         if (!ldepth) {
-            rgz_out_clrdst(params, &hregion->blitrects[lix][sidx]);
+            rgz_out_clrdst(params, RGZ_BLITRECT(hregion, lix, sidx));
             return 0;
         }
         lix = get_layer_ops_next(hregion, sidx, lix);
@@ -1635,7 +1825,7 @@ static int rgz_hwc_subregion_blit(blit_hregion_t *hregion, int sidx, rgz_out_par
     int noblend = rgz_is_blending_disabled(params);
 
     if (!noblend && ldepth > 1) { /* BLEND */
-        blit_rect_t *rect = &hregion->blitrects[lix][sidx];
+        blit_rect_t *rect = RGZ_BLITRECT(hregion, lix, sidx);
         struct rgz_blt_entry* e;
 
         int s2lix = lix;
@@ -1729,7 +1919,7 @@ static int rgz_hwc_subregion_blit(blit_hregion_t *hregion, int sidx, rgz_out_par
             rgz_batch_entry(e, BVFLAG_BATCH_END, 0);
 
     } else { /* COPY */
-        blit_rect_t *rect = &hregion->blitrects[lix][sidx];
+        blit_rect_t *rect = RGZ_BLITRECT(hregion, lix, sidx);
         if (noblend)    /* get_layer_ops() doesn't understand this so get the top */
             lix = get_top_rect(hregion, sidx, &rect);
         rgz_hwc_subregion_copy(params, rect, hregion->rgz_layers[lix]);
@@ -1793,6 +1983,44 @@ static int rgz_blts_bvdirect(rgz_t *rgz __unused, struct rgz_blts *blts, rgz_out
     return rv;
 }
 
+/*
+ * Determine if any subregion of a hregion needs to be redrawn, this is true if
+ * the hregion intersects the damaged area or any of its layers is dirty
+ */
+static int rgz_hwc_hregion_dirty(blit_hregion_t *hregion, blit_rect_t *damaged_area)
+{
+    int l;
+    if (RECT_INTERSECTS(*damaged_area, hregion->rect))
+        return 1;
+    for (l = 0; l < hregion->nlayers; l++) {
+        if (hregion->rgz_layers[l]->dirty_count)
+            return 1;
+    }
+    return 0;
+}
+
+/* Output the handles of the layers with a buffer in post2 buffer order */
+static int rgz_out_hndls(rgz_t *rgz, rgz_out_params_t *params)
+{
+    rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
+    int i, j;
+
+    params->data.bvc.out_nhndls = 0;
+    if (RGZ_POOL_RESERVE(rgz->pool.hndls, rgz->pool.hndlsz, cur_fb_state->rgz_layerno))
+        return -1;
+    params->data.bvc.out_hndls = rgz->pool.hndls;
+    /* Begin from index 1 to remove the background layer from the output */
+    for (j = 1, i = 0; j < cur_fb_state->rgz_layerno; j++) {
+        rgz_layer_t *rgz_layer = &cur_fb_state->rgz_layers[j];
+        /* We don't need the handles for layers marked as -1 */
+        if (rgz_layer->buffidx == -1)
+            continue;
+        params->data.bvc.out_hndls[i++] = rgz_layer->hwc_layer.handle;
+        params->data.bvc.out_nhndls++;
+    }
+    return 0;
+}
+
 static int rgz_out_region(rgz_t *rgz, rgz_out_params_t *params)
 {
     if (!(rgz->state & RGZ_REGION_DATA)) {
@@ -1818,6 +2046,9 @@ static int rgz_out_region(rgz_t *rgz, rgz_out_params_t *params)
             OUTE("hregion %p doesn't have any ops", hregion);
             return -1;
         }
+        /* Skip the subregions altogether if nothing changed in this hregion */
+        if (!rgz_hwc_hregion_dirty(hregion, &rgz->damaged_area))
+            continue;
         for (s = 0; s < hregion->nsubregions; s++) {
             ALOGD_IF(debug, "h[%d] -> [%d]", i, s);
             if (rgz_hwc_subregion_blit(hregion, s, params, &rgz->damaged_area))
@@ -1828,18 +2059,8 @@ static int rgz_out_region(rgz_t *rgz, rgz_out_params_t *params)
     int rv = 0;
 
     if (IS_BVCMD(params)) {
-        int j;
-        params->data.bvc.out_nhndls = 0;
-        rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
-        /* Begin from index 1 to remove the background layer from the output */
-        for (j = 1, i = 0; j < cur_fb_state->rgz_layerno; j++) {
-            rgz_layer_t *rgz_layer = &cur_fb_state->rgz_layers[j];
-            /* We don't need the handles for layers marked as -1 */
-            if (rgz_layer->buffidx == -1)
-                continue;
-            params->data.bvc.out_hndls[i++] = rgz_layer->hwc_layer.handle;
-            params->data.bvc.out_nhndls++;
-        }
+        if (rgz_out_hndls(rgz, params))
+            return -1;
 
         if (blts.idx > 0) {
             /* Last blit is made sync to act like a fence for the previous async blits */
@@ -1862,6 +2083,160 @@ static int rgz_out_region(rgz_t *rgz, rgz_out_params_t *params)
     return rv;
 }
 
+static uint32_t rgz_plan_hash(uint32_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    /* FNV-1a */
+    while (len--)
+        hash = (hash ^ *p++) * 16777619;
+    return hash;
+}
+
+/* Build the plan key of the current frame, -1 if it can't be stored */
+static int rgz_plan_key(rgz_t *rgz, rgz_out_params_t *params)
+{
+    rgz_fb_state_t *cur_fb_state = &rgz->cur_fb_state;
+    rgz_plan_t *key = &rgz->plan_cache.key;
+    struct bvsurfgeom *screen_geom = params->data.bvc.dstgeom;
+    int regionize = params->op == RGZ_OUT_BVCMD_REGION;
+    int i;
+
+    if (RGZ_POOL_RESERVE(key->layers, key->layersz, cur_fb_state->rgz_layerno))
+        return -1;
+
+    bzero(&key->hdr, sizeof(key->hdr));
+    key->hdr.op = params->op;
+    key->hdr.noblend = params->data.bvc.noblend;
+    key->hdr.screen_width = screen_geom->width;
+    key->hdr.screen_height = screen_geom->height;
+    key->hdr.screen_format = screen_geom->format;
+    key->hdr.screen_stride = screen_geom->virtstride;
+    /* Painting redraws every layer, the damage doesn't matter */
+    if (regionize)
+        key->hdr.damaged_area = rgz->damaged_area;
+    key->hdr.rgz_layerno = cur_fb_state->rgz_layerno;
+
+    for (i = 0; i < cur_fb_state->rgz_layerno; i++) {
+        rgz_layer_t *rgz_layer = &cur_fb_state->rgz_layers[i];
+        hwc_layer_1_t *layer = &rgz_layer->hwc_layer;
+        rgz_plan_layer_t *l = &key->layers[i];
+
+        bzero(l, sizeof(*l));
+        l->frame = layer->displayFrame;
+        l->crop = layer->sourceCrop;
+        l->transform = layer->transform;
+        l->blending = layer->blending;
+        l->buffidx = rgz_layer->buffidx;
+        if (regionize)
+            l->dirty_count = rgz_layer->dirty_count;
+        /* The background and clear fb hint layers have a dummy handle */
+        if (rgz_layer->buffidx >= 0) {
+            IMG_native_handle_t *handle = (IMG_native_handle_t *)layer->handle;
+            l->format = handle->iFormat;
+            l->width = handle->iWidth;
+            l->height = handle->iHeight;
+            l->stride = HANDLE_TO_STRIDE(handle);
+        }
+    }
+
+    key->hash = rgz_plan_hash(2166136261U, &key->hdr, sizeof(key->hdr));
+    key->hash = rgz_plan_hash(key->hash, key->layers,
+        sizeof(rgz_plan_layer_t) * cur_fb_state->rgz_layerno);
+    return 0;
+}
+
+static rgz_plan_t* rgz_plan_lookup(rgz_plan_cache_t *cache)
+{
+    rgz_plan_t *key = &cache->key;
+    int i;
+
+    for (i = 0; i < RGZ_PLAN_CACHE_SIZE; i++) {
+        rgz_plan_t *plan = &cache->plans[i];
+        if (plan->stamp && plan->hash == key->hash &&
+            !memcmp(&plan->hdr, &key->hdr, sizeof(key->hdr)) &&
+            !memcmp(plan->layers, key->layers, sizeof(rgz_plan_layer_t) * key->hdr.rgz_layerno)) {
+            plan->stamp = ++cache->stamp;
+            return plan;
+        }
+    }
+    return NULL;
+}
+
+/* Store the commands just generated under the current key evicting the least recently used plan */
+static void rgz_plan_store(rgz_plan_cache_t *cache, rgz_out_params_t *params)
+{
+    rgz_plan_t *key = &cache->key;
+    rgz_plan_t *plan = &cache->plans[0];
+    int i;
+
+    for (i = 1; i < RGZ_PLAN_CACHE_SIZE && plan->stamp; i++) {
+        if (cache->plans[i].stamp < plan->stamp)
+            plan = &cache->plans[i];
+    }
+
+    plan->stamp = 0;
+    if (RGZ_POOL_RESERVE(plan->layers, plan->layersz, key->hdr.rgz_layerno) ||
+        RGZ_POOL_RESERVE(plan->cmds, plan->cmdsz, params->data.bvc.cmdlen))
+        return;
+
+    plan->hash = key->hash;
+    plan->hdr = key->hdr;
+    memcpy(plan->layers, key->layers, sizeof(rgz_plan_layer_t) * key->hdr.rgz_layerno);
+    memcpy(plan->cmds, params->data.bvc.cmdp, sizeof(struct rgz_blt_entry) * params->data.bvc.cmdlen);
+    plan->cmdlen = params->data.bvc.cmdlen;
+    plan->out_blits = params->data.bvc.out_blits;
+    plan->stamp = ++cache->stamp;
+}
+
+static void rgz_plan_cache_free(rgz_plan_cache_t *cache)
+{
+    int i;
+    free(cache->key.layers);
+    for (i = 0; i < RGZ_PLAN_CACHE_SIZE; i++) {
+        free(cache->plans[i].layers);
+        free(cache->plans[i].cmds);
+    }
+    bzero(cache, sizeof(*cache));
+}
+
+static int rgz_out_bvcmd(rgz_t *rgz, rgz_out_params_t *params)
+{
+    int (*out)(rgz_t *rgz, rgz_out_params_t *params) =
+        params->op == RGZ_OUT_BVCMD_PAINT ? rgz_out_bvcmd_paint : rgz_out_region;
+    rgz_plan_cache_t *cache = &rgz->plan_cache;
+    rgz_plan_t *plan;
+    int rv;
+
+    params->data.bvc.out_cached = 0;
+    if (!params->data.bvc.plancache)
+        return out(rgz, params);
+
+    if (params->op == RGZ_OUT_BVCMD_REGION && !(rgz->state & RGZ_REGION_DATA)) {
+        OUTE("rgz_out_region invoked with bad state");
+        return -1;
+    }
+
+    if (rgz_plan_key(rgz, params))
+        return out(rgz, params);
+
+    plan = rgz_plan_lookup(cache);
+    if (plan) {
+        /* Same commands, only the buffers behind the post2 indexes differ */
+        if (rgz_out_hndls(rgz, params))
+            return -1;
+        params->data.bvc.cmdp = plan->cmds;
+        params->data.bvc.cmdlen = plan->cmdlen;
+        params->data.bvc.out_blits = plan->out_blits;
+        params->data.bvc.out_cached = 1;
+        return 0;
+    }
+
+    rv = out(rgz, params);
+    if (!rv)
+        rgz_plan_store(cache, params);
+    return rv;
+}
+
 void rgz_profile_hwc(hwc_display_contents_1_t* list, int dispw, int disph)
 {
     if (!list)  /* A NULL composition list can occur */
@@ -1895,6 +2270,7 @@ void rgz_profile_hwc(hwc_display_contents_1_t* list, int dispw, int disph)
         return;
 
     rgz_t rgz;
+    bzero(&rgz, sizeof(rgz));
     rgz_in_params_t ip = { .data = { .hwc = {
                            .layers = list->hwLayers,
                            .layerno = list->numHwLayers } } };
@@ -1917,7 +2293,7 @@ void rgz_profile_hwc(hwc_display_contents_1_t* list, int dispw, int disph)
             OUTP("<!-- ENDED-SVG-DUMP -->");
         }
     }
-    rgz_release(&rgz);
+    rgz_free(&rgz);
 }
 
 int rgz_get_screengeometry(int fd, struct bvsurfgeom *geom, int fmt)
@@ -1937,19 +2313,26 @@ int rgz_get_screengeometry(int fd, struct bvsurfgeom *geom, int fmt)
         return -EINVAL;
     }
 
+    rgz_set_screengeometry(geom, fb_varinfo.xres, fb_varinfo.yres,
+        fb_fixinfo.line_length, fmt);
+    return 0;
+}
+
+void rgz_set_screengeometry(struct bvsurfgeom *geom, int width, int height,
+    int stride, int fmt)
+{
     bzero(&bg_layer, sizeof(bg_layer));
     bg_layer.displayFrame.left = bg_layer.displayFrame.top = 0;
-    bg_layer.displayFrame.right = fb_varinfo.xres;
-    bg_layer.displayFrame.bottom = fb_varinfo.yres;
+    bg_layer.displayFrame.right = width;
+    bg_layer.displayFrame.bottom = height;
 
     bzero(geom, sizeof(*geom));
     geom->structsize = sizeof(*geom);
-    geom->width = fb_varinfo.xres;
-    geom->height = fb_varinfo.yres;
-    geom->virtstride = fb_fixinfo.line_length;
+    geom->width = width;
+    geom->height = height;
+    geom->virtstride = stride;
     geom->format = hal_to_ocd(fmt);
     geom->orientation = 0;
-    return 0;
 }
 
 int rgz_in(rgz_in_params_t *p, rgz_t *rgz)
@@ -1962,7 +2345,7 @@ int rgz_in(rgz_in_params_t *p, rgz_t *rgz)
             rv = rgz_in_hwc(p, rgz) ? 0 : RGZ_ALL;
         break;
     case RGZ_IN_HWCCHK:
-        bzero(rgz, sizeof(rgz_t));
+        rgz_reset(rgz);
         rv = rgz_in_hwccheck(p, rgz);
         break;
     default:
@@ -1975,11 +2358,40 @@ void rgz_release(rgz_t *rgz)
 {
     if (!rgz)
         return;
-    if (rgz->hregions)
-        free(rgz->hregions);
+    rgz_reset(rgz);
+}
+
+void rgz_free(rgz_t *rgz)
+{
+    int i;
+    if (!rgz)
+        return;
+    free(rgz->pool.hregions);
+    free(rgz->pool.layers);
+    free(rgz->pool.rects);
+    free(rgz->pool.edges);
+    free(rgz->pool.frames);
+    free(rgz->pool.hndls);
+    rgz_plan_cache_free(&rgz->plan_cache);
+    rgz_fb_state_free(&rgz->cur_fb_state);
+    for (i = 0; i < RGZ_NUM_FB; i++)
+        rgz_fb_state_free(&rgz->fb_states[i]);
     bzero(rgz, sizeof(*rgz));
 }
 
+#ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
+int rgz_ext_layer_list_reserve(rgz_ext_layer_list_t *list, int layerno)
+{
+    return RGZ_POOL_RESERVE(list->layers, list->size, layerno);
+}
+
+void rgz_ext_layer_list_free(rgz_ext_layer_list_t *list)
+{
+    free(list->layers);
+    bzero(list, sizeof(*list));
+}
+#endif
+
 int rgz_out(rgz_t *rgz, rgz_out_params_t *params)
 {
     switch (params->op) {
@@ -1989,9 +2401,9 @@ int rgz_out(rgz_t *rgz, rgz_out_params_t *params)
     case RGZ_OUT_BVDIRECT_PAINT:
         return rgz_out_bvdirect_paint(rgz, params);
     case RGZ_OUT_BVCMD_PAINT:
-        return rgz_out_bvcmd_paint(rgz, params);
-    case RGZ_OUT_BVDIRECT_REGION:
     case RGZ_OUT_BVCMD_REGION:
+        return rgz_out_bvcmd(rgz, params);
+    case RGZ_OUT_BVDIRECT_REGION:
         return rgz_out_region(rgz, params);
     default:
         return -1;
@@ -19,17 +19,12 @@
 #include <linux/bltsville.h>
 
 /*
- * Maximum number of layers used to generate subregion rectangles in a
- * horizontal region.
+ * Maximum number of blits the regionizer can generate for a frame, this is the
+ * size of the blit command list handed to the kernel with each composition.
+ * There is no limit on the number of input layers, the region tables grow as
+ * needed.
  */
-#define RGZ_MAXLAYERS 13
-
-/*
- * Maximum number of layers the regionizer will accept as input. Account for an
- * additional 'background layer' to generate empty subregion rectangles and
- * a damage region as well.
- */
-#define RGZ_INPUT_MAXLAYERS (RGZ_MAXLAYERS - 2)
+#define RGZ_MAX_BLITS 625
 
 /* Number of framebuffers to track */
 #define RGZ_NUM_FB 2
@@ -37,7 +32,8 @@
 /*
  * Regionizer data
  *
- * This is an oqaque structure passed in by the client
+ * This is an oqaque structure passed in by the client, it must be zero
+ * initialized before its first use and freed with rgz_free
  */
 struct rgz;
 typedef struct rgz rgz_t;
@@ -48,6 +44,13 @@ typedef struct rgz rgz_t;
  */
 int rgz_get_screengeometry(int fd, struct bvsurfgeom *geom, int fmt);
 
+/*
+ * Same as above with the geometry given explicitly, this is used when there is
+ * no framebuffer device e.g. by the regionizer benchmark
+ */
+void rgz_set_screengeometry(struct bvsurfgeom *geom, int width, int height,
+    int stride, int fmt);
+
 /*
  * Regionizer input parameters
  */
@@ -70,8 +73,22 @@ typedef struct rgz_in_params {
 
 #ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
 typedef struct rgz_ext_layer_list {
-    hwc_layer_extended_t layers[RGZ_INPUT_MAXLAYERS];
+    hwc_layer_extended_t *layers;
+    int size; /* allocated entries */
 } rgz_ext_layer_list_t;
+
+/*
+ * Make sure the extended layer list can hold at least layerno entries
+ *
+ * Returns:
+ * 0 on success, -1 failure
+ */
+int rgz_ext_layer_list_reserve(rgz_ext_layer_list_t *list, int layerno);
+
+/*
+ * Free the extended layer list storage
+ */
+void rgz_ext_layer_list_free(rgz_ext_layer_list_t *list);
 #endif
 
 /*
@@ -112,10 +129,17 @@ int rgz_in(rgz_in_params_t *param, rgz_t *rgz);
 #define RGZ_ALL 1
 
 /*
- * Free regionizer resources
+ * Release the region data and reset the regionizer state. The storage the
+ * regionizer grew is kept so following compositions don't need to allocate
+ * it again.
  */
 void rgz_release(rgz_t *rgz);
 
+/*
+ * Free regionizer resources
+ */
+void rgz_free(rgz_t *rgz);
+
 /*
  * Regionizer output operations
  */
@@ -124,9 +148,11 @@ struct rgz_out_bvcmd {
     int cmdlen;
     struct bvsurfgeom *dstgeom;
     int noblend;
-    buffer_handle_t out_hndls[RGZ_INPUT_MAXLAYERS]; /* OUTPUT */
+    int plancache; /* Replay the commands of an earlier frame with the same plan */
+    buffer_handle_t *out_hndls; /* OUTPUT, owned by the regionizer */
     int out_nhndls; /* OUTPUT */
     int out_blits; /* OUTPUT */
+    int out_cached; /* OUTPUT, the commands come from the plan cache */
 };
 
 struct rgz_out_svg {
@@ -181,9 +207,16 @@ typedef struct rgz_out_params {
  * data.bvc.cmdlen      length of cmdp
  * data.bvc.dstgeom     bltsville struct describing the destination geometry
  * data.bvc.noblend     Test option to disable blending
- * data.bvc.out_hndls   Array of buffer handles (OUTPUT)
+ * data.bvc.plancache   Look up the commands in the blit plan cache first, on
+ *                      a hit the cached commands are returned as they are and
+ *                      only the buffer handles are taken from the current
+ *                      layers
+ * data.bvc.out_hndls   Array of buffer handles (OUTPUT), valid until the
+ *                      next regionizer call
  * data.bvc.out_nhndls  Number of buffer handles (OUTPUT)
  * data.bvc.out_blits   Number of blits (OUTPUT)
+ * data.bvc.out_cached  Set if the commands were replayed from the plan cache
+ *                      (OUTPUT)
  */
 #define RGZ_OUT_BVCMD_PAINT 1
 
@@ -271,9 +304,6 @@ typedef struct blit_rect {
  * the diagram above H4 has 2 sub-regions, layer 0 intersects with the first
  * region and layers 0 and 2 intersect with the second region.
  */
-#define RGZ_SUBREGIONMAX ((RGZ_MAXLAYERS << 1) - 1)
-#define RGZ_MAX_BLITS (RGZ_SUBREGIONMAX * RGZ_SUBREGIONMAX)
-
 typedef struct rgz_layer {
     hwc_layer_1_t hwc_layer;
     uint32_t identity;
@@ -283,17 +313,111 @@ typedef struct rgz_layer {
 
 typedef struct rgz_fb_state {
     int rgz_layerno;
-    rgz_layer_t rgz_layers[RGZ_MAXLAYERS];
+    int rgz_layersz; /* allocated entries */
+    rgz_layer_t *rgz_layers;
 } rgz_fb_state_t;
 
+/*
+ * The layer and rectangle tables of every hregion are carved out of pools
+ * owned by the regionizer, blitrects holds nlayers rows of nsubregions
+ * rectangles (z-order | rectangle), use RGZ_BLITRECT to index it.
+ */
 typedef struct blit_hregion {
     blit_rect_t rect;
-    rgz_layer_t *rgz_layers[RGZ_MAXLAYERS];
+    rgz_layer_t **rgz_layers;
     int nlayers;
     int nsubregions;
-    blit_rect_t blitrects[RGZ_MAXLAYERS][RGZ_SUBREGIONMAX]; /* z-order | rectangle */
+    blit_rect_t *blitrects;
 } blit_hregion_t;
 
+#define RGZ_BLITRECT(hregion, l, r) \
+    (&(hregion)->blitrects[(l) * (hregion)->nsubregions + (r)])
+
+/*
+ * Storage which is kept across frames and only grows, the regionizer data
+ * points into these arrays
+ */
+typedef struct rgz_pool {
+    blit_hregion_t *hregions;
+    int hregionsz;
+    rgz_layer_t **layers;        /* Layers of each hregion */
+    int layersz;
+    blit_rect_t *rects;          /* Subregion rectangles of each hregion */
+    int rectsz;
+    int *edges;                  /* Scratch space to sort region edges */
+    int edgesz;
+    hwc_rect_t *frames;          /* See rgz_geom_key */
+    int framesz;
+    buffer_handle_t *hndls;      /* Output buffer handles */
+    int hndlsz;
+} rgz_pool_t;
+
+/*
+ * Geometry a hregion decomposition was generated from. If the next frame has
+ * the same geometry, i.e. only the layer contents changed, the hregions and
+ * their subregion rectangles are reused as they are.
+ */
+typedef struct rgz_geom_key {
+    int screen_width;
+    int screen_height;
+    int rgz_layerno;
+    blit_rect_t damaged_area;
+    hwc_rect_t *frames; /* displayFrame of each layer in z-order */
+} rgz_geom_key_t;
+
+/*
+ * Blit plan cache
+ *
+ * The commands generated for a frame only depend on the screen, the layer
+ * geometry, the description of the layer buffers and, when regionizing, on
+ * the dirty state of the layers. Buffers are referenced by their index in the
+ * post2 buffer list rather than by handle, so a plan can be replayed for any
+ * frame with the same key whatever buffers the layers point to.
+ */
+#define RGZ_PLAN_CACHE_SIZE 4
+
+typedef struct rgz_plan_hdr {
+    int op;
+    int noblend;
+    int screen_width;
+    int screen_height;
+    int screen_format;
+    int screen_stride;
+    blit_rect_t damaged_area;
+    int rgz_layerno;
+} rgz_plan_hdr_t;
+
+typedef struct rgz_plan_layer {
+    hwc_rect_t frame;
+    hwc_rect_t crop;
+    int transform;
+    int blending;
+    int buffidx;
+    int dirty_count;
+    int format; /* Buffer description, zero for layers without a buffer */
+    int width;
+    int height;
+    int stride;
+} rgz_plan_layer_t;
+
+typedef struct rgz_plan {
+    uint32_t hash;
+    unsigned int stamp; /* Last use, 0 if the entry is empty */
+    rgz_plan_hdr_t hdr;
+    rgz_plan_layer_t *layers;
+    int layersz;
+    struct rgz_blt_entry *cmds;
+    int cmdlen;
+    int cmdsz;
+    int out_blits;
+} rgz_plan_t;
+
+typedef struct rgz_plan_cache {
+    rgz_plan_t key; /* Key of the frame being generated, it has no commands */
+    rgz_plan_t plans[RGZ_PLAN_CACHE_SIZE];
+    unsigned int stamp;
+} rgz_plan_cache_t;
+
 enum { RGZ_STATE_INIT = 1, RGZ_REGION_DATA = 2} ;
 
 struct rgz {
@@ -305,6 +429,9 @@ struct rgz {
     int fb_state_idx; /* Target framebuffer index. Points to the fb where the blits will be applied to */
     rgz_fb_state_t fb_states[RGZ_NUM_FB]; /* Storage for previous framebuffer geometry states */
     blit_rect_t damaged_area; /* Area of the screen which will be redrawn unconditionally */
+    rgz_geom_key_t geom_key; /* Geometry of the current region data */
+    rgz_pool_t pool;
+    rgz_plan_cache_t plan_cache; /* Survives rgz_release, the keys are self contained */
 };
 
 #endif /* __RGZ_2D__ */
@@ -27,6 +27,8 @@
 #include <utils/Timers.h>
 
 #include "hwc_dev.h"
+#include "hwc_trace.h"
+#include "sw_vsync.h"
 
 static pthread_t vsync_thread;
 static pthread_mutex_t vsync_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -35,57 +37,87 @@ static bool vsync_loop_active = false;
 
 nsecs_t vsync_rate;
 
-static struct timespec diff(struct timespec start, struct timespec end)
+/*
+ * The vsync grid is anchor + k * period. The period follows the intervals
+ * between posts, within VSYNC_PERIOD_TOLERANCE of the nominal rate. Posts
+ * trail the vsync their frame was composed for by the composition time, so
+ * the grid is only pulled by changes of that latency. Locking to the post
+ * itself would move every vsync by part of the latency and the period would
+ * run away to the end of the tolerance.
+ */
+#define VSYNC_PHASE_GAIN 8          /* 1/8 of the phase error is corrected per post */
+#define VSYNC_LATENCY_GAIN 16       /* 1/16 of the latency change updates the expected one */
+#define VSYNC_PERIOD_GAIN 32        /* 1/32 of the period error is corrected per post */
+#define VSYNC_PERIOD_TOLERANCE 20   /* +-1/20 of the nominal period */
+#define VSYNC_MAX_POST_PERIODS 4    /* post intervals longer than this are not used */
+
+static nsecs_t vsync_period;        /* estimated period */
+static nsecs_t vsync_anchor;
+static nsecs_t vsync_last;          /* last vsync delivered */
+static nsecs_t frame_vsync;         /* vsync the composition being posted started from */
+static nsecs_t post_latency;        /* expected time from that vsync to the post */
+static nsecs_t last_post;
+static uint32_t idle_limit;         /* vsyncs without composition before pausing, 0 never pauses */
+static uint32_t idle_vsyncs;
+static bool vsync_paused = false;
+
+static nsecs_t now_ns(void)
 {
-    struct timespec temp;
-    if ((end.tv_nsec - start.tv_nsec) < 0) {
-        temp.tv_sec = end.tv_sec-start.tv_sec - 1;
-        temp.tv_nsec = 1000000000 + end.tv_nsec-start.tv_nsec;
-    } else {
-        temp.tv_sec = end.tv_sec - start.tv_sec;
-        temp.tv_nsec = end.tv_nsec - start.tv_nsec;
-    }
-    return temp;
+    struct timespec tp;
+
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (nsecs_t)tp.tv_sec * 1000000000 + tp.tv_nsec;
+}
+
+/* The first vsync of the grid after t, at least half a period after the last one delivered */
+static nsecs_t next_vsync_after(nsecs_t t)
+{
+    nsecs_t next;
+
+    if (!vsync_anchor)
+        vsync_anchor = t;
+    if (t < vsync_last + vsync_period / 2)
+        t = vsync_last + vsync_period / 2;
+    next = vsync_anchor + ((t - vsync_anchor) / vsync_period + 1) * vsync_period;
+    if (t < vsync_anchor)
+        next = vsync_anchor - ((vsync_anchor - t) / vsync_period) * vsync_period;
+    return next;
 }
 
 static void *vsync_loop(void *data)
 {
-    struct timespec tp, tp_next, tp_sleep;
-    nsecs_t now = 0, period = vsync_rate, next_vsync = 0, next_fake_vsync = 0, sleep = 0;
+    struct timespec tp_next;
+    nsecs_t next_vsync;
     omap_hwc_device_t *hwc_dev = (omap_hwc_device_t *)data;
-    tp_sleep.tv_sec = tp_sleep.tv_nsec = 0;
 
     setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
 
     for (;;) {
         pthread_mutex_lock(&vsync_mutex);
-        while (!vsync_loop_active) {
+        while (!vsync_loop_active || vsync_paused) {
             pthread_cond_wait(&vsync_cond, &vsync_mutex);
         }
-        /* the vsync_rate should be re-read after
-        * user sets the vsync_rate by calling start_sw_vsync
-        * explicitly. This is guaranteed by re-reading it
-        * after the vsync_cond is signalled.
-        */
-        period = vsync_rate; /* re-read rate */
-
+        next_vsync = next_vsync_after(now_ns());
         pthread_mutex_unlock(&vsync_mutex);
 
-        clock_gettime(CLOCK_MONOTONIC, &tp);
-        now = (tp.tv_sec * 1000000000) + tp.tv_nsec;
-        next_vsync = next_fake_vsync;
-        sleep = next_vsync - now;
-        if (sleep < 0) {
-            /* we missed, find where the next vsync should be */
-            sleep = (period - ((now - next_vsync) % period));
-            next_vsync = now + sleep;
+        /* absolute sleep, the wakeup doesn't drift with the time spent in the loop */
+        tp_next.tv_sec = next_vsync / 1000000000;
+        tp_next.tv_nsec = next_vsync % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tp_next, NULL) == EINTR)
+            ;
+
+        pthread_mutex_lock(&vsync_mutex);
+        bool deliver = vsync_loop_active;
+        if (deliver) {
+            vsync_last = next_vsync;
+            if (idle_limit && ++idle_vsyncs >= idle_limit)
+                vsync_paused = true;
         }
-        next_fake_vsync = next_vsync + period;
-        tp_next.tv_sec = (next_vsync / 1000000000);
-        tp_next.tv_nsec = (next_vsync % 1000000000);
-        tp_sleep = diff(tp, tp_next);
+        pthread_mutex_unlock(&vsync_mutex);
 
-        nanosleep(&tp_sleep, NULL);
+        if (!deliver)
+            continue;
+        hwc_trace_vsync(next_vsync);
         if (hwc_dev->procs && hwc_dev->procs->vsync) {
             hwc_dev->procs->vsync(hwc_dev->procs, 0, next_vsync);
         }
@@ -93,6 +125,71 @@ static void *vsync_loop(void *data)
     return NULL;
 }
 
+/* Called when a composition is requested, resumes an idle paused loop */
+void sw_vsync_kick()
+{
+    pthread_mutex_lock(&vsync_mutex);
+    frame_vsync = vsync_last;
+    idle_vsyncs = 0;
+    if (vsync_paused) {
+        vsync_paused = false;
+        pthread_cond_signal(&vsync_cond);
+    }
+    pthread_mutex_unlock(&vsync_mutex);
+}
+
+/* Called with the time a frame got posted to the display */
+void sw_vsync_post(nsecs_t when)
+{
+    pthread_mutex_lock(&vsync_mutex);
+    if (vsync_loop_active && vsync_anchor) {
+        nsecs_t period = vsync_period;
+        nsecs_t tolerance = vsync_rate / VSYNC_PERIOD_TOLERANCE;
+
+        /* period: the post interval divided by the vsyncs it spans */
+        if (last_post && when > last_post) {
+            nsecs_t interval = when - last_post;
+            nsecs_t n = (interval + period / 2) / period;
+
+            if (n >= 1 && n <= VSYNC_MAX_POST_PERIODS) {
+                period += (interval / n - period) / VSYNC_PERIOD_GAIN;
+                if (period < vsync_rate - tolerance)
+                    period = vsync_rate - tolerance;
+                else if (period > vsync_rate + tolerance)
+                    period = vsync_rate + tolerance;
+            }
+        }
+
+        /* phase: pull the nearest grid point towards the post, less the expected latency */
+        if (frame_vsync && when > frame_vsync) {
+            nsecs_t latency = when - frame_vsync;
+            nsecs_t t;
+
+            /* a composition that missed its vsync tells nothing about the latency */
+            if (!post_latency) {
+                if (latency < vsync_period)
+                    post_latency = latency;
+            } else {
+                if (latency < vsync_period)
+                    post_latency += (latency - post_latency) / VSYNC_LATENCY_GAIN;
+
+                t = when - post_latency;
+                nsecs_t k = (t - vsync_anchor + (t >= vsync_anchor ? vsync_period / 2 : -vsync_period / 2)) / vsync_period;
+                nsecs_t grid = vsync_anchor + k * vsync_period;
+                vsync_anchor = grid + (t - grid) / VSYNC_PHASE_GAIN;
+            }
+        }
+        vsync_period = period;
+    }
+    last_post = when;
+    idle_vsyncs = 0;
+    if (vsync_paused) {
+        vsync_paused = false;
+        pthread_cond_signal(&vsync_cond);
+    }
+    pthread_mutex_unlock(&vsync_mutex);
+}
+
 bool use_sw_vsync()
 {
     char board[PROPERTY_VALUE_MAX];
@@ -123,15 +220,33 @@ void start_sw_vsync()
     char refresh_rate[PROPERTY_VALUE_MAX];
     property_get("persist.hwc.sw_vsync_rate", refresh_rate, "60");
 
+    char idle[PROPERTY_VALUE_MAX];
+    property_get("persist.hwc.sw_vsync_idle", idle, "0");
+
     pthread_mutex_lock(&vsync_mutex);
     int rate = atoi(refresh_rate);
     if (rate <= 0)
         rate = 60;
-    vsync_rate = 1000000000 / rate;
+    if (vsync_rate != 1000000000 / rate) {
+        /* start estimating again from the new nominal rate */
+        vsync_rate = 1000000000 / rate;
+        vsync_period = vsync_rate;
+        vsync_anchor = 0;
+        frame_vsync = 0;
+        post_latency = 0;
+        last_post = 0;
+    }
+    idle_limit = atoi(idle) > 0 ? atoi(idle) : 0;
+    idle_vsyncs = 0;
     if (vsync_loop_active) {
+        if (vsync_paused) {
+            vsync_paused = false;
+            pthread_cond_signal(&vsync_cond);
+        }
         pthread_mutex_unlock(&vsync_mutex);
         return;
     }
+    vsync_paused = false;
     vsync_loop_active = true;
     pthread_mutex_unlock(&vsync_mutex);
     pthread_cond_signal(&vsync_cond);
@@ -21,5 +21,7 @@ bool use_sw_vsync();
 void init_sw_vsync(omap_hwc_device_t *hwc_dev);
 void start_sw_vsync();
 void stop_sw_vsync();
+void sw_vsync_kick();
+void sw_vsync_post(nsecs_t when);
 
 #endif
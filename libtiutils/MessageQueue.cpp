@@ -17,8 +17,11 @@
 
 #include <errno.h>
 #include <string.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/poll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <utils/Errors.h>
 
@@ -32,6 +35,46 @@
 namespace Ti {
 namespace Utils {
 
+/**
+   Every thread that waits for messages gets one eventfd, shared by all the
+   queues it waits on. A producer may still signal an eventfd shortly after
+   its thread stopped waiting, so the eventfds of exiting threads are kept
+   for later threads instead of being closed: a late signal can only cause
+   a spurious wakeup, never hit an unrelated fd.
+ */
+static pthread_once_t sWaiterOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t sWaiterKey;
+static pthread_mutex_t sWaiterLock = PTHREAD_MUTEX_INITIALIZER;
+static int *sFreeWaiters = NULL;
+static int sFreeWaiterCount = 0;
+static int sFreeWaiterSize = 0;
+
+static void releaseWaiterFd(void *fd)
+{
+    pthread_mutex_lock(&sWaiterLock);
+    if ( sFreeWaiterCount == sFreeWaiterSize )
+        {
+        int size = sFreeWaiterSize ? sFreeWaiterSize * 2 : 8;
+        int *fds = (int *) realloc(sFreeWaiters, size * sizeof(int));
+
+        if ( fds )
+            {
+            sFreeWaiters = fds;
+            sFreeWaiterSize = size;
+            }
+        }
+    if ( sFreeWaiterCount < sFreeWaiterSize )
+        {
+        sFreeWaiters[sFreeWaiterCount++] = reinterpret_cast<intptr_t>(fd) - 1;
+        }
+    pthread_mutex_unlock(&sWaiterLock);
+}
+
+static void createWaiterKey()
+{
+    pthread_key_create(&sWaiterKey, releaseWaiterFd);
+}
+
 /**
    @brief Constructor for the message queue class
 
@@ -42,24 +85,24 @@ MessageQueue::MessageQueue()
 {
     LOG_FUNCTION_NAME;
 
-    int fds[2] = {-1,-1};
-    android::status_t stat;
-
-    stat = pipe(fds);
+    mEnqueuePos = 0;
+    mDequeuePos = 0;
+    mWaiterFd = -1;
+    mPollFd = -1;
+    mFullWaiters = 0;
+    mHasMsg = false;
 
-    if ( 0 > stat )
+    mSlots = new Slot[kSlots];
+    if ( NULL == mSlots )
         {
-        MSGQ_LOGEB("Error while openning pipe: %s", strerror(stat) );
-        this->fd_read = 0;
-        this->fd_write = 0;
-        mHasMsg = false;
+        MSGQ_LOGEA("Error while allocating message ring");
         }
     else
         {
-        this->fd_read = fds[0];
-        this->fd_write = fds[1];
-
-        mHasMsg = false;
+        for ( uint32_t i = 0; i < kSlots; i++ )
+            {
+            mSlots[i].seq = i;
+            }
         }
 
     LOG_FUNCTION_NAME_EXIT;
@@ -75,17 +118,200 @@ MessageQueue::~MessageQueue()
 {
     LOG_FUNCTION_NAME;
 
-    if(this->fd_read >= 0)
+    if(this->mPollFd >= 0)
         {
-        close(this->fd_read);
+        close(this->mPollFd);
         }
 
-    if(this->fd_write >= 0)
+    delete [] mSlots;
+
+    LOG_FUNCTION_NAME_EXIT;
+}
+
+/**
+   @brief Take the oldest message off the ring without waiting
+
+   Bounded MPMC ring: every slot carries a sequence number telling whether it
+   is free for the producer at a position or filled for the consumer at it.
+
+   @param msg Message structure to hold the message to be retrieved
+   @return true if a message was retrieved
+ */
+bool MessageQueue::tryGet(Message* msg)
+{
+    uint32_t pos = __atomic_load_n(&mDequeuePos, __ATOMIC_RELAXED);
+    Slot *slot;
+
+    for ( ;; )
         {
-        close(this->fd_write);
+        slot = &mSlots[pos & (kSlots - 1)];
+        int32_t dif = (int32_t) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+
+        if ( 0 == dif )
+            {
+            if ( __atomic_compare_exchange_n(&mDequeuePos, &pos, pos + 1, true,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+                {
+                break;
+                }
+            }
+        else if ( dif < 0 )
+            {
+            return false;
+            }
+        else
+            {
+            pos = __atomic_load_n(&mDequeuePos, __ATOMIC_RELAXED);
+            }
         }
 
-    LOG_FUNCTION_NAME_EXIT;
+    *msg = slot->msg;
+    __atomic_store_n(&slot->seq, pos + kSlots, __ATOMIC_RELEASE);
+
+    if ( mPollFd >= 0 )
+        {
+        eventfd_t value;
+        eventfd_read(mPollFd, &value);
+        }
+
+    // Producers only sleep on a full ring, this is the rare path
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ( __atomic_load_n(&mFullWaiters, __ATOMIC_RELAXED) )
+        {
+        android::AutoMutex lock(mFullLock);
+        mFullCond.broadcast();
+        }
+
+    return true;
+}
+
+/**
+   @brief Append a message to the ring without waiting
+
+   @param msg Message to queue
+   @return false if the ring is full
+ */
+bool MessageQueue::tryPut(Message* msg)
+{
+    uint32_t pos = __atomic_load_n(&mEnqueuePos, __ATOMIC_RELAXED);
+    Slot *slot;
+
+    for ( ;; )
+        {
+        slot = &mSlots[pos & (kSlots - 1)];
+        int32_t dif = (int32_t) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if ( 0 == dif )
+            {
+            if ( __atomic_compare_exchange_n(&mEnqueuePos, &pos, pos + 1, true,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+                {
+                break;
+                }
+            }
+        else if ( dif < 0 )
+            {
+            return false;
+            }
+        else
+            {
+            pos = __atomic_load_n(&mEnqueuePos, __ATOMIC_RELAXED);
+            }
+        }
+
+    slot->msg = *msg;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+   @brief Whether the oldest slot holds a message
+
+   @param none
+   @return true if a message is queued
+ */
+bool MessageQueue::pending()
+{
+    uint32_t pos = __atomic_load_n(&mDequeuePos, __ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&mSlots[pos & (kSlots - 1)].seq, __ATOMIC_ACQUIRE) == pos + 1;
+}
+
+/**
+   @brief Wake up the thread waiting for this queue, if any
+
+   The first producer to see the waiter takes it off the queue, later puts
+   skip the syscall until the consumer waits again.
+
+   @param none
+   @return none
+ */
+void MessageQueue::wake()
+{
+    // Pairs with the fence in waitForMsg() between setWaiter() and pending()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if ( __atomic_load_n(&mWaiterFd, __ATOMIC_RELAXED) >= 0 )
+        {
+        int fd = __atomic_exchange_n(&mWaiterFd, -1, __ATOMIC_ACQ_REL);
+
+        if ( fd >= 0 )
+            {
+            eventfd_write(fd, 1);
+            }
+        }
+
+    if ( __atomic_load_n(&mPollFd, __ATOMIC_RELAXED) >= 0 )
+        {
+        eventfd_write(mPollFd, 1);
+        }
+}
+
+/**
+   @brief Register or, for -1, unregister the eventfd woken by put()
+
+   @param fd eventfd of the waiting thread
+   @return none
+ */
+void MessageQueue::setWaiter(int fd)
+{
+    __atomic_store_n(&mWaiterFd, fd, __ATOMIC_RELAXED);
+}
+
+/**
+   @brief eventfd of the calling thread, created on its first wait
+
+   @param none
+   @return eventfd or -1 if it could not be created
+ */
+int MessageQueue::waiterFd()
+{
+    pthread_once(&sWaiterOnce, createWaiterKey);
+
+    intptr_t fd = reinterpret_cast<intptr_t>(pthread_getspecific(sWaiterKey)) - 1;
+    if ( fd < 0 )
+        {
+        pthread_mutex_lock(&sWaiterLock);
+        if ( sFreeWaiterCount )
+            {
+            fd = sFreeWaiters[--sFreeWaiterCount];
+            }
+        pthread_mutex_unlock(&sWaiterLock);
+
+        if ( fd < 0 )
+            {
+            fd = eventfd(0, EFD_NONBLOCK);
+            }
+        if ( fd < 0 )
+            {
+            MSGQ_LOGEB("eventfd() error: %s", strerror(errno));
+            return -1;
+            }
+        pthread_setspecific(sWaiterKey, reinterpret_cast<void *>(fd + 1));
+        }
+
+    return fd;
 }
 
 /**
@@ -94,8 +320,8 @@ MessageQueue::~MessageQueue()
    @param msg Message structure to hold the message to be retrieved
    @return android::NO_ERROR On success
    @return android::BAD_VALUE if the message pointer is NULL
-   @return android::NO_INIT If the file read descriptor is not set
-   @return android::UNKNOWN_ERROR if the read operation fromthe file read descriptor fails
+   @return android::NO_INIT If the message ring is not allocated
+   @return android::UNKNOWN_ERROR if waiting for a message fails
  */
 android::status_t MessageQueue::get(Message* msg)
 {
@@ -108,29 +334,24 @@ android::status_t MessageQueue::get(Message* msg)
         return android::BAD_VALUE;
         }
 
-    if(!this->fd_read)
+    if(!this->mSlots)
         {
-        MSGQ_LOGEA("read descriptor not initialized for message queue");
+        MSGQ_LOGEA("message ring not initialized for message queue");
         LOG_FUNCTION_NAME_EXIT;
         return android::NO_INIT;
         }
 
-    char* p = (char*) msg;
-    size_t read_bytes = 0;
-
-    while( read_bytes  < sizeof(*msg) )
+    while ( !tryGet(msg) )
         {
-        int err = read(this->fd_read, p, sizeof(*msg) - read_bytes);
+        MessageQueue *self = this;
+        int ret = waitForMsg(&self, 1, -1);
 
-        if( err < 0 )
+        if( ret < 0 )
             {
-            MSGQ_LOGEB("read() error: %s", strerror(errno));
+            MSGQ_LOGEB("wait error: %d", ret);
+            LOG_FUNCTION_NAME_EXIT;
             return android::UNKNOWN_ERROR;
             }
-        else
-            {
-            read_bytes += err;
-            }
         }
 
     MSGQ_LOGDB("MQ.get(%d,%p,%p,%p,%p)", msg->command, msg->arg1,msg->arg2,msg->arg3,msg->arg4);
@@ -143,55 +364,49 @@ android::status_t MessageQueue::get(Message* msg)
 }
 
 /**
-   @brief Get the input file descriptor of the message queue
+   @brief Get a file descriptor that polls readable while messages are queued
+
+   The eventfd is only created on the first call, queues nobody polls never
+   signal the kernel. It is owned and closed by the queue.
 
    @param none
-   @return file read descriptor
+   @return file read descriptor, -1 on error
  */
 
 int MessageQueue::getInFd()
 {
-    return this->fd_read;
-}
+    android::AutoMutex lock(mPollFdLock);
 
-/**
-   @brief Constructor for the message queue class
-
-   @param fd file read descriptor
-   @return none
- */
-
-void MessageQueue::setInFd(int fd)
-{
-    LOG_FUNCTION_NAME;
-
-    if ( -1 != this->fd_read )
+    if ( mPollFd < 0 )
         {
-        close(this->fd_read);
-        }
+        uint32_t queued = __atomic_load_n(&mEnqueuePos, __ATOMIC_ACQUIRE) -
+                          __atomic_load_n(&mDequeuePos, __ATOMIC_ACQUIRE);
 
-    this->fd_read = fd;
+        mPollFd = eventfd(queued, EFD_NONBLOCK | EFD_SEMAPHORE);
+        if ( mPollFd < 0 )
+            {
+            MSGQ_LOGEB("eventfd() error: %s", strerror(errno));
+            }
+        }
 
-    LOG_FUNCTION_NAME_EXIT;
+    return this->mPollFd;
 }
 
 /**
    @brief Queue a message
 
+   Waits for the consumer if the ring is full, as a write to a full pipe did.
+
    @param msg Message structure to hold the message to be retrieved
    @return android::NO_ERROR On success
    @return android::BAD_VALUE if the message pointer is NULL
-   @return android::NO_INIT If the file write descriptor is not set
-   @return android::UNKNOWN_ERROR if the write operation fromthe file write descriptor fails
+   @return android::NO_INIT If the message ring is not allocated
  */
 
 android::status_t MessageQueue::put(Message* msg)
 {
     LOG_FUNCTION_NAME;
 
-    char* p = (char*) msg;
-    size_t bytes = 0;
-
     if(!msg)
         {
         MSGQ_LOGEA("msg is NULL");
@@ -199,9 +414,9 @@ android::status_t MessageQueue::put(Message* msg)
         return android::BAD_VALUE;
         }
 
-    if(!this->fd_write)
+    if(!this->mSlots)
         {
-        MSGQ_LOGEA("write descriptor not initialized for message queue");
+        MSGQ_LOGEA("message ring not initialized for message queue");
         LOG_FUNCTION_NAME_EXIT;
         return android::NO_INIT;
         }
@@ -209,22 +424,20 @@ android::status_t MessageQueue::put(Message* msg)
 
     MSGQ_LOGDB("MQ.put(%d,%p,%p,%p,%p)", msg->command, msg->arg1,msg->arg2,msg->arg3,msg->arg4);
 
-    while( bytes  < sizeof(msg) )
+    if ( !tryPut(msg) )
         {
-        int err = write(this->fd_write, p, sizeof(*msg) - bytes);
+        android::AutoMutex lock(mFullLock);
 
-        if( err < 0 )
+        __atomic_add_fetch(&mFullWaiters, 1, __ATOMIC_SEQ_CST);
+        while ( !tryPut(msg) )
             {
-            MSGQ_LOGEB("write() error: %s", strerror(errno));
-            LOG_FUNCTION_NAME_EXIT;
-            return android::UNKNOWN_ERROR;
-            }
-        else
-            {
-            bytes += err;
+            mFullCond.wait(mFullLock);
             }
+        __atomic_sub_fetch(&mFullWaiters, 1, __ATOMIC_SEQ_CST);
         }
 
+    wake();
+
     MSGQ_LOGDA("MessageQueue::put EXIT");
 
     LOG_FUNCTION_NAME_EXIT;
@@ -243,35 +456,14 @@ bool MessageQueue::isEmpty()
 {
     LOG_FUNCTION_NAME;
 
-    struct pollfd pfd;
-
-    pfd.fd = this->fd_read;
-    pfd.events = POLLIN;
-    pfd.revents = 0;
-
-    if(!this->fd_read)
+    if(!this->mSlots)
         {
-        MSGQ_LOGEA("read descriptor not initialized for message queue");
+        MSGQ_LOGEA("message ring not initialized for message queue");
         LOG_FUNCTION_NAME_EXIT;
         return android::NO_INIT;
         }
 
-
-    if( -1 == poll(&pfd,1,0) )
-        {
-        MSGQ_LOGEB("poll() error: %s", strerror(errno));
-        LOG_FUNCTION_NAME_EXIT;
-        return false;
-        }
-
-    if(pfd.revents & POLLIN)
-        {
-        mHasMsg = true;
-        }
-    else
-        {
-        mHasMsg = false;
-        }
+    mHasMsg = pending();
 
     LOG_FUNCTION_NAME_EXIT;
     return !mHasMsg;
@@ -281,19 +473,21 @@ void MessageQueue::clear()
 {
     LOG_FUNCTION_NAME;
 
-    if(!this->fd_read)
+    if(!this->mSlots)
         {
-        MSGQ_LOGEA("read descriptor not initialized for message queue");
+        MSGQ_LOGEA("message ring not initialized for message queue");
         LOG_FUNCTION_NAME_EXIT;
         return;
         }
 
     Message msg;
-    while(!isEmpty())
+    while(tryGet(&msg))
         {
-        get(&msg);
         }
 
+    mHasMsg = false;
+
+    LOG_FUNCTION_NAME_EXIT;
 }
 
 
@@ -310,110 +504,159 @@ void MessageQueue::setMsg(bool hasMsg)
 
 
 /**
-   @briefWait for message in maximum three different queues with a timeout
-
-   @param queue1 First queue. At least this should be set to a valid queue pointer
-   @param queue2 Second queue. Optional.
-   @param queue3 Third queue. Optional.
-   @param timeout The timeout value (in micro secs) to wait for a message in any of the queues
-   @return android::NO_ERROR On success
-   @return android::BAD_VALUE If queue1 is NULL
-   @return android::NO_INIT If the file read descriptor of any of the provided queues is not set
+   @brief Wait for message in any of the given queues with a timeout
+
+   Queues holding messages are marked with setMsg(true). The calling thread
+   sleeps on a single eventfd registered with all the queues, messages put
+   while nobody waits cost no syscall.
+
+   @param queues Array of queues, all of them must be valid queue pointers
+   @param count Number of queues in the array
+   @param timeout The timeout value (in milli secs) to wait for a message in any of the queues, -1 waits forever
+   @return Number of queues holding messages, 0 on timeout
+   @return android::BAD_VALUE If no valid queue is given
+   @return android::NO_INIT If the message ring of any of the provided queues is not allocated
  */
-android::status_t MessageQueue::waitForMsg(MessageQueue *queue1, MessageQueue *queue2, MessageQueue *queue3, int timeout)
+int MessageQueue::waitForMsg(MessageQueue **queues, int count, int timeout)
     {
     LOG_FUNCTION_NAME;
 
-    int n =1;
-    struct pollfd pfd[3];
+    int i, ret = 0, fd;
 
-    if(!queue1)
+    if(!queues || count <= 0)
         {
-        MSGQ_LOGEA("queue1 pointer is NULL");
+        MSGQ_LOGEA("no queue to wait for");
         LOG_FUNCTION_NAME_EXIT;
         return android::BAD_VALUE;
         }
 
-    pfd[0].fd = queue1->getInFd();
-    if(!pfd[0].fd)
+    for ( i = 0; i < count; i++ )
         {
-        MSGQ_LOGEA("read descriptor not initialized for message queue1");
-        LOG_FUNCTION_NAME_EXIT;
-        return android::NO_INIT;
-        }
-    pfd[0].events = POLLIN;
-    pfd[0].revents = 0;
-    if(queue2)
-        {
-        MSGQ_LOGDA("queue2 not-null");
-        pfd[1].fd = queue2->getInFd();
-        if(!pfd[1].fd)
+        if(!queues[i])
             {
-            MSGQ_LOGEA("read descriptor not initialized for message queue2");
+            MSGQ_LOGEB("queue%d pointer is NULL", i + 1);
             LOG_FUNCTION_NAME_EXIT;
-            return android::NO_INIT;
+            return android::BAD_VALUE;
             }
-
-        pfd[1].events = POLLIN;
-        pfd[1].revents = 0;
-        n++;
-        }
-
-    if(queue3)
-        {
-        MSGQ_LOGDA("queue3 not-null");
-        pfd[2].fd = queue3->getInFd();
-        if(!pfd[2].fd)
+        if(!queues[i]->mSlots)
             {
-            MSGQ_LOGEA("read descriptor not initialized for message queue3");
+            MSGQ_LOGEB("message ring not initialized for message queue%d", i + 1);
             LOG_FUNCTION_NAME_EXIT;
             return android::NO_INIT;
             }
-
-        pfd[2].events = POLLIN;
-        pfd[2].revents = 0;
-        n++;
+        if ( queues[i]->pending() )
+            {
+            queues[i]->setMsg(true);
+            ret++;
+            }
         }
 
-
-    int ret = poll(pfd, n, timeout);
-    if(ret==0)
+    if ( ret || !timeout )
         {
         LOG_FUNCTION_NAME_EXIT;
         return ret;
         }
 
-    if(ret<android::NO_ERROR)
+    fd = waiterFd();
+    if ( fd < 0 )
         {
-        MSGQ_LOGEB("Message queue returned error %d", ret);
         LOG_FUNCTION_NAME_EXIT;
-        return ret;
+        return android::UNKNOWN_ERROR;
         }
 
-    if (pfd[0].revents & POLLIN)
+    do
         {
-        queue1->setMsg(true);
-        }
+        for ( i = 0; i < count; i++ )
+            {
+            queues[i]->setWaiter(fd);
+            }
 
-    if(queue2)
-        {
-        if (pfd[1].revents & POLLIN)
+        // Pairs with the fence in wake(): either the producer sees our
+        // eventfd or we see its message
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        for ( i = 0; i < count && !ret; i++ )
             {
-            queue2->setMsg(true);
+            ret = queues[i]->pending();
             }
-        }
 
-    if(queue3)
-        {
-        if (pfd[2].revents & POLLIN)
+        if ( !ret )
             {
-            queue3->setMsg(true);
+            struct pollfd pfd;
+
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+
+            int err = poll(&pfd, 1, timeout);
+            if ( 0 < err )
+                {
+                eventfd_t value;
+                eventfd_read(fd, &value);
+                }
+            else if ( -1 == err && EINTR != errno )
+                {
+                MSGQ_LOGEB("poll() error: %s", strerror(errno));
+                }
+            }
+
+        for ( i = 0; i < count; i++ )
+            {
+            queues[i]->setWaiter(-1);
+            }
+
+        ret = 0;
+        for ( i = 0; i < count; i++ )
+            {
+            if ( queues[i]->pending() )
+                {
+                queues[i]->setMsg(true);
+                ret++;
+                }
             }
-        }
+
+        // A late signal from an earlier wait only wakes us up spuriously
+        } while ( !ret && timeout < 0 );
 
     LOG_FUNCTION_NAME_EXIT;
     return ret;
     }
 
+
+/**
+   @brief Wait for message in maximum three different queues with a timeout
+
+   @param queue1 First queue. At least this should be set to a valid queue pointer
+   @param queue2 Second queue. Optional.
+   @param queue3 Third queue. Optional.
+   @param timeout The timeout value (in milli secs) to wait for a message in any of the queues
+   @return Number of queues holding messages, 0 on timeout
+   @return android::BAD_VALUE If queue1 is NULL
+   @return android::NO_INIT If the message ring of any of the provided queues is not allocated
+ */
+int MessageQueue::waitForMsg(MessageQueue *queue1, MessageQueue *queue2, MessageQueue *queue3, int timeout)
+    {
+    MessageQueue *queues[3];
+    int n = 0;
+
+    if(!queue1)
+        {
+        MSGQ_LOGEA("queue1 pointer is NULL");
+        return android::BAD_VALUE;
+        }
+
+    queues[n++] = queue1;
+    if(queue2)
+        {
+        queues[n++] = queue2;
+        }
+    if(queue3)
+        {
+        queues[n++] = queue3;
+        }
+
+    return waitForMsg(queues, n, timeout);
+    }
+
 } // namespace Utils
 } // namespace Ti
@@ -48,6 +48,10 @@ struct Message
 };
 
 ///Message queue implementation
+///
+///Messages are kept in a bounded lock-free ring, put() and get() do not enter
+///the kernel unless a thread is blocked waiting for the queue. Any thread may
+///put messages, one thread at a time may wait for them.
 class MessageQueue
 {
 public:
@@ -55,15 +59,12 @@ public:
     MessageQueue();
     ~MessageQueue();
 
-    ///Get a message from the queue
+    ///Get a message from the queue, waits for one if the queue is empty
     android::status_t get(Message*);
 
-    ///Get the input file descriptor of the message queue
+    ///Get a file descriptor that polls readable while messages are queued
     int getInFd();
 
-    ///Set the input file descriptor for the message queue
-    void setInFd(int fd);
-
     ///Queue a message
     android::status_t put(Message*);
 
@@ -75,6 +76,9 @@ public:
     ///Force whether the message queue has message or not
     void setMsg(bool hasMsg=false);
 
+    ///Wait for message in any of the given queues with a timeout
+    static int waitForMsg(MessageQueue **queues, int count, int timeout);
+
     ///Wait for message in maximum three different queues with a timeout
     static int waitForMsg(MessageQueue *queue1, MessageQueue *queue2=0, MessageQueue *queue3=0, int timeout = 0);
 
@@ -84,8 +88,41 @@ public:
     }
 
 private:
-    int fd_read;
-    int fd_write;
+    ///Ring size, a power of two. Holds about as many messages as a pipe did.
+    static const uint32_t kSlots = 1024;
+
+    struct Slot
+    {
+        volatile uint32_t seq;
+        Message msg;
+    };
+
+    bool tryGet(Message*);
+    bool tryPut(Message*);
+    bool pending();
+    void wake();
+    void setWaiter(int fd);
+    static int waiterFd();
+
+    Slot *mSlots;
+
+    ///Producers and the consumer work on separate cache lines
+    volatile uint32_t mEnqueuePos;
+    char mPad0[60];
+    volatile uint32_t mDequeuePos;
+    char mPad1[60];
+
+    ///eventfd of the thread waiting for this queue, -1 if none
+    volatile int mWaiterFd;
+    ///eventfd handed out by getInFd, -1 until requested
+    volatile int mPollFd;
+    android::Mutex mPollFdLock;
+
+    ///Producers blocked on a full ring
+    volatile int mFullWaiters;
+    android::Mutex mFullLock;
+    android::Condition mFullCond;
+
     bool mHasMsg;
 };
 
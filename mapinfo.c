@@ -104,3 +104,64 @@ const mapinfo *pc_to_mapinfo(mapinfo *mi, unsigned pc, unsigned *rel_pc)
     }
     return NULL;
 }
+
+static int compare_start(const void *a, const void *b)
+{
+    const mapinfo *ma = *(const mapinfo * const *)a;
+    const mapinfo *mb = *(const mapinfo * const *)b;
+    return ma->start < mb->start ? -1 : ma->start > mb->start;
+}
+
+/* Build an index for looking up pcs in O(log n), the list must outlive it */
+mapindex *index_mapinfo(const mapinfo *mi)
+{
+    mapindex *idx;
+    const mapinfo *m;
+    unsigned count = 0;
+
+    for (m = mi; m; m = m->next)
+        count++;
+
+    idx = __real_malloc(sizeof(mapindex) + count * sizeof(mapinfo *));
+    if(idx == 0) return 0;
+
+    idx->count = 0;
+    for (m = mi; m; m = m->next)
+        idx->maps[idx->count++] = m;
+    qsort(idx->maps, idx->count, sizeof(mapinfo *), compare_start);
+
+    return idx;
+}
+
+void deinit_mapindex(mapindex *idx)
+{
+    __real_free(idx);
+}
+
+/* Same as pc_to_mapinfo but binary searches the index */
+const mapinfo *pc_to_mapindex(const mapindex *idx, unsigned pc, unsigned *rel_pc)
+{
+    unsigned lo = 0, hi = idx->count, mid;
+    const mapinfo *mi;
+
+    *rel_pc = pc;
+    /* find the last map starting at or below pc */
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (idx->maps[mid]->start <= pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!lo)
+        return NULL;
+
+    mi = idx->maps[lo - 1];
+    if (pc >= mi->end)
+        return NULL;
+    // Only calculate the relative offset for shared libraries
+    if (strstr(mi->name, ".so")) {
+        *rel_pc -= mi->start;
+    }
+    return mi;
+}
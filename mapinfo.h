@@ -8,9 +8,18 @@ typedef struct mapinfo {
     char name[];
 } mapinfo;
 
+/* The maps of a mapinfo list sorted by start address */
+typedef struct mapindex {
+    unsigned count;
+    const mapinfo *maps[];
+} mapindex;
+
 mapinfo *init_mapinfo(int pid);
 void deinit_mapinfo(mapinfo *mi);
 const char *map_to_name(mapinfo *mi, unsigned pc, const char* def);
 const mapinfo *pc_to_mapinfo(mapinfo *mi, unsigned pc, unsigned *rel_pc);
+mapindex *index_mapinfo(const mapinfo *mi);
+void deinit_mapindex(mapindex *idx);
+const mapinfo *pc_to_mapindex(const mapindex *idx, unsigned pc, unsigned *rel_pc);
 
 #endif
@@ -538,6 +538,7 @@ $(eval $(call TunableKernelConfigC,PVRSRV_DUMP_MK_TRACE,))
 $(eval $(call TunableKernelConfigC,PVRSRV_DUMP_KERNEL_CCB,))
 $(eval $(call TunableKernelConfigC,PVRSRV_REFCOUNT_DEBUG,))
 $(eval $(call TunableKernelConfigC,PVRSRV_MMU_MAKE_READWRITE_ON_DEMAND,))
+$(eval $(call TunableKernelConfigC,PVR_HASH_OPEN_ADDRESSING,))
 $(eval $(call TunableKernelConfigC,HYBRID_SHARED_PB_SIZE,))
 $(eval $(call TunableKernelConfigC,SUPPORT_LARGE_GENERAL_HEAP,))
 $(eval $(call TunableKernelConfigC,TTRACE,))
@@ -4236,6 +4236,7 @@ _SetDispatchTableEntry(IMG_UINT32 ui32Index,
 	}
 
 	g_BridgeDispatchTable[ui32Index].pfFunction = pfFunction;
+	g_BridgeDispatchTable[ui32Index].eLockClass = PVRSRV_BRIDGE_LOCK_GLOBAL;
 #if defined(DEBUG_BRIDGE_KM)
 	g_BridgeDispatchTable[ui32Index].pszIOCName = pszIOCName;
 	g_BridgeDispatchTable[ui32Index].pszFunctionName = pszFunctionName;
@@ -5335,6 +5336,17 @@ CommonBridgeInit(IMG_VOID)
 	SetDispatchTableEntry(PVRSRV_BRIDGE_ALLOC_SYNC_INFO, PVRSRVAllocSyncInfoBW);
 	SetDispatchTableEntry(PVRSRV_BRIDGE_FREE_SYNC_INFO, PVRSRVFreeSyncInfoBW);
 
+#if !defined(PDUMP)
+	/* Sync op queries only read the sync data of objects the caller has a
+	 * handle to and are polled by every client waiting on a render, they
+	 * don't need to wait behind the kicks and mappings of other processes.
+	 * With PDUMP they write polls to the shared script and stay global. */
+	SetDispatchTableEntryLockClass(PVRSRV_BRIDGE_SYNC_OPS_TAKE_TOKEN, PVRSRV_BRIDGE_LOCK_PROCESS);
+	SetDispatchTableEntryLockClass(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_TOKEN, PVRSRV_BRIDGE_LOCK_PROCESS);
+	SetDispatchTableEntryLockClass(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_MOD_OBJ, PVRSRV_BRIDGE_LOCK_PROCESS);
+	SetDispatchTableEntryLockClass(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_DELTA, PVRSRV_BRIDGE_LOCK_PROCESS);
+#endif
+
 #if defined (SUPPORT_SGX)
 	SetSGXDispatchTableEntry();
 #endif
@@ -5355,6 +5367,7 @@ CommonBridgeInit(IMG_VOID)
 		if(!g_BridgeDispatchTable[i].pfFunction)
 		{
 			g_BridgeDispatchTable[i].pfFunction = &DummyBW;
+			g_BridgeDispatchTable[i].eLockClass = PVRSRV_BRIDGE_LOCK_GLOBAL;
 #if defined(DEBUG_BRIDGE_KM)
 			g_BridgeDispatchTable[i].pszIOCName = "_PVRSRV_BRIDGE_DUMMY";
 			g_BridgeDispatchTable[i].pszFunctionName = "DummyBW";
@@ -5368,8 +5381,12 @@ CommonBridgeInit(IMG_VOID)
 	return PVRSRV_OK;
 }
 
-IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
-					  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM)
+static IMG_INT
+_BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
+				   PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM,
+				   IMG_VOID                * pvBridgeData,
+				   IMG_UINT32                ui32InBufferMax,
+				   IMG_UINT32                ui32OutBufferMax)
 {
 	IMG_VOID   * psBridgeIn;
 	IMG_VOID   * psBridgeOut;
@@ -5428,18 +5445,12 @@ IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 
 #if defined(__linux__)
 	{
-		/* This should be moved into the linux specific code */
-		SYS_DATA *psSysData;
-
-		SysAcquireData(&psSysData);
-
-		/* We have already set up some static buffers to store our ioctl data... */
-		psBridgeIn = ((ENV_DATA *)psSysData->pvEnvSpecificData)->pvBridgeData;
-		psBridgeOut = (IMG_PVOID)((IMG_PBYTE)psBridgeIn + PVRSRV_MAX_BRIDGE_IN_SIZE);
+		psBridgeIn = pvBridgeData;
+		psBridgeOut = (IMG_PVOID)((IMG_PBYTE)psBridgeIn + ui32InBufferMax);
 
 		/* check we are not using a bigger bridge than allocated */
-		if((psBridgePackageKM->ui32InBufferSize > PVRSRV_MAX_BRIDGE_IN_SIZE) || 
-			(psBridgePackageKM->ui32OutBufferSize > PVRSRV_MAX_BRIDGE_OUT_SIZE))
+		if((psBridgePackageKM->ui32InBufferSize > ui32InBufferMax) || 
+			(psBridgePackageKM->ui32OutBufferSize > ui32OutBufferMax))
 		{
 			goto return_fault;
 		}
@@ -5466,6 +5477,10 @@ IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 		}
 	}
 #else
+	PVR_UNREFERENCED_PARAMETER(pvBridgeData);
+	PVR_UNREFERENCED_PARAMETER(ui32InBufferMax);
+	PVR_UNREFERENCED_PARAMETER(ui32OutBufferMax);
+
 	psBridgeIn  = psBridgePackageKM->pvParamIn;
 	psBridgeOut = psBridgePackageKM->pvParamOut;
 #endif
@@ -5507,6 +5522,62 @@ return_fault:
 	return err;
 }
 
+IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
+					  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM)
+{
+#if defined(__linux__)
+	/* This should be moved into the linux specific code */
+	SYS_DATA *psSysData;
+
+	SysAcquireData(&psSysData);
+
+	/* We have already set up some static buffers to store our ioctl data,
+	 * they are shared so the caller holds the global services lock */
+	return _BridgedDispatchKM(psPerProc,
+							  psBridgePackageKM,
+							  ((ENV_DATA *)psSysData->pvEnvSpecificData)->pvBridgeData,
+							  PVRSRV_MAX_BRIDGE_IN_SIZE,
+							  PVRSRV_MAX_BRIDGE_OUT_SIZE);
+#else
+	return _BridgedDispatchKM(psPerProc, psBridgePackageKM, IMG_NULL, 0, 0);
+#endif
+}
+
+#if defined(__linux__)
+/*!
+******************************************************************************
+
+ @Function	BridgedDispatchUnlockedKM
+
+ @Description	Dispatch an ioctl of class PVRSRV_BRIDGE_LOCK_PROCESS without
+				the global services lock. The arguments are copied to the
+				stack instead of the shared bridge buffers, so they must fit
+				PVRSRV_BRIDGE_UNLOCKED_IN_SIZE and PVRSRV_BRIDGE_UNLOCKED_OUT_SIZE.
+
+ @Input		psPerProc - per-process data of the caller
+ @Input		psBridgePackageKM - ioctl package, copied from userspace
+
+ @Return	0 on success, -EFAULT otherwise
+
+******************************************************************************/
+IMG_INT BridgedDispatchUnlockedKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
+							  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM)
+{
+	IMG_UINT32 aui32BridgeData[(PVRSRV_BRIDGE_UNLOCKED_IN_SIZE +
+								PVRSRV_BRIDGE_UNLOCKED_OUT_SIZE) / sizeof(IMG_UINT32)];
+
+	PVR_ASSERT(psBridgePackageKM->ui32BridgeID < BRIDGE_DISPATCH_TABLE_ENTRY_COUNT &&
+			   g_BridgeDispatchTable[psBridgePackageKM->ui32BridgeID].eLockClass ==
+			   PVRSRV_BRIDGE_LOCK_PROCESS);
+
+	return _BridgedDispatchKM(psPerProc,
+							  psBridgePackageKM,
+							  aui32BridgeData,
+							  PVRSRV_BRIDGE_UNLOCKED_IN_SIZE,
+							  PVRSRV_BRIDGE_UNLOCKED_OUT_SIZE);
+}
+#endif
+
 /******************************************************************************
  End of file (bridged_pvr_bridge.c)
 ******************************************************************************/
@@ -171,10 +171,28 @@ typedef IMG_INT (*BridgeWrapperFunction)(IMG_UINT32 ui32BridgeID,
 									 IMG_VOID *psBridgeOut,
 									 PVRSRV_PER_PROCESS_DATA *psPerProc);
 
+/*!
+ * Lock needed to dispatch an ioctl. Every entry defaults to the global
+ * services lock, an entry may only be relaxed to PVRSRV_BRIDGE_LOCK_PROCESS
+ * if its wrapper function and everything it calls:
+ *  - only reaches objects through the caller's own handle base,
+ *  - does not change any handle, object or device state,
+ *  - never blocks or takes the global services lock.
+ * Such calls may run concurrently with each other and with calls from other
+ * processes; the OS layer keeps them out while a call of the same process
+ * holding the global lock is in flight.
+ */
+typedef enum _PVRSRV_BRIDGE_LOCK_CLASS_
+{
+	PVRSRV_BRIDGE_LOCK_GLOBAL = 0,	/*!< Serialised with all of services */
+	PVRSRV_BRIDGE_LOCK_PROCESS,		/*!< Read only, per-process objects only */
+} PVRSRV_BRIDGE_LOCK_CLASS;
+
 typedef struct _PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY
 {
 	BridgeWrapperFunction pfFunction; /*!< The wrapper function that validates the ioctl
 										arguments before calling into srvkm proper */
+	PVRSRV_BRIDGE_LOCK_CLASS eLockClass; /*!< Lock the OS layer takes around the call */
 #if defined(DEBUG_BRIDGE_KM)
 	const IMG_CHAR *pszIOCName; /*!< Name of the ioctl: e.g. "PVRSRV_BRIDGE_CONNECT_SERVICES" */
 	const IMG_CHAR *pszFunctionName; /*!< Name of the wrapper function: e.g. "PVRSRVConnectBW" */
@@ -183,6 +201,10 @@ typedef struct _PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY
 											 userspace within this ioctl */
 	IMG_UINT32 ui32CopyToUserTotalBytes; /*!< The total number of bytes copied from
 										   userspace within this ioctl */
+	IMG_UINT32 ui32UnlockedCallCount; /*!< Calls dispatched without the global lock */
+	IMG_UINT32 ui32LockWaitCount; /*!< Calls that found the global lock taken */
+	IMG_UINT32 ui32LockWaitTotalus; /*!< Total time spent waiting for the global lock */
+	IMG_UINT32 ui32LockWaitMaxus; /*!< Longest single wait for the global lock */
 #endif
 }PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY;
 
@@ -217,6 +239,10 @@ _SetDispatchTableEntry(IMG_UINT32 ui32Index,
 #define SetDispatchTableEntry(ui32Index, pfFunction) \
 	_SetDispatchTableEntry(PVRSRV_GET_BRIDGE_ID(ui32Index), #ui32Index, (BridgeWrapperFunction)pfFunction, #pfFunction)
 
+/* PRQA S 0884,3410 2*/ /* macro relies on the lack of brackets */
+#define SetDispatchTableEntryLockClass(ui32Index, eClass) \
+	g_BridgeDispatchTable[PVRSRV_GET_BRIDGE_ID(ui32Index)].eLockClass = eClass
+
 #define DISPATCH_TABLE_GAP_THRESHOLD 5
 
 #if defined(DEBUG)
@@ -232,6 +258,7 @@ typedef struct _PVRSRV_BRIDGE_GLOBAL_STATS
 	IMG_UINT32 ui32IOCTLCount;
 	IMG_UINT32 ui32TotalCopyFromUserBytes;
 	IMG_UINT32 ui32TotalCopyToUserBytes;
+	IMG_UINT32 ui32TotalLockWaitus;
 }PVRSRV_BRIDGE_GLOBAL_STATS;
 
 /* OS specific code way want to report the stats held here and within the
@@ -246,6 +273,16 @@ PVRSRV_ERROR CommonBridgeInit(IMG_VOID);
 IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 					  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM);
 
+#if defined(__linux__)
+/* Largest ioctl arguments a call dispatched without the global lock may
+ * have, they are copied on the stack rather than to the shared buffers */
+#define PVRSRV_BRIDGE_UNLOCKED_IN_SIZE	64
+#define PVRSRV_BRIDGE_UNLOCKED_OUT_SIZE	64
+
+IMG_INT BridgedDispatchUnlockedKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
+							  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM);
+#endif
+
 #if defined (__cplusplus)
 }
 #endif
@@ -60,6 +60,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define	KEY_COMPARE(pHash, pKey1, pKey2) \
 	((pHash)->pfnKeyComp((pHash)->uKeySize, (pKey1), (pKey2)))
 
+#if !defined(PVR_HASH_OPEN_ADDRESSING)
 /* Each entry in a hash table is placed into a bucket */
 struct _BUCKET_
 {
@@ -98,6 +99,106 @@ struct _HASH_TABLE_
 	HASH_KEY_COMP *pfnKeyComp;
 };
 
+#else /* !defined(PVR_HASH_OPEN_ADDRESSING) */
+
+/*
+ * Open addressing backend: entries live in a flat array of slots, so an
+ * insert does not allocate and a lookup touches one or two cache lines
+ * instead of walking a chain. Probing is linear with Robin Hood ordering:
+ * an insert takes the slot of the first entry closer to its home slot than
+ * the new one, moving the rest of the run up, so every run is sorted by
+ * distance from home. Lookups for missing keys stop early and a remove
+ * just moves the following entries that are away from home back by one,
+ * no tombstones build up under the insert and remove churn of the resource
+ * arenas. While HASH_Iterate runs nothing may move, a removed entry is left
+ * as a tombstone instead which keeps its place in the ordering.
+ *
+ * Resizing is incremental: the new slot array becomes current and the old
+ * one is drained HASH_MIGRATE_SLOTS slots per insert or remove. Lookups
+ * look in both until the old array is empty.
+ */
+
+/*
+ * Slot tags: a used slot has the key hash shifted up and both low bits set,
+ * a tombstone has the low bit cleared.
+ */
+#define SLOT_EMPTY				0
+#define SLOT_TAG(uHash)			(((IMG_UINTPTR_T)(uHash) << 2) | 3)
+#define SLOT_USED(uTag)			(((uTag) & 3) == 3)
+#define SLOT_TOMBSTONE(uTag)	((uTag) & ~(IMG_UINTPTR_T)1)
+#define SLOT_HOME(uTag, uMask)	((IMG_UINT32)((uTag) >> 2) & (uMask))
+
+/* Old slots moved to the new array per insert or remove during a resize */
+#define HASH_MIGRATE_SLOTS	8
+
+/* Each entry in a hash table occupies a slot */
+struct _SLOT_
+{
+	/* SLOT_EMPTY, SLOT_TAG of the key hash or its SLOT_TOMBSTONE */
+	IMG_UINTPTR_T uTag;
+
+	/* entry value */
+	IMG_UINTPTR_T v;
+
+	/* entry key */
+	IMG_UINTPTR_T k[];		/* PRQA S 0642 */ /* override dynamic array declaration warning */
+};
+typedef struct _SLOT_ SLOT;
+
+/* A slot array, the size is always a power of two */
+typedef struct _SLOT_TABLE_
+{
+	/* the slots, uSlotSize bytes each */
+	IMG_UINT8 *pui8Slots;
+
+	/* number of slots */
+	IMG_UINT32 uSize;
+
+	/* number of used slots */
+	IMG_UINT32 uUsed;
+
+	/* number of tombstones */
+	IMG_UINT32 uDeleted;
+} SLOT_TABLE;
+
+struct _HASH_TABLE_
+{
+	/* the slot array entries are inserted into */
+	SLOT_TABLE sTable;
+
+	/* the slot array being drained during a resize, IMG_NULL slots if none */
+	SLOT_TABLE sOldTable;
+
+	/* next slot of sOldTable to migrate */
+	IMG_UINT32 uMigrate;
+
+	/* number of entries currently in the hash table */
+	IMG_UINT32 uCount;
+
+	/* the minimum number of slots the hash table should be re-sized to */
+	IMG_UINT32 uMinimumSize;
+
+	/* size of key in bytes */
+	IMG_UINT32 uKeySize;
+
+	/* size of a slot in bytes */
+	IMG_UINT32 uSlotSize;
+
+	/* non zero while HASH_Iterate runs, slots must not move */
+	IMG_UINT32 uIterating;
+
+	/* hash function */
+	HASH_FUNC *pfnHashFunc;
+
+	/* key comparison function */
+	HASH_KEY_COMP *pfnKeyComp;
+};
+
+#define SLOT_AT(pHash, psTable, uIndex) \
+	((SLOT *)((psTable)->pui8Slots + (IMG_SIZE_T)(uIndex) * (pHash)->uSlotSize))
+
+#endif /* !defined(PVR_HASH_OPEN_ADDRESSING) */
+
 /*!
 ******************************************************************************
 	@Function   	HASH_Func_Default
@@ -173,6 +274,7 @@ HASH_Key_Comp_Default (IMG_SIZE_T uKeySize, IMG_VOID *pKey1, IMG_VOID *pKey2)
 	return IMG_TRUE;
 }
 
+#if !defined(PVR_HASH_OPEN_ADDRESSING)
 /*!
 ******************************************************************************
 	@Function   	_ChainInsert
@@ -353,26 +455,6 @@ HASH_TABLE * HASH_Create_Extended (IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize,
 	return pHash;
 }
 
-/*!
-******************************************************************************
-	@Function   	HASH_Create
-
-	@Description    Create a self scaling hash table with a key
-                    consisting of a single IMG_UINTPTR_T, and using
-                    the default hash and key comparison functions.
-
-	@Input          uInitialLen - initial and minimum length of the
-                    hash table, where the length refers to the
-                    number of entries in the hash table, not its size
-                    in bytes.
-	@Return 	    IMG_NULL or hash table handle.
-******************************************************************************/
-HASH_TABLE * HASH_Create (IMG_UINT32 uInitialLen)
-{
-	return HASH_Create_Extended(uInitialLen, sizeof(IMG_UINTPTR_T),
-		&HASH_Func_Default, &HASH_Key_Comp_Default);
-}
-
 /*!
 ******************************************************************************
 	@Function       HASH_Delete
@@ -470,30 +552,6 @@ HASH_Insert_Extended (HASH_TABLE *pHash, IMG_VOID *pKey, IMG_UINTPTR_T v)
 	return IMG_TRUE;
 }
 
-/*!
-******************************************************************************
-	@Function   	HASH_Insert
-
-	@Description    Insert a key value pair into a hash table created with
-                    HASH_Create.
-
-	@Input          pHash - the hash table.
-	@Input          k - the key value.
-	@Input          v - the value associated with the key.
-
-	@Return 	    IMG_TRUE - success.
-	            	IMG_FALSE - failure.
-******************************************************************************/
-IMG_BOOL
-HASH_Insert (HASH_TABLE *pHash, IMG_UINTPTR_T k, IMG_UINTPTR_T v)
-{
-	PVR_DPF ((PVR_DBG_MESSAGE,
-              "HASH_Insert: Hash=0x%x, k=0x%x, v=0x%x",
-              (IMG_UINTPTR_T)pHash, k, v));
-
-	return HASH_Insert_Extended(pHash, &k, v);
-}
-
 /*!
 ******************************************************************************
 	@Function   	HASH_Remove_Extended
@@ -564,28 +622,6 @@ HASH_Remove_Extended(HASH_TABLE *pHash, IMG_VOID *pKey)
 	return 0;
 }
 
-/*!
-******************************************************************************
-	@Function   	HASH_Remove
-
-	@Description    Remove a key value pair from a hash table created
-                    with HASH_Create.
-
-	@Input          pHash - the hash table
-	@Input          k - the key
-
-	@Return         0 if the key is missing, or the value associated
-                    with the key.
-******************************************************************************/
-IMG_UINTPTR_T
-HASH_Remove (HASH_TABLE *pHash, IMG_UINTPTR_T k)
-{
-	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Remove: Hash=0x%x, k=0x%x",
-			(IMG_UINTPTR_T)pHash, k));
-
-	return HASH_Remove_Extended(pHash, &k);
-}
-
 /*!
 ******************************************************************************
 	@Function   	HASH_Retrieve_Extended
@@ -638,26 +674,6 @@ HASH_Retrieve_Extended (HASH_TABLE *pHash, IMG_VOID *pKey)
 	return 0;
 }
 
-/*!
-******************************************************************************
-	@Function   	HASH_Retrieve
-
-	@Description    Retrieve a value from a hash table created with
-                    HASH_Create.
-
-	@Input          pHash - the hash table
-	@Input          k - the key
-	@Return 	    0 if the key is missing, or the value associated with
-                    the key.
-******************************************************************************/
-IMG_UINTPTR_T
-HASH_Retrieve (HASH_TABLE *pHash, IMG_UINTPTR_T k)
-{
-	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Retrieve: Hash=0x%x, k=0x%x",
-			(IMG_UINTPTR_T)pHash, k));
-	return HASH_Retrieve_Extended(pHash, &k);
-}
-
 /*!
 ******************************************************************************
 	@Function   	HASH_Iterate
@@ -736,3 +752,819 @@ HASH_Dump (HASH_TABLE *pHash)
 	PVR_TRACE(("  empty=%d  max=%d", uEmptyCount, uMaxLength));
 }
 #endif
+
+#else /* !defined(PVR_HASH_OPEN_ADDRESSING) */
+
+/*!
+******************************************************************************
+	@Function   	_RoundUpPow2
+
+	@Description    Round a number of slots up to a power of two.
+
+	@Input          uSize - the required number of slots.
+
+	@Return         The number of slots to allocate.
+******************************************************************************/
+static IMG_UINT32
+_RoundUpPow2 (IMG_UINT32 uSize)
+{
+	IMG_UINT32 uPow2 = 8;
+
+	while (uPow2 < uSize)
+		uPow2 <<= 1;
+	return uPow2;
+}
+
+/*!
+******************************************************************************
+	@Function   	_SlotTableInit
+
+	@Description    Allocate an array of empty slots.
+
+	@Input          pHash - the hash table.
+	@Input          psTable - the slot array to initialise.
+	@Input          uSize - number of slots, a power of two.
+
+	@Return         IMG_TRUE Success
+	            	IMG_FALSE Failed
+******************************************************************************/
+static IMG_BOOL
+_SlotTableInit (HASH_TABLE *pHash, SLOT_TABLE *psTable, IMG_UINT32 uSize)
+{
+	if (OSAllocMem(PVRSRV_PAGEABLE_SELECT,
+					(IMG_SIZE_T)uSize * pHash->uSlotSize,
+					(IMG_VOID **)&psTable->pui8Slots, IMG_NULL,
+					"Hash Table Slots") != PVRSRV_OK)
+	{
+		psTable->pui8Slots = IMG_NULL;
+		return IMG_FALSE;
+	}
+
+	OSMemSet(psTable->pui8Slots, 0, (IMG_SIZE_T)uSize * pHash->uSlotSize);
+	psTable->uSize = uSize;
+	psTable->uUsed = 0;
+	psTable->uDeleted = 0;
+	return IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+	@Function   	_SlotTableDeinit
+
+	@Description    Free an array of slots.
+
+	@Input          pHash - the hash table.
+	@Input          psTable - the slot array.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_SlotTableDeinit (HASH_TABLE *pHash, SLOT_TABLE *psTable)
+{
+	if (psTable->pui8Slots != IMG_NULL)
+	{
+		OSFreeMem(PVRSRV_PAGEABLE_SELECT,
+				  (IMG_SIZE_T)psTable->uSize * pHash->uSlotSize,
+				  psTable->pui8Slots, IMG_NULL);
+		psTable->pui8Slots = IMG_NULL;
+	}
+	psTable->uSize = 0;
+	psTable->uUsed = 0;
+	psTable->uDeleted = 0;
+}
+
+/*!
+******************************************************************************
+	@Function   	_SlotCopy
+
+	@Description    Copy a slot, slots are whole IMG_UINTPTR_Ts.
+
+	@Input          pHash - the hash table.
+	@Input          pDst - the slot to copy to.
+	@Input          pSrc - the slot to copy from.
+
+	@Return         None
+******************************************************************************/
+static INLINE IMG_VOID
+_SlotCopy (HASH_TABLE *pHash, SLOT *pDst, SLOT *pSrc)
+{
+	IMG_UINTPTR_T *puDst = (IMG_UINTPTR_T *)pDst;
+	IMG_UINTPTR_T *puSrc = (IMG_UINTPTR_T *)pSrc;
+	IMG_UINT32 uWords = pHash->uSlotSize / sizeof(IMG_UINTPTR_T);
+
+	while (uWords-- != 0)
+		*puDst++ = *puSrc++;
+}
+
+/*!
+******************************************************************************
+	@Function   	_SlotFind
+
+	@Description    Find the slot holding a key.
+
+	@Input          pHash - the hash table.
+	@Input          psTable - the slot array to search.
+	@Input          pKey - pointer to the key.
+	@Output         puIndex - index of the slot found.
+
+	@Return         IMG_NULL or the slot.
+******************************************************************************/
+static SLOT *
+_SlotFind (HASH_TABLE *pHash, SLOT_TABLE *psTable, IMG_VOID *pKey, IMG_UINT32 *puIndex)
+{
+	IMG_UINT32 uMask = psTable->uSize - 1;
+	IMG_UINT32 uHash;
+	IMG_UINT32 uIndex;
+	IMG_UINT32 uDist;
+	IMG_UINTPTR_T uTag;
+
+	if (psTable->uUsed == 0)
+		return IMG_NULL;
+
+	uHash = pHash->pfnHashFunc(pHash->uKeySize, pKey, psTable->uSize);
+	uTag = SLOT_TAG(uHash);
+
+	for (uIndex = uHash & uMask, uDist = 0; uDist < psTable->uSize; uIndex = (uIndex + 1) & uMask, uDist++)
+	{
+		SLOT *pSlot = SLOT_AT(pHash, psTable, uIndex);
+
+		/* Past the entries that are further from home than the key would be */
+		if (pSlot->uTag == SLOT_EMPTY ||
+			((uIndex - SLOT_HOME(pSlot->uTag, uMask)) & uMask) < uDist)
+			break;
+
+		/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
+		if (pSlot->uTag == uTag && KEY_COMPARE(pHash, pSlot->k, pKey))
+		{
+			*puIndex = uIndex;
+			return pSlot;
+		}
+	}
+	return IMG_NULL;
+}
+
+/*!
+******************************************************************************
+	@Function   	_SlotInsert
+
+	@Description    Put a key value pair into a slot array. It goes in
+	                front of the first entry closer to its home slot, or a
+	                tombstone in that place, the entries up to the next
+	                empty slot move up by one.
+
+	@Input          pHash - the hash table.
+	@Input          psTable - the slot array.
+	@Input          pKey - pointer to the key.
+	@Input          v - the value associated with the key.
+
+	@Return         IMG_TRUE Success
+	            	IMG_FALSE No free slot
+******************************************************************************/
+static IMG_BOOL
+_SlotInsert (HASH_TABLE *pHash, SLOT_TABLE *psTable, IMG_VOID *pKey, IMG_UINTPTR_T v)
+{
+	IMG_UINT32 uMask = psTable->uSize - 1;
+	IMG_UINT32 uHash;
+	IMG_UINT32 uIndex;
+	IMG_UINT32 uDist;
+	SLOT *pSlot = IMG_NULL;
+
+	if (psTable->uUsed + psTable->uDeleted == psTable->uSize)
+		return IMG_FALSE;
+
+	uHash = pHash->pfnHashFunc(pHash->uKeySize, pKey, psTable->uSize);
+
+	for (uIndex = uHash & uMask, uDist = 0; ; uIndex = (uIndex + 1) & uMask, uDist++)
+	{
+		IMG_UINTPTR_T uTag;
+
+		pSlot = SLOT_AT(pHash, psTable, uIndex);
+		uTag = pSlot->uTag;
+
+		if (uTag == SLOT_EMPTY)
+			break;
+
+		if (((uIndex - SLOT_HOME(uTag, uMask)) & uMask) < uDist)
+		{
+			IMG_UINT32 uEnd;
+
+			if (!SLOT_USED(uTag))
+			{
+				psTable->uDeleted--;
+				break;
+			}
+
+			/* There is an empty slot, the table is not full */
+			for (uEnd = (uIndex + 1) & uMask;
+				 SLOT_AT(pHash, psTable, uEnd)->uTag != SLOT_EMPTY;
+				 uEnd = (uEnd + 1) & uMask)
+				;
+			for (; uEnd != uIndex; uEnd = (uEnd - 1) & uMask)
+			{
+				_SlotCopy(pHash, SLOT_AT(pHash, psTable, uEnd),
+						  SLOT_AT(pHash, psTable, (uEnd - 1) & uMask));
+			}
+			break;
+		}
+	}
+
+	pSlot->uTag = SLOT_TAG(uHash);
+	pSlot->v = v;
+	/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k (linux)*/
+	OSMemCopy(pSlot->k, pKey, pHash->uKeySize);
+	psTable->uUsed++;
+	return IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+	@Function   	_SlotRemove
+
+	@Description    Free a used slot. When bShift is set the entries
+	                following it that are away from their home slot move
+	                back by one, otherwise it becomes a tombstone.
+
+	@Input          pHash - the hash table.
+	@Input          psTable - the slot array.
+	@Input          pSlot - the slot.
+	@Input          uIndex - index of the slot.
+	@Input          bShift - entries may be moved.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_SlotRemove (HASH_TABLE *pHash, SLOT_TABLE *psTable, SLOT *pSlot, IMG_UINT32 uIndex, IMG_BOOL bShift)
+{
+	IMG_UINT32 uMask = psTable->uSize - 1;
+	IMG_UINT32 uProbe;
+
+	psTable->uUsed--;
+
+	if (!bShift)
+	{
+		pSlot->uTag = SLOT_TOMBSTONE(pSlot->uTag);
+		psTable->uDeleted++;
+		return;
+	}
+
+	for (uProbe = 1; uProbe < psTable->uSize; uProbe++)
+	{
+		IMG_UINT32 uNext = (uIndex + 1) & uMask;
+		SLOT *pNext = SLOT_AT(pHash, psTable, uNext);
+
+		if (pNext->uTag == SLOT_EMPTY || SLOT_HOME(pNext->uTag, uMask) == uNext)
+			break;
+
+		_SlotCopy(pHash, pSlot, pNext);
+		pSlot = pNext;
+		uIndex = uNext;
+	}
+	pSlot->uTag = SLOT_EMPTY;
+}
+
+/*!
+******************************************************************************
+	@Function   	_Migrate
+
+	@Description    Move entries from the slot array being drained to the
+	                current one, and free it once it is empty. Moved slots
+	                become tombstones so the probe runs of the entries left
+	                behind stay intact.
+
+	@Input          pHash - the hash table.
+	@Input          uSlots - number of old slots to visit.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_Migrate (HASH_TABLE *pHash, IMG_UINT32 uSlots)
+{
+	SLOT_TABLE *psOld = &pHash->sOldTable;
+
+	while (uSlots-- != 0 && psOld->uUsed != 0)
+	{
+		SLOT *pSlot = SLOT_AT(pHash, psOld, pHash->uMigrate);
+
+		if (SLOT_USED(pSlot->uTag))
+		{
+			/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
+			if (!_SlotInsert(pHash, &pHash->sTable, pSlot->k, pSlot->v))
+			{
+				/* The new array was sized to hold every entry */
+				PVR_DPF((PVR_DBG_ERROR, "_Migrate: call to _SlotInsert failed"));
+				PVR_ASSERT(IMG_FALSE);
+				return;
+			}
+			pSlot->uTag = SLOT_TOMBSTONE(pSlot->uTag);
+			psOld->uUsed--;
+		}
+		pHash->uMigrate++;
+	}
+
+	if (psOld->pui8Slots != IMG_NULL && psOld->uUsed == 0)
+	{
+		_SlotTableDeinit(pHash, psOld);
+		pHash->uMigrate = 0;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_Resize
+
+	@Description    Start moving a hash table to a new slot array, which may
+	                have the same size to sweep out tombstones. Failure to
+	                allocate the new array is not a hard failure, the table
+	                carries on with longer probe runs.
+
+	@Input          pHash - Hash table to resize.
+	@Input          uNewSize - Required number of slots, a power of two.
+
+	@Return         IMG_TRUE Success
+	            	IMG_FALSE Failed
+******************************************************************************/
+static IMG_BOOL
+_Resize (HASH_TABLE *pHash, IMG_UINT32 uNewSize)
+{
+	SLOT_TABLE sNewTable;
+
+	/* Slots must stay where they are under HASH_Iterate */
+	if (pHash->uIterating != 0)
+		return IMG_FALSE;
+
+	/* Only one resize is in flight, finish the previous one first */
+	_Migrate(pHash, pHash->sOldTable.uSize);
+	if (pHash->sOldTable.pui8Slots != IMG_NULL)
+		return IMG_FALSE;
+
+	PVR_DPF ((PVR_DBG_MESSAGE,
+              "HASH_Resize: oldsize=0x%x  newsize=0x%x  count=0x%x",
+			pHash->sTable.uSize, uNewSize, pHash->uCount));
+
+	if (!_SlotTableInit(pHash, &sNewTable, uNewSize))
+		return IMG_FALSE;
+
+	pHash->sOldTable = pHash->sTable;
+	pHash->sTable = sNewTable;
+	pHash->uMigrate = 0;
+	return IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+	@Function   	_Rebalance
+
+	@Description    Called after every insert and remove: moves the next few
+	                entries of a resize in progress, and starts a resize
+	                when the slots in use or tombstones pass three quarters
+	                of the table, or the entries drop below an eighth.
+
+	@Input          pHash - the hash table.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_Rebalance (HASH_TABLE *pHash)
+{
+	SLOT_TABLE *psTable = &pHash->sTable;
+	IMG_UINT32 uNewSize;
+
+	if (pHash->uIterating != 0)
+		return;
+
+	if (pHash->sOldTable.pui8Slots != IMG_NULL)
+	{
+		_Migrate(pHash, HASH_MIGRATE_SLOTS);
+	}
+
+	if (psTable->uUsed + psTable->uDeleted > psTable->uSize - (psTable->uSize >> 2) ||
+		((pHash->uCount << 3) < psTable->uSize &&
+		 psTable->uSize > pHash->uMinimumSize &&
+		 pHash->sOldTable.pui8Slots == IMG_NULL))
+	{
+		uNewSize = _RoundUpPow2(PRIVATE_MAX(pHash->uCount << 1, pHash->uMinimumSize));
+
+		/* Ignore the return code from _Resize because the hash table is
+		   still in a valid state and although not ideally sized, it is still
+		   functional */
+		_Resize (pHash, uNewSize);
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_Create_Extended
+
+	@Description    Create a self scaling hash table, using the supplied
+                    key size, and the supplied hash and key comparsion
+                    functions.
+
+	@Input          uInitialLen - initial and minimum length of the
+                    hash table, where the length refers to the number
+                    of entries in the hash table, not its size in
+                    bytes.
+	@Input          uKeySize - the size of the key, in bytes.
+	@Input          pfnHashFunc - pointer to hash function.
+    @Input          pfnKeyComp - pointer to key comparsion function.
+	@Return         IMG_NULL or hash table handle.
+******************************************************************************/
+HASH_TABLE * HASH_Create_Extended (IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize, HASH_FUNC *pfnHashFunc, HASH_KEY_COMP *pfnKeyComp)
+{
+	HASH_TABLE *pHash;
+
+	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Create_Extended: InitialSize=0x%x", uInitialLen));
+
+	if(OSAllocMem(PVRSRV_PAGEABLE_SELECT,
+					sizeof(HASH_TABLE),
+					(IMG_VOID **)&pHash, IMG_NULL,
+					"Hash Table") != PVRSRV_OK)
+	{
+		return IMG_NULL;
+	}
+
+	pHash->uCount = 0;
+	pHash->uMinimumSize = _RoundUpPow2(uInitialLen);
+	pHash->uKeySize = (IMG_UINT32)uKeySize;
+	/* Keys are accessed as IMG_UINTPTR_T arrays, keep every slot aligned */
+	pHash->uSlotSize = (IMG_UINT32)((sizeof(SLOT) + uKeySize + sizeof(IMG_UINTPTR_T) - 1) &
+									~(sizeof(IMG_UINTPTR_T) - 1));
+	pHash->uIterating = 0;
+	pHash->uMigrate = 0;
+	pHash->pfnHashFunc = pfnHashFunc;
+	pHash->pfnKeyComp = pfnKeyComp;
+	pHash->sOldTable.pui8Slots = IMG_NULL;
+	pHash->sOldTable.uSize = 0;
+	pHash->sOldTable.uUsed = 0;
+	pHash->sOldTable.uDeleted = 0;
+
+	if (!_SlotTableInit(pHash, &pHash->sTable, pHash->uMinimumSize))
+	{
+		OSFreeMem(PVRSRV_PAGEABLE_SELECT, sizeof(HASH_TABLE), pHash, IMG_NULL);
+		/*not nulling pointer, out of scope*/
+		return IMG_NULL;
+	}
+
+	return pHash;
+}
+
+/*!
+******************************************************************************
+	@Function       HASH_Delete
+
+	@Description    Delete a hash table created by HASH_Create_Extended or
+                    HASH_Create.  All entries in the table must have been
+                    removed before calling this function.
+
+	@Input          pHash - hash table
+    
+	@Return 	    None
+******************************************************************************/
+IMG_VOID
+HASH_Delete (HASH_TABLE *pHash)
+{
+	if (pHash != IMG_NULL)
+    {
+		PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Delete"));
+
+		PVR_ASSERT (pHash->uCount==0);
+		if(pHash->uCount != 0)
+		{
+			PVR_DPF ((PVR_DBG_ERROR, "HASH_Delete: leak detected in hash table!"));
+			PVR_DPF ((PVR_DBG_ERROR, "Likely Cause: client drivers not freeing alocations before destroying devmemcontext"));
+		}
+		_SlotTableDeinit(pHash, &pHash->sOldTable);
+		_SlotTableDeinit(pHash, &pHash->sTable);
+		OSFreeMem(PVRSRV_PAGEABLE_SELECT, sizeof(HASH_TABLE), pHash, IMG_NULL);
+		/*not nulling pointer, copy on stack*/
+    }
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_Insert_Extended
+
+	@Description    Insert a key value pair into a hash table created
+                    with HASH_Create_Extended.
+
+	@Input          pHash - the hash table.
+	@Input          pKey - pointer to the key.
+	@Input          v - the value associated with the key.
+
+	@Return 	    IMG_TRUE  - success
+	            	IMG_FALSE  - failure
+******************************************************************************/
+IMG_BOOL
+HASH_Insert_Extended (HASH_TABLE *pHash, IMG_VOID *pKey, IMG_UINTPTR_T v)
+{
+	PVR_DPF ((PVR_DBG_MESSAGE,
+              "HASH_Insert_Extended: Hash=0x%08x, pKey=0x%08x, v=0x%x",
+              (IMG_UINTPTR_T)pHash, (IMG_UINTPTR_T)pKey, v));
+
+	PVR_ASSERT (pHash != IMG_NULL);
+
+	if (pHash == IMG_NULL)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "HASH_Insert_Extended: invalid parameter"));
+		return IMG_FALSE;
+	}
+
+	if (!_SlotInsert (pHash, &pHash->sTable, pKey, v))
+	{
+		/* Every slot is in use, an earlier resize must have failed */
+		if (!_Resize (pHash, pHash->sTable.uSize << 1) ||
+			!_SlotInsert (pHash, &pHash->sTable, pKey, v))
+		{
+			PVR_DPF((PVR_DBG_ERROR, "HASH_Insert_Extended: hash table full"));
+			return IMG_FALSE;
+		}
+	}
+
+	pHash->uCount++;
+
+	_Rebalance (pHash);
+
+	return IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_Remove_Extended
+
+	@Description    Remove a key from a hash table created with
+                    HASH_Create_Extended.
+
+	@Input          pHash - the hash table.
+	@Input          pKey - pointer to key.
+
+	@Return 	    0 if the key is missing, or the value associated
+                    with the key.
+******************************************************************************/
+IMG_UINTPTR_T
+HASH_Remove_Extended(HASH_TABLE *pHash, IMG_VOID *pKey)
+{
+	SLOT_TABLE *psTable;
+	SLOT *pSlot;
+	IMG_UINT32 uIndex;
+
+	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Remove_Extended: Hash=0x%x, pKey=0x%x",
+			(IMG_UINTPTR_T)pHash, (IMG_UINTPTR_T)pKey));
+
+	PVR_ASSERT (pHash != IMG_NULL);
+
+	if (pHash == IMG_NULL)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "HASH_Remove_Extended: Null hash table"));
+		return 0;
+	}
+
+	psTable = &pHash->sTable;
+	pSlot = _SlotFind (pHash, psTable, pKey, &uIndex);
+	if (pSlot == IMG_NULL)
+	{
+		psTable = &pHash->sOldTable;
+		pSlot = _SlotFind (pHash, psTable, pKey, &uIndex);
+	}
+
+	if (pSlot != IMG_NULL)
+	{
+		IMG_UINTPTR_T v = pSlot->v;
+
+		/* Entries of the array being drained stay put, _Migrate walks it in order */
+		_SlotRemove (pHash, psTable, pSlot, uIndex,
+					 (IMG_BOOL)(psTable == &pHash->sTable && pHash->uIterating == 0));
+		pHash->uCount--;
+
+		_Rebalance (pHash);
+
+		PVR_DPF ((PVR_DBG_MESSAGE,
+                  "HASH_Remove_Extended: Hash=0x%x, pKey=0x%x = 0x%x",
+                  (IMG_UINTPTR_T)pHash, (IMG_UINTPTR_T)pKey, v));
+		return v;
+	}
+	PVR_DPF ((PVR_DBG_MESSAGE,
+              "HASH_Remove_Extended: Hash=0x%x, pKey=0x%x = 0x0 !!!!",
+              (IMG_UINTPTR_T)pHash, (IMG_UINTPTR_T)pKey));
+	return 0;
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_Retrieve_Extended
+
+	@Description    Retrieve a value from a hash table created with
+                    HASH_Create_Extended.
+
+	@Input          pHash - the hash table.
+	@Input          pKey - pointer to the key.
+
+	@Return 	    0 if the key is missing, or the value associated with
+                    the key.
+******************************************************************************/
+IMG_UINTPTR_T
+HASH_Retrieve_Extended (HASH_TABLE *pHash, IMG_VOID *pKey)
+{
+	SLOT *pSlot;
+	IMG_UINT32 uIndex;
+
+	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Retrieve_Extended: Hash=0x%x, pKey=0x%x",
+			(IMG_UINTPTR_T)pHash, (IMG_UINTPTR_T)pKey));
+
+	PVR_ASSERT (pHash != IMG_NULL);
+
+	if (pHash == IMG_NULL)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "HASH_Retrieve_Extended: Null hash table"));
+		return 0;
+	}
+
+	pSlot = _SlotFind (pHash, &pHash->sTable, pKey, &uIndex);
+	if (pSlot == IMG_NULL)
+	{
+		pSlot = _SlotFind (pHash, &pHash->sOldTable, pKey, &uIndex);
+	}
+
+	if (pSlot != IMG_NULL)
+	{
+		PVR_DPF ((PVR_DBG_MESSAGE,
+                  "HASH_Retrieve: Hash=0x%x, pKey=0x%x = 0x%x",
+                  (IMG_UINTPTR_T)pHash, (IMG_UINTPTR_T)pKey, pSlot->v));
+		return pSlot->v;
+	}
+	PVR_DPF ((PVR_DBG_MESSAGE,
+              "HASH_Retrieve: Hash=0x%x, pKey=0x%x = 0x0 !!!!",
+              (IMG_UINTPTR_T)pHash, (IMG_UINTPTR_T)pKey));
+	return 0;
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_Iterate
+
+	@Description    Iterate over every entry in the hash table. The
+	                callback may remove entries, they become tombstones
+	                and resizing is held off until it returns. Inserts
+	                move entries and must not be made from the callback.
+
+	@Input          pHash - the old hash table
+	@Input          pfnCallback - the size of the old hash table
+
+	@Return 	    Callback error if any, otherwise PVRSRV_OK
+******************************************************************************/
+PVRSRV_ERROR
+HASH_Iterate(HASH_TABLE *pHash, HASH_pfnCallback pfnCallback)
+{
+	SLOT_TABLE *apsTables[2];
+	PVRSRV_ERROR eError = PVRSRV_OK;
+	IMG_UINT32 uTable;
+	IMG_UINT32 uIndex;
+
+	apsTables[0] = &pHash->sTable;
+	apsTables[1] = &pHash->sOldTable;
+
+	pHash->uIterating++;
+	for (uTable = 0; uTable < 2 && eError == PVRSRV_OK; uTable++)
+	{
+		for (uIndex = 0; uIndex < apsTables[uTable]->uSize; uIndex++)
+		{
+			SLOT *pSlot = SLOT_AT(pHash, apsTables[uTable], uIndex);
+
+			if (!SLOT_USED(pSlot->uTag))
+				continue;
+
+			eError = pfnCallback(pSlot->k[0], pSlot->v);
+
+			/* The callback might want us to break out early */
+			if (eError != PVRSRV_OK)
+				break;
+		}
+	}
+	pHash->uIterating--;
+
+	return eError;
+}
+
+#ifdef HASH_TRACE
+/*!
+******************************************************************************
+	@Function   	HASH_Dump
+
+	@Description   	To dump the contents of a hash table in human readable
+                    form.
+
+	@Input          pHash - the hash table
+
+	@Return 	    None
+******************************************************************************/
+IMG_VOID
+HASH_Dump (HASH_TABLE *pHash)
+{
+	IMG_UINT32 uIndex;
+	IMG_UINT32 uRun = 0;
+	IMG_UINT32 uMaxRun = 0;
+
+	PVR_ASSERT (pHash != IMG_NULL);
+	for (uIndex=0; uIndex<pHash->sTable.uSize; uIndex++)
+	{
+		if (SLOT_AT(pHash, &pHash->sTable, uIndex)->uTag == SLOT_EMPTY)
+		{
+			uRun = 0;
+			continue;
+		}
+		uRun++;
+		uMaxRun = PRIVATE_MAX (uMaxRun, uRun);
+	}
+
+	PVR_TRACE(("hash table: uMinimumSize=%d  size=%d  count=%d",
+			pHash->uMinimumSize, pHash->sTable.uSize, pHash->uCount));
+	PVR_TRACE(("  deleted=%d  max run=%d  migrating=%d",
+			pHash->sTable.uDeleted, uMaxRun, pHash->sOldTable.uUsed));
+}
+#endif
+
+#endif /* !defined(PVR_HASH_OPEN_ADDRESSING) */
+
+/*!
+******************************************************************************
+	@Function   	HASH_Create
+
+	@Description    Create a self scaling hash table with a key
+                    consisting of a single IMG_UINTPTR_T, and using
+                    the default hash and key comparison functions.
+
+	@Input          uInitialLen - initial and minimum length of the
+                    hash table, where the length refers to the
+                    number of entries in the hash table, not its size
+                    in bytes.
+	@Return 	    IMG_NULL or hash table handle.
+******************************************************************************/
+HASH_TABLE * HASH_Create (IMG_UINT32 uInitialLen)
+{
+	return HASH_Create_Extended(uInitialLen, sizeof(IMG_UINTPTR_T),
+		&HASH_Func_Default, &HASH_Key_Comp_Default);
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_Insert
+
+	@Description    Insert a key value pair into a hash table created with
+                    HASH_Create.
+
+	@Input          pHash - the hash table.
+	@Input          k - the key value.
+	@Input          v - the value associated with the key.
+
+	@Return 	    IMG_TRUE - success.
+	            	IMG_FALSE - failure.
+******************************************************************************/
+IMG_BOOL
+HASH_Insert (HASH_TABLE *pHash, IMG_UINTPTR_T k, IMG_UINTPTR_T v)
+{
+	PVR_DPF ((PVR_DBG_MESSAGE,
+              "HASH_Insert: Hash=0x%x, k=0x%x, v=0x%x",
+              (IMG_UINTPTR_T)pHash, k, v));
+
+	return HASH_Insert_Extended(pHash, &k, v);
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_Remove
+
+	@Description    Remove a key value pair from a hash table created
+                    with HASH_Create.
+
+	@Input          pHash - the hash table
+	@Input          k - the key
+
+	@Return         0 if the key is missing, or the value associated
+                    with the key.
+******************************************************************************/
+IMG_UINTPTR_T
+HASH_Remove (HASH_TABLE *pHash, IMG_UINTPTR_T k)
+{
+	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Remove: Hash=0x%x, k=0x%x",
+			(IMG_UINTPTR_T)pHash, k));
+
+	return HASH_Remove_Extended(pHash, &k);
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_Retrieve
+
+	@Description    Retrieve a value from a hash table created with
+                    HASH_Create.
+
+	@Input          pHash - the hash table
+	@Input          k - the key
+	@Return 	    0 if the key is missing, or the value associated with
+                    the key.
+******************************************************************************/
+IMG_UINTPTR_T
+HASH_Retrieve (HASH_TABLE *pHash, IMG_UINTPTR_T k)
+{
+	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Retrieve: Hash=0x%x, k=0x%x",
+			(IMG_UINTPTR_T)pHash, k));
+	return HASH_Retrieve_Extended(pHash, &k);
+}
@@ -174,6 +174,18 @@ struct _BT_
 };
 typedef struct _BT_ BT;
 
+/* Boundary tags are carved out of slabs of BT_SLAB_SIZE tags so that
+   splitting and coalescing segments does not call OSAllocMem/OSFreeMem for
+   every tag. Unused tags are kept on a per arena list linked through
+   pNextFree, the slabs are only returned when the arena is deleted. */
+#define BT_SLAB_SIZE 64
+
+typedef struct _BT_SLAB_
+{
+	struct _BT_SLAB_ *psNext;
+	BT asBT[BT_SLAB_SIZE];
+} BT_SLAB;
+
 
 /* resource allocation arena */
 struct _RA_ARENA_
@@ -209,6 +221,13 @@ struct _RA_ARENA_
 	/* power-of-two table of free lists */
 	BT *aHeadFree [FREE_TABLE_LIMIT];
 
+	/* bit n set when aHeadFree[n] is not empty */
+	IMG_UINT32 ui32FreeBucketMap;
+
+	/* boundary tag slabs and the unused tags in them */
+	BT_SLAB *psBTSlabs;
+	BT *pUnusedBT;
+
 	/* resource ordered segment list */
 	BT *pHeadSegment;
 	BT *pTailSegment;
@@ -353,6 +372,9 @@ _RequestAllocFail (IMG_VOID *_h,
 static IMG_UINT32
 pvr_log2 (IMG_SIZE_T n)
 {
+#if defined(__GNUC__)
+	return n ? (IMG_UINT32)(sizeof(unsigned long) * 8 - 1 - __builtin_clzl((unsigned long)n)) : 0;
+#else
 	IMG_UINT32 l = 0;
 	n>>=1;
 	while (n>0)
@@ -361,6 +383,118 @@ pvr_log2 (IMG_SIZE_T n)
 		l++;
 	}
 	return l;
+#endif
+}
+
+/*!
+******************************************************************************
+	@Function       _FirstSetBit
+
+	@Description    Finds the least significant bit set in a non zero word
+
+	@Input          ui32Bits - the word, must not be 0
+
+	@Return         Index of the bit
+******************************************************************************/
+static INLINE IMG_UINT32
+_FirstSetBit (IMG_UINT32 ui32Bits)
+{
+#if defined(__GNUC__)
+	return (IMG_UINT32)__builtin_ctz(ui32Bits);
+#else
+	IMG_UINT32 l = 0;
+	while (!(ui32Bits & 1))
+	{
+		ui32Bits >>= 1;
+		l++;
+	}
+	return l;
+#endif
+}
+
+/*!
+******************************************************************************
+	@Function       _AllocBT
+
+	@Description    Take a zeroed boundary tag from the arena slab cache,
+                    growing the cache by a slab when it is empty.
+
+	@Input          pArena - the arena.
+
+	@Return         boundary tag, or IMG_NULL on failure
+******************************************************************************/
+static BT *
+_AllocBT (RA_ARENA *pArena)
+{
+	BT *pBT;
+
+	if (pArena->pUnusedBT == IMG_NULL)
+	{
+		BT_SLAB *psSlab;
+		IMG_UINT32 i;
+
+		if(OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
+						sizeof(BT_SLAB),
+						(IMG_VOID **)&psSlab, IMG_NULL,
+						"Boundary Tag Slab") != PVRSRV_OK)
+		{
+			return IMG_NULL;
+		}
+
+		psSlab->psNext = pArena->psBTSlabs;
+		pArena->psBTSlabs = psSlab;
+		for (i = 0; i < BT_SLAB_SIZE; i++)
+		{
+			psSlab->asBT[i].pNextFree = pArena->pUnusedBT;
+			pArena->pUnusedBT = &psSlab->asBT[i];
+		}
+	}
+
+	pBT = pArena->pUnusedBT;
+	pArena->pUnusedBT = pBT->pNextFree;
+	OSMemSet(pBT, 0, sizeof(BT));
+
+	return pBT;
+}
+
+/*!
+******************************************************************************
+	@Function       _ReleaseBT
+
+	@Description    Return a boundary tag to the arena slab cache.
+
+	@Input          pArena - the arena.
+	@Input          pBT - the boundary tag, no longer on any list.
+
+	@Return         None
+******************************************************************************/
+static INLINE IMG_VOID
+_ReleaseBT (RA_ARENA *pArena, BT *pBT)
+{
+	pBT->pNextFree = pArena->pUnusedBT;
+	pArena->pUnusedBT = pBT;
+}
+
+/*!
+******************************************************************************
+	@Function       _DeleteBTSlabs
+
+	@Description    Free all boundary tag slabs of an arena.
+
+	@Input          pArena - the arena, must not reference any tag anymore.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_DeleteBTSlabs (RA_ARENA *pArena)
+{
+	while (pArena->psBTSlabs != IMG_NULL)
+	{
+		BT_SLAB *psSlab = pArena->psBTSlabs;
+		pArena->psBTSlabs = psSlab->psNext;
+		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT_SLAB), psSlab, IMG_NULL);
+	}
+	pArena->pUnusedBT = IMG_NULL;
 }
 
 /*!
@@ -516,16 +650,12 @@ _SegmentSplit (RA_ARENA *pArena, BT *pBT, IMG_SIZE_T uSize)
 		return IMG_NULL;
 	}
 
-	if(OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
-					sizeof(BT),
-					(IMG_VOID **)&pNeighbour, IMG_NULL,
-					"Boundary Tag") != PVRSRV_OK)
+	pNeighbour = _AllocBT (pArena);
+	if (pNeighbour == IMG_NULL)
 	{
 		return IMG_NULL;
 	}
 
-	OSMemSet(pNeighbour, 0, sizeof(BT));
-
 #if defined(VALIDATE_ARENA_TEST)
 	pNeighbour->ui32BoundaryTagID = ++ui32BoundaryTagID;
 #endif
@@ -588,6 +718,7 @@ _FreeListInsert (RA_ARENA *pArena, BT *pBT)
 	if (pArena->aHeadFree[uIndex] != IMG_NULL)
 		pArena->aHeadFree[uIndex]->pPrevFree = pBT;
 	pArena->aHeadFree [uIndex] = pBT;
+	pArena->ui32FreeBucketMap |= 1U << uIndex;
 }
 
 /*!
@@ -610,7 +741,11 @@ _FreeListRemove (RA_ARENA *pArena, BT *pBT)
 	if (pBT->pNextFree != IMG_NULL)
 		pBT->pNextFree->pPrevFree = pBT->pPrevFree;
 	if (pBT->pPrevFree == IMG_NULL)
+	{
 		pArena->aHeadFree[uIndex] = pBT->pNextFree;
+		if (pBT->pNextFree == IMG_NULL)
+			pArena->ui32FreeBucketMap &= ~(1U << uIndex);
+	}
 	else
 		pBT->pPrevFree->pNextFree = pBT->pNextFree;
 }
@@ -628,20 +763,16 @@ _FreeListRemove (RA_ARENA *pArena, BT *pBT)
 
 ******************************************************************************/
 static BT *
-_BuildSpanMarker (IMG_UINTPTR_T base, IMG_SIZE_T uSize)
+_BuildSpanMarker (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 {
 	BT *pBT;
 
-	if(OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
-					sizeof(BT),
-					(IMG_VOID **)&pBT, IMG_NULL,
-					"Boundary Tag") != PVRSRV_OK)
+	pBT = _AllocBT (pArena);
+	if (pBT == IMG_NULL)
 	{
 		return IMG_NULL;
 	}
 
-	OSMemSet(pBT, 0, sizeof(BT));
-
 #if defined(VALIDATE_ARENA_TEST)
 	pBT->ui32BoundaryTagID = ++ui32BoundaryTagID;
 #endif
@@ -660,6 +791,7 @@ _BuildSpanMarker (IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 
 	@Description    Construct a boundary tag for a free segment.
 
+	@Input          pArena - arena to contain the boundary tag.
 	@Input          base - the base of the resource segment.
 	@Input          uSize - the extent of the resouce segment.
 
@@ -667,20 +799,16 @@ _BuildSpanMarker (IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 
 ******************************************************************************/
 static BT *
-_BuildBT (IMG_UINTPTR_T base, IMG_SIZE_T uSize)
+_BuildBT (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 {
 	BT *pBT;
 
-	if(OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
-					sizeof(BT),
-					(IMG_VOID **)&pBT, IMG_NULL,
-					"Boundary Tag") != PVRSRV_OK)
+	pBT = _AllocBT (pArena);
+	if (pBT == IMG_NULL)
 	{
 		return IMG_NULL;
 	}
 
-	OSMemSet(pBT, 0, sizeof(BT));
-
 #if defined(VALIDATE_ARENA_TEST)
 	pBT->ui32BoundaryTagID = ++ui32BoundaryTagID;
 #endif
@@ -717,7 +845,7 @@ _InsertResource (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 		return IMG_NULL;
 	}
 
-	pBT = _BuildBT (base, uSize);
+	pBT = _BuildBT (pArena, base, uSize);
 	if (pBT != IMG_NULL)
 	{
 
@@ -773,7 +901,7 @@ _InsertResourceSpan (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 			  "RA_InsertResourceSpan: arena='%s', base=0x%x, size=0x%x",
 			  pArena->name, base, uSize));
 
-	pSpanStart = _BuildSpanMarker (base, uSize);
+	pSpanStart = _BuildSpanMarker (pArena, base, uSize);
 	if (pSpanStart == IMG_NULL)
 	{
 		goto fail_start;
@@ -784,7 +912,7 @@ _InsertResourceSpan (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 	pSpanStart->eResourceType = IMPORTED_RESOURCE_TYPE;
 #endif
 
-	pSpanEnd = _BuildSpanMarker (base + uSize, 0);
+	pSpanEnd = _BuildSpanMarker (pArena, base + uSize, 0);
 	if (pSpanEnd == IMG_NULL)
 	{
 		goto fail_end;
@@ -795,7 +923,7 @@ _InsertResourceSpan (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 	pSpanEnd->eResourceType = IMPORTED_RESOURCE_TYPE;
 #endif
 
-	pBT = _BuildBT (base, uSize);
+	pBT = _BuildBT (pArena, base, uSize);
 	if (pBT == IMG_NULL)
 	{
 		goto fail_bt;
@@ -837,14 +965,11 @@ _InsertResourceSpan (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 	return pBT;
 
   fail_SegListInsert:
-	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pBT, IMG_NULL);
-	/*not nulling pointer, out of scope*/
+	_ReleaseBT (pArena, pBT);
   fail_bt:
-	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pSpanEnd, IMG_NULL);
-	/*not nulling pointer, out of scope*/
+	_ReleaseBT (pArena, pSpanEnd);
   fail_end:
-	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pSpanStart, IMG_NULL);
-	/*not nulling pointer, out of scope*/
+	_ReleaseBT (pArena, pSpanStart);
   fail_start:
 	return IMG_NULL;
 }
@@ -897,8 +1022,7 @@ _FreeBT (RA_ARENA *pArena, BT *pBT, IMG_BOOL bFreeBackingStore)
 		_SegmentListRemove (pArena, pNeighbour);
 		pBT->base = pNeighbour->base;
 		pBT->uSize += pNeighbour->uSize;
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pNeighbour, IMG_NULL);
-		/*not nulling original pointer, already overwritten*/
+		_ReleaseBT (pArena, pNeighbour);
 #ifdef RA_STATS
 		pArena->sStatistics.uFreeSegmentCount--;
 #endif
@@ -913,8 +1037,7 @@ _FreeBT (RA_ARENA *pArena, BT *pBT, IMG_BOOL bFreeBackingStore)
 		_FreeListRemove (pArena, pNeighbour);
 		_SegmentListRemove (pArena, pNeighbour);
 		pBT->uSize += pNeighbour->uSize;
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pNeighbour, IMG_NULL);
-		/*not nulling original pointer, already overwritten*/
+		_ReleaseBT (pArena, pNeighbour);
 #ifdef RA_STATS
 		pArena->sStatistics.uFreeSegmentCount--;
 #endif
@@ -963,18 +1086,104 @@ _FreeBT (RA_ARENA *pArena, BT *pBT, IMG_BOOL bFreeBackingStore)
 		pArena->sStatistics.uFreeResourceCount-=pBT->uSize;
 		pArena->sStatistics.uTotalResourceCount-=pBT->uSize;
 #endif
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), next, IMG_NULL);
-		/*not nulling original pointer, already overwritten*/
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), prev, IMG_NULL);
-		/*not nulling original pointer, already overwritten*/
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pBT, IMG_NULL);
-		/*not nulling pointer, copy on stack*/
+		_ReleaseBT (pArena, next);
+		_ReleaseBT (pArena, prev);
+		_ReleaseBT (pArena, pBT);
 	}
 	else
 		_FreeListInsert (pArena, pBT);
 }
 
 
+/*!
+******************************************************************************
+	@Function       _FindFreeBT
+
+	@Description    Find a free boundary tag for an allocation. The free
+                    lists above the pvr_log2(uSize) one only hold tags big
+                    enough for the request, so the first usable tag of the
+                    lowest non empty one is taken, found through the bucket
+                    bitmap. Tags in the pvr_log2(uSize) list may be too small,
+                    that list is searched for the best fit.
+
+	@Input          pArena - the arena.
+	@Input          uSize - the requested allocation size.
+	@Input          uFlags - allocation flags
+	@Input          uAlignment - required uAlignment, or 0
+	@Input          uAlignmentOffset
+	@Output         pAlignedBase - base of the allocation within the tag
+
+	@Return         boundary tag, or IMG_NULL if none fits
+******************************************************************************/
+static BT *
+_FindFreeBT (RA_ARENA *pArena,
+			 IMG_SIZE_T uSize,
+			 IMG_UINT32 uFlags,
+			 IMG_UINT32 uAlignment,
+			 IMG_UINT32 uAlignmentOffset,
+			 IMG_UINTPTR_T *pAlignedBase)
+{
+	IMG_UINT32 uIndex, uFirstIndex;
+	IMG_UINT32 ui32Buckets;
+	IMG_UINTPTR_T aligned_base, best_base = 0;
+	BT *pBT, *pBest = IMG_NULL;
+
+	uFirstIndex = pvr_log2 (uSize);
+	if (uFirstIndex >= FREE_TABLE_LIMIT)
+		return IMG_NULL;
+
+	ui32Buckets = pArena->ui32FreeBucketMap & ~((1U << uFirstIndex) - 1);
+	while (ui32Buckets != 0)
+	{
+		uIndex = _FirstSetBit (ui32Buckets);
+		ui32Buckets &= ui32Buckets - 1;
+
+		for (pBT = pArena->aHeadFree[uIndex]; pBT != IMG_NULL; pBT = pBT->pNextFree)
+		{
+			if (uAlignment>1)
+				aligned_base = (pBT->base + uAlignmentOffset + uAlignment - 1) / uAlignment * uAlignment - uAlignmentOffset;
+			else
+				aligned_base = pBT->base;
+			PVR_DPF ((PVR_DBG_MESSAGE,
+					  "RA_AttemptAllocAligned: pBT-base=0x%x "
+					  "pBT-size=0x%x alignedbase=0x%x size=0x%x",
+					pBT->base, pBT->uSize, aligned_base, uSize));
+
+			if (pBT->base + pBT->uSize < aligned_base + uSize)
+				continue;
+
+			if (pBT->psMapping && pBT->psMapping->ui32Flags != uFlags)
+			{
+				PVR_DPF ((PVR_DBG_MESSAGE,
+						"AttemptAllocAligned: mismatch in flags. Import has %x, request was %x", pBT->psMapping->ui32Flags, uFlags));
+				continue;
+			}
+
+			if (uIndex != uFirstIndex)
+			{
+				*pAlignedBase = aligned_base;
+				return pBT;
+			}
+
+			if (pBest == IMG_NULL || pBT->uSize < pBest->uSize)
+			{
+				pBest = pBT;
+				best_base = aligned_base;
+				if (pBT->uSize == uSize)
+					break;
+			}
+		}
+
+		if (pBest != IMG_NULL)
+		{
+			*pAlignedBase = best_base;
+			return pBest;
+		}
+	}
+
+	return IMG_NULL;
+}
+
 /*!
 ******************************************************************************
 	@Function       _AttemptAllocAligned
@@ -1002,7 +1211,9 @@ _AttemptAllocAligned (RA_ARENA *pArena,
 					  IMG_UINT32 uAlignmentOffset,
 					  IMG_UINTPTR_T *base)
 {
-	IMG_UINT32 uIndex;
+	IMG_UINTPTR_T aligned_base;
+	BT *pBT;
+
 	PVR_ASSERT (pArena!=IMG_NULL);
 	if (pArena == IMG_NULL)
 	{
@@ -1013,137 +1224,93 @@ _AttemptAllocAligned (RA_ARENA *pArena,
 	if (uAlignment>1)
 		uAlignmentOffset %= uAlignment;
 
-	/* search for a near fit free boundary tag, start looking at the
-	   pvr_log2 free table for our required size and work on up the
-	   table. */
-	uIndex = pvr_log2 (uSize);
+	pBT = _FindFreeBT (pArena, uSize, uFlags, uAlignment, uAlignmentOffset,
+					   &aligned_base);
+	if (pBT == IMG_NULL)
+		return IMG_FALSE;
+
+	_FreeListRemove (pArena, pBT);
+
+	PVR_ASSERT (pBT->type == btt_free);
 
-	while (uIndex < FREE_TABLE_LIMIT && pArena->aHeadFree[uIndex]==IMG_NULL)
-		uIndex++;
+#ifdef RA_STATS
+	pArena->sStatistics.uLiveSegmentCount++;
+	pArena->sStatistics.uFreeSegmentCount--;
+	pArena->sStatistics.uFreeResourceCount-=pBT->uSize;
+#endif
 
-	while (uIndex < FREE_TABLE_LIMIT)
+	/* with uAlignment we might need to discard the front of this segment */
+	if (aligned_base > pBT->base)
 	{
-		if (pArena->aHeadFree[uIndex]!=IMG_NULL)
+		BT *pNeighbour;
+		pNeighbour = _SegmentSplit (pArena, pBT, (IMG_SIZE_T)(aligned_base - pBT->base));
+		/* partition the buffer, create a new boundary tag */
+		if (pNeighbour==IMG_NULL)
 		{
-			/* we have a cached free boundary tag */
-			BT *pBT;
-
-			pBT = pArena->aHeadFree [uIndex];
-			while (pBT!=IMG_NULL)
-			{
-				IMG_UINTPTR_T aligned_base;
-
-				if (uAlignment>1)
-					aligned_base = (pBT->base + uAlignmentOffset + uAlignment - 1) / uAlignment * uAlignment - uAlignmentOffset;
-				else
-					aligned_base = pBT->base;
-				PVR_DPF ((PVR_DBG_MESSAGE,
-						  "RA_AttemptAllocAligned: pBT-base=0x%x "
-						  "pBT-size=0x%x alignedbase=0x%x size=0x%x",
-						pBT->base, pBT->uSize, aligned_base, uSize));
+			PVR_DPF ((PVR_DBG_ERROR,"_AttemptAllocAligned: Front split failed"));
+			/* Put pBT back in the list */
+			_FreeListInsert (pArena, pBT);
+			return IMG_FALSE;
+		}
 
-				if (pBT->base + pBT->uSize >= aligned_base + uSize)
-				{
-					if(!pBT->psMapping || pBT->psMapping->ui32Flags == uFlags)
-					{
-						_FreeListRemove (pArena, pBT);
+		_FreeListInsert (pArena, pBT);
+#ifdef RA_STATS
+		pArena->sStatistics.uFreeSegmentCount++;
+		pArena->sStatistics.uFreeResourceCount+=pBT->uSize;
+#endif
+		pBT = pNeighbour;
+	}
 
-						PVR_ASSERT (pBT->type == btt_free);
+	/* the segment might be too big, if so, discard the back of the segment */
+	if (pBT->uSize > uSize)
+	{
+		BT *pNeighbour;
+		pNeighbour = _SegmentSplit (pArena, pBT, uSize);
+		/* partition the buffer, create a new boundary tag */
+		if (pNeighbour==IMG_NULL)
+		{
+			PVR_DPF ((PVR_DBG_ERROR,"_AttemptAllocAligned: Back split failed"));
+			/* Put pBT back in the list */
+			_FreeListInsert (pArena, pBT);
+			return IMG_FALSE;
+		}
 
+		_FreeListInsert (pArena, pNeighbour);
 #ifdef RA_STATS
-						pArena->sStatistics.uLiveSegmentCount++;
-						pArena->sStatistics.uFreeSegmentCount--;
-						pArena->sStatistics.uFreeResourceCount-=pBT->uSize;
+		pArena->sStatistics.uFreeSegmentCount++;
+		pArena->sStatistics.uFreeResourceCount+=pNeighbour->uSize;
 #endif
+	}
 
-						/* with uAlignment we might need to discard the front of this segment */
-						if (aligned_base > pBT->base)
-						{
-							BT *pNeighbour;
-							pNeighbour = _SegmentSplit (pArena, pBT, (IMG_SIZE_T)(aligned_base - pBT->base));
-							/* partition the buffer, create a new boundary tag */
-							if (pNeighbour==IMG_NULL)
-							{
-								PVR_DPF ((PVR_DBG_ERROR,"_AttemptAllocAligned: Front split failed"));
-								/* Put pBT back in the list */
-								_FreeListInsert (pArena, pBT);
-								return IMG_FALSE;
-							}
-
-							_FreeListInsert (pArena, pBT);
-	#ifdef RA_STATS
-							pArena->sStatistics.uFreeSegmentCount++;
-							pArena->sStatistics.uFreeResourceCount+=pBT->uSize;
-	#endif
-							pBT = pNeighbour;
-						}
-
-						/* the segment might be too big, if so, discard the back of the segment */
-						if (pBT->uSize > uSize)
-						{
-							BT *pNeighbour;
-							pNeighbour = _SegmentSplit (pArena, pBT, uSize);
-							/* partition the buffer, create a new boundary tag */
-							if (pNeighbour==IMG_NULL)
-							{
-								PVR_DPF ((PVR_DBG_ERROR,"_AttemptAllocAligned: Back split failed"));
-								/* Put pBT back in the list */
-								_FreeListInsert (pArena, pBT);
-								return IMG_FALSE;
-							}
-
-							_FreeListInsert (pArena, pNeighbour);
-	#ifdef RA_STATS
-							pArena->sStatistics.uFreeSegmentCount++;
-							pArena->sStatistics.uFreeResourceCount+=pNeighbour->uSize;
-	#endif
-						}
-
-						pBT->type = btt_live;
+	pBT->type = btt_live;
 
 #if defined(VALIDATE_ARENA_TEST)
-						if (pBT->eResourceType == IMPORTED_RESOURCE_TYPE)
-						{
-							pBT->eResourceSpan = IMPORTED_RESOURCE_SPAN_LIVE;
-						}
-						else if (pBT->eResourceType == NON_IMPORTED_RESOURCE_TYPE)
-						{
-							pBT->eResourceSpan = RESOURCE_SPAN_LIVE;
-						}
-						else
-						{
-							PVR_DPF ((PVR_DBG_ERROR,"_AttemptAllocAligned ERROR: pBT->eResourceType unrecognized"));
-							PVR_DBG_BREAK;
-						}
+	if (pBT->eResourceType == IMPORTED_RESOURCE_TYPE)
+	{
+		pBT->eResourceSpan = IMPORTED_RESOURCE_SPAN_LIVE;
+	}
+	else if (pBT->eResourceType == NON_IMPORTED_RESOURCE_TYPE)
+	{
+		pBT->eResourceSpan = RESOURCE_SPAN_LIVE;
+	}
+	else
+	{
+		PVR_DPF ((PVR_DBG_ERROR,"_AttemptAllocAligned ERROR: pBT->eResourceType unrecognized"));
+		PVR_DBG_BREAK;
+	}
 #endif
-						if (!HASH_Insert (pArena->pSegmentHash, pBT->base, (IMG_UINTPTR_T) pBT))
-						{
-							_FreeBT (pArena, pBT, IMG_FALSE);
-							return IMG_FALSE;
-						}
-
-						if (ppsMapping!=IMG_NULL)
-							*ppsMapping = pBT->psMapping;
-
-						*base = pBT->base;
-
-						return IMG_TRUE;
-					}
-					else
-					{
-						PVR_DPF ((PVR_DBG_MESSAGE,
-								"AttemptAllocAligned: mismatch in flags. Import has %x, request was %x", pBT->psMapping->ui32Flags, uFlags));
+	if (!HASH_Insert (pArena->pSegmentHash, pBT->base, (IMG_UINTPTR_T) pBT))
+	{
+		_FreeBT (pArena, pBT, IMG_FALSE);
+		return IMG_FALSE;
+	}
 
-					}
-				}
-				pBT = pBT->pNextFree;
-			}
+	if (ppsMapping!=IMG_NULL)
+		*ppsMapping = pBT->psMapping;
 
-		}
-		uIndex++;
-	}
+	*base = pBT->base;
 
-	return IMG_FALSE;
+	return IMG_TRUE;
 }
 
 
@@ -1203,6 +1370,9 @@ RA_Create (IMG_CHAR *name,
 	pArena->pImportHandle = pImportHandle;
 	for (i=0; i<FREE_TABLE_LIMIT; i++)
 		pArena->aHeadFree[i] = IMG_NULL;
+	pArena->ui32FreeBucketMap = 0;
+	pArena->psBTSlabs = IMG_NULL;
+	pArena->pUnusedBT = IMG_NULL;
 	pArena->pHeadSegment = IMG_NULL;
 	pArena->pTailSegment = IMG_NULL;
 	pArena->uQuantum = uQuantum;
@@ -1294,6 +1464,7 @@ RA_Create (IMG_CHAR *name,
 	return pArena;
 
 insert_fail:
+	_DeleteBTSlabs (pArena);
 	HASH_Delete (pArena->pSegmentHash);
 hash_fail:
 	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(RA_ARENA), pArena, IMG_NULL);
@@ -1331,6 +1502,7 @@ RA_Delete (RA_ARENA *pArena)
 
 	for (uIndex=0; uIndex<FREE_TABLE_LIMIT; uIndex++)
 		pArena->aHeadFree[uIndex] = IMG_NULL;
+	pArena->ui32FreeBucketMap = 0;
 
 	while (pArena->pHeadSegment != IMG_NULL)
 	{
@@ -1344,12 +1516,11 @@ RA_Delete (RA_ARENA *pArena)
 		}
 
 		_SegmentListRemove (pArena, pBT);
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pBT, IMG_NULL);
-		/*not nulling original pointer, it has changed*/
 #ifdef RA_STATS
 		pArena->sStatistics.uSpanCount--;
 #endif
 	}
+	_DeleteBTSlabs (pArena);
 #if defined(CONFIG_PROC_FS) && defined(CONFIG_PVR_PROC_FS)
 	{
 		IMG_VOID (*pfnRemoveProcEntrySeq)(struct proc_dir_entry*);
@@ -44,6 +44,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <linux/list.h>
 #include <linux/proc_fs.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include "services.h"
 #include "handle.h"
@@ -53,6 +55,12 @@ typedef struct _PVRSRV_ENV_PER_PROCESS_DATA_
 {
 	IMG_HANDLE hBlockAlloc;
 	struct proc_dir_entry *psProcDir;
+	/* Bridge calls of the process running without gPVRSRVLock (readers)
+	 * and holding it (writers), see pvr_bridge_k.c */
+	spinlock_t sBridgeLock;
+	IMG_UINT32 ui32BridgeReaders;
+	IMG_UINT32 ui32BridgeWriters;
+	wait_queue_head_t sBridgeReadersDone;
 #if defined(SUPPORT_DRI_DRM) && defined(PVR_SECURE_DRM_AUTH_EXPORT)
 	struct list_head sDRMAuthListHead;
 #endif
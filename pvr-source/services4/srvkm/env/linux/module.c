@@ -772,6 +772,7 @@ static int PVRSRVOpen(struct inode unref__ * pInode, struct file *pFile)
 	list_add_tail(&psPrivateData->sDRMAuthListItem, &psEnvPerProc->sDRMAuthListHead);
 #endif
 	psPrivateData->ui32OpenPID = ui32PID;
+	psPrivateData->psPerProc = PVRSRVPerProcessData(ui32PID);
 	psPrivateData->hBlockAlloc = hBlockAlloc;
 	PRIVATE_DATA(pFile) = psPrivateData;
 	iRet = 0;
@@ -76,6 +76,9 @@ PVRSRV_ERROR OSPerProcessPrivateDataInit(IMG_HANDLE *phOsPrivateData)
 
 	psEnvPerProc->hBlockAlloc = hBlockAlloc;
 
+	spin_lock_init(&psEnvPerProc->sBridgeLock);
+	init_waitqueue_head(&psEnvPerProc->sBridgeReadersDone);
+
 	/* Linux specific mmap processing */
 	LinuxMMapPerProcessConnect(psEnvPerProc);
 
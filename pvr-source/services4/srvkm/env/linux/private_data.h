@@ -63,6 +63,9 @@ typedef struct
 	/* PID that created this services connection */
 	IMG_UINT32 ui32OpenPID;
 
+	/* Per-process data of ui32OpenPID, kept alive by this connection */
+	PVRSRV_PER_PROCESS_DATA *psPerProc;
+
 	/* Global kernel MemInfo handle */
 #if defined (SUPPORT_SID_INTERFACE)
 	IMG_SID hKernelMemInfo;
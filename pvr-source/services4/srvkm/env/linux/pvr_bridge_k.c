@@ -41,6 +41,12 @@ IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */ /**************************************************************************/
 
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#if defined(DEBUG_BRIDGE_KM)
+#include <linux/ktime.h>
+#endif
+
 #include "img_defs.h"
 #include "services.h"
 #include "pvr_bridge.h"
@@ -55,13 +61,11 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "pvr_uaccess.h"
 #include "refcount.h"
 #include "buffer_manager.h"
+#include "env_perproc.h"
 
 #if defined(SUPPORT_DRI_DRM)
 #include <drm/drmP.h>
 #include "pvr_drm.h"
-#if defined(PVR_SECURE_DRM_AUTH_EXPORT)
-#include "env_perproc.h"
-#endif
 #endif
 
 /* VGX: */
@@ -208,32 +212,194 @@ static void ProcSeqShowBridgeStats(struct seq_file *sfile,void* el)
 						  "Total ioctl call count = %u\n"
 						  "Total number of bytes copied via copy_from_user = %u\n"
 						  "Total number of bytes copied via copy_to_user = %u\n"
-						  "Total number of bytes copied via copy_*_user = %u\n\n"
-						  "%-45s | %-40s | %10s | %20s | %10s\n",
+						  "Total number of bytes copied via copy_*_user = %u\n"
+						  "Total time waiting for the bridge lock = %uus\n\n"
+						  "%-45s | %-40s | %10s | %20s | %10s | %10s | %10s | %12s | %10s\n",
 						  g_BridgeGlobalStats.ui32IOCTLCount,
 						  g_BridgeGlobalStats.ui32TotalCopyFromUserBytes,
 						  g_BridgeGlobalStats.ui32TotalCopyToUserBytes,
 						  g_BridgeGlobalStats.ui32TotalCopyFromUserBytes+g_BridgeGlobalStats.ui32TotalCopyToUserBytes,
+						  g_BridgeGlobalStats.ui32TotalLockWaitus,
 						  "Bridge Name",
 						  "Wrapper Function",
 						  "Call Count",
 						  "copy_from_user Bytes",
-						  "copy_to_user Bytes"
+						  "copy_to_user Bytes",
+						  "Unlocked",
+						  "Lock Waits",
+						  "Lock Wait us",
+						  "Max Wait us"
 						 );
 		return;
 	}
 
 	seq_printf(sfile,
-				   "%-45s   %-40s   %-10u   %-20u   %-10u\n",
+				   "%-45s   %-40s   %-10u   %-20u   %-10u   %-10u   %-10u   %-12u   %-10u\n",
 				   psEntry->pszIOCName,
 				   psEntry->pszFunctionName,
 				   psEntry->ui32CallCount,
 				   psEntry->ui32CopyFromUserTotalBytes,
-				   psEntry->ui32CopyToUserTotalBytes);
+				   psEntry->ui32CopyToUserTotalBytes,
+				   psEntry->ui32UnlockedCallCount,
+				   psEntry->ui32LockWaitCount,
+				   psEntry->ui32LockWaitTotalus,
+				   psEntry->ui32LockWaitMaxus);
 }
 
 #endif /* DEBUG_BRIDGE_KM */
 
+/*
+ * Calls of class PVRSRV_BRIDGE_LOCK_PROCESS run without gPVRSRVLock
+ * (readers). They only read objects reached through the handle base of
+ * their process, which only changes in calls of the same process that hold
+ * gPVRSRVLock (writers). A writer counts from the moment its per-process
+ * data is found until it returns, including while it sleeps in an event
+ * object wait with gPVRSRVLock dropped. Readers don't start while there is
+ * a writer, they take gPVRSRVLock like any other call instead, and writers
+ * wait for the readers already running. Readers never block, so writers can
+ * wait for them with gPVRSRVLock held.
+ */
+static IMG_BOOL BridgeReaderEnter(PVRSRV_ENV_PER_PROCESS_DATA *psEnvPerProc)
+{
+	IMG_BOOL bEntered = IMG_FALSE;
+
+	spin_lock(&psEnvPerProc->sBridgeLock);
+	if (psEnvPerProc->ui32BridgeWriters == 0)
+	{
+		psEnvPerProc->ui32BridgeReaders++;
+		bEntered = IMG_TRUE;
+	}
+	spin_unlock(&psEnvPerProc->sBridgeLock);
+
+	return bEntered;
+}
+
+static IMG_VOID BridgeReaderExit(PVRSRV_ENV_PER_PROCESS_DATA *psEnvPerProc)
+{
+	IMG_BOOL bWake;
+
+	spin_lock(&psEnvPerProc->sBridgeLock);
+	psEnvPerProc->ui32BridgeReaders--;
+	bWake = psEnvPerProc->ui32BridgeReaders == 0 && psEnvPerProc->ui32BridgeWriters != 0;
+	spin_unlock(&psEnvPerProc->sBridgeLock);
+
+	if (bWake)
+	{
+		wake_up(&psEnvPerProc->sBridgeReadersDone);
+	}
+}
+
+static IMG_BOOL BridgeReadersDone(PVRSRV_ENV_PER_PROCESS_DATA *psEnvPerProc)
+{
+	IMG_BOOL bDone;
+
+	spin_lock(&psEnvPerProc->sBridgeLock);
+	bDone = psEnvPerProc->ui32BridgeReaders == 0;
+	spin_unlock(&psEnvPerProc->sBridgeLock);
+
+	return bDone;
+}
+
+static IMG_VOID BridgeWriterEnter(PVRSRV_ENV_PER_PROCESS_DATA *psEnvPerProc)
+{
+	spin_lock(&psEnvPerProc->sBridgeLock);
+	psEnvPerProc->ui32BridgeWriters++;
+	spin_unlock(&psEnvPerProc->sBridgeLock);
+
+	wait_event(psEnvPerProc->sBridgeReadersDone, BridgeReadersDone(psEnvPerProc));
+}
+
+static IMG_VOID BridgeWriterExit(PVRSRV_ENV_PER_PROCESS_DATA *psEnvPerProc)
+{
+	spin_lock(&psEnvPerProc->sBridgeLock);
+	psEnvPerProc->ui32BridgeWriters--;
+	spin_unlock(&psEnvPerProc->sBridgeLock);
+}
+
+/*
+ * Dispatch a call of class PVRSRV_BRIDGE_LOCK_PROCESS without gPVRSRVLock.
+ * Only done for the process that opened the connection and through the
+ * connection's own services handle: the per-process data is then kept alive
+ * by the open file and doesn't need looking up in the kernel handle base.
+ * Returns IMG_FALSE if the call has to take gPVRSRVLock after all.
+ */
+static IMG_BOOL
+BridgeDispatchUnlocked(PVRSRV_FILE_PRIVATE_DATA *psPrivateData,
+					   PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM,
+					   IMG_UINT32 ui32PID,
+					   IMG_INT *piErr)
+{
+	PVRSRV_PER_PROCESS_DATA *psPerProc = psPrivateData->psPerProc;
+	PVRSRV_ENV_PER_PROCESS_DATA *psEnvPerProc;
+
+	/* Import/Export file descriptors are checked with the lock held */
+	if (psPerProc == IMG_NULL ||
+		psPrivateData->ui32OpenPID != ui32PID ||
+		psPrivateData->hKernelMemInfo ||
+		psPerProc->hPerProcData != psBridgePackageKM->hKernelServices ||
+		psBridgePackageKM->ui32InBufferSize > PVRSRV_BRIDGE_UNLOCKED_IN_SIZE ||
+		psBridgePackageKM->ui32OutBufferSize > PVRSRV_BRIDGE_UNLOCKED_OUT_SIZE)
+	{
+		return IMG_FALSE;
+	}
+
+	psEnvPerProc = (PVRSRV_ENV_PER_PROCESS_DATA *)PVRSRVProcessPrivateData(psPerProc);
+	if (psEnvPerProc == IMG_NULL || !BridgeReaderEnter(psEnvPerProc))
+	{
+		return IMG_FALSE;
+	}
+
+	psBridgePackageKM->ui32BridgeID = PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID);
+
+	*piErr = BridgedDispatchUnlockedKM(psPerProc, psBridgePackageKM);
+
+	BridgeReaderExit(psEnvPerProc);
+
+#if defined(DEBUG_BRIDGE_KM)
+	/* Not under gPVRSRVLock, the odd update may get lost */
+	g_BridgeDispatchTable[psBridgePackageKM->ui32BridgeID].ui32UnlockedCallCount++;
+#endif
+	return IMG_TRUE;
+}
+
+/*
+ * Take gPVRSRVLock for a bridge call, accounting the time spent waiting for
+ * it to the call's dispatch table entry.
+ */
+static IMG_VOID BridgeLock(IMG_UINT32 ui32BridgeID)
+{
+#if defined(DEBUG_BRIDGE_KM)
+	ktime_t sStart;
+	IMG_UINT32 ui32Waitus;
+
+	if (LinuxTryLockMutex(&gPVRSRVLock))
+	{
+		return;
+	}
+
+	sStart = ktime_get();
+	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+	ui32Waitus = (IMG_UINT32)ktime_to_us(ktime_sub(ktime_get(), sStart));
+
+	if (ui32BridgeID < BRIDGE_DISPATCH_TABLE_ENTRY_COUNT)
+	{
+		PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY *psEntry = &g_BridgeDispatchTable[ui32BridgeID];
+
+		psEntry->ui32LockWaitCount++;
+		psEntry->ui32LockWaitTotalus += ui32Waitus;
+		if (ui32Waitus > psEntry->ui32LockWaitMaxus)
+		{
+			psEntry->ui32LockWaitMaxus = ui32Waitus;
+		}
+	}
+	g_BridgeGlobalStats.ui32TotalLockWaitus += ui32Waitus;
+#else
+	PVR_UNREFERENCED_PARAMETER(ui32BridgeID);
+
+	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+#endif
+}
+
 
 #if defined(SUPPORT_DRI_DRM)
 int
@@ -251,10 +417,10 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 	PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM;
 	IMG_UINT32 ui32PID = OSGetCurrentProcessIDKM();
 	PVRSRV_PER_PROCESS_DATA *psPerProc;
+	PVRSRV_ENV_PER_PROCESS_DATA *psEnvPerProc = IMG_NULL;
+	IMG_UINT32 ui32BridgeID;
 	IMG_INT err = -EFAULT;
 
-	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
-
 #if defined(SUPPORT_DRI_DRM)
 	psBridgePackageKM = (PVRSRV_BRIDGE_PACKAGE *)arg;
 	PVR_ASSERT(psBridgePackageKM != IMG_NULL);
@@ -268,7 +434,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 		PVR_DPF((PVR_DBG_ERROR, "%s: Received invalid pointer to function arguments",
 				 __FUNCTION__));
 
-		goto unlock_and_return;
+		return err;
 	}
 	
 	/* FIXME - Currently the CopyFromUserWrapper which collects stats about
@@ -280,12 +446,22 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 					  sizeof(PVRSRV_BRIDGE_PACKAGE))
 	  != PVRSRV_OK)
 	{
-		goto unlock_and_return;
+		return err;
 	}
 #endif
 
 	cmd = psBridgePackageKM->ui32BridgeID;
-	
+	ui32BridgeID = PVRSRV_GET_BRIDGE_ID(cmd);
+
+	if(ui32BridgeID < BRIDGE_DISPATCH_TABLE_ENTRY_COUNT &&
+	   g_BridgeDispatchTable[ui32BridgeID].eLockClass == PVRSRV_BRIDGE_LOCK_PROCESS &&
+	   BridgeDispatchUnlocked(PRIVATE_DATA(pFile), psBridgePackageKM, ui32PID, &err))
+	{
+		return err;
+	}
+
+	BridgeLock(ui32BridgeID);
+
 	if(cmd != PVRSRV_BRIDGE_CONNECT_SERVICES)
 	{
 		PVRSRV_ERROR eError;
@@ -321,7 +497,13 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 		}
 	}
 
-	psBridgePackageKM->ui32BridgeID = PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID);
+	psEnvPerProc = (PVRSRV_ENV_PER_PROCESS_DATA *)PVRSRVProcessPrivateData(psPerProc);
+	if(psEnvPerProc != IMG_NULL)
+	{
+		BridgeWriterEnter(psEnvPerProc);
+	}
+
+	psBridgePackageKM->ui32BridgeID = ui32BridgeID;
 
 	switch(cmd)
 	{
@@ -519,6 +701,10 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 	}
 
 unlock_and_return:
+	if(psEnvPerProc != IMG_NULL)
+	{
+		BridgeWriterExit(psEnvPerProc);
+	}
 	LinuxUnLockMutex(&gPVRSRVLock);
 	return err;
 }
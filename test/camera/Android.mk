@@ -0,0 +1,126 @@
+#
+# Copyright (C) Texas Instruments - http://www.ti.com/
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+LOCAL_PATH:= $(call my-dir)
+
+JPEG_BENCH_SRC_FILES := \
+    jpeg_encoder_bench.cpp \
+    ../../camera/StripeEncoder_libjpeg.cpp \
+    ../../camera/NV12_resize.cpp \
+    ../../camera/PixelConvert.cpp
+JPEG_BENCH_C_INCLUDES := \
+    $(LOCAL_PATH)/../../camera/inc \
+    $(LOCAL_PATH)/../../libtiutils
+JPEG_BENCH_CFLAGS := -DLOG_TAG=\"jpeg_encoder_bench\" -Wall
+
+# Striped JPEG encoder benchmark for the target
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(JPEG_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(JPEG_BENCH_C_INCLUDES) external/jpeg
+LOCAL_CFLAGS := $(JPEG_BENCH_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libjpeg libtiutils libutils libcutils liblog
+LOCAL_MODULE := jpeg_encoder_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+# Same benchmark running on the build host, against the host's libjpeg
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+    $(JPEG_BENCH_SRC_FILES) \
+    ../../libtiutils/DebugUtils.cpp
+LOCAL_C_INCLUDES := $(JPEG_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(JPEG_BENCH_CFLAGS)
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -ljpeg -lpthread -lrt
+LOCAL_MODULE := jpeg_encoder_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+MJPEG_BENCH_SRC_FILES := \
+    mjpeg_decoder_bench.cpp \
+    ../../camera/Decoder_libjpeg.cpp \
+    ../../camera/PixelConvert.cpp
+MJPEG_BENCH_C_INCLUDES := \
+    $(LOCAL_PATH)/../../camera/inc \
+    $(LOCAL_PATH)/../../libtiutils
+MJPEG_BENCH_CFLAGS := -DLOG_TAG=\"mjpeg_decoder_bench\" -Wall
+
+# MJPEG preview decoder benchmark for the target
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(MJPEG_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(MJPEG_BENCH_C_INCLUDES) external/jpeg
+LOCAL_CFLAGS := $(MJPEG_BENCH_CFLAGS) $(ANDROID_API_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libjpeg libtiutils libutils libcutils liblog
+LOCAL_MODULE := mjpeg_decoder_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+# Same benchmark running on the build host, the host's libjpeg has none of
+# the Android seek extensions
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+    $(MJPEG_BENCH_SRC_FILES) \
+    ../../libtiutils/DebugUtils.cpp
+LOCAL_C_INCLUDES := $(MJPEG_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(MJPEG_BENCH_CFLAGS) -DANDROID_API_N_OR_LATER
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -ljpeg -lpthread -lrt
+LOCAL_MODULE := mjpeg_decoder_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+PIXEL_CONVERT_C_INCLUDES := $(LOCAL_PATH)/../../camera/inc
+PIXEL_CONVERT_CFLAGS := -Wall
+ifdef ARCH_ARM_HAVE_NEON
+    PIXEL_CONVERT_TARGET_CFLAGS := -DARCH_ARM_HAVE_NEON
+endif
+
+# Pixel conversion test and benchmark for the target, each runs every
+# instruction set the CPU has
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := pixel_convert_test.cpp ../../camera/PixelConvert.cpp
+LOCAL_C_INCLUDES := $(PIXEL_CONVERT_C_INCLUDES)
+LOCAL_CFLAGS := $(PIXEL_CONVERT_CFLAGS) $(PIXEL_CONVERT_TARGET_CFLAGS)
+LOCAL_MODULE := pixel_convert_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := pixel_convert_bench.cpp ../../camera/PixelConvert.cpp
+LOCAL_C_INCLUDES := $(PIXEL_CONVERT_C_INCLUDES)
+LOCAL_CFLAGS := $(PIXEL_CONVERT_CFLAGS) $(PIXEL_CONVERT_TARGET_CFLAGS)
+LOCAL_MODULE := pixel_convert_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+# Same on the build host, SSE2 and AVX2 against the C kernels
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := pixel_convert_test.cpp ../../camera/PixelConvert.cpp
+LOCAL_C_INCLUDES := $(PIXEL_CONVERT_C_INCLUDES)
+LOCAL_CFLAGS := $(PIXEL_CONVERT_CFLAGS)
+LOCAL_LDLIBS := -lpthread
+LOCAL_MODULE := pixel_convert_test
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := pixel_convert_bench.cpp ../../camera/PixelConvert.cpp
+LOCAL_C_INCLUDES := $(PIXEL_CONVERT_C_INCLUDES)
+LOCAL_CFLAGS := $(PIXEL_CONVERT_CFLAGS)
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := pixel_convert_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
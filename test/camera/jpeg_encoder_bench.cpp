@@ -0,0 +1,406 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Striped JPEG encoder benchmark
+ *
+ * Encodes synthetic captures from 2MP to 13MP with StripeEncoder_libjpeg,
+ * the way Encoder_libjpeg does for ENCODE_RAW_YUV422I_TO_JPEG frames. Every
+ * size is measured three ways:
+ *
+ * single  one pass on the calling thread, as before the stripes
+ * striped one capture at a time split over the worker pool
+ * burst   as many captures in flight as there are workers, the way
+ *         Encoder_libjpeg threads pile up during burst capture
+ *
+ * The striped JPEG is decoded and checked against the single pass one, the
+ * restart markers must not change a pixel. So are a few small edge cases
+ * first, run it under ASan to catch reads past the planes.
+ *
+ * usage: jpeg_encoder_bench [frames] [uyvy|yuyv|nv12]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+extern "C" {
+#include "jpeglib.h"
+}
+
+#include "StripeEncoder_libjpeg.h"
+
+using Ti::Camera::StripeEncoder_libjpeg;
+using Ti::Camera::libjpeg_encode_params;
+using Ti::Camera::libjpeg_input_format;
+
+#define DEFAULT_FRAMES 10
+#define QUALITY 95
+
+/* Stripes the check splits into, whatever the number of workers */
+#define CHECK_STRIPES 8
+
+static const struct {
+    const char* name;
+    int width;
+    int height;
+} sizes[] = {
+    { "2MP", 1600, 1200 },
+    { "3MP", 2048, 1536 },
+    { "5MP", 2592, 1944 },
+    { "8MP", 3264, 2448 },
+    { "13MP", 4160, 3120 },
+};
+
+/* Resizing is for yuv420sp only, an odd width for yuv422i only: the encoder
+ * must turn it down as it comes in pixel pairs */
+static const struct {
+    int in_width;
+    int in_height;
+    int out_width;
+    int out_height;
+} edges[] = {
+    /* an output height of 16k + 1 puts a lone chroma row at an MCU row start */
+    { 640, 480, 160, 129 },
+    { 640, 480, 320, 241 },
+    { 160, 129, 160, 129 },
+    { 161, 121, 161, 121 },
+};
+
+static const struct {
+    const char* name;
+    libjpeg_input_format format;
+} formats[] = {
+    { "uyvy", Ti::Camera::LIBJPEG_INPUT_YUV422I_UYVY },
+    { "yuyv", Ti::Camera::LIBJPEG_INPUT_YUV422I_YUYV },
+    { "nv12", Ti::Camera::LIBJPEG_INPUT_YUV420SP },
+};
+
+struct bench_frame {
+    libjpeg_input_format format;
+    int width;
+    int height;
+    int out_width;
+    int out_height;
+    uint8_t* src;
+    int src_size;
+};
+
+struct burst_thread {
+    pthread_t thread;
+    const bench_frame* frame;
+    int frames;
+    int ok;
+};
+
+static const volatile bool not_canceled = false;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Smooth gradients with some noise, compresses like a camera capture */
+static int init_frame(bench_frame* f, libjpeg_input_format format, int width, int height)
+{
+    unsigned int seed = width;
+    int x, y;
+
+    f->format = format;
+    f->width = f->out_width = width;
+    f->height = f->out_height = height;
+    f->src_size = format == Ti::Camera::LIBJPEG_INPUT_YUV420SP ?
+                  width * (height + (height + 1) / 2) : width * height * 2;
+    f->src = (uint8_t*)malloc(f->src_size);
+    if (!f->src)
+        return -1;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            int luma, cb, cr;
+
+            seed = seed * 1103515245 + 12345;
+            luma = (x * 255 / width + y * 255 / height) / 2 + ((seed >> 16) & 15);
+            cb = 128 + (x - width / 2) * 96 / width;
+            cr = 128 + (y - height / 2) * 96 / height;
+
+            if (format == Ti::Camera::LIBJPEG_INPUT_YUV420SP) {
+                f->src[y * width + x] = luma;
+                if (!(y & 1) && !(x & 1)) {
+                    uint8_t* uv = f->src + width * height + (y / 2) * width + x;
+                    uv[0] = cr;
+                    uv[1] = cb;
+                }
+            } else {
+                uint8_t* p = f->src + y * width * 2 + (x & ~1) * 2;
+                int uyvy = format == Ti::Camera::LIBJPEG_INPUT_YUV422I_UYVY;
+
+                /* the last pixel of an odd width has no pair */
+                if ((x | 1) >= width) {
+                    p[0] = uyvy ? cb : luma;
+                    p[1] = uyvy ? luma : cb;
+                    continue;
+                }
+                p[(uyvy ? 1 : 0) + (x & 1) * 2] = luma;
+                p[uyvy ? 0 : 1] = cb;
+                p[uyvy ? 2 : 3] = cr;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Same buffer sizing as AppCallbackNotifier, the raw frame size */
+static size_t encode(const bench_frame* f, uint8_t* dst, int stripes)
+{
+    libjpeg_encode_params p;
+
+    memset(&p, 0, sizeof(p));
+    p.src = f->src;
+    p.src_size = f->src_size;
+    p.dst = dst;
+    p.dst_size = f->src_size;
+    p.quality = QUALITY;
+    p.in_width = f->width;
+    p.in_height = f->height;
+    p.out_width = f->out_width;
+    p.out_height = f->out_height;
+    return StripeEncoder_libjpeg::encode(&p, f->format, &not_canceled, stripes);
+}
+
+/* libjpeg 6b has no jpeg_mem_src, the whole JPEG is one buffer */
+static void mem_init_source(j_decompress_ptr)
+{
+}
+
+static boolean mem_fill_input_buffer(j_decompress_ptr)
+{
+    return FALSE;
+}
+
+static void mem_skip_input_data(j_decompress_ptr cinfo, long n)
+{
+    cinfo->src->next_input_byte += n;
+    cinfo->src->bytes_in_buffer -= n;
+}
+
+static void mem_term_source(j_decompress_ptr)
+{
+}
+
+static uint8_t* decode(const uint8_t* jpeg, size_t size, size_t* out_size)
+{
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    jpeg_source_mgr src;
+    uint8_t* pixels;
+    size_t stride;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+
+    memset(&src, 0, sizeof(src));
+    src.next_input_byte = jpeg;
+    src.bytes_in_buffer = size;
+    src.init_source = mem_init_source;
+    src.fill_input_buffer = mem_fill_input_buffer;
+    src.skip_input_data = mem_skip_input_data;
+    src.resync_to_restart = jpeg_resync_to_restart;
+    src.term_source = mem_term_source;
+    cinfo.src = &src;
+
+    jpeg_read_header(&cinfo, TRUE);
+    jpeg_start_decompress(&cinfo);
+    stride = cinfo.output_width * cinfo.output_components;
+    *out_size = stride * cinfo.output_height;
+    pixels = (uint8_t*)malloc(*out_size);
+    while (pixels && cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels + cinfo.output_scanline * stride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return pixels;
+}
+
+/* Decoded pixels of the striped JPEG must match the single pass ones */
+static int check(const bench_frame* f, uint8_t* dst)
+{
+    size_t single_size, striped_size, single_len, striped_len;
+    uint8_t *single, *striped;
+    int rv;
+
+    single_len = encode(f, dst, 1);
+    single = single_len ? decode(dst, single_len, &single_size) : NULL;
+    striped_len = encode(f, dst, CHECK_STRIPES);
+    striped = striped_len ? decode(dst, striped_len, &striped_size) : NULL;
+
+    rv = single && striped && single_size == striped_size &&
+         !memcmp(single, striped, single_size) ? 0 : -1;
+    free(single);
+    free(striped);
+    return rv;
+}
+
+static int check_edges(libjpeg_input_format format)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        bool yuv420sp = format == Ti::Camera::LIBJPEG_INPUT_YUV420SP;
+        bool resize = edges[i].in_width != edges[i].out_width ||
+                      edges[i].in_height != edges[i].out_height;
+        bench_frame f;
+        uint8_t* dst;
+        int rv;
+
+        if (resize ? !yuv420sp : yuv420sp && (edges[i].out_width & 1))
+            continue;
+        if (init_frame(&f, format, edges[i].in_width, edges[i].in_height))
+            return -1;
+        f.out_width = edges[i].out_width;
+        f.out_height = edges[i].out_height;
+        dst = (uint8_t*)malloc(f.src_size);
+
+        if (!dst)
+            rv = -1;
+        else if (f.out_width & 1)
+            rv = encode(&f, dst, 1) ? -1 : 0;
+        else
+            rv = check(&f, dst);
+
+        free(dst);
+        free(f.src);
+        if (rv) {
+            printf("%dx%d to %dx%d  edge case check failed\n", edges[i].in_width,
+                edges[i].in_height, edges[i].out_width, edges[i].out_height);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static double run(const bench_frame* f, uint8_t* dst, int stripes, int frames, size_t* size)
+{
+    uint64_t start = now_ns();
+    int i;
+
+    for (i = 0; i < frames; i++)
+        *size = encode(f, dst, stripes);
+    return (now_ns() - start) / 1e6 / frames;
+}
+
+static void* burst_loop(void* arg)
+{
+    burst_thread* t = (burst_thread*)arg;
+    uint8_t* dst = (uint8_t*)malloc(t->frame->src_size);
+    int i;
+
+    t->ok = dst != NULL;
+    for (i = 0; t->ok && i < t->frames; i++)
+        t->ok = encode(t->frame, dst, 0) > 0;
+    free(dst);
+    return NULL;
+}
+
+static double run_burst(const bench_frame* f, int threads, int frames, int* ok)
+{
+    burst_thread* t = (burst_thread*)calloc(threads, sizeof(*t));
+    uint64_t start;
+    int i;
+
+    *ok = t != NULL;
+    if (!t)
+        return 0;
+
+    start = now_ns();
+    for (i = 0; i < threads; i++) {
+        t[i].frame = f;
+        t[i].frames = frames;
+        pthread_create(&t[i].thread, NULL, burst_loop, &t[i]);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(t[i].thread, NULL);
+        *ok = *ok && t[i].ok;
+    }
+
+    free(t);
+    return threads * frames / ((now_ns() - start) / 1e9);
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : DEFAULT_FRAMES;
+    const char* format_name = argc > 2 ? argv[2] : formats[0].name;
+    int workers = StripeEncoder_libjpeg::getWorkerCount();
+    int format = -1;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (!strcmp(format_name, formats[i].name))
+            format = i;
+    }
+
+    if (frames <= 0 || format < 0) {
+        fprintf(stderr, "usage: %s [frames] [uyvy|yuyv|nv12]\n", argv[0]);
+        return 1;
+    }
+
+    if (check_edges(formats[format].format))
+        return 1;
+
+    printf("%s captures, quality %d, %d frames per size, %d workers\n",
+        formats[format].name, QUALITY, frames, workers);
+    printf("size   single ms  striped ms  speedup  single fps  burst fps     bytes\n");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_frame f;
+        uint8_t* dst;
+        double single_ms, striped_ms, burst_fps;
+        size_t single_size = 0, striped_size = 0;
+        int ok;
+
+        if (init_frame(&f, formats[format].format, sizes[i].width, sizes[i].height))
+            return 1;
+        dst = (uint8_t*)malloc(f.src_size);
+        if (!dst)
+            return 1;
+
+        if (check(&f, dst)) {
+            printf("%-5s  striped JPEG does not match the single pass one\n", sizes[i].name);
+            return 1;
+        }
+
+        single_ms = run(&f, dst, 1, frames, &single_size);
+        striped_ms = run(&f, dst, 0, frames, &striped_size);
+        burst_fps = run_burst(&f, workers, frames, &ok);
+        if (!single_size || !striped_size || !ok) {
+            printf("%-5s  encode failed\n", sizes[i].name);
+            return 1;
+        }
+
+        printf("%-5s  %9.1f  %10.1f  %7.2f  %10.1f  %9.1f  %8zu\n", sizes[i].name,
+            single_ms, striped_ms, single_ms / striped_ms, 1000.0 / single_ms,
+            burst_fps, striped_size);
+
+        free(dst);
+        free(f.src);
+    }
+    return 0;
+}
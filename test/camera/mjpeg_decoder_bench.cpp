@@ -0,0 +1,475 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * MJPEG preview decoder benchmark
+ *
+ * Decodes MJPEG streams to tiler strided NV12 with Decoder_libjpeg, the way
+ * SwFrameDecoder does for USB cameras. A stream is either recorded from a
+ * UVC camera, one JPEG after the other as written by
+ *
+ *   ffmpeg -f v4l2 -input_format mjpeg -video_size 1280x720 -i /dev/video0 \
+ *          -c copy -f mjpeg preview_720p.mjpeg
+ *
+ * or, with no file given, synthesized at 720p and 1080p as 4:2:2 frames
+ * without Huffman tables like UVC cameras send. Every stream is measured
+ * three ways:
+ *
+ * copy    appendDHT into a bounce buffer then decode, one frame at a time
+ * dht     decodeWithDHT reading the tables ahead of the frame
+ * N thr   decodeWithDHT with a frame per thread in flight, as many threads
+ *         as SwFrameDecoder starts on this machine
+ *
+ * Both single thread paths must produce the same NV12 frame. The last column
+ * tells whether the pipelined rate keeps up with a 30 fps preview.
+ *
+ * usage: mjpeg_decoder_bench [frames] [stream.mjpeg ...]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C" {
+#include "jpeglib.h"
+}
+
+#include "Decoder_libjpeg.h"
+
+using Ti::Camera::Decoder_libjpeg;
+
+#define DEFAULT_FRAMES 300
+#define QUALITY 80
+#define TARGET_FPS 30
+
+/* Frames a synthesized stream loops over */
+#define SYNTH_FRAMES 30
+
+/* Same as SwFrameDecoder */
+#define NV12_TILER_STRIDE 4096
+#define MAX_DECODE_THREADS 4
+
+static const struct {
+    const char* name;
+    int width;
+    int height;
+} synth_sizes[] = {
+    { "720p", 1280, 720 },
+    { "1080p", 1920, 1080 },
+};
+
+struct mjpeg_stream {
+    char name[64];
+    int width;
+    int height;
+    int count;
+    unsigned char** frames;
+    int* lens;
+};
+
+struct decode_thread {
+    pthread_t thread;
+    const mjpeg_stream* stream;
+    int frames;
+    int* next;
+    pthread_mutex_t* lock;
+    int ok;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int add_frame(mjpeg_stream* s, const unsigned char* data, int len)
+{
+    unsigned char** frames = (unsigned char**)realloc(s->frames, (s->count + 1) * sizeof(*frames));
+    int* lens = (int*)realloc(s->lens, (s->count + 1) * sizeof(*lens));
+
+    if (frames)
+        s->frames = frames;
+    if (lens)
+        s->lens = lens;
+    if (!frames || !lens)
+        return -1;
+
+    s->frames[s->count] = (unsigned char*)malloc(len);
+    if (!s->frames[s->count])
+        return -1;
+    memcpy(s->frames[s->count], data, len);
+    s->lens[s->count++] = len;
+    return 0;
+}
+
+/* libjpeg 6b has no jpeg_mem_dest, frames are collected in one buffer */
+struct mem_destination {
+    jpeg_destination_mgr pub;
+    unsigned char* buf;
+    size_t size;
+};
+
+static void mem_init_destination(j_compress_ptr cinfo)
+{
+    mem_destination* dest = (mem_destination*)cinfo->dest;
+    dest->pub.next_output_byte = dest->buf;
+    dest->pub.free_in_buffer = dest->size;
+}
+
+static boolean mem_empty_output_buffer(j_compress_ptr)
+{
+    /* Sized for the worst case, never full */
+    return FALSE;
+}
+
+static void mem_term_destination(j_compress_ptr)
+{
+}
+
+/*
+ * Drops the DHT segments of a JPEG the way UVC cameras leave them out, the
+ * encoder used the standard tables the decoder puts back.
+ */
+static int strip_dht(unsigned char* jpeg, int len)
+{
+    int i = 2, out = 2;
+
+    while (i + 4 <= len && jpeg[i] == 0xFF && jpeg[i + 1] != 0xDA) {
+        int seg = 2 + (jpeg[i + 2] << 8 | jpeg[i + 3]);
+        if (jpeg[i + 1] != 0xC4) {
+            memmove(jpeg + out, jpeg + i, seg);
+            out += seg;
+        }
+        i += seg;
+    }
+    memmove(jpeg + out, jpeg + i, len - i);
+    return out + len - i;
+}
+
+/* Moving gradients with some noise, like a camera pointed at a scene */
+static int synth_stream(mjpeg_stream* s, const char* name, int width, int height)
+{
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    mem_destination dest;
+    unsigned char* row = (unsigned char*)malloc(width * 3);
+    unsigned int seed = width;
+    int f, ret = 0;
+
+    memset(s, 0, sizeof(*s));
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->width = width;
+    s->height = height;
+
+    dest.size = width * height * 3 + 4096;
+    dest.buf = (unsigned char*)malloc(dest.size);
+    if (!row || !dest.buf)
+        ret = -1;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    dest.pub.init_destination = mem_init_destination;
+    dest.pub.empty_output_buffer = mem_empty_output_buffer;
+    dest.pub.term_destination = mem_term_destination;
+    cinfo.dest = &dest.pub;
+
+    for (f = 0; !ret && f < SYNTH_FRAMES; f++) {
+        cinfo.image_width = width;
+        cinfo.image_height = height;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_YCbCr;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, QUALITY, TRUE);
+        /* 4:2:2 as UVC cameras send */
+        cinfo.comp_info[0].h_samp_factor = 2;
+        cinfo.comp_info[0].v_samp_factor = 1;
+        jpeg_start_compress(&cinfo, TRUE);
+
+        while (cinfo.next_scanline < cinfo.image_height) {
+            int y = cinfo.next_scanline, x;
+            for (x = 0; x < width; x++) {
+                seed = seed * 1103515245 + 12345;
+                row[x * 3] = ((x + f * 8) * 255 / width + y * 255 / height) / 2 + ((seed >> 16) & 15);
+                row[x * 3 + 1] = 128 + (x - width / 2) * 96 / width;
+                row[x * 3 + 2] = 128 + (y - height / 2) * 96 / height;
+            }
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+
+        ret = add_frame(s, dest.buf, strip_dht(dest.buf, dest.size - dest.pub.free_in_buffer));
+    }
+
+    jpeg_destroy_compress(&cinfo);
+    free(dest.buf);
+    free(row);
+    return ret;
+}
+
+/* Reads the frame size from the first SOF marker */
+static int read_size(const unsigned char* jpeg, int len, int* width, int* height)
+{
+    int i = 2;
+
+    while (i + 9 <= len && jpeg[i] == 0xFF) {
+        if (jpeg[i + 1] == 0xC0 || jpeg[i + 1] == 0xC1) {
+            *height = jpeg[i + 5] << 8 | jpeg[i + 6];
+            *width = jpeg[i + 7] << 8 | jpeg[i + 8];
+            return 0;
+        }
+        i += 2 + (jpeg[i + 2] << 8 | jpeg[i + 3]);
+    }
+    return -1;
+}
+
+/* Splits a recorded stream at the SOI markers */
+static int load_stream(mjpeg_stream* s, const char* path)
+{
+    FILE* fp = fopen(path, "rb");
+    unsigned char* data;
+    long size, i, start = -1;
+    const char* base = strrchr(path, '/');
+
+    memset(s, 0, sizeof(*s));
+    snprintf(s->name, sizeof(s->name), "%s", base ? base + 1 : path);
+    if (!fp)
+        return -1;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = (unsigned char*)malloc(size);
+    if (!data || fread(data, 1, size, fp) != (size_t)size) {
+        free(data);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    for (i = 0; i + 1 < size; i++) {
+        if (data[i] == 0xFF && data[i + 1] == 0xD8 && (i + 2 >= size || data[i + 2] == 0xFF)) {
+            if (start >= 0 && add_frame(s, data + start, i - start))
+                break;
+            start = i;
+        }
+    }
+    if (start >= 0)
+        add_frame(s, data + start, size - start);
+    free(data);
+
+    return s->count && !read_size(s->frames[0], s->lens[0], &s->width, &s->height) ? 0 : -1;
+}
+
+static void free_stream(mjpeg_stream* s)
+{
+    int i;
+
+    for (i = 0; i < s->count; i++)
+        free(s->frames[i]);
+    free(s->frames);
+    free(s->lens);
+}
+
+static size_t nv12_size(const mjpeg_stream* s)
+{
+    return (size_t)NV12_TILER_STRIDE * (s->height + s->height / 2);
+}
+
+/* Both single thread paths must give the same frame */
+static int check(const mjpeg_stream* s, unsigned char* bounce, int bounce_size)
+{
+    Decoder_libjpeg decoder;
+    size_t size = nv12_size(s);
+    unsigned char* copy = (unsigned char*)calloc(1, size);
+    unsigned char* dht = (unsigned char*)calloc(1, size);
+    int i, rv = copy && dht ? 0 : -1;
+
+    for (i = 0; !rv && i < s->count && i < 4; i++) {
+        int len = Decoder_libjpeg::appendDHT(s->frames[i], s->lens[i], bounce, bounce_size);
+
+        if (!len || !decoder.decode(bounce, len, copy, NV12_TILER_STRIDE) ||
+            !decoder.decodeWithDHT(s->frames[i], s->lens[i], dht, NV12_TILER_STRIDE) ||
+            memcmp(copy, dht, size))
+            rv = -1;
+    }
+
+    free(copy);
+    free(dht);
+    return rv;
+}
+
+static double run_copy(const mjpeg_stream* s, unsigned char* bounce, int bounce_size,
+    unsigned char* nv12, int frames)
+{
+    Decoder_libjpeg decoder;
+    uint64_t start = now_ns();
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        int len = Decoder_libjpeg::appendDHT(s->frames[i % s->count], s->lens[i % s->count],
+            bounce, bounce_size);
+        if (!decoder.decode(bounce, len, nv12, NV12_TILER_STRIDE))
+            return 0;
+    }
+    return frames / ((now_ns() - start) / 1e9);
+}
+
+static double run_dht(const mjpeg_stream* s, unsigned char* nv12, int frames)
+{
+    Decoder_libjpeg decoder;
+    uint64_t start = now_ns();
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        if (!decoder.decodeWithDHT(s->frames[i % s->count], s->lens[i % s->count], nv12,
+            NV12_TILER_STRIDE))
+            return 0;
+    }
+    return frames / ((now_ns() - start) / 1e9);
+}
+
+/* Each thread takes the next frame of the stream, like SwFrameDecoder workers */
+static void* decode_loop(void* arg)
+{
+    decode_thread* t = (decode_thread*)arg;
+    const mjpeg_stream* s = t->stream;
+    Decoder_libjpeg decoder;
+    unsigned char* nv12 = (unsigned char*)malloc(nv12_size(s));
+
+    t->ok = nv12 != NULL;
+    while (t->ok) {
+        int i;
+
+        pthread_mutex_lock(t->lock);
+        i = (*t->next)++;
+        pthread_mutex_unlock(t->lock);
+        if (i >= t->frames)
+            break;
+
+        t->ok = decoder.decodeWithDHT(s->frames[i % s->count], s->lens[i % s->count], nv12,
+            NV12_TILER_STRIDE);
+    }
+    free(nv12);
+    return NULL;
+}
+
+static double run_pipelined(const mjpeg_stream* s, int threads, int frames)
+{
+    decode_thread t[MAX_DECODE_THREADS];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    uint64_t start = now_ns();
+    int i, next = 0, ok = 1;
+
+    for (i = 0; i < threads; i++) {
+        t[i].stream = s;
+        t[i].frames = frames;
+        t[i].next = &next;
+        t[i].lock = &lock;
+        pthread_create(&t[i].thread, NULL, decode_loop, &t[i]);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(t[i].thread, NULL);
+        ok = ok && t[i].ok;
+    }
+    return ok ? frames / ((now_ns() - start) / 1e9) : 0;
+}
+
+static int bench(const mjpeg_stream* s, int frames, int threads)
+{
+    int bounce_size = s->width * s->height / 2 + Decoder_libjpeg::readDHTSize();
+    unsigned char* bounce = (unsigned char*)malloc(bounce_size);
+    unsigned char* nv12 = (unsigned char*)malloc(nv12_size(s));
+    double copy_fps, dht_fps, pipelined_fps;
+    long bytes = 0;
+    int i;
+
+    if (!bounce || !nv12)
+        return -1;
+
+    if (check(s, bounce, bounce_size)) {
+        printf("%-16s decodeWithDHT does not match appendDHT and decode\n", s->name);
+        return -1;
+    }
+
+    copy_fps = run_copy(s, bounce, bounce_size, nv12, frames);
+    dht_fps = run_dht(s, nv12, frames);
+    pipelined_fps = run_pipelined(s, threads, frames);
+    if (!copy_fps || !dht_fps || !pipelined_fps) {
+        printf("%-16s decode failed\n", s->name);
+        return -1;
+    }
+
+    for (i = 0; i < s->count; i++)
+        bytes += s->lens[i];
+
+    printf("%-16s %4dx%-4d  %8ld  %8.1f  %8.1f  %8.1f  %s\n", s->name, s->width, s->height,
+        bytes / s->count, copy_fps, dht_fps, pipelined_fps,
+        pipelined_fps >= TARGET_FPS ? "yes" : "drops");
+
+    free(bounce);
+    free(nv12);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : DEFAULT_FRAMES;
+    long threads = sysconf(_SC_NPROCESSORS_CONF);
+    int rv = 0;
+    unsigned int i;
+
+    if (frames <= 0) {
+        fprintf(stderr, "usage: %s [frames] [stream.mjpeg ...]\n", argv[0]);
+        return 1;
+    }
+    if (threads < 1)
+        threads = 1;
+    else if (threads > MAX_DECODE_THREADS)
+        threads = MAX_DECODE_THREADS;
+
+    printf("%d frames per stream, %ld decode threads\n", frames, threads);
+    printf("stream           size        bytes/fr  copy fps   dht fps  %ld thr fps  %dfps\n",
+        threads, TARGET_FPS);
+
+    if (argc > 2) {
+        for (i = 2; !rv && i < (unsigned int)argc; i++) {
+            mjpeg_stream s;
+
+            if (load_stream(&s, argv[i])) {
+                fprintf(stderr, "%s: no MJPEG frames\n", argv[i]);
+                rv = -1;
+            } else {
+                rv = bench(&s, frames, threads);
+            }
+            free_stream(&s);
+        }
+    } else {
+        for (i = 0; !rv && i < sizeof(synth_sizes) / sizeof(synth_sizes[0]); i++) {
+            mjpeg_stream s;
+
+            rv = synth_stream(&s, synth_sizes[i].name, synth_sizes[i].width, synth_sizes[i].height);
+            if (!rv)
+                rv = bench(&s, frames, threads);
+            free_stream(&s);
+        }
+    }
+    return rv ? 1 : 0;
+}
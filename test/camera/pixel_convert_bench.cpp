@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Pixel conversion benchmark
+ *
+ * Times the frame conversions of the camera paths with each instruction set
+ * PixelConvert has on this build and CPU, from VGA to 13MP:
+ *
+ * yuyv>nv12  USB camera preview into a tiler buffer (V4LCameraAdapter)
+ * nv12>nv21  preview callback chroma (AppCallbackNotifier)
+ * nv12>yv12  same, YV12 callbacks
+ * nv12>yuyv  same, YUV422I callbacks
+ * yuyv>jpeg  yuv422i to the planes libjpeg encodes (StripeEncoder_libjpeg)
+ *
+ * Times are milliseconds per frame, the best of the runs.
+ *
+ * usage: pixel_convert_bench [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PixelConvert.h"
+
+using Ti::Camera::PixelConvert;
+using Ti::Camera::PixelConvertIsa;
+
+#define DEFAULT_FRAMES 10
+#define TILER_STRIDE 4096
+
+static const struct {
+    const char* name;
+    int width;
+    int height;
+} sizes[] = {
+    { "VGA", 640, 480 },
+    { "720p", 1280, 720 },
+    { "1080p", 1920, 1080 },
+    { "5MP", 2592, 1944 },
+    { "8MP", 3264, 2448 },
+    { "13MP", 4160, 3120 },
+};
+
+enum conversion {
+    YUYV_TO_NV12,
+    NV12_TO_NV21,
+    NV12_TO_YV12,
+    NV12_TO_YUYV,
+    YUYV_TO_PLANES,
+    CONVERSIONS
+};
+
+static const char* const conversion_names[CONVERSIONS] = {
+    "yuyv>nv12", "nv12>nv21", "nv12>yv12", "nv12>yuyv", "yuyv>jpeg",
+};
+
+struct bench_buffers {
+    int width, height;
+    int stride;     // TILER_STRIDE, or the width of captures wider than it
+    uint8_t* yuyv;  // width * 2 bytes per row
+    uint8_t* tiler; // NV12, stride bytes per row
+    uint8_t* out;   // packed output of the callback conversions
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void convert(const bench_buffers* b, conversion c)
+{
+    const int w = b->width, h = b->height, stride = b->stride;
+    const uint8_t* tiler_uv = b->tiler + stride * h;
+
+    switch (c) {
+    case YUYV_TO_NV12:
+        PixelConvert::yuyvToNV12(b->yuyv, w * 2, b->tiler, b->tiler + stride * h, stride, w, h);
+        break;
+    case NV12_TO_NV21:
+        for (int i = 0; i < h / 2; i++)
+            PixelConvert::swapPairs(tiler_uv + i * stride, b->out + w * h + i * w, w / 2);
+        break;
+    case NV12_TO_YV12:
+        for (int i = 0; i < h / 2; i++)
+            PixelConvert::splitPairs(tiler_uv + i * stride, b->out + w * h + i * w / 2,
+                                     b->out + w * h * 5 / 4 + i * w / 2, w / 2);
+        break;
+    case NV12_TO_YUYV:
+        for (int i = 0; i < h; i++)
+            PixelConvert::mergePairs(b->tiler + i * stride, tiler_uv + (i / 2) * stride,
+                                     b->out + i * w * 2, w);
+        break;
+    case YUYV_TO_PLANES:
+        for (int i = 0; i < h; i += 2) {
+            uint8_t* y = b->out + i * w;
+
+            PixelConvert::yuv422iToPlanes(b->yuyv + i * w * 2, b->yuyv + (i + 1) * w * 2,
+                                          y, y + w, b->out + w * h + i / 2 * (w / 2),
+                                          b->out + w * h * 5 / 4 + i / 2 * (w / 2), w, false);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static double time_conversion(const bench_buffers* b, conversion c, int frames)
+{
+    uint64_t best = ~0ULL;
+
+    convert(b, c); // warm up
+    for (int i = 0; i < frames; i++) {
+        uint64_t start = now_ns();
+        convert(b, c);
+        uint64_t t = now_ns() - start;
+        if (t < best)
+            best = t;
+    }
+    return best / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : DEFAULT_FRAMES;
+    PixelConvertIsa best = PixelConvert::getIsa();
+
+    if (frames <= 0) {
+        fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d frames per conversion, default kernels: %s\n", frames,
+           PixelConvert::getIsaName(best));
+    printf("size   conversion");
+    for (int i = 0; i < Ti::Camera::PIXEL_CONVERT_ISAS; i++) {
+        if (PixelConvert::setIsa((PixelConvertIsa)i))
+            printf("  %5s ms", PixelConvert::getIsaName((PixelConvertIsa)i));
+    }
+    printf("  speedup\n");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        bench_buffers b;
+
+        b.width = sizes[s].width;
+        b.height = sizes[s].height;
+        b.stride = b.width > TILER_STRIDE ? b.width : TILER_STRIDE;
+        b.yuyv = (uint8_t*)malloc(b.width * 2 * b.height);
+        b.tiler = (uint8_t*)malloc(b.stride * b.height * 3 / 2);
+        b.out = (uint8_t*)malloc(b.width * 2 * b.height);
+        if (!b.yuyv || !b.tiler || !b.out) {
+            printf("%-5s  out of memory\n", sizes[s].name);
+            free(b.yuyv);
+            free(b.tiler);
+            free(b.out);
+            continue;
+        }
+        for (int i = 0; i < b.width * 2 * b.height; i++)
+            b.yuyv[i] = i * 7;
+        memset(b.tiler, 0x80, b.stride * b.height * 3 / 2);
+
+        for (int c = 0; c < CONVERSIONS; c++) {
+            double c_ms = 0, fastest = 0;
+
+            printf("%-5s  %-10s", sizes[s].name, conversion_names[c]);
+            for (int i = 0; i < Ti::Camera::PIXEL_CONVERT_ISAS; i++) {
+                if (!PixelConvert::setIsa((PixelConvertIsa)i))
+                    continue;
+
+                double ms = time_conversion(&b, (conversion)c, frames);
+                if (i == Ti::Camera::PIXEL_CONVERT_C)
+                    c_ms = ms;
+                if (fastest == 0 || ms < fastest)
+                    fastest = ms;
+                printf("  %8.2f", ms);
+            }
+            printf("  %7.2f\n", fastest > 0 ? c_ms / fastest : 0);
+        }
+
+        free(b.yuyv);
+        free(b.tiler);
+        free(b.out);
+    }
+    PixelConvert::setIsa(best);
+
+    return 0;
+}
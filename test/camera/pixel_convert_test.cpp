@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * PixelConvert unit test
+ *
+ * Runs every conversion with each instruction set this build and CPU have,
+ * against plain loops written here. Widths go from 1 to past a few vector
+ * lengths, plus the camera ones, with rows starting at every alignment.
+ * Bytes around the output must not change: a tail converted past the width
+ * or a stride ignored shows there.
+ *
+ * usage: pixel_convert_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PixelConvert.h"
+
+using Ti::Camera::PixelConvert;
+using Ti::Camera::PixelConvertIsa;
+
+/* Guard bytes before and after every output */
+#define GUARD 64
+#define GUARD_BYTE 0xA5
+
+#define MAX_ALIGN 4
+#define TILER_STRIDE 4096
+
+static const int camera_widths[] = { 176, 320, 352, 640, 720, 1280, 1920, 2592, 4160 };
+
+static unsigned int seed = 1;
+static int failures;
+
+static void fill_random(uint8_t* p, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        p[i] = seed >> 16;
+    }
+}
+
+/* Output buffer with guards, the returned pointer is misaligned by align */
+static uint8_t* guarded(uint8_t* buf, size_t n, int align)
+{
+    memset(buf, GUARD_BYTE, n + 2 * GUARD + MAX_ALIGN);
+    return buf + GUARD + align;
+}
+
+static bool guards_intact(const uint8_t* out, size_t n)
+{
+    for (int i = 1; i <= GUARD - MAX_ALIGN; i++) {
+        if (out[-i] != GUARD_BYTE || out[n + i - 1] != GUARD_BYTE)
+            return false;
+    }
+    return true;
+}
+
+static void fail(const char* what, PixelConvertIsa isa, size_t width, int align)
+{
+    if (failures++ < 20)
+        printf("  %s wrong with %s, width %zu, alignment %d\n", what,
+            PixelConvert::getIsaName(isa), width, align);
+}
+
+static void test_split(PixelConvertIsa isa, size_t pairs, int align)
+{
+    static uint8_t src[8192 * 2 + MAX_ALIGN], even_buf[8192 + 2 * GUARD + MAX_ALIGN],
+        odd_buf[8192 + 2 * GUARD + MAX_ALIGN];
+    uint8_t* s = src + align;
+    uint8_t* even = guarded(even_buf, pairs, align);
+    uint8_t* odd = guarded(odd_buf, pairs, (align + 1) % MAX_ALIGN);
+    bool ok = true;
+
+    fill_random(s, pairs * 2);
+    PixelConvert::splitPairs(s, even, odd, pairs);
+    for (size_t i = 0; i < pairs; i++)
+        ok = ok && even[i] == s[i * 2] && odd[i] == s[i * 2 + 1];
+    if (!ok || !guards_intact(even, pairs) || !guards_intact(odd, pairs))
+        fail("splitPairs", isa, pairs, align);
+
+    even = guarded(even_buf, pairs, align);
+    PixelConvert::splitPairs(s, even, NULL, pairs);
+    for (size_t i = 0; i < pairs; i++)
+        ok = ok && even[i] == s[i * 2];
+    if (!ok || !guards_intact(even, pairs))
+        fail("splitPairs without odd", isa, pairs, align);
+}
+
+static void test_merge(PixelConvertIsa isa, size_t pairs, int align)
+{
+    static uint8_t even[8192 + MAX_ALIGN], odd[8192 + MAX_ALIGN],
+        dst_buf[8192 * 2 + 2 * GUARD + MAX_ALIGN];
+    uint8_t* dst = guarded(dst_buf, pairs * 2, align);
+    bool ok = true;
+
+    fill_random(even, pairs + MAX_ALIGN);
+    fill_random(odd, pairs + MAX_ALIGN);
+    PixelConvert::mergePairs(even + align, odd + 1, dst, pairs);
+    for (size_t i = 0; i < pairs; i++)
+        ok = ok && dst[i * 2] == even[align + i] && dst[i * 2 + 1] == odd[1 + i];
+    if (!ok || !guards_intact(dst, pairs * 2))
+        fail("mergePairs", isa, pairs, align);
+}
+
+static void test_swap(PixelConvertIsa isa, size_t pairs, int align)
+{
+    static uint8_t src[8192 * 2 + MAX_ALIGN], dst_buf[8192 * 2 + 2 * GUARD + MAX_ALIGN];
+    uint8_t* s = src + align;
+    uint8_t* dst = guarded(dst_buf, pairs * 2, align);
+    bool ok = true;
+
+    fill_random(s, pairs * 2);
+    PixelConvert::swapPairs(s, dst, pairs);
+    for (size_t i = 0; i < pairs; i++)
+        ok = ok && dst[i * 2] == s[i * 2 + 1] && dst[i * 2 + 1] == s[i * 2];
+    if (!ok || !guards_intact(dst, pairs * 2))
+        fail("swapPairs", isa, pairs, align);
+
+    // in place must give the same bytes
+    PixelConvert::swapPairs(dst, dst, pairs);
+    if (memcmp(dst, s, pairs * 2) || !guards_intact(dst, pairs * 2))
+        fail("swapPairs in place", isa, pairs, align);
+}
+
+static void test_yuv422i(PixelConvertIsa isa, size_t width, int align, bool uyvy)
+{
+    static uint8_t src[2][8192 * 2 + 4 + MAX_ALIGN];
+    static uint8_t out_buf[4][8192 + 2 * GUARD + MAX_ALIGN];
+    const size_t pairs = (width + 1) / 2;
+    const int y = uyvy ? 1 : 0, u = uyvy ? 0 : 1, v = uyvy ? 2 : 3;
+    uint8_t* s0 = src[0] + align;
+    uint8_t* s1 = src[1] + (align + 2) % MAX_ALIGN;
+    uint8_t* y0 = guarded(out_buf[0], pairs * 2, align);
+    uint8_t* y1 = guarded(out_buf[1], pairs * 2, (align + 1) % MAX_ALIGN);
+    uint8_t* cb = guarded(out_buf[2], pairs, (align + 2) % MAX_ALIGN);
+    uint8_t* cr = guarded(out_buf[3], pairs, (align + 3) % MAX_ALIGN);
+    bool ok = true;
+
+    fill_random(s0, pairs * 4);
+    fill_random(s1, pairs * 4);
+    PixelConvert::yuv422iToPlanes(s0, s1, y0, y1, cb, cr, width, uyvy);
+    for (size_t i = 0; i < pairs; i++) {
+        const uint8_t* p0 = s0 + i * 4;
+        const uint8_t* p1 = s1 + i * 4;
+
+        ok = ok && y0[i * 2] == p0[y] && y0[i * 2 + 1] == p0[y + 2] &&
+             y1[i * 2] == p1[y] && y1[i * 2 + 1] == p1[y + 2] &&
+             cb[i] == (p0[u] + p1[u] + 1) / 2 && cr[i] == (p0[v] + p1[v] + 1) / 2;
+    }
+    if (!ok || !guards_intact(y0, pairs * 2) || !guards_intact(y1, pairs * 2) ||
+        !guards_intact(cb, pairs) || !guards_intact(cr, pairs))
+        fail(uyvy ? "yuv422iToPlanes uyvy" : "yuv422iToPlanes yuyv", isa, width, align);
+}
+
+/* Whole frame into a tiler strided buffer, the padding of each row stays */
+static void test_yuyv_to_nv12(PixelConvertIsa isa, int width, int height)
+{
+    const size_t src_stride = width * 2 + 32;
+    uint8_t* src = (uint8_t*)malloc(src_stride * height);
+    uint8_t* dst = (uint8_t*)malloc(TILER_STRIDE * (height + height / 2 + 1));
+    uint8_t* dst_uv = dst + TILER_STRIDE * height;
+    bool ok = src && dst;
+
+    if (ok) {
+        fill_random(src, src_stride * height);
+        memset(dst, GUARD_BYTE, TILER_STRIDE * (height + height / 2 + 1));
+        PixelConvert::yuyvToNV12(src, src_stride, dst, dst_uv, TILER_STRIDE, width, height);
+    }
+
+    for (int i = 0; ok && i < height; i++) {
+        const uint8_t* s = src + i * src_stride;
+        const uint8_t* d = dst + i * TILER_STRIDE;
+
+        for (int j = 0; ok && j < width; j++)
+            ok = d[j] == s[j * 2];
+        for (int j = width; ok && j < TILER_STRIDE; j++)
+            ok = d[j] == GUARD_BYTE;
+    }
+    for (int i = 0; ok && i <= height / 2; i++) {
+        const uint8_t* s = src + i * 2 * src_stride;
+        const uint8_t* d = dst_uv + i * TILER_STRIDE;
+
+        // an odd height has no chroma row for its last line
+        for (int j = 0; ok && j < width; j++)
+            ok = d[j] == (i < height / 2 ? s[j * 2 + 1] : GUARD_BYTE);
+        for (int j = width; ok && j < TILER_STRIDE; j++)
+            ok = d[j] == GUARD_BYTE;
+    }
+    if (!ok)
+        fail("yuyvToNV12", isa, width, height);
+
+    free(src);
+    free(dst);
+}
+
+static void test_width(PixelConvertIsa isa, size_t width)
+{
+    for (int align = 0; align < MAX_ALIGN; align++) {
+        test_split(isa, width, align);
+        test_merge(isa, width, align);
+        test_swap(isa, width, align);
+        test_yuv422i(isa, width, align, false);
+        test_yuv422i(isa, width, align, true);
+    }
+}
+
+int main()
+{
+    PixelConvertIsa best = PixelConvert::getIsa();
+    int tested = 0;
+
+    printf("default kernels: %s\n", PixelConvert::getIsaName(best));
+    for (int i = 0; i < Ti::Camera::PIXEL_CONVERT_ISAS; i++) {
+        PixelConvertIsa isa = (PixelConvertIsa)i;
+        int before = failures;
+
+        if (!PixelConvert::setIsa(isa)) {
+            printf("%-5s not available\n", PixelConvert::getIsaName(isa));
+            continue;
+        }
+
+        for (size_t w = 1; w <= 200; w++)
+            test_width(isa, w);
+        for (size_t i = 0; i < sizeof(camera_widths) / sizeof(camera_widths[0]); i++) {
+            test_width(isa, camera_widths[i]);
+            test_width(isa, camera_widths[i] + 1);
+        }
+        test_yuyv_to_nv12(isa, 640, 480);
+        test_yuyv_to_nv12(isa, 1920, 1080);
+        test_yuyv_to_nv12(isa, 1, 1);
+        test_yuyv_to_nv12(isa, 37, 29);
+        test_yuyv_to_nv12(isa, 1279, 721);
+
+        printf("%-5s %s\n", PixelConvert::getIsaName(isa), failures == before ? "ok" : "FAILED");
+        tested++;
+    }
+    PixelConvert::setIsa(best);
+
+    if (failures || !tested) {
+        printf("%d conversions wrong\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#
+# Copyright (C) Texas Instruments - http://www.ti.com/
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+LOCAL_PATH:= $(call my-dir)
+
+DOMX_PATH := $(LOCAL_PATH)/../../domx
+
+# Proxy buffer path benchmark, the proxy common code against a stand-in
+# for the RPC layer
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+    proxy_bufmap_bench.c \
+    ../../domx/domx/omx_proxy_common/src/omx_proxy_common.c \
+    ../../domx/domx/omx_proxy_common/src/omx_proxy_bufmap.c \
+    ../../domx/domx/profiling/src/profile.c
+LOCAL_C_INCLUDES := \
+    $(DOMX_PATH)/domx \
+    $(DOMX_PATH)/domx/omx_rpc/inc \
+    $(DOMX_PATH)/domx/profiling/inc \
+    $(DOMX_PATH)/domx/plugins/inc \
+    $(DOMX_PATH)/omx_core/inc \
+    $(DOMX_PATH)/mm_osal/inc \
+    frameworks/native/include/media/openmax
+LOCAL_CFLAGS := -Wall -D_Android $(ANDROID_API_CFLAGS)
+LOCAL_SHARED_LIBRARIES := \
+    libmm_osal \
+    liblog \
+    libcutils
+LOCAL_MODULE := proxy_bufmap_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
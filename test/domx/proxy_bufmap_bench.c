@@ -0,0 +1,620 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * DOMX proxy buffer path benchmark
+ *
+ * Runs the proxy common code against a stand-in for the RPC layer. The
+ * buffer calls the proxy makes to the remote core are queued, and a callback
+ * thread answers them through the proxy's EmptyBufferDone/FillBufferDone
+ * the way the RPC skeleton does for Ducati. So every round trip goes through
+ * PROXY_EmptyThisBuffer()/PROXY_FillThisBuffer(), the local header lookup,
+ * the remote header lookup on the callback thread and the client callback.
+ *
+ * The timed pass cycles all buffers of the component and gives the time of
+ * one round trip, per number of buffers. The churn pass frees and registers
+ * the idle buffers from the client thread while the others are in flight,
+ * like port reconfiguration does; every callback has to come back with the
+ * header that was submitted and no lookup may fail.
+ *
+ * usage: proxy_bufmap_bench [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#include "timm_osal_memory.h"
+#include "OMX_TI_Common.h"
+#include "OMX_TI_Index.h"
+#include "omx_proxy_common.h"
+#include "omx_rpc.h"
+#include "omx_rpc_stub.h"
+#include "memplugin.h"
+
+#define DEFAULT_ROUNDS 2000
+
+#define BENCH_COMPONENT "OMX.TI.DUCATI1.MISC.SAMPLE"
+#define BENCH_BUFSIZE 4096
+
+/* Even buffer slots go to the input port, odd ones to the output port */
+#define BENCH_INPUT_PORT 0
+#define BENCH_OUTPUT_PORT 1
+
+/* Remote headers are Ducati addresses handed out back to back */
+#define BENCH_REMOTE_BASE 0x9D000000
+#define BENCH_REMOTE_STRIDE 0x60
+
+/* Stand-in remote core: submitted buffers waiting for their callback */
+struct bench_remote {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int quit;
+    OMX_HANDLETYPE hComponent;
+    OMX_U32 queue[MAX_NUM_PROXY_BUFFERS];
+    OMX_BOOL fill[MAX_NUM_PROXY_BUFFERS];
+    int head, count;
+    OMX_U32 next_remote;
+    RPC_OMX_CONTEXT context;
+};
+
+/* Client of the proxy */
+struct bench_app {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    OMX_BUFFERHEADERTYPE *hdr[MAX_NUM_PROXY_BUFFERS];
+    OMX_U8 *data[MAX_NUM_PROXY_BUFFERS];
+    int inflight[MAX_NUM_PROXY_BUFFERS];
+    int outstanding;
+    long errors;
+};
+
+static struct bench_remote remote = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+};
+
+static struct bench_app app = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* ------------------------------------------------------------------------
+ * Stand-in remote core
+ */
+
+static void *remote_callback_thread(void *arg)
+{
+    (void)arg;
+
+    for (;;) {
+        OMX_COMPONENTTYPE *hComp;
+        PROXY_COMPONENT_PRIVATE *pCompPrv;
+        OMX_U32 remoteBufHdr;
+        OMX_BOOL fill;
+
+        pthread_mutex_lock(&remote.lock);
+        while (!remote.count && !remote.quit)
+            pthread_cond_wait(&remote.cond, &remote.lock);
+        if (!remote.count) {
+            pthread_mutex_unlock(&remote.lock);
+            return NULL;
+        }
+        remoteBufHdr = remote.queue[remote.head];
+        fill = remote.fill[remote.head];
+        remote.head = (remote.head + 1) % MAX_NUM_PROXY_BUFFERS;
+        remote.count--;
+        hComp = (OMX_COMPONENTTYPE *)remote.hComponent;
+        pthread_mutex_unlock(&remote.lock);
+
+        pCompPrv = (PROXY_COMPONENT_PRIVATE *)hComp->pComponentPrivate;
+        if (fill)
+            pCompPrv->proxyFillBufferDone(hComp, remoteBufHdr, BENCH_BUFSIZE, 0, 0, 0, NULL, NULL);
+        else
+            pCompPrv->proxyEmptyBufferDone(hComp, remoteBufHdr, 0, 0, 0);
+    }
+}
+
+static RPC_OMX_ERRORTYPE remote_submit(OMX_U32 remoteBufHdr, OMX_BOOL fill)
+{
+    RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+
+    pthread_mutex_lock(&remote.lock);
+    if (remote.count < MAX_NUM_PROXY_BUFFERS) {
+        int tail = (remote.head + remote.count) % MAX_NUM_PROXY_BUFFERS;
+        remote.queue[tail] = remoteBufHdr;
+        remote.fill[tail] = fill;
+        remote.count++;
+        pthread_cond_signal(&remote.cond);
+    } else {
+        eRPCError = RPC_OMX_ErrorInsufficientResources;
+    }
+    pthread_mutex_unlock(&remote.lock);
+    return eRPCError;
+}
+
+RPC_OMX_ERRORTYPE RPC_InstanceInit(OMX_STRING cComponentName, OMX_HANDLETYPE *phRPCCtx)
+{
+    (void)cComponentName;
+
+    remote.quit = 0;
+    remote.head = remote.count = 0;
+    remote.next_remote = BENCH_REMOTE_BASE;
+    if (pthread_create(&remote.thread, NULL, remote_callback_thread, NULL))
+        return RPC_OMX_ErrorInsufficientResources;
+    *phRPCCtx = &remote.context;
+    return RPC_OMX_ErrorNone;
+}
+
+RPC_OMX_ERRORTYPE RPC_InstanceDeInit(OMX_HANDLETYPE hRPCCtx)
+{
+    (void)hRPCCtx;
+
+    pthread_mutex_lock(&remote.lock);
+    remote.quit = 1;
+    pthread_cond_signal(&remote.cond);
+    pthread_mutex_unlock(&remote.lock);
+    pthread_join(remote.thread, NULL);
+    return RPC_OMX_ErrorNone;
+}
+
+RPC_OMX_ERRORTYPE RPC_GetHandle(OMX_HANDLETYPE hRPCCtx, OMX_STRING cComponentName,
+    OMX_PTR pAppData, OMX_CALLBACKTYPE *pCallBacks, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)cComponentName; (void)pCallBacks;
+
+    remote.hComponent = pAppData;
+    *nCmdStatus = OMX_ErrorNone;
+    return RPC_OMX_ErrorNone;
+}
+
+RPC_OMX_ERRORTYPE RPC_FreeHandle(OMX_HANDLETYPE hRPCCtx, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx;
+
+    *nCmdStatus = OMX_ErrorNone;
+    return RPC_OMX_ErrorNone;
+}
+
+RPC_OMX_ERRORTYPE RPC_UseBuffer(OMX_HANDLETYPE hRPCCtx, OMX_BUFFERHEADERTYPE **ppBufferHdr,
+    OMX_U32 nPortIndex, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes, OMX_U8 *pBuffer,
+    OMX_U32 *pBufHeaderRemote, OMX_ERRORTYPE *nCmdStatus)
+{
+    OMX_BUFFERHEADERTYPE *pBufferHdr = *ppBufferHdr;
+
+    (void)hRPCCtx; (void)nPortIndex; (void)pBuffer;
+
+    /* What the remote header fills in when it is copied back */
+    pBufferHdr->nSize = sizeof(OMX_BUFFERHEADERTYPE);
+    pBufferHdr->nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+    pBufferHdr->nVersion.s.nVersionMinor = OMX_VER_MINOR;
+    pBufferHdr->nAllocLen = nSizeBytes;
+    pBufferHdr->nFilledLen = 0;
+    pBufferHdr->nOffset = 0;
+    pBufferHdr->nFlags = 0;
+    pBufferHdr->pAppPrivate = pAppPrivate;
+    pBufferHdr->hMarkTargetComponent = NULL;
+    pBufferHdr->pMarkData = NULL;
+    pBufferHdr->nInputPortIndex = BENCH_INPUT_PORT;
+    pBufferHdr->nOutputPortIndex = BENCH_OUTPUT_PORT;
+
+    *pBufHeaderRemote = remote.next_remote;
+    remote.next_remote += BENCH_REMOTE_STRIDE;
+    *nCmdStatus = OMX_ErrorNone;
+    return RPC_OMX_ErrorNone;
+}
+
+RPC_OMX_ERRORTYPE RPC_FreeBuffer(OMX_HANDLETYPE hRPCCtx, OMX_U32 nPortIndex,
+    OMX_U32 BufHdrRemote, OMX_U32 pBuffer, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)nPortIndex; (void)BufHdrRemote; (void)pBuffer;
+
+    *nCmdStatus = OMX_ErrorNone;
+    return RPC_OMX_ErrorNone;
+}
+
+RPC_OMX_ERRORTYPE RPC_EmptyThisBuffer(OMX_HANDLETYPE hRPCCtx, OMX_BUFFERHEADERTYPE *pBufferHdr,
+    OMX_U32 BufHdrRemote, OMX_ERRORTYPE *nCmdStatus, OMX_BOOL bMapBuffer)
+{
+    (void)hRPCCtx; (void)pBufferHdr; (void)bMapBuffer;
+
+    *nCmdStatus = OMX_ErrorNone;
+    return remote_submit(BufHdrRemote, OMX_FALSE);
+}
+
+RPC_OMX_ERRORTYPE RPC_FillThisBuffer(OMX_HANDLETYPE hRPCCtx, OMX_BUFFERHEADERTYPE *pBufferHdr,
+    OMX_U32 BufHdrRemote, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)pBufferHdr;
+
+    *nCmdStatus = OMX_ErrorNone;
+    return remote_submit(BufHdrRemote, OMX_TRUE);
+}
+
+RPC_OMX_ERRORTYPE RPC_GetParameter(OMX_HANDLETYPE hRPCCtx, OMX_INDEXTYPE nParamIndex,
+    OMX_PTR pCompParam, OMX_PTR pLocBufNeedMap, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)pLocBufNeedMap;
+
+    /* PROXY_UseBuffer() asks whether the port wants metadata buffers */
+    if (nParamIndex == (OMX_INDEXTYPE)OMX_TI_IndexParamMetaDataBufferInfo) {
+        ((OMX_TI_PARAM_METADATABUFFERINFO *)pCompParam)->bIsMetaDataEnabledOnPort = OMX_FALSE;
+        ((OMX_TI_PARAM_METADATABUFFERINFO *)pCompParam)->nMetaDataSize = 0;
+        *nCmdStatus = OMX_ErrorNone;
+    } else {
+        *nCmdStatus = OMX_ErrorUnsupportedIndex;
+    }
+    return RPC_OMX_ErrorNone;
+}
+
+/* The rest of the remote core is not needed by the buffer path */
+RPC_OMX_ERRORTYPE RPC_SetParameter(OMX_HANDLETYPE hRPCCtx, OMX_INDEXTYPE nParamIndex,
+    OMX_PTR pCompParam, OMX_PTR pLocBufNeedMap, OMX_U32 nNumOfLocalBuf,
+    OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)nParamIndex; (void)pCompParam; (void)pLocBufNeedMap;
+    (void)nNumOfLocalBuf; (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+RPC_OMX_ERRORTYPE RPC_SetConfig(OMX_HANDLETYPE hRPCCtx, OMX_INDEXTYPE nConfigIndex,
+    OMX_PTR pCompConfig, OMX_PTR pLocBufNeedMap, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)nConfigIndex; (void)pCompConfig; (void)pLocBufNeedMap;
+    (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+RPC_OMX_ERRORTYPE RPC_GetConfig(OMX_HANDLETYPE hRPCCtx, OMX_INDEXTYPE nConfigIndex,
+    OMX_PTR pCompConfig, OMX_PTR pLocBufNeedMap, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)nConfigIndex; (void)pCompConfig; (void)pLocBufNeedMap;
+    (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+RPC_OMX_ERRORTYPE RPC_GetComponentVersion(OMX_HANDLETYPE hRPCCtx, OMX_STRING pComponentName,
+    OMX_VERSIONTYPE *pComponentVersion, OMX_VERSIONTYPE *pSpecVersion,
+    OMX_UUIDTYPE *pComponentUUID, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)pComponentName; (void)pComponentVersion; (void)pSpecVersion;
+    (void)pComponentUUID; (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+RPC_OMX_ERRORTYPE RPC_SendCommand(OMX_HANDLETYPE hRPCCtx, OMX_COMMANDTYPE eCmd,
+    OMX_U32 nParam, OMX_PTR pCmdData, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)eCmd; (void)nParam; (void)pCmdData; (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+RPC_OMX_ERRORTYPE RPC_GetState(OMX_HANDLETYPE hRPCCtx, OMX_STATETYPE *pState,
+    OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)pState; (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+RPC_OMX_ERRORTYPE RPC_GetExtensionIndex(OMX_HANDLETYPE hComponent, OMX_STRING cParameterName,
+    OMX_INDEXTYPE *pIndexType, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hComponent; (void)cParameterName; (void)pIndexType; (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+RPC_OMX_ERRORTYPE RPC_AllocateBuffer(OMX_HANDLETYPE hRPCCtx, OMX_BUFFERHEADERTYPE **ppBufferHdr,
+    OMX_U32 nPortIndex, OMX_U32 *pBufHeaderRemote, OMX_PTR pAppPrivate, OMX_U32 nSizeBytes,
+    OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)ppBufferHdr; (void)nPortIndex; (void)pBufHeaderRemote;
+    (void)pAppPrivate; (void)nSizeBytes; (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+RPC_OMX_ERRORTYPE RPC_ComponentTunnelRequest(OMX_HANDLETYPE hRPCCtx, OMX_U32 nPort,
+    OMX_HANDLETYPE hTunneledremoteHandle, OMX_U32 nTunneledPort,
+    OMX_TUNNELSETUPTYPE *pTunnelSetup, OMX_ERRORTYPE *nCmdStatus)
+{
+    (void)hRPCCtx; (void)nPort; (void)hTunneledremoteHandle; (void)nTunneledPort;
+    (void)pTunnelSetup; (void)nCmdStatus;
+    return RPC_OMX_ErrorUndefined;
+}
+
+/* Metadata buffers are never asked for, the plugin only has to open */
+MEMPLUGIN_ERRORTYPE MemPlugin_Init(char *cMemPluginName, void **pMemPluginHandle)
+{
+    (void)cMemPluginName;
+
+    *pMemPluginHandle = &remote;
+    return MEMPLUGIN_ERROR_NONE;
+}
+
+MEMPLUGIN_ERRORTYPE MemPlugin_Open(void *pMemPluginHandle, OMX_U32 *pClient)
+{
+    (void)pMemPluginHandle;
+
+    *pClient = 1;
+    return MEMPLUGIN_ERROR_NONE;
+}
+
+MEMPLUGIN_ERRORTYPE MemPlugin_Close(void *pMemPluginHandle, OMX_U32 nClient)
+{
+    (void)pMemPluginHandle; (void)nClient;
+    return MEMPLUGIN_ERROR_NONE;
+}
+
+MEMPLUGIN_ERRORTYPE MemPlugin_Alloc(void *pMemPluginHandle, OMX_U32 nClient,
+    MEMPLUGIN_BUFFER_PARAMS *pBufferParams, MEMPLUGIN_BUFFER_PROPERTIES *pBufferProp)
+{
+    (void)pMemPluginHandle; (void)nClient; (void)pBufferParams; (void)pBufferProp;
+    return MEMPLUGIN_ERROR_NOTIMPLEMENTED;
+}
+
+MEMPLUGIN_ERRORTYPE MemPlugin_Free(void *pMemPluginHandle, OMX_U32 nClient,
+    MEMPLUGIN_BUFFER_PARAMS *pBufferParams, MEMPLUGIN_BUFFER_PROPERTIES *pBufferProp)
+{
+    (void)pMemPluginHandle; (void)nClient; (void)pBufferParams; (void)pBufferProp;
+    return MEMPLUGIN_ERROR_NOTIMPLEMENTED;
+}
+
+MEMPLUGIN_ERRORTYPE MemPlugin_DeInit(void *pMemPluginHandle)
+{
+    (void)pMemPluginHandle;
+    return MEMPLUGIN_ERROR_NONE;
+}
+
+/* ------------------------------------------------------------------------
+ * Client
+ */
+
+static void buffer_done(OMX_BUFFERHEADERTYPE *pBuffer)
+{
+    int slot = (int)(intptr_t)pBuffer->pAppPrivate;
+
+    pthread_mutex_lock(&app.lock);
+    if (slot < 0 || slot >= MAX_NUM_PROXY_BUFFERS || app.hdr[slot] != pBuffer ||
+        !app.inflight[slot]) {
+        app.errors++;
+    } else {
+        app.inflight[slot] = 0;
+        if (--app.outstanding == 0)
+            pthread_cond_signal(&app.cond);
+    }
+    pthread_mutex_unlock(&app.lock);
+}
+
+static OMX_ERRORTYPE app_empty_buffer_done(OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+    OMX_BUFFERHEADERTYPE *pBuffer)
+{
+    (void)hComponent; (void)pAppData;
+
+    buffer_done(pBuffer);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE app_fill_buffer_done(OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+    OMX_BUFFERHEADERTYPE *pBuffer)
+{
+    (void)hComponent; (void)pAppData;
+
+    buffer_done(pBuffer);
+    return OMX_ErrorNone;
+}
+
+/* A callback whose remote header the proxy cannot resolve ends up here */
+static OMX_ERRORTYPE app_event_handler(OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+    OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+    (void)hComponent; (void)pAppData; (void)nData1; (void)nData2; (void)pEventData;
+
+    if (eEvent == OMX_EventError) {
+        pthread_mutex_lock(&app.lock);
+        app.errors++;
+        pthread_mutex_unlock(&app.lock);
+    }
+    return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE app_callbacks = {
+    app_event_handler, app_empty_buffer_done, app_fill_buffer_done,
+};
+
+static OMX_COMPONENTTYPE *create_component(void)
+{
+    OMX_COMPONENTTYPE *hComp = calloc(1, sizeof(OMX_COMPONENTTYPE));
+    PROXY_COMPONENT_PRIVATE *pCompPrv;
+
+    if (!hComp)
+        return NULL;
+    hComp->nSize = sizeof(OMX_COMPONENTTYPE);
+    hComp->nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+    hComp->nVersion.s.nVersionMinor = OMX_VER_MINOR;
+
+    /* As a component proxy does before the common init */
+    pCompPrv = TIMM_OSAL_Malloc(sizeof(PROXY_COMPONENT_PRIVATE), TIMM_OSAL_TRUE, 0,
+        TIMMOSAL_MEM_SEGMENT_INT);
+    if (!pCompPrv) {
+        free(hComp);
+        return NULL;
+    }
+    memset(pCompPrv, 0, sizeof(PROXY_COMPONENT_PRIVATE));
+    pCompPrv->cCompName = TIMM_OSAL_Malloc(strlen(BENCH_COMPONENT) + 1, TIMM_OSAL_TRUE, 0,
+        TIMMOSAL_MEM_SEGMENT_INT);
+    if (pCompPrv->cCompName)
+        strcpy(pCompPrv->cCompName, BENCH_COMPONENT);
+    hComp->pComponentPrivate = pCompPrv;
+
+    if (!pCompPrv->cCompName || OMX_ProxyCommonInit(hComp) != OMX_ErrorNone ||
+        hComp->SetCallbacks(hComp, &app_callbacks, &app) != OMX_ErrorNone) {
+        fprintf(stderr, "proxy init failed\n");
+        return NULL;
+    }
+    return hComp;
+}
+
+static int use_buffer(OMX_COMPONENTTYPE *hComp, int slot)
+{
+    OMX_U32 port = slot % 2 ? BENCH_OUTPUT_PORT : BENCH_INPUT_PORT;
+
+    if (hComp->UseBuffer(hComp, &app.hdr[slot], port, (OMX_PTR)(intptr_t)slot,
+            BENCH_BUFSIZE, app.data[slot]) != OMX_ErrorNone) {
+        fprintf(stderr, "UseBuffer of buffer %d failed\n", slot);
+        return -1;
+    }
+    return 0;
+}
+
+static int free_buffer(OMX_COMPONENTTYPE *hComp, int slot)
+{
+    OMX_U32 port = slot % 2 ? BENCH_OUTPUT_PORT : BENCH_INPUT_PORT;
+    OMX_ERRORTYPE eError = hComp->FreeBuffer(hComp, port, app.hdr[slot]);
+
+    app.hdr[slot] = NULL;
+    if (eError != OMX_ErrorNone) {
+        fprintf(stderr, "FreeBuffer of buffer %d failed\n", slot);
+        return -1;
+    }
+    return 0;
+}
+
+static void submit(OMX_COMPONENTTYPE *hComp, int slot)
+{
+    OMX_ERRORTYPE eError;
+
+    pthread_mutex_lock(&app.lock);
+    app.inflight[slot] = 1;
+    app.outstanding++;
+    pthread_mutex_unlock(&app.lock);
+
+    if (slot % 2)
+        eError = hComp->FillThisBuffer(hComp, app.hdr[slot]);
+    else
+        eError = hComp->EmptyThisBuffer(hComp, app.hdr[slot]);
+
+    if (eError != OMX_ErrorNone) {
+        pthread_mutex_lock(&app.lock);
+        app.inflight[slot] = 0;
+        app.outstanding--;
+        app.errors++;
+        pthread_mutex_unlock(&app.lock);
+    }
+}
+
+static void wait_all_returned(void)
+{
+    pthread_mutex_lock(&app.lock);
+    while (app.outstanding)
+        pthread_cond_wait(&app.cond, &app.lock);
+    pthread_mutex_unlock(&app.lock);
+}
+
+/* Returns the round trip time in ns, negative on failure */
+static double run(int nbufs, int rounds, long *errors)
+{
+    OMX_COMPONENTTYPE *hComp = create_component();
+    uint64_t start, total;
+    int r, i, failed = 0;
+
+    if (!hComp)
+        return -1;
+
+    app.errors = 0;
+    for (i = 0; i < nbufs; i++) {
+        app.data[i] = malloc(BENCH_BUFSIZE);
+        if (!app.data[i] || use_buffer(hComp, i))
+            return -1;
+    }
+
+    /* Timed pass, all buffers cycle through the remote core */
+    start = now_ns();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < nbufs; i++)
+            submit(hComp, i);
+        wait_all_returned();
+    }
+    total = now_ns() - start;
+
+    /* Churn pass, half of the buffers are replaced while the others are
+       looked up by the callback thread */
+    for (r = 0; r < rounds && !failed; r++) {
+        int busy = r % 2;
+
+        for (i = 0; i < nbufs; i++)
+            if ((i / 2) % 2 == busy)
+                submit(hComp, i);
+        for (i = 0; i < nbufs && !failed; i++)
+            if ((i / 2) % 2 != busy)
+                failed = free_buffer(hComp, i) || use_buffer(hComp, i);
+        wait_all_returned();
+    }
+
+    for (i = 0; i < nbufs; i++) {
+        if (app.hdr[i] && free_buffer(hComp, i))
+            failed = 1;
+        free(app.data[i]);
+        app.data[i] = NULL;
+    }
+    if (hComp->ComponentDeInit(hComp) != OMX_ErrorNone)
+        failed = 1;
+    free(hComp);
+
+    *errors = app.errors;
+    return failed ? -1 : (double)total / ((double)rounds * nbufs);
+}
+
+int main(int argc, char **argv)
+{
+    static const int sizes[] = { 4, 8, 16, 32, 48, 64, 96 };
+    int rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+    long total_errors = 0;
+    unsigned int i;
+
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d rounds of ETB/FTB + EBD/FBD per buffer through the proxy\n", rounds);
+    printf("buffers  ns/round trip  churn errors\n");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        long errors = 0;
+        double ns = run(sizes[i], rounds, &errors);
+
+        if (ns < 0)
+            return 1;
+        printf("%7d  %13.1f  %12ld\n", sizes[i], ns, errors);
+        total_errors += errors;
+    }
+
+    if (total_errors) {
+        printf("%ld buffers came back wrong\n", total_errors);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#
+# Copyright (C) Texas Instruments - http://www.ti.com/
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+LOCAL_PATH:= $(call my-dir)
+
+RGZ_BENCH_SRC_FILES := rgz_bench.c ../../hwc/rgz_2d.c
+RGZ_BENCH_C_INCLUDES := \
+    $(LOCAL_PATH)/../../hwc \
+    $(LOCAL_PATH)/../../kernel-headers \
+    $(LOCAL_PATH)/../../include
+RGZ_BENCH_CFLAGS := -DLOG_TAG=\"rgz_bench\" -Wall
+
+ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
+RGZ_BENCH_CFLAGS += -DOMAP_ENHANCEMENT_HWC_EXTENDED_API
+endif
+
+# Regionizer benchmark for the target
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(RGZ_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(RGZ_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(RGZ_BENCH_CFLAGS)
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+LOCAL_MODULE := rgz_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+# Same benchmark running on the build host
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(RGZ_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(RGZ_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(RGZ_BENCH_CFLAGS)
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := rgz_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Regionizer benchmark
+ *
+ * Feeds synthetic HWC layer stacks into rgz_in/rgz_out the same way
+ * blit_layers() does with BLTMODE_REGION and reports the time spent per frame
+ * for every stack size up to what the HWC handles, until the regionizer gives
+ * up e.g. because the blits would not fit RGZ_MAX_BLITS. Two workloads are
+ * measured:
+ *
+ * geometry  one layer moves on every frame, the regions are regenerated
+ * content   one layer gets a new buffer on every frame, the geometry is static
+ *
+ * The content workload is measured a second time with the blit plan cache
+ * enabled as blit_layers() does with BLTPOLICY_ALL.
+ *
+ * usage: rgz_bench [frames] [width] [height]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hardware/hwcomposer.h>
+
+#include "hwc_dev.h"
+
+#define WIDTH(rect) ((rect).right - (rect).left)
+#define HEIGHT(rect) ((rect).bottom - (rect).top)
+
+#define DEFAULT_FRAMES 2000
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+
+/* Same as the maximum number of layers the HWC handles */
+#define BENCH_MAXLAYERS 32
+
+/* Two buffers per layer so content changes can flip between them */
+#define BENCH_BUFS 2
+
+enum { BENCH_GEOMETRY = 0, BENCH_CONTENT = 1 };
+
+struct bench_stack {
+    int layerno;
+    hwc_layer_1_t layers[BENCH_MAXLAYERS];
+#ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
+    hwc_layer_extended_t extlayers[BENCH_MAXLAYERS];
+#endif
+    IMG_native_handle_t handles[BENCH_MAXLAYERS][BENCH_BUFS];
+    int bufidx[BENCH_MAXLAYERS];
+};
+
+static unsigned int seed = 1;
+
+/* Deterministic so every run regionizes the same stacks */
+static int bench_rand(int range)
+{
+    seed = seed * 1103515245 + 12345;
+    return range > 0 ? (int)((seed >> 16) % range) : 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void set_frame(hwc_rect_t *r, int left, int top, int width, int height)
+{
+    r->left = left;
+    r->top = top;
+    r->right = left + width;
+    r->bottom = top + height;
+}
+
+/*
+ * Layer 0 is an opaque fullscreen wallpaper, the rest are blended layers of
+ * random size and position partially overlapping each other. Like on launcher
+ * and notification screens, odd layers are full width strips and even layers
+ * are smaller windows.
+ */
+static void init_stack(struct bench_stack *s, int layerno, int w, int h)
+{
+    int i, b;
+
+    memset(s, 0, sizeof(*s));
+    s->layerno = layerno;
+    for (i = 0; i < layerno; i++) {
+        hwc_layer_1_t *l = &s->layers[i];
+        int lw = !i || i & 1 ? w : w / 8 + bench_rand(w / 4);
+        int lh = !i ? h : i & 1 ? h / 16 + bench_rand(h / 8) : h / 8 + bench_rand(h / 4);
+
+        for (b = 0; b < BENCH_BUFS; b++) {
+            IMG_native_handle_t *hndl = &s->handles[i][b];
+            hndl->iWidth = lw;
+            hndl->iHeight = lh;
+            hndl->iFormat = i ? HAL_PIXEL_FORMAT_BGRA_8888 : HAL_PIXEL_FORMAT_RGBX_8888;
+            hndl->usage = GRALLOC_USAGE_HW_RENDER;
+        }
+
+        l->compositionType = HWC_FRAMEBUFFER;
+        l->handle = (buffer_handle_t)&s->handles[i][0];
+        l->blending = i ? HWC_BLENDING_PREMULT : HWC_BLENDING_NONE;
+        set_frame(&l->sourceCrop, 0, 0, lw, lh);
+        set_frame(&l->displayFrame, i ? bench_rand(w - lw) : 0,
+            i ? bench_rand(h - lh) : 0, lw, lh);
+        l->acquireFenceFd = l->releaseFenceFd = -1;
+#ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
+        s->extlayers[i].idx = i;
+        s->extlayers[i].identity = i + 1;
+#endif
+    }
+}
+
+static void update_stack(struct bench_stack *s, int mode, int frame, int w, int h)
+{
+    int i = s->layerno > 1 ? 1 + frame % (s->layerno - 1) : 0;
+    hwc_layer_1_t *l = &s->layers[i];
+
+    if (mode == BENCH_GEOMETRY && i) {
+        int lw = WIDTH(l->displayFrame);
+        int lh = HEIGHT(l->displayFrame);
+        set_frame(&l->displayFrame, bench_rand(w - lw), bench_rand(h - lh), lw, lh);
+    } else {
+        s->bufidx[i] = (s->bufidx[i] + 1) % BENCH_BUFS;
+        l->handle = (buffer_handle_t)&s->handles[i][s->bufidx[i]];
+    }
+
+    /* blit_layers() leaves every layer marked as an overlay */
+    for (i = 0; i < s->layerno; i++)
+        s->layers[i].compositionType = HWC_FRAMEBUFFER;
+}
+
+static int run(int layerno, int mode, int plancache, int frames, int w, int h,
+    double *us_per_frame, double *blits_per_frame)
+{
+    struct bench_stack *s = malloc(sizeof(*s));
+    struct bvsurfgeom geom;
+    rgz_t rgz;
+    uint64_t total = 0;
+    long blits = 0;
+    int f, rv = 0;
+
+    if (!s)
+        return -1;
+
+    rgz_set_screengeometry(&geom, w, h, w * 4, HAL_PIXEL_FORMAT_BGRA_8888);
+    memset(&rgz, 0, sizeof(rgz));
+    init_stack(s, layerno, w, h);
+
+    for (f = 0; f < frames; f++) {
+        update_stack(s, mode, f, w, h);
+
+        rgz_in_params_t in = {
+            .op = RGZ_IN_HWC,
+            .data = {
+                .hwc = {
+                    .dstgeom = &geom,
+                    .layers = s->layers,
+#ifdef OMAP_ENHANCEMENT_HWC_EXTENDED_API
+                    .extlayers = s->extlayers,
+#endif
+                    .layerno = s->layerno
+                }
+            }
+        };
+        rgz_out_params_t out = {
+            .op = RGZ_OUT_BVCMD_REGION,
+            .data = {
+                .bvc = {
+                    .dstgeom = &geom,
+                    .noblend = 0,
+                    .plancache = plancache,
+                }
+            }
+        };
+
+        uint64_t start = now_ns();
+        if (rgz_in(&in, &rgz) != RGZ_ALL || rgz_out(&rgz, &out) != 0) {
+            rv = -1;
+            break;
+        }
+        total += now_ns() - start;
+        blits += out.data.bvc.out_blits;
+    }
+
+    rgz_free(&rgz);
+    free(s);
+
+    *us_per_frame = frames ? total / 1000.0 / frames : 0;
+    *blits_per_frame = frames ? (double)blits / frames : 0;
+    return rv;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : DEFAULT_FRAMES;
+    int w = argc > 2 ? atoi(argv[2]) : DEFAULT_WIDTH;
+    int h = argc > 3 ? atoi(argv[3]) : DEFAULT_HEIGHT;
+    int layerno;
+
+    if (frames <= 0 || w <= 0 || h <= 0) {
+        fprintf(stderr, "usage: %s [frames] [width] [height]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d frames on a %dx%d screen\n", frames, w, h);
+    printf("layers  geometry us/frame  blits/frame  content us/frame  blits/frame  cached us/frame\n");
+    for (layerno = 1; layerno <= BENCH_MAXLAYERS; layerno++) {
+        double geom_us, geom_blits, content_us, content_blits, cached_us, cached_blits;
+        int rv;
+
+        seed = layerno;
+        rv = run(layerno, BENCH_GEOMETRY, 0, frames, w, h, &geom_us, &geom_blits);
+        seed = layerno;
+        if (!rv)
+            rv = run(layerno, BENCH_CONTENT, 0, frames, w, h, &content_us, &content_blits);
+        seed = layerno;
+        if (!rv)
+            rv = run(layerno, BENCH_CONTENT, 1, frames, w, h, &cached_us, &cached_blits);
+        if (rv) {
+            /* From here on blit_layers() would fall back to SGX composition */
+            printf("%6d  not accepted by the regionizer\n", layerno);
+            break;
+        }
+
+        printf("%6d  %17.2f  %11.1f  %16.2f  %11.1f  %15.2f\n", layerno,
+            geom_us, geom_blits, content_us, content_blits, cached_us);
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#
+# Copyright (C) Texas Instruments - http://www.ti.com/
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+LOCAL_PATH:= $(call my-dir)
+
+MSGQ_BENCH_C_INCLUDES := \
+    $(LOCAL_PATH)/../../libtiutils \
+    frameworks/native/include
+MSGQ_BENCH_CFLAGS := -Wall
+
+# MessageQueue benchmark for the target
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := msgq_bench.cpp
+LOCAL_C_INCLUDES := $(MSGQ_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(MSGQ_BENCH_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libtiutils libutils libcutils liblog
+LOCAL_MODULE := msgq_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+# Same benchmark running on the build host
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+    msgq_bench.cpp \
+    ../../libtiutils/MessageQueue.cpp \
+    ../../libtiutils/DebugUtils.cpp
+LOCAL_C_INCLUDES := $(MSGQ_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(MSGQ_BENCH_CFLAGS)
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+LOCAL_MODULE := msgq_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * MessageQueue benchmark
+ *
+ * Compares Ti::Utils::MessageQueue with the pipe based queue it replaced,
+ * kept below as PipeQueue. Two workloads are measured, both with the
+ * consumer looping the way AppCallbackNotifier::notificationThread() does:
+ * waitForMsg() on three queues, then draining every queue marked by it.
+ *
+ * throughput  one producer thread per queue puts messages as fast as it can
+ * latency     a producer wakes the idle consumer every 200us, the message
+ *             carries the time it was put
+ *
+ * usage: msgq_bench [messages]
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "MessageQueue.h"
+
+using Ti::Utils::Message;
+using Ti::Utils::MessageQueue;
+
+#define DEFAULT_MESSAGES 200000
+#define LATENCY_SAMPLES 2000
+#define LATENCY_PERIOD_US 200
+
+/* Same as the notification thread */
+#define BENCH_QUEUES 3
+
+enum { CMD_DATA = 1, CMD_EXIT = 2 };
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* The queue as it was: one write() per put, one read() per get */
+class PipeQueue
+{
+public:
+    PipeQueue() : mHasMsg(false)
+    {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            fds[0] = fds[1] = -1;
+        }
+        mRead = fds[0];
+        mWrite = fds[1];
+    }
+
+    ~PipeQueue()
+    {
+        close(mRead);
+        close(mWrite);
+    }
+
+    int put(Message *msg)
+    {
+        return write(mWrite, msg, sizeof(*msg)) == sizeof(*msg) ? 0 : -1;
+    }
+
+    int get(Message *msg)
+    {
+        size_t bytes = 0;
+        while (bytes < sizeof(*msg)) {
+            ssize_t err = read(mRead, (char *)msg + bytes, sizeof(*msg) - bytes);
+            if (err < 0)
+                return -1;
+            bytes += err;
+        }
+        mHasMsg = false;
+        return 0;
+    }
+
+    bool isEmpty()
+    {
+        struct pollfd pfd = { mRead, POLLIN, 0 };
+        poll(&pfd, 1, 0);
+        mHasMsg = pfd.revents & POLLIN;
+        return !mHasMsg;
+    }
+
+    bool hasMsg() { return mHasMsg; }
+
+    static int waitForMsg(PipeQueue *q1, PipeQueue *q2, PipeQueue *q3, int timeout)
+    {
+        PipeQueue *q[BENCH_QUEUES] = { q1, q2, q3 };
+        struct pollfd pfd[BENCH_QUEUES];
+        int i, n = 0, ret;
+
+        for (i = 0; i < BENCH_QUEUES && q[i]; i++, n++) {
+            pfd[i].fd = q[i]->mRead;
+            pfd[i].events = POLLIN;
+            pfd[i].revents = 0;
+        }
+        ret = poll(pfd, n, timeout);
+        for (i = 0; ret > 0 && i < n; i++)
+            if (pfd[i].revents & POLLIN)
+                q[i]->mHasMsg = true;
+        return ret;
+    }
+
+private:
+    int mRead;
+    int mWrite;
+    bool mHasMsg;
+};
+
+template <class Queue>
+struct Bench {
+    Queue queues[BENCH_QUEUES];
+    int messages;
+    int producers;
+    int periodUs;
+    uint64_t latencyTotal;
+    uint64_t latencyMax;
+};
+
+template <class Queue>
+struct Producer {
+    Bench<Queue> *bench;
+    int index;
+};
+
+template <class Queue>
+static void *produce(void *arg)
+{
+    Producer<Queue> *p = (Producer<Queue> *)arg;
+    Bench<Queue> *b = p->bench;
+    Message msg;
+    int i;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.command = CMD_DATA;
+    for (i = 0; i < b->messages; i++) {
+        if (b->periodUs)
+            usleep(b->periodUs);
+        msg.id = now_ns();
+        b->queues[p->index].put(&msg);
+    }
+
+    msg.command = CMD_EXIT;
+    b->queues[p->index].put(&msg);
+    return NULL;
+}
+
+/* Returns the messages received, all of them or -1 on a lost message */
+template <class Queue>
+static long consume(Bench<Queue> *b)
+{
+    int live = b->producers, i;
+    long received = 0;
+    Message msg;
+
+    while (live) {
+        Queue::waitForMsg(&b->queues[0], &b->queues[1], &b->queues[2], -1);
+        for (i = 0; i < BENCH_QUEUES; i++) {
+            if (!b->queues[i].hasMsg())
+                continue;
+            while (!b->queues[i].isEmpty()) {
+                b->queues[i].get(&msg);
+                if (msg.command == CMD_EXIT) {
+                    live--;
+                    continue;
+                }
+                if (b->periodUs) {
+                    uint64_t latency = now_ns() - msg.id;
+                    b->latencyTotal += latency;
+                    if (latency > b->latencyMax)
+                        b->latencyMax = latency;
+                }
+                received++;
+            }
+        }
+    }
+
+    return received == (long)b->messages * b->producers ? received : -1;
+}
+
+template <class Queue>
+static int run(int producers, int messages, int periodUs, double *rate,
+    double *avg_us, double *max_us)
+{
+    Bench<Queue> *b = new Bench<Queue>;
+    Producer<Queue> p[BENCH_QUEUES];
+    pthread_t threads[BENCH_QUEUES];
+    uint64_t start;
+    long received;
+    int i;
+
+    b->messages = messages;
+    b->producers = producers;
+    b->periodUs = periodUs;
+    b->latencyTotal = 0;
+    b->latencyMax = 0;
+
+    start = now_ns();
+    for (i = 0; i < producers; i++) {
+        p[i].bench = b;
+        p[i].index = i;
+        pthread_create(&threads[i], NULL, produce<Queue>, &p[i]);
+    }
+    received = consume(b);
+    for (i = 0; i < producers; i++)
+        pthread_join(threads[i], NULL);
+
+    if (received > 0) {
+        *rate = received * 1e9 / (now_ns() - start);
+        *avg_us = b->latencyTotal / 1000.0 / received;
+        *max_us = b->latencyMax / 1000.0;
+    }
+    delete b;
+    return received > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    int messages = argc > 1 ? atoi(argv[1]) : DEFAULT_MESSAGES;
+    double pipe_rate, ring_rate, pipe_avg, ring_avg, pipe_max, ring_max;
+    int producers;
+
+    if (messages <= 0) {
+        fprintf(stderr, "usage: %s [messages]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d messages per producer\n", messages);
+    printf("producers  pipe msgs/s  ring msgs/s\n");
+    for (producers = 1; producers <= BENCH_QUEUES; producers++) {
+        if (run<PipeQueue>(producers, messages, 0, &pipe_rate, &pipe_avg, &pipe_max) ||
+            run<MessageQueue>(producers, messages, 0, &ring_rate, &ring_avg, &ring_max)) {
+            fprintf(stderr, "messages lost with %d producers\n", producers);
+            return 1;
+        }
+        printf("%9d  %11.0f  %11.0f\n", producers, pipe_rate, ring_rate);
+    }
+
+    printf("\nwakeup latency, one message every %dus\n", LATENCY_PERIOD_US);
+    if (run<PipeQueue>(1, LATENCY_SAMPLES, LATENCY_PERIOD_US, &pipe_rate, &pipe_avg, &pipe_max) ||
+        run<MessageQueue>(1, LATENCY_SAMPLES, LATENCY_PERIOD_US, &ring_rate, &ring_avg, &ring_max)) {
+        fprintf(stderr, "messages lost\n");
+        return 1;
+    }
+    printf("queue  avg us  max us\n");
+    printf("pipe   %6.1f  %6.1f\n", pipe_avg, pipe_max);
+    printf("ring   %6.1f  %6.1f\n", ring_avg, ring_max);
+    return 0;
+}
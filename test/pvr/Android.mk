@@ -0,0 +1,95 @@
+#
+# Copyright (C) Texas Instruments - http://www.ti.com/
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+LOCAL_PATH:= $(call my-dir)
+
+PVR_SRVKM := ../../pvr-source/services4/srvkm
+
+# The services sources are built into userspace, mmap.h from this directory
+# stands in for the kernel only one
+RA_BENCH_SRC_FILES := \
+    ra_bench.c \
+    $(PVR_SRVKM)/common/ra.c \
+    $(PVR_SRVKM)/common/hash.c
+RA_BENCH_C_INCLUDES := \
+    $(LOCAL_PATH) \
+    $(LOCAL_PATH)/../../pvr-source/include4 \
+    $(LOCAL_PATH)/../../pvr-source/services4/include \
+    $(LOCAL_PATH)/$(PVR_SRVKM)/include \
+    $(LOCAL_PATH)/$(PVR_SRVKM)/hwdefs \
+    $(LOCAL_PATH)/$(PVR_SRVKM)/devices/sgx \
+    $(LOCAL_PATH)/../../pvr-source/services4/system/include \
+    $(LOCAL_PATH)/../../pvr-source/services4/system/omap4
+RA_BENCH_CFLAGS := -DLINUX -DSGX540 -DSUPPORT_SGX540 -DSGX_CORE_REV=120
+
+# Resource arena benchmark for the target
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(RA_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(RA_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(RA_BENCH_CFLAGS)
+LOCAL_MODULE := ra_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+# Same benchmark running on the build host
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(RA_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(RA_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(RA_BENCH_CFLAGS)
+LOCAL_LDLIBS := -lrt
+LOCAL_MODULE := ra_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+HASH_BENCH_SRC_FILES := \
+    hash_bench.c \
+    $(PVR_SRVKM)/common/hash.c
+
+# Hash table benchmark, chained backend
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(HASH_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(RA_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(RA_BENCH_CFLAGS)
+LOCAL_MODULE := hash_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(HASH_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(RA_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(RA_BENCH_CFLAGS)
+LOCAL_LDLIBS := -lrt
+LOCAL_MODULE := hash_bench
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# Same benchmark with the open addressing backend
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(HASH_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(RA_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(RA_BENCH_CFLAGS) -DPVR_HASH_OPEN_ADDRESSING
+LOCAL_MODULE := hash_bench_oa
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := $(HASH_BENCH_SRC_FILES)
+LOCAL_C_INCLUDES := $(RA_BENCH_C_INCLUDES)
+LOCAL_CFLAGS := $(RA_BENCH_CFLAGS) -DPVR_HASH_OPEN_ADDRESSING
+LOCAL_LDLIBS := -lrt
+LOCAL_MODULE := hash_bench_oa
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * PVR services hash table benchmark
+ *
+ * Links hash.c into a userspace program and runs the key mixes its users
+ * produce, for a range of live entry counts. Built once per backend,
+ * hash_bench for the chained one and hash_bench_oa for the open addressing
+ * one (PVR_HASH_OPEN_ADDRESSING). Three workloads are measured:
+ *
+ * ra      the resource arena segment map: page aligned base addresses of a
+ *         heap are inserted and removed at random around a steady live
+ *         count, addresses are reused as they are freed
+ * lookup  handle lookups: 90% retrieves of live keys, the rest inserts and
+ *         removes
+ * grow    the table is filled from empty and drained again, the worst
+ *         single insert or remove is reported as resizing happens there
+ *
+ * Every retrieve and remove is checked against the value inserted.
+ *
+ * usage: hash_bench [ops]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "services_headers.h"
+#include "hash.h"
+
+#define DEFAULT_OPS 1000000
+
+#define HEAP_BASE 0x10000000
+#define HEAP_QUANTUM 4096
+
+/* Table created with the initial size the resource arena uses */
+#define INITIAL_SIZE 64
+
+static const int live_counts[] = { 10, 100, 1000, 10000, 100000 };
+
+struct bench_keys {
+    /* pages of the heap, the first nlive are in the table */
+    IMG_UINTPTR_T *pages;
+    int npages;
+    int nlive;
+};
+
+static unsigned long os_allocs;
+static unsigned long errors;
+static unsigned int seed = 1;
+
+/* OS layer stubs used by hash.c */
+
+PVRSRV_ERROR OSAllocMem_Impl(IMG_UINT32 ui32Flags, IMG_SIZE_T ui32Size,
+    IMG_PVOID *ppvLinAddr, IMG_HANDLE *phBlockAlloc)
+{
+    (void)ui32Flags;
+    (void)phBlockAlloc;
+    os_allocs++;
+    *ppvLinAddr = malloc(ui32Size);
+    return *ppvLinAddr ? PVRSRV_OK : PVRSRV_ERROR_OUT_OF_MEMORY;
+}
+
+PVRSRV_ERROR OSFreeMem_Impl(IMG_UINT32 ui32Flags, IMG_SIZE_T ui32Size,
+    IMG_PVOID pvLinAddr, IMG_HANDLE hBlockAlloc)
+{
+    (void)ui32Flags;
+    (void)ui32Size;
+    (void)hBlockAlloc;
+    free(pvLinAddr);
+    return PVRSRV_OK;
+}
+
+IMG_VOID OSMemSet(IMG_VOID *pvDest, IMG_UINT8 ui8Value, IMG_SIZE_T ui32Size)
+{
+    memset(pvDest, ui8Value, ui32Size);
+}
+
+IMG_VOID OSMemCopy(IMG_VOID *pvDst, IMG_VOID *pvSrc, IMG_SIZE_T ui32Size)
+{
+    memcpy(pvDst, pvSrc, ui32Size);
+}
+
+static unsigned int bench_rand(unsigned int range)
+{
+    seed = seed * 1103515245 + 12345;
+    return range ? (seed >> 8) % range : 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Values are the page number plus one so a missing key (0) is told apart */
+static IMG_UINTPTR_T page_value(IMG_UINTPTR_T key)
+{
+    return (key - HEAP_BASE) / HEAP_QUANTUM + 1;
+}
+
+static int init_keys(struct bench_keys *k, int live)
+{
+    int i;
+
+    /* A quarter full heap, like the arena after some churn */
+    k->npages = live * 4;
+    k->nlive = 0;
+    k->pages = malloc(k->npages * sizeof(*k->pages));
+    if (!k->pages)
+        return -1;
+    for (i = 0; i < k->npages; i++)
+        k->pages[i] = HEAP_BASE + (IMG_UINTPTR_T)i * HEAP_QUANTUM;
+    /* Shuffle so pages are handed out in no particular order */
+    for (i = k->npages - 1; i > 0; i--) {
+        int j = bench_rand(i + 1);
+        IMG_UINTPTR_T t = k->pages[i];
+        k->pages[i] = k->pages[j];
+        k->pages[j] = t;
+    }
+    return 0;
+}
+
+static void swap_key(struct bench_keys *k, int a, int b)
+{
+    IMG_UINTPTR_T t = k->pages[a];
+    k->pages[a] = k->pages[b];
+    k->pages[b] = t;
+}
+
+/* Insert a random free page */
+static void insert_one(HASH_TABLE *h, struct bench_keys *k)
+{
+    int i = k->nlive + bench_rand(k->npages - k->nlive);
+    IMG_UINTPTR_T key = k->pages[i];
+
+    if (!HASH_Insert(h, key, page_value(key)))
+        errors++;
+    swap_key(k, i, k->nlive++);
+}
+
+/* Remove a random live page */
+static void remove_one(HASH_TABLE *h, struct bench_keys *k)
+{
+    int i = bench_rand(k->nlive);
+    IMG_UINTPTR_T key = k->pages[i];
+
+    if (HASH_Remove(h, key) != page_value(key))
+        errors++;
+    swap_key(k, i, --k->nlive);
+}
+
+static void retrieve_one(HASH_TABLE *h, struct bench_keys *k)
+{
+    IMG_UINTPTR_T key = k->pages[bench_rand(k->nlive)];
+
+    if (HASH_Retrieve(h, key) != page_value(key))
+        errors++;
+}
+
+static void drain(HASH_TABLE *h, struct bench_keys *k)
+{
+    while (k->nlive)
+        remove_one(h, k);
+}
+
+static void fill(HASH_TABLE *h, struct bench_keys *k, int live)
+{
+    while (k->nlive < live)
+        insert_one(h, k);
+}
+
+static double run_ra(HASH_TABLE *h, struct bench_keys *k, int live, int ops)
+{
+    uint64_t start;
+    int i;
+
+    fill(h, k, live);
+    start = now_ns();
+    for (i = 0; i < ops; i++) {
+        /* Free and allocate at random, within an eighth of the live count */
+        if (k->nlive > live + live / 8 ||
+            (k->nlive > live - live / 8 && bench_rand(2)))
+            remove_one(h, k);
+        else if (k->nlive < k->npages)
+            insert_one(h, k);
+    }
+    return (double)(now_ns() - start) / ops;
+}
+
+static double run_lookup(HASH_TABLE *h, struct bench_keys *k, int live, int ops)
+{
+    uint64_t start;
+    int i;
+
+    fill(h, k, live);
+    start = now_ns();
+    for (i = 0; i < ops; i++) {
+        unsigned int r = bench_rand(20);
+
+        if (r >= 2 || !k->nlive)
+            retrieve_one(h, k);
+        else if (r == 0 && k->nlive > live / 2)
+            remove_one(h, k);
+        else if (k->nlive < k->npages)
+            insert_one(h, k);
+    }
+    return (double)(now_ns() - start) / ops;
+}
+
+static double run_grow(HASH_TABLE *h, struct bench_keys *k, int live, int ops,
+    uint64_t *worst)
+{
+    uint64_t total = 0, start, t;
+    long n = 0;
+
+    drain(h, k);
+    *worst = 0;
+    do {
+        while (k->nlive < live) {
+            start = now_ns();
+            insert_one(h, k);
+            t = now_ns() - start;
+            total += t;
+            if (t > *worst)
+                *worst = t;
+            n++;
+        }
+        while (k->nlive) {
+            start = now_ns();
+            remove_one(h, k);
+            t = now_ns() - start;
+            total += t;
+            if (t > *worst)
+                *worst = t;
+            n++;
+        }
+    } while (n < ops);
+    return (double)total / n;
+}
+
+int main(int argc, char **argv)
+{
+    int ops = argc > 1 ? atoi(argv[1]) : DEFAULT_OPS;
+    unsigned int i;
+
+    if (ops <= 0) {
+        fprintf(stderr, "usage: %s [ops]\n", argv[0]);
+        return 1;
+    }
+
+#if defined(PVR_HASH_OPEN_ADDRESSING)
+    printf("open addressing backend, %d ops per workload\n", ops);
+#else
+    printf("chained backend, %d ops per workload\n", ops);
+#endif
+    printf("   live  ra ns/op  lookup ns/op  grow ns/op  worst ns  OSAllocMem/op\n");
+    for (i = 0; i < sizeof(live_counts) / sizeof(live_counts[0]); i++) {
+        int live = live_counts[i];
+        struct bench_keys k;
+        HASH_TABLE *h;
+        double ra_ns, lookup_ns, grow_ns;
+        unsigned long allocs;
+        uint64_t worst;
+
+        seed = live;
+        if (init_keys(&k, live))
+            return 1;
+        h = HASH_Create(INITIAL_SIZE);
+        if (!h) {
+            fprintf(stderr, "HASH_Create failed\n");
+            return 1;
+        }
+
+        allocs = os_allocs;
+        ra_ns = run_ra(h, &k, live, ops);
+        allocs = os_allocs - allocs;
+        lookup_ns = run_lookup(h, &k, live, ops);
+        grow_ns = run_grow(h, &k, live, ops, &worst);
+
+        drain(h, &k);
+        HASH_Delete(h);
+        free(k.pages);
+
+        printf("%7d  %8.1f  %12.1f  %10.1f  %8llu  %13.3f\n", live, ra_ns,
+            lookup_ns, grow_ns, (unsigned long long)worst, (double)allocs / ops);
+    }
+
+    if (errors) {
+        printf("%lu lookups returned the wrong value\n", errors);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stands in for services4/srvkm/env/linux/mmap.h, which needs kernel
+ * headers, when services code is built into userspace benchmarks. Only the
+ * fields refcount.h touches are provided.
+ */
+
+#ifndef __MMAP_H__
+#define __MMAP_H__
+
+typedef struct KV_OFFSET_STRUCT_TAG
+{
+	IMG_UINT32 ui32Mapped;
+	IMG_UINT32 ui32RefCount;
+} KV_OFFSET_STRUCT, *PKV_OFFSET_STRUCT;
+
+#endif
@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * PVR resource arena benchmark
+ *
+ * Links the services resource allocator (ra.c, hash.c) into a userspace
+ * program with the OS functions it needs stubbed out and replays an
+ * allocation trace against an arena laid out like the device memory heaps
+ * buffer_manager.c carves from it: one fixed span, page quantum, page or
+ * 64K aligned requests. Reports the time per RA_Alloc/RA_Free, the number
+ * of OSAllocMem calls the arena made, the allocations that failed and the
+ * external fragmentation (1 - largest free extent / free bytes) averaged
+ * over the run.
+ *
+ * Without a trace file a synthetic one is generated: the heap is filled to
+ * about three quarters with a mix of small, medium and large buffers which
+ * are then freed and reallocated at random. A trace file has one operation
+ * per line:
+ *
+ *   a <id> <size> <alignment>
+ *   f <id>
+ *
+ * usage: ra_bench [ops]
+ *        ra_bench -t <tracefile>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "services_headers.h"
+#include "ra.h"
+
+#define DEFAULT_OPS 200000
+
+#define HEAP_BASE 0x10000000
+#define HEAP_SIZE (64 * 1024 * 1024)
+#define HEAP_QUANTUM 4096
+
+/* Live allocations the synthetic trace keeps around at most */
+#define MAX_LIVE 8192
+
+/* Fragmentation is sampled every SAMPLE_OPS operations */
+#define SAMPLE_OPS 1000
+
+struct bench_alloc {
+    IMG_UINTPTR_T base;
+    IMG_SIZE_T size;
+};
+
+static unsigned long os_allocs;
+static unsigned int seed = 1;
+
+#if defined(__x86_64__) && defined(MAP_32BIT)
+/*
+ * Services keep pointers in 32 bit IMG_UINTPTR_T (segment hash values), so
+ * on a 64 bit build host memory handed to them has to stay below 4G. Blocks
+ * come from a MAP_32BIT pool and are recycled per 16 byte size class.
+ */
+#define LOW_POOL_SIZE (256 * 1024 * 1024)
+#define LOW_CLASSES 4096
+
+static char *low_pool, *low_next;
+static void *low_free[LOW_CLASSES];
+
+static void *low_alloc(size_t size)
+{
+    size_t cls = (size + 15) / 16;
+    void *p;
+
+    if (cls < LOW_CLASSES && low_free[cls]) {
+        p = low_free[cls];
+        low_free[cls] = *(void **)p;
+        return p;
+    }
+    if (!low_pool) {
+        low_pool = mmap(NULL, LOW_POOL_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+        if (low_pool == MAP_FAILED) {
+            low_pool = NULL;
+            return NULL;
+        }
+        low_next = low_pool;
+    }
+    if (low_next + cls * 16 > low_pool + LOW_POOL_SIZE)
+        return NULL;
+    p = low_next;
+    low_next += cls * 16;
+    return p;
+}
+
+static void low_release(void *p, size_t size)
+{
+    size_t cls = (size + 15) / 16;
+
+    if (cls < LOW_CLASSES) {
+        *(void **)p = low_free[cls];
+        low_free[cls] = p;
+    }
+}
+#else
+#define low_alloc(size) malloc(size)
+#define low_release(p, size) free(p)
+#endif
+
+/* OS layer stubs used by ra.c and hash.c */
+
+PVRSRV_ERROR OSAllocMem_Impl(IMG_UINT32 ui32Flags, IMG_SIZE_T ui32Size,
+    IMG_PVOID *ppvLinAddr, IMG_HANDLE *phBlockAlloc)
+{
+    (void)ui32Flags;
+    (void)phBlockAlloc;
+    os_allocs++;
+    *ppvLinAddr = low_alloc(ui32Size);
+    return *ppvLinAddr ? PVRSRV_OK : PVRSRV_ERROR_OUT_OF_MEMORY;
+}
+
+PVRSRV_ERROR OSFreeMem_Impl(IMG_UINT32 ui32Flags, IMG_SIZE_T ui32Size,
+    IMG_PVOID pvLinAddr, IMG_HANDLE hBlockAlloc)
+{
+    (void)ui32Flags;
+    (void)hBlockAlloc;
+    if (pvLinAddr)
+        low_release(pvLinAddr, ui32Size);
+    return PVRSRV_OK;
+}
+
+IMG_VOID OSMemSet(IMG_VOID *pvDest, IMG_UINT8 ui8Value, IMG_SIZE_T ui32Size)
+{
+    memset(pvDest, ui8Value, ui32Size);
+}
+
+IMG_VOID OSMemCopy(IMG_VOID *pvDst, IMG_VOID *pvSrc, IMG_SIZE_T ui32Size)
+{
+    memcpy(pvDst, pvSrc, ui32Size);
+}
+
+IMG_UINT32 OSGetCurrentProcessIDKM(IMG_VOID)
+{
+    return 0;
+}
+
+int OSGetProcCmdline(IMG_UINT32 ui32PID, char *buffer, int buff_size)
+{
+    (void)ui32PID;
+    return snprintf(buffer, buff_size, "ra_bench");
+}
+
+const char *OSGetPathBaseName(char *buffer, int buff_size)
+{
+    (void)buff_size;
+    return buffer;
+}
+
+IMG_INT32 OSSNPrintf(IMG_CHAR *pStr, IMG_SIZE_T ui32Size, const IMG_CHAR *pszFormat, ...)
+{
+    va_list ap;
+    int ret;
+
+    va_start(ap, pszFormat);
+    ret = vsnprintf(pStr, ui32Size, pszFormat, ap);
+    va_end(ap);
+    return ret;
+}
+
+/* Failed allocations dump the heap, which is expected when it is full */
+IMG_VOID PVRSRVReleasePrintf(const IMG_CHAR *pszFormat, ...)
+{
+    (void)pszFormat;
+}
+
+static unsigned int bench_rand(unsigned int range)
+{
+    seed = seed * 1103515245 + 12345;
+    return range ? (seed >> 8) % range : 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare_base(const void *a, const void *b)
+{
+    const struct bench_alloc *pa = a, *pb = b;
+    return pa->base < pb->base ? -1 : pa->base > pb->base;
+}
+
+/* 1 - largest free extent / free bytes of the heap */
+static double fragmentation(const struct bench_alloc *live, int nlive)
+{
+    struct bench_alloc *sorted = malloc(nlive * sizeof(*sorted) + 1);
+    IMG_UINTPTR_T pos = HEAP_BASE;
+    IMG_SIZE_T largest = 0, total = 0, gap;
+    int i, n = 0;
+
+    if (!sorted)
+        return 0;
+    for (i = 0; i < nlive; i++)
+        if (live[i].size)
+            sorted[n++] = live[i];
+    qsort(sorted, n, sizeof(*sorted), compare_base);
+
+    for (i = 0; i <= n; i++) {
+        IMG_UINTPTR_T end = i < n ? sorted[i].base : HEAP_BASE + HEAP_SIZE;
+        gap = end - pos;
+        total += gap;
+        if (gap > largest)
+            largest = gap;
+        if (i < n)
+            pos = sorted[i].base + sorted[i].size;
+    }
+    free(sorted);
+
+    return total ? 1.0 - (double)largest / total : 0;
+}
+
+/* Buffer mix of a graphics heap: textures and vertex data up to 64K,
+ * render targets up to 1M and the odd camera or video frame up to 4M */
+static void synth_request(IMG_SIZE_T *size, IMG_UINT32 *align)
+{
+    unsigned int r = bench_rand(100);
+
+    if (r < 60)
+        *size = 4096 + bench_rand(60 * 1024);
+    else if (r < 90)
+        *size = 64 * 1024 + bench_rand(960 * 1024);
+    else
+        *size = 1024 * 1024 + bench_rand(3 * 1024 * 1024);
+    *size = (*size + HEAP_QUANTUM - 1) / HEAP_QUANTUM * HEAP_QUANTUM;
+    *align = bench_rand(4) ? HEAP_QUANTUM : 64 * 1024;
+}
+
+struct bench_result {
+    unsigned long allocs, frees, failed;
+    uint64_t alloc_ns, free_ns;
+    double frag;
+    int samples;
+};
+
+static void do_alloc(RA_ARENA *arena, struct bench_alloc *a, IMG_SIZE_T size,
+    IMG_UINT32 align, struct bench_result *r)
+{
+    IMG_UINTPTR_T base;
+    uint64_t start = now_ns();
+    IMG_BOOL ok = RA_Alloc(arena, size, IMG_NULL, IMG_NULL, 0, align, 0,
+        IMG_NULL, 0, &base);
+
+    r->alloc_ns += now_ns() - start;
+    r->allocs++;
+    if (ok) {
+        a->base = base;
+        a->size = size;
+    } else {
+        r->failed++;
+    }
+}
+
+static void do_free(RA_ARENA *arena, struct bench_alloc *a, struct bench_result *r)
+{
+    uint64_t start = now_ns();
+
+    RA_Free(arena, a->base, IMG_FALSE);
+    r->free_ns += now_ns() - start;
+    r->frees++;
+    a->size = 0;
+}
+
+static void sample(const struct bench_alloc *live, int nlive, struct bench_result *r)
+{
+    r->frag += fragmentation(live, nlive);
+    r->samples++;
+}
+
+static int run_synthetic(RA_ARENA *arena, int ops, struct bench_result *r)
+{
+    static struct bench_alloc live[MAX_LIVE];
+    IMG_SIZE_T used = 0;
+    int i, nlive = 0;
+
+    for (i = 0; i < ops; i++) {
+        if (nlive && (used > HEAP_SIZE / 4 * 3 || nlive == MAX_LIVE || bench_rand(2))) {
+            int k = bench_rand(nlive);
+            used -= live[k].size;
+            do_free(arena, &live[k], r);
+            live[k] = live[--nlive];
+        } else {
+            IMG_SIZE_T size;
+            IMG_UINT32 align;
+            synth_request(&size, &align);
+            do_alloc(arena, &live[nlive], size, align, r);
+            if (live[nlive].size) {
+                used += size;
+                nlive++;
+            }
+        }
+        if (i % SAMPLE_OPS == SAMPLE_OPS - 1)
+            sample(live, nlive, r);
+    }
+
+    while (nlive)
+        do_free(arena, &live[--nlive], r);
+    return 0;
+}
+
+static int run_trace(RA_ARENA *arena, FILE *fp, struct bench_result *r)
+{
+    struct bench_alloc *live = NULL;
+    int nids = 0, ops = 0, id, i;
+    unsigned long size, align;
+    char op;
+
+    while (fscanf(fp, " %c %d", &op, &id) == 2) {
+        if (id < 0)
+            break;
+        if (id >= nids) {
+            int n = id * 2 + 16;
+            struct bench_alloc *grown = realloc(live, n * sizeof(*live));
+            if (!grown)
+                break;
+            memset(grown + nids, 0, (n - nids) * sizeof(*live));
+            live = grown;
+            nids = n;
+        }
+        if (op == 'a' && fscanf(fp, "%lu %lu", &size, &align) == 2) {
+            if (live[id].size)
+                do_free(arena, &live[id], r);
+            do_alloc(arena, &live[id], size, align, r);
+        } else if (op == 'f' && live[id].size) {
+            do_free(arena, &live[id], r);
+        }
+        if (++ops % SAMPLE_OPS == 0)
+            sample(live, nids, r);
+    }
+
+    for (i = 0; i < nids; i++)
+        if (live[i].size)
+            do_free(arena, &live[i], r);
+    free(live);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_result r;
+    RA_ARENA *arena;
+    FILE *trace = NULL;
+    int ops = DEFAULT_OPS;
+    unsigned long arena_allocs;
+
+    if (argc > 2 && !strcmp(argv[1], "-t")) {
+        trace = fopen(argv[2], "r");
+        if (!trace) {
+            perror(argv[2]);
+            return 1;
+        }
+    } else if (argc > 1) {
+        ops = atoi(argv[1]);
+    }
+    if (ops <= 0) {
+        fprintf(stderr, "usage: %s [ops]\n       %s -t <tracefile>\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    memset(&r, 0, sizeof(r));
+    arena = RA_Create("ra_bench", HEAP_BASE, HEAP_SIZE, IMG_NULL, HEAP_QUANTUM,
+        IMG_NULL, IMG_NULL, IMG_NULL, IMG_NULL);
+    if (!arena) {
+        fprintf(stderr, "RA_Create failed\n");
+        return 1;
+    }
+    arena_allocs = os_allocs;
+
+    if (trace) {
+        run_trace(arena, trace, &r);
+        fclose(trace);
+    } else {
+        run_synthetic(arena, ops, &r);
+    }
+
+    printf("%lu allocs (%lu failed), %lu frees on a %d MB heap\n",
+        r.allocs, r.failed, r.frees, HEAP_SIZE >> 20);
+    printf("RA_Alloc %.1f ns  RA_Free %.1f ns\n",
+        r.allocs ? (double)r.alloc_ns / r.allocs : 0,
+        r.frees ? (double)r.free_ns / r.frees : 0);
+    printf("OSAllocMem calls %lu  fragmentation %.3f\n",
+        os_allocs - arena_allocs, r.samples ? r.frag / r.samples : 0);
+
+    RA_Delete(arena);
+    return 0;
+}